@@ -0,0 +1,110 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* pgn-benchrun: run one benchmark workload and write its result as a
+ * single line of JSON, for bench/run-benchmarks.
+ * The wall time, user and system time and peak resident set size
+ * are those of the command, which is run as a child process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s workload games bytes command [argument ...]\n"
+          "Run command and write the JSON result of workload, which "
+          "processes games games of bytes bytes, to stdout.\n",
+          program);
+  exit(1);
+}
+
+static double seconds_of(const struct timeval *tv) {
+  return (double)tv->tv_sec + (double)tv->tv_usec / 1e6;
+}
+
+/* Write str as a JSON string. */
+static void print_json_string(const char *str) {
+  putchar('"');
+  for (; *str != '\0'; str++) {
+    if (*str == '"' || *str == '\\') {
+      putchar('\\');
+    }
+    putchar(*str);
+  }
+  putchar('"');
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long games, bytes;
+  struct timespec start, end;
+  struct rusage resources;
+  int status;
+  pid_t child;
+  double wall;
+
+  if (argc < 5 || sscanf(argv[2], "%lu", &games) != 1 ||
+      sscanf(argv[3], "%lu", &bytes) != 1) {
+    usage(argv[0]);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  child = fork();
+  if (child < 0) {
+    perror("fork");
+    exit(1);
+  } else if (child == 0) {
+    execvp(argv[4], &argv[4]);
+    perror(argv[4]);
+    _exit(127);
+  }
+  if (wait4(child, &status, 0, &resources) < 0) {
+    perror("wait4");
+    exit(1);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s: the %s workload failed.\n", argv[0], argv[1]);
+    exit(1);
+  }
+  wall = (double)(end.tv_sec - start.tv_sec) +
+         (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  if (wall <= 0) {
+    wall = 1e-9;
+  }
+
+  printf("{\"workload\": ");
+  print_json_string(argv[1]);
+  printf(", \"games\": %lu, \"bytes\": %lu", games, bytes);
+  printf(", \"wall_seconds\": %.3f, \"user_seconds\": %.3f", wall,
+         seconds_of(&resources.ru_utime));
+  printf(", \"system_seconds\": %.3f", seconds_of(&resources.ru_stime));
+  /* ru_maxrss is in kilobytes on Linux. */
+  printf(", \"peak_rss_kb\": %ld", resources.ru_maxrss);
+  printf(", \"games_per_second\": %.0f, \"mb_per_second\": %.2f}\n",
+         games / wall, bytes / wall / 1e6);
+  return 0;
+}
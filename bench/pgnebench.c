@@ -0,0 +1,616 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* pgne-bench: time the core kernels of the pgne library in isolation.
+ * The games of a PGN file are read once to record the inputs of each
+ * kernel: the move text, the decoded moves and the positions before
+ * each move of the main lines, and the tags of each game.
+ * Each kernel is then run over its recorded inputs, after some warm-up
+ * runs, and the ns/op of the repetitions are summarised.
+ *
+ * Kernels that are private to their module are timed through the
+ * public function that calls them:
+ *     get_next_symbol through next_token, which includes the
+ *         decoding of moves by the lexer;
+ *     check_list through check_tag_details_not_ECO;
+ *     print_move through format_game, which includes a replay
+ *         of the game.
+ */
+
+#include "apply.h"
+#include "decode.h"
+#include "defs.h"
+#include "fenmatcher.h"
+#include "grammar.h"
+#include "lex.h"
+#include "map.h"
+#include "moves.h"
+#include "mymalloc.h"
+#include "output.h"
+#include "taglist.h"
+#include "tokens.h"
+#include "typedef.h"
+#include "zobrist.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The most repetitions of a kernel. */
+#define MAX_REPETITIONS 1000
+
+typedef struct {
+  /* The tags of the game, indexed by TagName, and any others. */
+  char **tags;
+  ExtraTag *extra_tags;
+  unsigned num_extra_tags;
+  /* The main line, decoded and applied. */
+  Move *moves;
+  unsigned long plies;
+} RecordedGame;
+
+typedef struct {
+  /* The position before the move. */
+  Board board;
+  /* The move as decoded by the lexer, before it was applied. */
+  Move decoded;
+  /* The move as applied to board. */
+  const Move *applied;
+} RecordedPly;
+
+typedef struct {
+  RecordedGame *games;
+  unsigned long num_games, games_space;
+  RecordedPly *plies;
+  unsigned long num_plies, plies_space;
+} Recording;
+
+typedef struct {
+  /* Runs of each kernel that are not timed. */
+  unsigned warm_up;
+  /* Timed runs of each kernel. */
+  unsigned repetitions;
+  /* The most games to record. */
+  unsigned long games;
+  /* The -t criterion for check_list, as for extract_tag_argument. */
+  const char *tag_criterion;
+  /* The --fenpattern for pattern_match_board. */
+  const char *fen_pattern;
+} Settings;
+
+/* A kernel runs over the recording and returns the number of operations. */
+typedef unsigned long (*Kernel)(const Recording *recording);
+
+/* The library needs a state, but few of the program's options. */
+static StateInfo globals;
+static GameHeader game_header;
+/* Where format_game writes. */
+static FILE *null_output;
+/* Results of the kernels, so that their calls are not optimised away. */
+static volatile unsigned long sink;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Free the value of a token that is not being recorded. */
+static void discard_token(TokenType token) {
+  switch (token) {
+  case STRING:
+  case NAG:
+  case TERMINATING_RESULT:
+    (void)free((void *)yylval.token_string);
+    break;
+  case COMMENT:
+    free_comment_list(&game_header, yylval.comment);
+    break;
+  case MOVE:
+    free_move_list(&game_header, yylval.move_details);
+    break;
+  default:
+    break;
+  }
+}
+
+/* The state of the game being recorded. */
+typedef struct {
+  /* Whether the moves of the game have started. */
+  bool in_moves;
+  /* Whether a move of the main line could not be applied. */
+  bool failed;
+  Board board;
+  Move *head, *tail;
+  /* The index of the first ply of the game in the recording. */
+  unsigned long first_ply;
+} GameInProgress;
+
+static void record_ply(Recording *recording, const Board *board,
+                       const Move *decoded, const Move *applied) {
+  if (recording->num_plies == recording->plies_space) {
+    recording->plies_space =
+        recording->plies_space == 0 ? 1024 : 2 * recording->plies_space;
+    recording->plies = (RecordedPly *)realloc_or_die(
+        recording->plies, recording->plies_space * sizeof(RecordedPly));
+  }
+  RecordedPly *ply = &recording->plies[recording->num_plies++];
+  ply->board = *board;
+  ply->decoded = *decoded;
+  ply->applied = applied;
+}
+
+/* Apply a move of the main line of the game in progress. */
+static void record_move(Recording *recording, GameInProgress *game,
+                        Move *move) {
+  if (!game->in_moves) {
+    Board *board =
+        new_game_board(&globals, &game_header, game_header.Tags[FEN_TAG]);
+
+    game->in_moves = true;
+    if (board != NULL) {
+      game->board = *board;
+      free_board(board);
+    } else {
+      game->failed = true;
+    }
+  }
+  if (game->failed) {
+    free_move_list(&game_header, move);
+  } else {
+    Board before = game->board;
+    Move decoded = *move;
+
+    if (apply_move(&globals, &game_header, move, &game->board)) {
+      record_ply(recording, &before, &decoded, move);
+      if (game->tail == NULL) {
+        game->head = move;
+      } else {
+        game->tail->next = move;
+        move->prev = game->tail;
+      }
+      game->tail = move;
+    } else {
+      free_move_list(&game_header, move);
+      game->failed = true;
+    }
+  }
+}
+
+/* Keep the game in progress if it is complete, and start another. */
+static void finish_game(Recording *recording, GameInProgress *game,
+                        char *result) {
+  unsigned tag;
+
+  if (!game->failed && game->head != NULL) {
+    RecordedGame *recorded;
+
+    if (recording->num_games == recording->games_space) {
+      recording->games_space =
+          recording->games_space == 0 ? 256 : 2 * recording->games_space;
+      recording->games = (RecordedGame *)realloc_or_die(
+          recording->games, recording->games_space * sizeof(RecordedGame));
+    }
+    recorded = &recording->games[recording->num_games++];
+    recorded->tags = (char **)malloc_or_die(ORIGINAL_NUMBER_OF_TAGS *
+                                            sizeof(*recorded->tags));
+    memcpy(recorded->tags, game_header.Tags,
+           ORIGINAL_NUMBER_OF_TAGS * sizeof(*recorded->tags));
+    recorded->num_extra_tags = game_header.num_extra_tags;
+    recorded->extra_tags = (ExtraTag *)malloc_or_die(
+        (recorded->num_extra_tags + 1) * sizeof(*recorded->extra_tags));
+    memcpy(recorded->extra_tags, game_header.extra_tags,
+           recorded->num_extra_tags * sizeof(*recorded->extra_tags));
+    recorded->moves = game->head;
+    recorded->plies = recording->num_plies - game->first_ply;
+    game->tail->terminating_result = result;
+  } else {
+    for (tag = 0; tag < ORIGINAL_NUMBER_OF_TAGS; tag++) {
+      if (game_header.Tags[tag] != NULL) {
+        (void)free((void *)game_header.Tags[tag]);
+      }
+    }
+    for (tag = 0; tag < game_header.num_extra_tags; tag++) {
+      (void)free((void *)game_header.extra_tags[tag].value);
+    }
+    free_move_list(&game_header, game->head);
+    if (result != NULL) {
+      (void)free((void *)result);
+    }
+    recording->num_plies = game->first_ply;
+  }
+  for (tag = 0; tag < ORIGINAL_NUMBER_OF_TAGS; tag++) {
+    game_header.Tags[tag] = NULL;
+  }
+  game_header.num_extra_tags = 0;
+  *game = (GameInProgress){0};
+  game->first_ply = recording->num_plies;
+}
+
+/* Record the games of the first input file, up to max_games of them.
+ * Return the first token of the next file.
+ */
+static TokenType record_games(Recording *recording, unsigned long max_games) {
+  GameInProgress game = {0};
+  /* The tag of a pending tag string. */
+  int tag = -1;
+  unsigned depth = 0;
+  TokenType token = next_token(&globals, &game_header);
+
+  while (token != EOF_TOKEN && current_file_number() == 0) {
+    bool recording_game = recording->num_games < max_games;
+
+    switch (token) {
+    case TAG:
+      if (game.in_moves && recording_game) {
+        finish_game(recording, &game, NULL);
+      }
+      tag = (int)yylval.tag_index;
+      break;
+    case STRING:
+      if (recording_game && tag >= 0) {
+        set_game_tag(&globals, &game_header, tag, yylval.token_string);
+      } else {
+        discard_token(token);
+      }
+      tag = -1;
+      break;
+    case RAV_START:
+      depth++;
+      break;
+    case RAV_END:
+      if (depth > 0) {
+        depth--;
+      }
+      break;
+    case MOVE:
+      if (recording_game && depth == 0) {
+        record_move(recording, &game, yylval.move_details);
+      } else {
+        discard_token(token);
+      }
+      break;
+    case TERMINATING_RESULT:
+      if (recording_game && depth == 0) {
+        finish_game(recording, &game, yylval.token_string);
+      } else {
+        discard_token(token);
+      }
+      break;
+    default:
+      discard_token(token);
+      break;
+    }
+    token = next_token(&globals, &game_header);
+  }
+  if (recording->num_games < max_games) {
+    finish_game(recording, &game, NULL);
+  }
+  return token;
+}
+
+static int compare_samples(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Print the mean, median, minimum and standard deviation of the
+ * ns/op of the repetitions of a kernel.
+ */
+static void report(const char *name, unsigned long ops, double samples[],
+                   unsigned repetitions) {
+  double sum = 0, variance = 0, mean, median;
+
+  for (unsigned i = 0; i < repetitions; i++) {
+    sum += samples[i];
+  }
+  mean = sum / repetitions;
+  for (unsigned i = 0; i < repetitions; i++) {
+    variance += (samples[i] - mean) * (samples[i] - mean);
+  }
+  variance = repetitions > 1 ? variance / (repetitions - 1) : 0;
+  qsort(samples, repetitions, sizeof(*samples), compare_samples);
+  median = repetitions % 2 == 1 ? samples[repetitions / 2]
+                                : (samples[repetitions / 2 - 1] +
+                                   samples[repetitions / 2]) /
+                                      2;
+  printf("%-24s %10lu %10.1f %10.1f %10.1f %10.1f\n", name, ops, mean, median,
+         samples[0], sqrt(variance));
+}
+
+static void run_kernel(const char *name, Kernel kernel,
+                       const Recording *recording, const Settings *settings) {
+  double samples[MAX_REPETITIONS];
+  unsigned long ops = 0;
+
+  for (unsigned i = 0; i < settings->warm_up; i++) {
+    (void)kernel(recording);
+  }
+  for (unsigned i = 0; i < settings->repetitions; i++) {
+    uint64_t start = now_ns();
+
+    ops = kernel(recording);
+    samples[i] = ops > 0 ? (double)(now_ns() - start) / ops : 0;
+  }
+  if (ops > 0) {
+    report(name, ops, samples, settings->repetitions);
+  } else {
+    printf("%-24s %10s\n", name, "no inputs");
+  }
+}
+
+/* Time the tokenisation of the remaining copies of the input file,
+ * starting with the given token of the second copy.
+ */
+static void run_tokenizer(TokenType token, const Settings *settings) {
+  double samples[MAX_REPETITIONS];
+  unsigned copy = 0;
+  unsigned file = current_file_number();
+  unsigned long tokens = 1, copy_tokens = 0;
+  uint64_t start = now_ns();
+
+  discard_token(token);
+  while (token != EOF_TOKEN) {
+    token = next_token(&globals, &game_header);
+    if (token == EOF_TOKEN || current_file_number() != file) {
+      uint64_t end = now_ns();
+
+      if (copy >= settings->warm_up) {
+        samples[copy - settings->warm_up] = (double)(end - start) / tokens;
+      }
+      copy++;
+      copy_tokens = tokens;
+      file = current_file_number();
+      tokens = 0;
+      start = end;
+    }
+    discard_token(token);
+    tokens++;
+  }
+  /* Every copy has the same number of tokens. */
+  report("next_token", copy_tokens, samples, settings->repetitions);
+}
+
+static unsigned long decode_move_kernel(const Recording *recording) {
+  for (unsigned long i = 0; i < recording->num_plies; i++) {
+    Move *move = decode_move(&globals, recording->plies[i].applied->move);
+
+    sink += move->class;
+    free_move_list(&game_header, move);
+  }
+  return recording->num_plies;
+}
+
+static unsigned long make_move_kernel(const Recording *recording) {
+  for (unsigned long i = 0; i < recording->num_plies; i++) {
+    const RecordedPly *ply = &recording->plies[i];
+    Board board = ply->board;
+    Move move = ply->decoded;
+
+    if (determine_move_details(&globals, &game_header, board.to_move, &move,
+                               &board) &&
+        move.class != NULL_MOVE) {
+      make_move(move.class, move.from_col, move.from_rank, move.to_col,
+                move.to_rank, move.piece_to_move, board.to_move, &board);
+    }
+    sink += board.weak_hash_value;
+  }
+  return recording->num_plies;
+}
+
+static unsigned long check_kernel(const Recording *recording) {
+  for (unsigned long i = 0; i < recording->num_plies; i++) {
+    const Board *board = &recording->plies[i].board;
+
+    sink += king_is_in_check(board, board->to_move);
+  }
+  return recording->num_plies;
+}
+
+/* Only positions in which the side to move is in check. */
+static unsigned long checkmate_kernel(const Recording *recording) {
+  unsigned long ops = 0;
+
+  for (unsigned long i = 0; i < recording->num_plies; i++) {
+    Board *board = &recording->plies[i].board;
+
+    if (king_is_in_check(board, board->to_move) != NOCHECK) {
+      sink += king_is_in_checkmate(&globals, board->to_move, board);
+      ops++;
+    }
+  }
+  return ops;
+}
+
+static unsigned long zobrist_kernel(const Recording *recording) {
+  for (unsigned long i = 0; i < recording->num_plies; i++) {
+    sink += generate_zobrist_hash_from_board(&recording->plies[i].board);
+  }
+  return recording->num_plies;
+}
+
+static unsigned long pattern_kernel(const Recording *recording) {
+  for (unsigned long i = 0; i < recording->num_plies; i++) {
+    sink += pattern_match_board(&globals, &recording->plies[i].board) != NULL;
+  }
+  return recording->num_plies;
+}
+
+static unsigned long tag_kernel(const Recording *recording) {
+  for (unsigned long i = 0; i < recording->num_games; i++) {
+    const RecordedGame *recorded = &recording->games[i];
+    Game game = {0};
+
+    game.tags = recorded->tags;
+    game.extra_tags = recorded->extra_tags;
+    game.num_extra_tags = recorded->num_extra_tags;
+    sink += check_tag_details_not_ECO(&globals, &game, true);
+  }
+  return recording->num_games;
+}
+
+/* Per move of the output. */
+static unsigned long format_kernel(const Recording *recording) {
+  unsigned long ops = 0;
+
+  for (unsigned long i = 0; i < recording->num_games; i++) {
+    const RecordedGame *recorded = &recording->games[i];
+    Game game = {0};
+
+    game.tags = recorded->tags;
+    game.extra_tags = recorded->extra_tags;
+    game.num_extra_tags = recorded->num_extra_tags;
+    game.moves = recorded->moves;
+    format_game(&globals, &game_header, &game, null_output);
+    ops += recorded->plies;
+  }
+  return ops;
+}
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] file.pgn\n"
+          "    -w runs - untimed runs of each kernel (default 1)\n"
+          "    -r runs - timed runs of each kernel (default 10)\n"
+          "    -g games - the most games to record from the file "
+          "(default 1000)\n"
+          "    -t criterion - the tag criterion of check_list, as for "
+          "-t files (default \"pFischer\")\n"
+          "    -f pattern - the FEN pattern of pattern_match_board "
+          "(default \"*/*/*/*/4P3/*/*/*\")\n",
+          program);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  Settings settings = {1, 10, 1000, "pFischer", "*/*/*/*/4P3/*/*/*"};
+  Recording recording = {0};
+  const char *filename = NULL;
+  TokenType token;
+
+  for (int argnum = 1; argnum < argc; argnum++) {
+    const char *argument = argv[argnum];
+    const char *value = argnum + 1 < argc ? argv[argnum + 1] : NULL;
+    unsigned long number;
+
+    if (argument[0] != '-') {
+      if (filename != NULL) {
+        usage(argv[0]);
+      }
+      filename = argument;
+      continue;
+    }
+    if (argument[1] == '\0' || argument[2] != '\0' || value == NULL) {
+      usage(argv[0]);
+    }
+    argnum++;
+    if (argument[1] == 't') {
+      settings.tag_criterion = value;
+      continue;
+    }
+    if (argument[1] == 'f') {
+      settings.fen_pattern = value;
+      continue;
+    }
+    if (sscanf(value, "%lu", &number) != 1) {
+      usage(argv[0]);
+    }
+    switch (argument[1]) {
+    case 'w':
+      settings.warm_up = (unsigned)number;
+      break;
+    case 'r':
+      settings.repetitions = number > 0 ? (unsigned)number : 1;
+      break;
+    case 'g':
+      settings.games = number;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (filename == NULL) {
+    usage(argv[0]);
+  }
+  if (settings.repetitions > MAX_REPETITIONS) {
+    settings.repetitions = MAX_REPETITIONS;
+  }
+  if (settings.warm_up > MAX_REPETITIONS - settings.repetitions) {
+    settings.warm_up = MAX_REPETITIONS - settings.repetitions;
+  }
+
+  globals.logfile = stderr;
+  globals.outputfile = stdout;
+  globals.keep_NAGs = true;
+  globals.keep_comments = true;
+  globals.keep_variations = true;
+  globals.tag_output_format = ALL_TAGS;
+  globals.output_format = SAN;
+  globals.keep_move_numbers = true;
+  globals.keep_results = true;
+  globals.keep_checks = true;
+  globals.output_ply_limit = -1;
+  globals.current_file_type = NORMALFILE;
+  game_header = new_game_header();
+  set_output_line_length(&globals, MAX_LINE_LENGTH);
+  init_tag_lists();
+  init_hashtab();
+  init_lex_tables();
+  extract_tag_argument(&globals, settings.tag_criterion, true);
+  add_fen_pattern(&globals, settings.fen_pattern, false, "");
+
+  null_output = fopen("/dev/null", "w");
+  if (null_output == NULL) {
+    fprintf(stderr, "Unable to open /dev/null\n");
+    exit(1);
+  }
+
+  /* The first copy of the file is recorded, and the others are
+   * tokenised to time the lexer.
+   */
+  for (unsigned i = 0; i <= settings.warm_up + settings.repetitions; i++) {
+    add_filename_to_source_list(&globals, filename, NORMALFILE);
+  }
+  if (!open_first_file(&globals)) {
+    exit(1);
+  }
+  token = record_games(&recording, settings.games);
+  printf("%lu games, %lu plies recorded from %s\n", recording.num_games,
+         recording.num_plies, filename);
+  printf("%-24s %10s %10s %10s %10s %10s\n", "kernel (ns/op)", "ops", "mean",
+         "median", "min", "stddev");
+
+  run_tokenizer(token, &settings);
+  run_kernel("decode_move", decode_move_kernel, &recording, &settings);
+  run_kernel("determine+make_move", make_move_kernel, &recording, &settings);
+  run_kernel("king_is_in_check", check_kernel, &recording, &settings);
+  run_kernel("king_is_in_checkmate", checkmate_kernel, &recording, &settings);
+  run_kernel("zobrist_hash", zobrist_kernel, &recording, &settings);
+  run_kernel("pattern_match_board", pattern_kernel, &recording, &settings);
+  run_kernel("check_list", tag_kernel, &recording, &settings);
+  run_kernel("format_game/print_move", format_kernel, &recording, &settings);
+  return 0;
+}
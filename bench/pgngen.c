@@ -0,0 +1,433 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* pgn-generate: write a synthetic corpus of games for benchmarking.
+ * The games are random sequences of legal moves, found with the
+ * move generation of the pgne library and checked by replaying them
+ * with it, so that every game is valid. The same options and seed
+ * always produce the same corpus.
+ */
+
+#include "apply.h"
+#include "decode.h"
+#include "defs.h"
+#include "grammar.h"
+#include "lex.h"
+#include "map.h"
+#include "moves.h"
+#include "taglist.h"
+#include "typedef.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The longest line of move text written. */
+#define MAX_LINE_LENGTH 75
+/* The longest variation, in plies. */
+#define MAX_VARIATION_PLIES 8
+/* The percentage of moves of a line at which a variation starts. */
+#define VARIATION_PERCENT 5
+
+typedef struct {
+  /* Games to write. */
+  unsigned long games;
+  uint64_t seed;
+  /* The average number of plies of a game. */
+  unsigned plies;
+  /* The percentage of moves followed by a comment. */
+  unsigned comment_percent;
+  /* How deeply variations may be nested. */
+  unsigned variation_depth;
+  /* The number of different players. */
+  unsigned players;
+} Settings;
+
+typedef struct {
+  const Settings *settings;
+  uint64_t random_state;
+  FILE *fp;
+  /* The length of the line of move text being written. */
+  unsigned line_length;
+  /* Whether the next move needs a move number, even if played by Black. */
+  bool number_needed;
+} Generator;
+
+/* The library needs a state, but none of the program's options. */
+static StateInfo globals;
+static GameHeader game_header;
+
+static const char *const surnames[] = {
+    "Anderssen", "Botvinnik", "Capablanca", "Dzindzichashvili", "Euwe",
+    "Fischer",   "Geller",    "Hort",       "Ivanchuk",         "Janowski",
+    "Karpov",    "Lasker",    "Morphy",     "Nimzowitsch",      "Olafsson",
+    "Petrosian", "Quinteros", "Reti",       "Smyslov",          "Tal",
+    "Uhlmann",   "Vidmar",    "Winawer",    "Xie",              "Yusupov",
+    "Zukertort"};
+#define NUM_SURNAMES (sizeof(surnames) / sizeof(surnames[0]))
+
+static const char *const comment_words[] = {
+    "a",        "the",      "strong",     "weak",   "move",  "idea",
+    "attack",   "defence",  "initiative", "pawn",   "king",  "centre",
+    "position", "is",       "better",     "worse",  "with",  "against",
+    "threat",   "sacrifice"};
+#define NUM_COMMENT_WORDS (sizeof(comment_words) / sizeof(comment_words[0]))
+
+/* Return the next of a sequence of pseudo-random numbers
+ * (xorshift64*), which depends only on the seed.
+ */
+static uint64_t next_random(Generator *gen) {
+  gen->random_state ^= gen->random_state >> 12;
+  gen->random_state ^= gen->random_state << 25;
+  gen->random_state ^= gen->random_state >> 27;
+  return gen->random_state * 0x2545f4914f6cdd1dULL;
+}
+
+/* Return a pseudo-random number in [0, limit). */
+static unsigned random_below(Generator *gen, unsigned limit) {
+  return limit == 0 ? 0 : (unsigned)((next_random(gen) >> 32) % limit);
+}
+
+static bool random_percent(Generator *gen, unsigned percent) {
+  return random_below(gen, 100) < percent;
+}
+
+/* Add text to the move text, starting a new line if necessary. */
+static void emit(Generator *gen, const char *text) {
+  size_t length = strlen(text);
+
+  if (gen->line_length > 0 &&
+      gen->line_length + 1 + length > MAX_LINE_LENGTH) {
+    putc('\n', gen->fp);
+    gen->line_length = 0;
+  }
+  if (gen->line_length > 0) {
+    putc(' ', gen->fp);
+    gen->line_length++;
+  }
+  fputs(text, gen->fp);
+  gen->line_length += (unsigned)length;
+}
+
+/* Write in san the SAN text, without any check indication, of the
+ * legal move pair of the side to move in board. all_moves holds all
+ * of their legal moves.
+ */
+static void build_SAN(Generator *gen, const Board *board,
+                      const MovePair *pair, const MovePair *all_moves,
+                      char *san) {
+  Piece piece = EXTRACT_PIECE(BOARD_SQUARE(
+      board, RankConvert(pair->from_rank), ColConvert(pair->from_col)));
+  bool capture = BOARD_SQUARE(board, RankConvert(pair->to_rank),
+                              ColConvert(pair->to_col)) != EMPTY;
+  Piece promotion = EMPTY;
+  char *p = san;
+
+  if (piece == KING && (pair->to_col - pair->from_col > 1 ||
+                        pair->from_col - pair->to_col > 1)) {
+    strcpy(san, pair->to_col == 'g' ? "O-O" : "O-O-O");
+    return;
+  }
+  if (piece == PAWN) {
+    if (pair->from_col != pair->to_col) {
+      /* Including en-passant captures. */
+      *p++ = pair->from_col;
+      capture = true;
+    }
+    if (pair->to_rank == LASTRANK || pair->to_rank == FIRSTRANK) {
+      static const Piece promotions[] = {QUEEN, QUEEN, QUEEN,
+                                         ROOK,  BISHOP, KNIGHT};
+
+      promotion = promotions[random_below(gen, sizeof(promotions) /
+                                                   sizeof(promotions[0]))];
+    }
+  } else {
+    bool ambiguous = false, same_col = false, same_rank = false;
+
+    *p++ = SAN_piece_letter(piece);
+    for (const MovePair *other = all_moves; other != NULL;
+         other = other->next) {
+      if (other != pair && other->to_col == pair->to_col &&
+          other->to_rank == pair->to_rank &&
+          EXTRACT_PIECE(BOARD_SQUARE(board, RankConvert(other->from_rank),
+                                     ColConvert(other->from_col))) == piece) {
+        ambiguous = true;
+        same_col |= other->from_col == pair->from_col;
+        same_rank |= other->from_rank == pair->from_rank;
+      }
+    }
+    if (ambiguous && (!same_col || same_rank)) {
+      *p++ = pair->from_col;
+    }
+    if (ambiguous && same_col) {
+      *p++ = pair->from_rank;
+    }
+  }
+  if (capture) {
+    *p++ = 'x';
+  }
+  *p++ = pair->to_col;
+  *p++ = pair->to_rank;
+  if (promotion != EMPTY) {
+    *p++ = '=';
+    *p++ = SAN_piece_letter(promotion);
+  }
+  *p = '\0';
+}
+
+static void emit_comment(Generator *gen) {
+  unsigned words = 2 + random_below(gen, 10);
+
+  emit(gen, "{");
+  for (unsigned i = 0; i < words; i++) {
+    emit(gen, comment_words[random_below(gen, NUM_COMMENT_WORDS)]);
+  }
+  emit(gen, "}");
+}
+
+/* Play and write up to plies random moves from board.
+ * Variations are nested up to depth deep.
+ * Return the check status of the final move.
+ */
+static CheckStatus generate_line(Generator *gen, Board *board,
+                                 unsigned plies, unsigned depth) {
+  CheckStatus status = NOCHECK;
+
+  gen->number_needed = true;
+  for (unsigned ply = 0; ply < plies; ply++) {
+    MovePair *all_moves = find_all_moves(&globals, board, board->to_move);
+    unsigned num_moves = 0, choice;
+    const MovePair *pair;
+    Board previous = *board;
+    char san[20], number[20];
+    Move *move;
+
+    for (pair = all_moves; pair != NULL; pair = pair->next) {
+      num_moves++;
+    }
+    if (num_moves == 0) {
+      break;
+    }
+    choice = random_below(gen, num_moves);
+    for (pair = all_moves; choice > 0; pair = pair->next) {
+      choice--;
+    }
+    build_SAN(gen, board, pair, all_moves, san);
+    free_move_pair_list(all_moves);
+
+    if (board->to_move == WHITE) {
+      sprintf(number, "%u.", board->move_number);
+      emit(gen, number);
+    } else if (gen->number_needed) {
+      sprintf(number, "%u...", board->move_number);
+      emit(gen, number);
+    }
+    gen->number_needed = false;
+    move = decode_move(&globals, (const unsigned char *)san);
+    if (move == NULL || !apply_move(&globals, &game_header, move, board)) {
+      fprintf(stderr, "Internal error: generated the illegal move %s.\n",
+              san);
+      exit(1);
+    }
+    status = move->check_status;
+    strcat(san, status == CHECKMATE ? "#" : status == CHECK ? "+" : "");
+    free_move_list(&game_header, move);
+    emit(gen, san);
+
+    if (random_percent(gen, gen->settings->comment_percent)) {
+      emit_comment(gen);
+      gen->number_needed = true;
+    }
+    if (depth > 0 && random_percent(gen, VARIATION_PERCENT)) {
+      /* An alternative to the move just played. */
+      emit(gen, "(");
+      (void)generate_line(gen, &previous,
+                          1 + random_below(gen, MAX_VARIATION_PLIES),
+                          depth - 1);
+      emit(gen, ")");
+      gen->number_needed = true;
+    }
+  }
+  return status;
+}
+
+static void emit_tag(Generator *gen, const char *name, const char *value) {
+  fprintf(gen->fp, "[%s \"%s\"]\n", name, value);
+}
+
+static void player_name(unsigned player, char *name) {
+  sprintf(name, "%s, %c.", surnames[player % NUM_SURNAMES],
+          'A' + (int)(player / NUM_SURNAMES % 26));
+  if (player >= NUM_SURNAMES * 26) {
+    sprintf(name + strlen(name), " %lu",
+            (unsigned long)(player / (NUM_SURNAMES * 26)));
+  }
+}
+
+static void generate_game(Generator *gen, unsigned long game_number) {
+  const Settings *settings = gen->settings;
+  Board *board = new_game_board(&globals, &game_header, NULL);
+  unsigned plies = settings->plies / 2 + random_below(gen, settings->plies + 1);
+  unsigned white = random_below(gen, settings->players);
+  unsigned black = random_below(gen, settings->players);
+  /* The move text is written after the tags, but decides the result. */
+  char *movetext = NULL;
+  size_t movetext_length = 0;
+  FILE *tags_fp = gen->fp;
+  char value[100];
+  const char *result;
+  CheckStatus status;
+
+  gen->fp = open_memstream(&movetext, &movetext_length);
+  if (gen->fp == NULL) {
+    fprintf(stderr, "Unable to generate a game.\n");
+    exit(1);
+  }
+  gen->line_length = 0;
+  status = generate_line(gen, board, plies, settings->variation_depth);
+  if (status == CHECKMATE) {
+    result = board->to_move == WHITE ? "0-1" : "1-0";
+  } else if (!at_least_one_move(&globals, board, board->to_move)) {
+    /* Stalemate. */
+    result = "1/2-1/2";
+  } else {
+    static const char *const results[] = {"1-0", "0-1", "1/2-1/2", "*"};
+
+    result = results[random_below(gen, 4)];
+  }
+  emit(gen, result);
+  (void)fclose(gen->fp);
+  gen->fp = tags_fp;
+
+  sprintf(value, "Synthetic Open %u",
+          random_below(gen, settings->players / 8 + 1));
+  emit_tag(gen, "Event", value);
+  emit_tag(gen, "Site", "pgn-generate");
+  sprintf(value, "%u.%02u.%02u", 1950 + random_below(gen, 75),
+          1 + random_below(gen, 12), 1 + random_below(gen, 28));
+  emit_tag(gen, "Date", value);
+  sprintf(value, "%lu", game_number);
+  emit_tag(gen, "Round", value);
+  player_name(white, value);
+  emit_tag(gen, "White", value);
+  player_name(black, value);
+  emit_tag(gen, "Black", value);
+  emit_tag(gen, "Result", result);
+  sprintf(value, "%u", 1200 + (white * 7919) % 1600);
+  emit_tag(gen, "WhiteElo", value);
+  sprintf(value, "%u", 1200 + (black * 7919) % 1600);
+  emit_tag(gen, "BlackElo", value);
+  if (random_percent(gen, 50)) {
+    sprintf(value, "%u+%u", 60 * (1 + random_below(gen, 90)),
+            random_below(gen, 30));
+    emit_tag(gen, "TimeControl", value);
+  }
+  fprintf(gen->fp, "\n%s\n\n", movetext);
+  (void)free((void *)movetext);
+  free_board(board);
+}
+
+static void usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [-g games] [-s seed] [-p plies] [-c comment%%] "
+          "[-v depth] [-t players] [-o file]\n"
+          "    -g games - the number of games (default 10000)\n"
+          "    -s seed - the seed of the random moves (default 1)\n"
+          "    -p plies - the average number of plies of a game (default "
+          "80)\n"
+          "    -c comment%% - the percentage of moves with a comment "
+          "(default 5)\n"
+          "    -v depth - how deeply variations are nested (default 0)\n"
+          "    -t players - the number of different players, which sets "
+          "the variety of tag values (default 500)\n"
+          "    -o file - where to write the games (default stdout)\n",
+          program);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  Settings settings = {10000, 1, 80, 5, 0, 500};
+  Generator gen = {&settings, 0, stdout, 0, true};
+
+  for (int argnum = 1; argnum < argc; argnum++) {
+    const char *argument = argv[argnum];
+    const char *value = argnum + 1 < argc ? argv[argnum + 1] : NULL;
+    unsigned long number;
+
+    if (argument[0] != '-' || argument[1] == '\0' || argument[2] != '\0' ||
+        value == NULL) {
+      usage(argv[0]);
+    }
+    argnum++;
+    if (argument[1] == 'o') {
+      gen.fp = fopen(value, "w");
+      if (gen.fp == NULL) {
+        fprintf(stderr, "Unable to open the file: \"%s\"\n", value);
+        exit(1);
+      }
+      continue;
+    }
+    if (sscanf(value, "%lu", &number) != 1) {
+      usage(argv[0]);
+    }
+    switch (argument[1]) {
+    case 'g':
+      settings.games = number;
+      break;
+    case 's':
+      settings.seed = number;
+      break;
+    case 'p':
+      settings.plies = (unsigned)number;
+      break;
+    case 'c':
+      settings.comment_percent = (unsigned)number;
+      break;
+    case 'v':
+      settings.variation_depth = (unsigned)number;
+      break;
+    case 't':
+      settings.players = number > 0 ? (unsigned)number : 1;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  globals.logfile = stderr;
+  globals.outputfile = stdout;
+  game_header = new_game_header();
+  init_tag_lists();
+  init_hashtab();
+  init_lex_tables();
+
+  /* xorshift must not start from 0. */
+  gen.random_state = settings.seed * 0x9e3779b97f4a7c15ULL + 1;
+  for (unsigned long game = 1; game <= settings.games; game++) {
+    generate_game(&gen, game);
+  }
+  if (gen.fp != stdout && fclose(gen.fp) != 0) {
+    fprintf(stderr, "Error writing the games.\n");
+    exit(1);
+  }
+  return 0;
+}
@@ -2,7 +2,7 @@ extern crate bindgen;
 extern crate cmake;
 
 use cmake::Config;
-use std::{env, path::PathBuf};
+use std::{env, fs, path::Path, path::PathBuf};
 
 fn main() {
     // Run cmake to build nng
@@ -17,6 +17,13 @@ fn main() {
     println!("cargo:rustc-link-search=native={}", dst.display());
     // Tell rustc to use nng static library
     println!("cargo:rustc-link-lib=static=pgne");
+    // And with the libraries that cmake found for it, one to a line,
+    // either as a name or as the path of the library file.
+    let libraries = fs::read_to_string(dst.join("pgne-link-libraries.txt"))
+        .expect("Couldn't read pgne-link-libraries.txt");
+    for library in libraries.lines().filter(|line| !line.is_empty()) {
+        link_library(library);
+    }
 
     let bindings = bindgen::Builder::default()
         .header("wrapper.h")
@@ -29,3 +36,24 @@ fn main() {
         .write_to_file(out_path.join("bindings.rs"))
         .expect("Couldn't write bindings");
 }
+
+// Tell rustc to link with a library given by name, such as "m", or by
+// the path of its file, such as "/usr/lib/libz.so".
+fn link_library(library: &str) {
+    let path = Path::new(library);
+    if !path.is_absolute() {
+        println!("cargo:rustc-link-lib={}", library);
+        return;
+    }
+    if let Some(dir) = path.parent() {
+        println!("cargo:rustc-link-search=native={}", dir.display());
+    }
+    let file_name = path.file_name().unwrap().to_string_lossy();
+    let stem = file_name.split('.').next().unwrap();
+    let name = stem.strip_prefix("lib").unwrap_or(stem);
+    if file_name.ends_with(".a") {
+        println!("cargo:rustc-link-lib=static={}", name);
+    } else {
+        println!("cargo:rustc-link-lib={}", name);
+    }
+}
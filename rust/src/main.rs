@@ -27,6 +27,8 @@ fn main() {
 
     let default_eco_file = std::ffi::CString::new(bindings::DEFAULT_ECO_FILE).unwrap();
 
+    let default_compressed_output_suffix = std::ffi::CString::new("").unwrap();
+
     let globals = StateInfo {
         skipping_current_game: false,                           /*  */
         check_only: false,                                      /*  (-r) */
@@ -102,6 +104,19 @@ fn main() {
         delete_same_setup: false,                               /*  (--deletesamesetup) */
         lichess_comment_fix: false,                             /*  (--lichesscommentfix) */
         keep_only_commented_games: false,                       /*  (--only_commented_games) */
+        build_index: false,                                     /*  (--buildindex) */
+        index_ply_limit: 0,                                     /*  (--indexply) */
+        update_index: false,                                    /*  (--updateindex) */
+        use_game_cache: false,                                  /*  (--cache) */
+        position_sample_interval: 1,                            /*  (--sampleply) */
+        skip_positions_in_check: false,                         /*  (--skipchecks) */
+        compression_level: 0,                                   /*  (--compresslevel) */
+        perft_depth: 0,                                         /*  (--perft) */
+        memory_statistics: false,                               /*  (--memstats) */
+        slow_games_to_report: 0,                                /*  (--slowgames) */
+        progress_interval: 1,                                   /*  (--progressinterval) */
+        checkpoint_interval: 60,                                /*  (--checkpointinterval) */
+        interned_tag_values: 0,                                 /*  (--interntags) */
         split_depth_limit: 0,                                   /*  */
         current_file_type: bindings::SourceFileType_NORMALFILE, /*  */
         setup_status: bindings::SetupOutputStatus_SETUP_TAG_OK, /*  */
@@ -110,6 +125,12 @@ fn main() {
         FEN_comment_pattern: null_mut(),        /*  (-Fpattern) */
         drop_comment_pattern: null_mut(),       /*  (--dropbefore) */
         line_number_marker: null_mut(),         /*  (--linenumbers) */
+        compressed_output_suffix: default_compressed_output_suffix.as_ptr(), /*  (--compress) */
+        perft_fen: null_mut(),                  /*  (--perft) */
+        perft_suite: null_mut(),                /*  (--perftsuite) */
+        heartbeat_file: null_mut(),             /*  (--heartbeat) */
+        checkpoint_file: null_mut(),            /*  (--checkpoint) */
+        resume_file: null_mut(),                /*  (--resume) */
         current_input_file: null_mut(),         /*  */
         eco_file: default_eco_file.as_ptr(),    /*  (-e) */
         outputfile: null_mut(),                 /*  (-o, -a). Default is stdout */
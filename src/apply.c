@@ -25,6 +25,7 @@
 #include "defs.h"
 #include "eco.h"
 #include "fenmatcher.h"
+#include "gameindex.h"
 #include "grammar.h"
 #include "hashing.h"
 #include "lex.h"
@@ -46,7 +47,6 @@
 /* Define a positional search depth that should look at the
  * full length of a game.  This is used in play_moves().
  */
-#define DEFAULT_POSITIONAL_DEPTH 300
 
 /* Prototypes of functions limited to this file. */
 static bool check_move_validity(const StateInfo *globals,
@@ -166,11 +166,16 @@ void set_output_piece_characters(const StateInfo *globals,
 
 /* Return a fresh copy of the given string. */
 char *copy_string(const char *str) {
+  return copy_string_for(MEMORY_OTHER, str);
+}
+
+/* Return a fresh copy of the given string, allocated for category. */
+char *copy_string_for(MemoryCategory category, const char *str) {
   char *result;
   if (str != NULL) {
     size_t len = strlen(str);
 
-    result = (char *)malloc_or_die(len + 1);
+    result = (char *)malloc_for(category, len + 1);
     strcpy(result, str);
   } else {
     result = NULL;
@@ -271,7 +276,7 @@ static Col find_rook_starting_position(const Board *board, Colour colour,
     boundary = LASTCOL + 1;
   }
   while (col != boundary && rook_count > 0) {
-    if (board->board[RankConvert(rank)][ColConvert(col)] != rook) {
+    if (BOARD_SQUARE(board, RankConvert(rank), ColConvert(col)) != rook) {
       col += direction;
     } else {
       rook_count--;
@@ -303,26 +308,26 @@ Board *new_fen_board(const StateInfo *globals, GameHeader *game_header,
   /* Start with a clear board. */
   static const Board initial_board = {
       /* Board */
-      .board = {{OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
-                {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
-                {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF}},
+      .squares = {{OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
+                  {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
+                  {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF}},
       /* Who to move next. */
       .to_move = WHITE,
       /* Move number. */
@@ -373,7 +378,7 @@ Board *new_fen_board(const StateInfo *globals, GameHeader *game_header,
         colour = BLACK;
       }
       if (col <= LASTCOL) {
-        new_board->board[RankConvert(rank)][ColConvert(col)] =
+        BOARD_SQUARE(new_board, RankConvert(rank), ColConvert(col)) =
             MAKE_COLOURED_PIECE(colour, piece);
         if (piece == KING) {
           if (colour == WHITE) {
@@ -622,28 +627,32 @@ void add_fen_castling(const StateInfo *globals, GameHeader *game_header,
   bool added = false;
   /* NB: This is not coded for Chess 960 positions. */
   if (board->WKingCol == 'e' && board->WKingRank == '1') {
-    board->WKingCastle = board->board[RankConvert('1')][ColConvert('h')] ==
-                                 MAKE_COLOURED_PIECE(WHITE, ROOK)
-                             ? 'h'
-                             : '\0';
-    board->WQueenCastle = board->board[RankConvert('1')][ColConvert('a')] ==
-                                  MAKE_COLOURED_PIECE(WHITE, ROOK)
-                              ? 'a'
-                              : '\0';
+    board->WKingCastle =
+        BOARD_SQUARE(board, RankConvert('1'), ColConvert('h')) ==
+                MAKE_COLOURED_PIECE(WHITE, ROOK)
+            ? 'h'
+            : '\0';
+    board->WQueenCastle =
+        BOARD_SQUARE(board, RankConvert('1'), ColConvert('a')) ==
+                MAKE_COLOURED_PIECE(WHITE, ROOK)
+            ? 'a'
+            : '\0';
     added = true;
   } else {
     board->WKingCastle = '\0';
     board->WQueenCastle = '\0';
   }
   if (board->BKingCol == 'e' && board->BKingRank == '8') {
-    board->BKingCastle = board->board[RankConvert('8')][ColConvert('h')] ==
-                                 MAKE_COLOURED_PIECE(BLACK, ROOK)
-                             ? 'h'
-                             : '\0';
-    board->BQueenCastle = board->board[RankConvert('8')][ColConvert('a')] ==
-                                  MAKE_COLOURED_PIECE(BLACK, ROOK)
-                              ? 'a'
-                              : '\0';
+    board->BKingCastle =
+        BOARD_SQUARE(board, RankConvert('8'), ColConvert('h')) ==
+                MAKE_COLOURED_PIECE(BLACK, ROOK)
+            ? 'h'
+            : '\0';
+    board->BQueenCastle =
+        BOARD_SQUARE(board, RankConvert('8'), ColConvert('a')) ==
+                MAKE_COLOURED_PIECE(BLACK, ROOK)
+            ? 'a'
+            : '\0';
     added = true;
   } else {
     board->BKingCastle = '\0';
@@ -667,26 +676,26 @@ Board *new_game_board(const StateInfo *globals, GameHeader *game_header,
                       const char *fen) {
   Board *new_board = NULL;
   static const Board initial_board = {
-      .board = {{OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
-                {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
-                {OFF, OFF, W(ROOK), W(KNIGHT), W(BISHOP), W(QUEEN), W(KING),
-                 W(BISHOP), W(KNIGHT), W(ROOK), OFF, OFF},
-                {OFF, OFF, W(PAWN), W(PAWN), W(PAWN), W(PAWN), W(PAWN), W(PAWN),
-                 W(PAWN), W(PAWN), OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
-                 EMPTY, OFF, OFF},
-                {OFF, OFF, B(PAWN), B(PAWN), B(PAWN), B(PAWN), B(PAWN), B(PAWN),
-                 B(PAWN), B(PAWN), OFF, OFF},
-                {OFF, OFF, B(ROOK), B(KNIGHT), B(BISHOP), B(QUEEN), B(KING),
-                 B(BISHOP), B(KNIGHT), B(ROOK), OFF, OFF},
-                {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
-                {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF}},
+      .squares = {{OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
+                  {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
+                  {OFF, OFF, W(ROOK), W(KNIGHT), W(BISHOP), W(QUEEN), W(KING),
+                   W(BISHOP), W(KNIGHT), W(ROOK), OFF, OFF},
+                  {OFF, OFF, W(PAWN), W(PAWN), W(PAWN), W(PAWN), W(PAWN),
+                   W(PAWN), W(PAWN), W(PAWN), OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+                   EMPTY, OFF, OFF},
+                  {OFF, OFF, B(PAWN), B(PAWN), B(PAWN), B(PAWN), B(PAWN),
+                   B(PAWN), B(PAWN), B(PAWN), OFF, OFF},
+                  {OFF, OFF, B(ROOK), B(KNIGHT), B(BISHOP), B(QUEEN), B(KING),
+                   B(BISHOP), B(KNIGHT), B(ROOK), OFF, OFF},
+                  {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF},
+                  {OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF, OFF}},
       /* Who to move next. */
       .to_move = WHITE,
       /* Move number. */
@@ -734,7 +743,7 @@ Board *new_game_board(const StateInfo *globals, GameHeader *game_header,
     for (rank = FIRSTRANK; rank <= LASTRANK; rank++) {
       /* Find the basic components. */
       Piece coloured_piece =
-          new_board->board[RankConvert(rank)][ColConvert(col)];
+          BOARD_SQUARE(new_board, RankConvert(rank), ColConvert(col));
       Piece piece = EXTRACT_PIECE(coloured_piece);
       Colour colour = EXTRACT_COLOUR(coloured_piece);
 
@@ -752,7 +761,7 @@ static void print_square(const StateInfo *globals, Col col, Rank rank,
   int r = RankConvert(rank);
   int c = ColConvert(col);
 
-  Piece coloured_piece = board->board[r][c];
+  Piece coloured_piece = BOARD_SQUARE(board, r, c);
   switch ((int)coloured_piece) {
   case W(PAWN):
   case W(KNIGHT):
@@ -809,7 +818,7 @@ static void check_board(const Board *board, const char *where) {
       int r = RankConvert(rank);
       int c = ColConvert(col);
 
-      switch (board->board[r][c]) {
+      switch (BOARD_SQUARE(board, r, c)) {
       case W(PAWN):
       case W(KNIGHT):
       case W(BISHOP):
@@ -827,7 +836,7 @@ static void check_board(const Board *board, const char *where) {
       default:
         fprintf(globals->logfile,
                 "%s: Illegal square %c%c (%u %u) contains %d.\n", where, col,
-                rank, r, c, board->board[r][c]);
+                rank, r, c, BOARD_SQUARE(board, r, c));
         report_details(game_header, globals->logfile);
         abort();
         break;
@@ -915,8 +924,7 @@ bool apply_move(const StateInfo *globals, GameHeader *game_header,
       if (globals->output_format == EPD || globals->add_FEN_comments) {
         char epd[FEN_SPACE], fen_suffix[FEN_SPACE];
         build_FEN_components(globals, board, epd, fen_suffix);
-        move_details->epd = copy_string(epd);
-        move_details->fen_suffix = copy_string(fen_suffix);
+        annotate_move_FEN(move_details, epd, fen_suffix);
       }
     }
   } else {
@@ -955,6 +963,13 @@ static bool play_moves(const StateInfo *globals, GameHeader *game_header,
 
   const char *match_label = NULL;
 
+  if (globals->build_index) {
+    index_position(globals, board, 0);
+    if (mainline) {
+      index_material(board, true);
+    }
+  }
+
   /* Try the initial board position for a match.
    * This is required because the game might have been set up
    * from a FEN string, rather than being the normal starting
@@ -1006,6 +1021,12 @@ static bool play_moves(const StateInfo *globals, GameHeader *game_header,
       }
       if (check_move_validity) {
         if (apply_move(globals, game_header, next_move, board)) {
+          if (globals->build_index) {
+            index_position(globals, board, plies);
+            if (mainline) {
+              index_material(board, false);
+            }
+          }
           /* Don't try for a positional match if we already have one. */
           if (check_for_match && !game_matches &&
               (match_label = position_matches(globals, board)) != NULL) {
@@ -2114,14 +2135,15 @@ static bool rewrite_moves(const StateInfo *globals, GameHeader *game_header,
         }
 
         if (globals->output_evaluation) {
-          move_details->evaluation = evaluate(globals, board);
+          annotate_move(move_details)->evaluation = evaluate(globals, board);
         }
 
         if (globals->add_hashcode_comments) {
           /* Append a hashcode comment using the new state of the board
            * with the move having been played.
            */
-          move_details->zobrist = generate_zobrist_hash_from_board(board);
+          annotate_move(move_details)->zobrist =
+              generate_zobrist_hash_from_board(board);
         }
 
         if (globals->drop_comment_pattern != NULL &&
@@ -2174,7 +2196,8 @@ static bool rewrite_moves(const StateInfo *globals, GameHeader *game_header,
   if (!game_ok) {
     if (globals->keep_broken_games && move_details != NULL) {
       /* Try to place the remaining moves into a comment. */
-      CommentList *comment = (CommentList *)malloc_or_die(sizeof(*comment));
+      CommentList *comment =
+          (CommentList *)malloc_for(MEMORY_COMMENT, sizeof(*comment));
       /* Break the link from the previous move. */
       Move *prev;
       StringList *commented_move_list = NULL;
@@ -2404,7 +2427,7 @@ void store_hash_value(const StateInfo *globals, GameHeader *game_header,
   }
 
   if (Ok) {
-    HashLog *entry = (HashLog *)malloc_or_die(sizeof(*entry));
+    HashLog *entry = (HashLog *)malloc_for(MEMORY_HASH, sizeof(*entry));
     unsigned ix = board->weak_hash_value % MAX_NON_POLYGLOT_CODE;
 
     /* We don't include the cumulative hash value as the sequence
@@ -2450,7 +2473,7 @@ bool save_polyglot_hashcode(const StateInfo *globals, const char *value) {
       hash = strtoull(value, &end, 16);
       Ok = (errno == 0 && *end == '\0');
       if (Ok) {
-        HashLog *entry = (HashLog *)malloc_or_die(sizeof(*entry));
+        HashLog *entry = (HashLog *)malloc_for(MEMORY_HASH, sizeof(*entry));
         unsigned ix = hash % MAX_POLYGLOT_CODE;
 
         /* We don't include the cumulative hash value as the sequence
@@ -2474,6 +2497,28 @@ bool save_polyglot_hashcode(const StateInfo *globals, const char *value) {
   return Ok;
 }
 
+/* If the positions of interest are given solely as polyglot hashcodes
+ * then set codes to a newly allocated array of them and return how many
+ * there are. Otherwise, return 0 as other positions could match too.
+ */
+unsigned polyglot_codes_for_index(uint64_t **codes) {
+  unsigned num_codes = 0;
+
+  *codes = NULL;
+  if (!using_polyglot || using_non_polyglot || fen_patterns_present()) {
+    return 0;
+  }
+  for (unsigned ix = 0; ix < MAX_POLYGLOT_CODE; ix++) {
+    for (HashLog *entry = polyglot_codes_of_interest[ix]; entry != NULL;
+         entry = entry->next) {
+      *codes = (uint64_t *)realloc_or_die((void *)*codes,
+                                          (num_codes + 1) * sizeof(**codes));
+      (*codes)[num_codes++] = entry->final_hash_value;
+    }
+  }
+  return num_codes;
+}
+
 /* Does the current board match a position of interest.
  * Look in codes_of_interest for current_hash_value.
  * Return NULL if no match, otherwise a possible label for the
@@ -2544,7 +2589,8 @@ void build_basic_EPD_string(const StateInfo *globals, const Board *board,
     Col col;
     int consecutive_spaces = 0;
     for (col = FIRSTCOL; col <= LASTCOL; col++) {
-      int coloured_piece = board->board[RankConvert(rank)][ColConvert(col)];
+      int coloured_piece =
+          BOARD_SQUARE(board, RankConvert(rank), ColConvert(col));
       if (coloured_piece != EMPTY) {
         if (consecutive_spaces > 0) {
           epd[ix] = '0' + consecutive_spaces;
@@ -2725,8 +2771,8 @@ void build_basic_EPD_string(const StateInfo *globals, const Board *board,
         pawn = B(PAWN);
       }
       if ((ep_col > FIRSTCOL) &&
-          (board->board[RankConvert(from_rank)][ColConvert(ep_col - 1)] ==
-           pawn)) {
+          (BOARD_SQUARE(board, RankConvert(from_rank),
+                        ColConvert(ep_col - 1)) == pawn)) {
         /* Check that the move does not leave the king in check. */
         Board copy_board = *board;
         make_move(UNKNOWN_MOVE, ep_col - 1, from_rank, board->ep_col,
@@ -2736,8 +2782,8 @@ void build_basic_EPD_string(const StateInfo *globals, const Board *board,
         }
       }
       if (redundant && (ep_col < LASTCOL) &&
-          (board->board[RankConvert(from_rank)][ColConvert(ep_col + 1)] ==
-           pawn)) {
+          (BOARD_SQUARE(board, RankConvert(from_rank),
+                        ColConvert(ep_col + 1)) == pawn)) {
         /* Check that the move does not leave the king in check. */
         Board copy_board = *board;
         make_move(UNKNOWN_MOVE, ep_col + 1, from_rank, board->ep_col,
@@ -2880,7 +2926,8 @@ CommentList *create_match_comment(const StateInfo *globals,
     match_comment = get_FEN_string(globals, board);
   }
   StringList *current_comment = save_string_list_item(NULL, match_comment);
-  CommentList *comment = (CommentList *)malloc_or_die(sizeof(*comment));
+  CommentList *comment =
+      (CommentList *)malloc_for(MEMORY_COMMENT, sizeof(*comment));
 
   comment->comment = current_comment;
   comment->next = NULL;
@@ -2929,7 +2976,7 @@ static double shannonEvaluation(const StateInfo *globals, const Board *board) {
     for (col = FIRSTCOL; col <= LASTCOL; col++) {
       int c = ColConvert(col);
       int pieceValue = 0;
-      Piece occupant = board->board[r][c];
+      Piece occupant = BOARD_SQUARE(board, r, c);
       if (occupant != EMPTY) {
         /* This square is occupied by a piece of the required colour. */
         Piece piece = EXTRACT_PIECE(occupant);
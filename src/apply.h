@@ -26,6 +26,9 @@
 
 #include <stdbool.h>
 
+/* The default ply depth to which positional matches are sought. */
+#define DEFAULT_POSITIONAL_DEPTH 300
+
 void add_fen_castling(const StateInfo *globals, GameHeader *game_header,
                       Game *game_details, Board *board);
 bool apply_move_list(const StateInfo *globals, GameHeader *game_header,
@@ -50,6 +53,7 @@ const char *piece_str(Piece piece);
 Board *rewrite_game(const StateInfo *globals, GameHeader *game_header,
                     Game *game_details);
 char SAN_piece_letter(Piece piece);
+unsigned polyglot_codes_for_index(uint64_t **codes);
 bool save_polyglot_hashcode(const StateInfo *globals, const char *value);
 /* letters should contain a string of the form: "PNBRQK" */
 void set_output_piece_characters(const StateInfo *globals, const char *letters);
@@ -22,6 +22,7 @@
 #include "argsfile.h"
 
 #include "apply.h"
+#include "compression.h"
 #include "defs.h"
 #include "eco.h"
 #include "fenmatcher.h"
@@ -112,6 +113,23 @@ static const char *skip_leading_spaces(const char *str) {
   return str;
 }
 
+/* Return the mode in which to open the output file filename, which
+ * is continued from its checkpoint length rather than written from
+ * the start if the run is resumed (--resume).
+ */
+static const char *output_file_mode(const StateInfo *globals,
+                                    const char *filename) {
+  if (globals->resume_file == NULL) {
+    return "w";
+  } else if (compression_of_file_name(filename) != COMPRESSION_NONE) {
+    fprintf(globals->logfile,
+            "--resume requires output files that are not compressed.\n");
+    exit(1);
+  } else {
+    return "r+";
+  }
+}
+
 /* Print a usage message, and exit. */
 static void usage_and_exit(const StateInfo *globals) {
   const char *help_data[] = {
@@ -180,13 +198,16 @@ static void usage_and_exit(const StateInfo *globals) {
       "retained.",
       "-wwidth -- set width as an approximate line width for output. 0 means "
       "unlimited.",
-      "-W[cm|epd|halg|lalg|elalg|xlalg|xolalg|san] -- specify the output "
-      "format to use.",
+      "-W[bin|cm|epd|halg|lalg|elalg|xlalg|xolalg|pos|san] -- specify the "
+      "output format to use.",
       "      Default is SAN.",
       "      -W means use the input format.",
+      "      -Wbin is a compact binary format that can be read back in.",
       "      -Wcm is (a possibly obsolete) ChessMaster format.",
       "      -Wepd is EPD format.",
       "      -Wfen is FEN format.",
+      "      -Wpos is fixed-size binary records of the positions of the main "
+      "line.",
       "      -Wsan[PNBRQK] for language specific output.",
       "      -Whalg is hyphenated long algebraic.",
       "      -Wlalg is long algebraic.",
@@ -216,10 +237,23 @@ static void usage_and_exit(const StateInfo *globals) {
       "--allownullmoves - allow NULL moves in the main line",
       "--append - see -a",
       "--btm - match position only if Black is to move (see -t)",
+      "--buildindex - write an index of the games in each input file, "
+      "file.pgn, to file.pgn.idx for faster selection by game number",
+      "--cache - keep the games parsed from each input file, file.pgn, in "
+      "file.pgn.cache, unless errors are reported in it, and read them "
+      "from there while file.pgn is unchanged",
       "--checkfile - see -c",
       "--checkmate - see -M",
+      "--checkpoint file - save the state of the run to file every "
+      "--checkpointinterval seconds (default 60), for --resume.",
+      "--checkpointinterval N - the seconds between checkpoints.",
       "--commented - only match games with at least one comment",
       "--commentlines - output each comment on a separate line",
+      "--compress format - compress the output files of -# and -E with "
+      "format: gz, bz2, xz or zst. Output files named with one of these "
+      "suffixes are always compressed",
+      "--compresslevel N - the level of compression of compressed output "
+      "files",
       "--deletesamesetup - suppress games with the same initial position as "
       "one already processed",
       "--detag tag - don't include tag in the output",
@@ -242,9 +276,17 @@ static void usage_and_exit(const StateInfo *globals) {
       "--fuzzydepth plies - positional duplicates match",
       "--gamelimit N - only process up to and including game number N.",
       "--hashcomments - include a hashcode string after each move",
+      "--heartbeat file - append a line of JSON progress (games, matches, "
+      "bytes, rates and ETA) to file every --progressinterval seconds; "
+      "/dev/fd/N writes to file descriptor N.",
       "--help - see -h",
+      "--indexply N - with --buildindex, only index the positions of the "
+      "first N plies of each game (0 for no limit).",
       "--insufficient - only output games that end with insufficient mating "
       "material.",
+      "--interntags N - share the values of tags such as Event, Site and the "
+      "players' names between games, keeping the N most recent values of "
+      "each tag.",
       "--json - output the game in JSON format",
       "--tsv - output the game in TSV format",
       "--keepbroken - retain games with errors",
@@ -264,6 +306,8 @@ static void usage_and_exit(const StateInfo *globals) {
       "--minply N - only output games with at least N ply.",
       "--maxmoves N - only output games with at N or fewer moves.",
       "--maxply N - only output games with at N or fewer ply.",
+      "--memstats - report the memory allocated by each part of the program, "
+      "in total and per game.",
       "--nestedcomments - allow nested comments.",
       "--nobadresults - reject games with inconsistent result indications.",
       "--nochecks - don't output + and # after moves.",
@@ -280,19 +324,34 @@ static void usage_and_exit(const StateInfo *globals) {
       "--novars - see -V",
       "--onlysetuptags - only match games with a SetUp tag.",
       "--output - see -o",
+      "--perft FEN depth - count the positions reached by all sequences of "
+      "depth legal moves from FEN, for each first move, and report the "
+      "speed of the move generator",
+      "--perftsuite file - check the perft counts of the positions of an EPD "
+      "file, with lines of the form: FEN ;D1 20 ;D2 400",
       "--plycount - include a PlyCount tag.",
       "--plylimit - limit the number of plies output.",
+      "--progressinterval N - report progress every N seconds (default 1, "
+      "0 for none).",
       "--quiescent N - position quiescence length (default 0)",
       "--quiet - No status processing output (see, also, -s).",
       "--repetition - only output games that include 3-fold repetition.",
       "--repetition5 - only output games that include 5-fold repetition.",
+      "--resume file - continue the run saved in the checkpoint file, with "
+      "the same arguments, appending to its output files.",
+      "--sampleply N - with -Wpos, only output every Nth position of each "
+      "game.",
       "--selectonly range[,range ...] - only output the selected matched "
       "game(s)",
       "--seven - see -7",
       "--seventyfive - only output games that include seventy-five moves with "
       "no capture or pawn move.",
+      "--skipchecks - with -Wpos, don't output positions in which the side "
+      "to move is in check.",
       "--skipmatching range[,range ...] - don't output the selected matched "
       "game(s)",
+      "--slowgames N - report the N games that took longest to process, with "
+      "their moves, bytes, allocations, file and lines.",
       "--splitvariants [depth] - output each variation (to the given depth) as "
       "a separate game.",
       "--stalemate - only output games that end in stalemate.",
@@ -303,6 +362,8 @@ static void usage_and_exit(const StateInfo *globals) {
       "--totalplycount - include a tag with the total number of plies in a "
       "game.",
       "--underpromotion - match only games that contain an underpromotion.",
+      "--updateindex - as --buildindex, but only read the games that have "
+      "been appended to each input file since its index was built.",
       "--version - print the current version number and exit.",
       "--wtm - match position only if White is to move (see -t)",
       "--xroster - don't output tags not included with the -R option (see -R).",
@@ -589,7 +650,8 @@ void process_argument(StateInfo *globals, GameHeader *game_header,
         (void)fclose(globals->outputfile);
       }
       if (arg_letter == WRITE_TO_OUTPUT_FILE_ARGUMENT) {
-        globals->outputfile = must_open_file(globals, filename, "w");
+        globals->outputfile = must_open_file(
+            globals, filename, output_file_mode(globals, filename));
       } else {
         globals->outputfile = must_open_file(globals, filename, "a");
       }
@@ -621,7 +683,8 @@ void process_argument(StateInfo *globals, GameHeader *game_header,
               DONT_KEEP_DUPLICATES_ARGUMENT);
       exit(1);
     } else {
-      globals->duplicate_file = must_open_file(globals, filename, "w");
+      globals->duplicate_file = must_open_file(
+          globals, filename, output_file_mode(globals, filename));
     }
     break;
   case USE_ECO_FILE_ARGUMENT:
@@ -774,7 +837,8 @@ void process_argument(StateInfo *globals, GameHeader *game_header,
       if (strcmp(filename, "stdout") == 0) {
         globals->non_matching_file = stdout;
       } else {
-        globals->non_matching_file = must_open_file(globals, filename, "w");
+        globals->non_matching_file = must_open_file(
+            globals, filename, output_file_mode(globals, filename));
       }
     } else {
       fprintf(globals->logfile, "Usage: -%cfilename.\n", arg_letter);
@@ -1012,6 +1076,14 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
               argument);
     }
     return 1;
+  } else if (stringcompare(argument, "buildindex") == 0 ||
+             stringcompare(argument, "build-index") == 0) {
+    globals->build_index = true;
+    globals->check_only = true;
+    return 1;
+  } else if (stringcompare(argument, "cache") == 0) {
+    globals->use_game_cache = true;
+    return 1;
   } else if (stringcompare(argument, "checkfile") == 0) {
     process_argument(globals, game_header, CHECK_FILE_ARGUMENT,
                      associated_value);
@@ -1019,6 +1091,26 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
   } else if (stringcompare(argument, "checkmate") == 0) {
     process_argument(globals, game_header, MATCH_CHECKMATE_ARGUMENT, "");
     return 1;
+  } else if (stringcompare(argument, "checkpoint") == 0) {
+    if (*associated_value != '\0') {
+      globals->checkpoint_file = associated_value;
+    } else {
+      fprintf(globals->logfile, "--%s requires a file name following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
+  } else if (stringcompare(argument, "checkpointinterval") == 0) {
+    unsigned interval = 0;
+
+    if (sscanf(associated_value, "%u", &interval) == 1) {
+      globals->checkpoint_interval = interval;
+    } else {
+      fprintf(globals->logfile, "--%s requires a number following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "commented") == 0) {
     if (!globals->keep_comments) {
       fprintf(globals->logfile, "--%s clashes with -%c\n", argument,
@@ -1031,13 +1123,36 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
   } else if (stringcompare(argument, "commentlines") == 0) {
     globals->separate_comment_lines = true;
     return 1;
+  } else if (stringcompare(argument, "compress") == 0) {
+    const char *suffix = compressed_file_suffix(associated_value);
+
+    if (suffix != NULL) {
+      globals->compressed_output_suffix = suffix;
+    } else {
+      fprintf(globals->logfile,
+              "--%s requires one of gz, bz2, xz or zst following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
+  } else if (stringcompare(argument, "compresslevel") == 0) {
+    int level = 0;
+
+    if (sscanf(associated_value, "%d", &level) == 1 && level > 0) {
+      globals->compression_level = level;
+    } else {
+      fprintf(globals->logfile,
+              "--%s requires a positive number following it.\n", argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "deletesamesetup") == 0) {
     globals->delete_same_setup = true;
     return 1;
   } else if (stringcompare(argument, "detag") == 0) {
     /* Save the tag to be dropped. */
     if (associated_value != NULL) {
-      suppress_tag(globals, game_header, associated_value);
+      suppress_tag(globals, associated_value);
     } else {
       fprintf(globals->logfile, "--%s requires a tag name following it.\n",
               argument);
@@ -1162,9 +1277,31 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
     /* Output a hashcode comment after each move. */
     globals->add_hashcode_comments = true;
     return 1;
+  } else if (stringcompare(argument, "heartbeat") == 0) {
+    if (*associated_value != '\0') {
+      globals->heartbeat_file = associated_value;
+    } else {
+      fprintf(globals->logfile, "--%s requires a file name following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "help") == 0) {
     process_argument(globals, game_header, HELP_ARGUMENT, "");
     return 1;
+  } else if (stringcompare(argument, "indexply") == 0) {
+    unsigned limit = 0;
+
+    if (sscanf(associated_value, "%u", &limit) == 1) {
+      globals->index_ply_limit = limit;
+    } else {
+      fprintf(globals->logfile,
+              "--%s requires a non-negative number (0 for no limit) "
+              "following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "insufficient") == 0) {
     if (globals->match_only_checkmate) {
       fprintf(globals->logfile, "--%s clashes with the --checkmate.\n",
@@ -1178,6 +1315,17 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
       globals->match_only_insufficient_material = true;
     }
     return 1;
+  } else if (stringcompare(argument, "interntags") == 0) {
+    unsigned values = 0;
+
+    if (sscanf(associated_value, "%u", &values) == 1 && values > 0) {
+      globals->interned_tag_values = values;
+    } else {
+      fprintf(globals->logfile,
+              "--%s requires a positive number following it.\n", argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "json") == 0) {
     globals->json_format = true;
     return 1;
@@ -1327,6 +1475,10 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
       exit(1);
     }
     return 2;
+  } else if (stringcompare(argument, "memstats") == 0) {
+    globals->memory_statistics = true;
+    start_memory_accounting();
+    return 1;
   } else if (stringcompare(argument, "nestedcomments") == 0) {
     globals->allow_nested_comments = true;
     return 1;
@@ -1390,6 +1542,15 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
     process_argument(globals, game_header, WRITE_TO_OUTPUT_FILE_ARGUMENT,
                      associated_value);
     return 2;
+  } else if (stringcompare(argument, "perftsuite") == 0) {
+    if (*associated_value != '\0') {
+      globals->perft_suite = associated_value;
+    } else {
+      fprintf(globals->logfile, "--%s requires a file name following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "plycount") == 0) {
     globals->output_plycount = true;
     return 1;
@@ -1412,6 +1573,17 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
       exit(1);
     }
     return 2;
+  } else if (stringcompare(argument, "progressinterval") == 0) {
+    unsigned interval = 0;
+
+    if (sscanf(associated_value, "%u", &interval) == 1) {
+      globals->progress_interval = interval;
+    } else {
+      fprintf(globals->logfile, "--%s requires a number following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "quiescent") == 0) {
     int threshold = 0;
 
@@ -1459,6 +1631,15 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
               argument);
       exit(1);
     }
+  } else if (stringcompare(argument, "resume") == 0) {
+    if (*associated_value != '\0') {
+      globals->resume_file = associated_value;
+    } else {
+      fprintf(globals->logfile, "--%s requires a file name following it.\n",
+              argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "selectonly") == 0) {
     /* Extract the selected match numbers from a list. */
     game_number *number_list =
@@ -1470,6 +1651,17 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
       exit(1);
     }
     return 2;
+  } else if (stringcompare(argument, "sampleply") == 0) {
+    unsigned interval = 0;
+
+    if (sscanf(associated_value, "%u", &interval) == 1 && interval > 0) {
+      globals->position_sample_interval = interval;
+    } else {
+      fprintf(globals->logfile,
+              "--%s requires a positive number following it.\n", argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "seven") == 0) {
     process_argument(globals, game_header, SEVEN_TAG_ROSTER_ARGUMENT, "");
     return 1;
@@ -1486,6 +1678,9 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
               globals->check_for_N_move_rule);
       exit(1);
     }
+  } else if (stringcompare(argument, "skipchecks") == 0) {
+    globals->skip_positions_in_check = true;
+    return 1;
   } else if (stringcompare(argument, "skipmatching") == 0) {
     /* Extract the selected match numbers from a list. */
     game_number *number_list =
@@ -1497,6 +1692,18 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
       exit(1);
     }
     return 2;
+  } else if (stringcompare(argument, "slowgames") == 0) {
+    unsigned number = 0;
+
+    if (sscanf(associated_value, "%u", &number) == 1 && number > 0) {
+      globals->slow_games_to_report = number;
+      start_memory_accounting();
+    } else {
+      fprintf(globals->logfile,
+              "--%s requires a positive number following it.\n", argument);
+      exit(1);
+    }
+    return 2;
   } else if (stringcompare(argument, "splitvariants") == 0) {
     if (globals->keep_variations) {
       globals->split_variants = true;
@@ -1584,6 +1791,12 @@ int process_long_form_argument(StateInfo *globals, GameHeader *game_header,
   } else if (stringcompare(argument, "underpromotion") == 0) {
     globals->match_underpromotion = true;
     return 1;
+  } else if (stringcompare(argument, "updateindex") == 0 ||
+             stringcompare(argument, "update-index") == 0) {
+    globals->build_index = true;
+    globals->update_index = true;
+    globals->check_only = true;
+    return 1;
   } else if (stringcompare(argument, "version") == 0) {
     fprintf(globals->logfile, "pgn-extract %s\n", CURRENT_VERSION);
     exit(0);
@@ -0,0 +1,947 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "binary.h"
+
+#include "decode.h"
+#include "defs.h"
+#include "grammar.h"
+#include "lex.h"
+#include "mymalloc.h"
+#include "postings.h"
+#include "taglist.h"
+#include "typedef.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The layout of a binary game file.
+ * The file starts with BINARY_MAGIC and a version byte, followed by
+ * one record for each game, introduced by BINARY_GAME_RECORD.
+ * A game record holds:
+ *     the numbers of the lines of its source on which it started and
+ *         ended;
+ *     the number of tags, followed by the name and value of each;
+ *     the comments preceding the moves;
+ *     the moves of the game.
+ * A sequence of moves is held as its length, followed by a 16-bit
+ * little-endian code for each move:
+ *     bits 0-5: the square moved from;
+ *     bits 6-11: the square moved to;
+ *     bits 12-14: the kind of move (MOVE_KIND_ values);
+ *     bit 15: set if the move is followed by its annotations.
+ * Squares are numbered from 0 (a1) to 63 (h8) along the ranks.
+ * A move that has not been decoded to squares is held in its source
+ * form instead: its code has both squares 0 and MOVE_KIND_NORMAL, and
+ * is followed by a reference to its text in the table of moves.
+ * The first reference to a text is followed by MOVE_DETAILS_LENGTH
+ * bytes of what decode_move made of it.
+ * The annotations of a move are its NAGs, its comments, its terminating
+ * result and its variations.
+ * All numbers other than move codes are stored with write_varint.
+ *
+ * Strings are held in two forms. Literal strings, used for comments and
+ * NAGs, are their length followed by their bytes. The other strings are
+ * held as references into a table of strings:
+ *     0: no string;
+ *     1: a new string, held as a literal and added to the table;
+ *     n > 1: entry n - 2 in the table.
+ * The tables are emptied whenever the file header is repeated,
+ * which allows files to be concatenated and written in several runs.
+ */
+static const char BINARY_MAGIC[] = "PGNB";
+#define BINARY_MAGIC_LENGTH (sizeof(BINARY_MAGIC) - 1)
+#define BINARY_VERSION 2
+#define BINARY_GAME_RECORD 'G'
+
+#define NO_STRING_REFERENCE 0
+#define NEW_STRING_REFERENCE 1
+#define FIRST_STRING_REFERENCE 2
+
+/* Start new string tables once either has this many entries. */
+#define MAX_BINARY_STRINGS (64 * 1024)
+/* A sanity check on the length of strings being read. */
+#define MAX_BINARY_STRING_LENGTH (16 * 1024 * 1024)
+
+typedef enum {
+  MOVE_KIND_NORMAL,
+  MOVE_KIND_PROMOTE_KNIGHT,
+  MOVE_KIND_PROMOTE_BISHOP,
+  MOVE_KIND_PROMOTE_ROOK,
+  MOVE_KIND_PROMOTE_QUEEN,
+  MOVE_KIND_KINGSIDE_CASTLE,
+  MOVE_KIND_QUEENSIDE_CASTLE,
+  MOVE_KIND_NULL
+} MoveKind;
+
+#define MOVE_SQUARE_BITS 6
+#define MOVE_SQUARE_MASK 0x3f
+#define MOVE_KIND_SHIFT 12
+#define MOVE_KIND_MASK 0x7
+#define MOVE_ANNOTATED 0x8000
+/* The code of a move held in its source form. */
+#define SOURCE_MOVE_CODE 0
+/* The class, piece_to_move, from_col, from_rank, to_col and to_rank
+ * of a move held in its source form.
+ */
+#define MOVE_DETAILS_LENGTH 6
+
+/* The strings of a file that may be referred to.
+ * Writers also keep a hash table of indices into strings, with
+ * 0 marking an empty slot and i + 1 entry i.
+ * When reading a table of moves, details holds MOVE_DETAILS_LENGTH
+ * bytes for each entry.
+ */
+typedef struct {
+  char **strings;
+  unsigned long num_strings;
+  unsigned long max_strings;
+  unsigned long *slots;
+  unsigned long num_slots;
+  unsigned char *details;
+} StringTable;
+
+/* A file being written in the binary format.
+ * end is the file position following the last game written, so that
+ * a file whose position has moved since can be detected, and its
+ * string tables restarted.
+ */
+typedef struct {
+  FILE *fp;
+  long end;
+  StringTable strings;
+  StringTable moves;
+} BinaryOutput;
+
+/* How a game is to be written. */
+typedef struct {
+  const StateInfo *globals;
+  BinaryOutput *output;
+  bool keep_comments;
+  bool keep_NAGs;
+  bool keep_variations;
+  /* Whether kept variations are output as separate games. */
+  bool split_variants;
+  /* Whether all tags are kept, regardless of the tag output settings. */
+  bool all_tags;
+  /* Whether all moves are held in their source form. */
+  bool source_moves;
+} BinaryWriter;
+
+/* Allow for the separate files of -# and -E to be written in turn. */
+#define MAX_BINARY_OUTPUTS 4
+static BinaryOutput binary_outputs[MAX_BINARY_OUTPUTS];
+static unsigned next_binary_output = 0;
+
+/* The string tables of the binary file being read. */
+static StringTable input_strings = {NULL, 0, 0, NULL, 0, NULL};
+static StringTable input_moves = {NULL, 0, 0, NULL, 0, NULL};
+
+static unsigned long string_hash(const char *str) {
+  /* FNV-1a */
+  unsigned long hash = 2166136261UL;
+
+  for (; *str != '\0'; str++) {
+    hash ^= (unsigned char)*str;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+static void clear_string_table(StringTable *table) {
+  for (unsigned long i = 0; i < table->num_strings; i++) {
+    (void)free((void *)table->strings[i]);
+  }
+  table->num_strings = 0;
+  if (table->slots != NULL) {
+    memset(table->slots, 0, table->num_slots * sizeof(*table->slots));
+  }
+}
+
+/* Return the slot of table->slots for str, which is either empty or
+ * refers to an identical string.
+ */
+static unsigned long find_string_slot(const StringTable *table,
+                                      const char *str) {
+  unsigned long slot = string_hash(str) & (table->num_slots - 1);
+
+  while (table->slots[slot] != 0 &&
+         strcmp(table->strings[table->slots[slot] - 1], str) != 0) {
+    slot = (slot + 1) & (table->num_slots - 1);
+  }
+  return slot;
+}
+
+/* Add a copy of str to the table. */
+static void add_string(StringTable *table, const char *str, bool hashed) {
+  if (table->num_strings == table->max_strings) {
+    table->max_strings = table->max_strings == 0 ? 256 : 2 * table->max_strings;
+    table->strings = (char **)realloc_or_die(
+        (void *)table->strings, table->max_strings * sizeof(*table->strings));
+    if (table == &input_moves) {
+      table->details = (unsigned char *)realloc_or_die(
+          (void *)table->details, table->max_strings * MOVE_DETAILS_LENGTH);
+    }
+  }
+  table->strings[table->num_strings] = copy_string(str);
+  table->num_strings++;
+  if (hashed) {
+    if (2 * table->num_strings > table->num_slots) {
+      /* Rehash into a table of twice the size. */
+      (void)free((void *)table->slots);
+      table->num_slots = table->num_slots == 0 ? 512 : 2 * table->num_slots;
+      table->slots = (unsigned long *)malloc_or_die(table->num_slots *
+                                                    sizeof(*table->slots));
+      memset(table->slots, 0, table->num_slots * sizeof(*table->slots));
+      for (unsigned long i = 0; i < table->num_strings; i++) {
+        table->slots[find_string_slot(table, table->strings[i])] = i + 1;
+      }
+    } else {
+      table->slots[find_string_slot(table, str)] = table->num_strings;
+    }
+  }
+}
+
+static void write_header(FILE *fp) {
+  (void)fwrite(BINARY_MAGIC, 1, BINARY_MAGIC_LENGTH, fp);
+  putc(BINARY_VERSION, fp);
+}
+
+/* Return the BinaryOutput for outputfile, writing a file header
+ * if its string tables are not known to be current.
+ */
+static BinaryOutput *find_binary_output(FILE *outputfile) {
+  long position = ftell(outputfile);
+  BinaryOutput *output = NULL;
+
+  for (unsigned i = 0; i < MAX_BINARY_OUTPUTS && output == NULL; i++) {
+    if (binary_outputs[i].fp == outputfile) {
+      output = &binary_outputs[i];
+    }
+  }
+  if (output != NULL && position != 0 && position == output->end &&
+      output->strings.num_strings < MAX_BINARY_STRINGS &&
+      output->moves.num_strings < MAX_BINARY_STRINGS) {
+    return output;
+  }
+  if (output == NULL) {
+    output = &binary_outputs[next_binary_output];
+    next_binary_output = (next_binary_output + 1) % MAX_BINARY_OUTPUTS;
+    output->fp = outputfile;
+  }
+  clear_string_table(&output->strings);
+  clear_string_table(&output->moves);
+  write_header(outputfile);
+  return output;
+}
+
+static void write_literal(FILE *fp, const char *str) {
+  size_t length = strlen(str);
+
+  write_varint(fp, length);
+  (void)fwrite(str, 1, length, fp);
+}
+
+/* Write a reference to str in table.
+ * Return true if it was new to the table.
+ */
+static bool write_string_reference(FILE *fp, StringTable *table,
+                                   const char *str) {
+  unsigned long slot = 0;
+
+  if (str == NULL) {
+    write_varint(fp, NO_STRING_REFERENCE);
+    return false;
+  }
+  if (table->num_slots != 0) {
+    slot = find_string_slot(table, str);
+  }
+  if (table->num_slots != 0 && table->slots[slot] != 0) {
+    write_varint(fp, table->slots[slot] - 1 + FIRST_STRING_REFERENCE);
+    return false;
+  } else {
+    write_varint(fp, NEW_STRING_REFERENCE);
+    write_literal(fp, str);
+    add_string(table, str, true);
+    return true;
+  }
+}
+
+static void write_string_list(FILE *fp, const StringList *list) {
+  unsigned long count = 0;
+
+  for (const StringList *item = list; item != NULL; item = item->next) {
+    count++;
+  }
+  write_varint(fp, count);
+  for (; list != NULL; list = list->next) {
+    write_literal(fp, list->str != NULL ? list->str : "");
+  }
+}
+
+static unsigned long comment_list_length(const CommentList *comments) {
+  unsigned long length = 0;
+
+  for (; comments != NULL; comments = comments->next) {
+    length++;
+  }
+  return length;
+}
+
+static void write_comments(FILE *fp, const CommentList *comments) {
+  for (; comments != NULL; comments = comments->next) {
+    write_string_list(fp, comments->comment);
+  }
+}
+
+static void write_comment_list(const BinaryWriter *writer,
+                               const CommentList *comments) {
+  if (!writer->keep_comments) {
+    comments = NULL;
+  }
+  write_varint(writer->output->fp, comment_list_length(comments));
+  write_comments(writer->output->fp, comments);
+}
+
+/* Write the comments of move.
+ * When NAGs or variations are not being kept, the comments attached
+ * to them are kept with the move, as they would be on output.
+ */
+static void write_move_comments(const BinaryWriter *writer, const Move *move) {
+  FILE *fp = writer->output->fp;
+  const Nag *nags = writer->keep_NAGs ? NULL : move->NAGs;
+  const Variation *variants = writer->keep_variations ? NULL : move->Variants;
+  unsigned long count;
+
+  if (!writer->keep_comments) {
+    write_varint(fp, 0);
+    return;
+  }
+  count = comment_list_length(move->comment_list);
+  for (const Nag *nag = nags; nag != NULL; nag = nag->next) {
+    count += comment_list_length(nag->comments);
+  }
+  for (const Variation *variant = variants; variant != NULL;
+       variant = variant->next) {
+    count += comment_list_length(variant->suffix_comment);
+  }
+  write_varint(fp, count);
+  write_comments(fp, move->comment_list);
+  for (; nags != NULL; nags = nags->next) {
+    write_comments(fp, nags->comments);
+  }
+  for (; variants != NULL; variants = variants->next) {
+    write_comments(fp, variants->suffix_comment);
+  }
+}
+
+static unsigned square_number(Col col, Rank rank) {
+  return (col - 'a') + 8 * (rank - '1');
+}
+
+static bool on_board(Col col, Rank rank) {
+  return col >= 'a' && col <= 'h' && rank >= '1' && rank <= '8';
+}
+
+/* Return the code of move, or SOURCE_MOVE_CODE if it cannot be
+ * represented because it has not been fully decoded.
+ * As a1a1 is not a possible move, SOURCE_MOVE_CODE is never a valid code.
+ */
+static unsigned encode_move(const Move *move) {
+  MoveKind kind;
+
+  switch (move->class) {
+  case PAWN_MOVE:
+  case ENPASSANT_PAWN_MOVE:
+  case PIECE_MOVE:
+    kind = MOVE_KIND_NORMAL;
+    break;
+  case PAWN_MOVE_WITH_PROMOTION:
+    switch (move->promoted_piece) {
+    case KNIGHT:
+      kind = MOVE_KIND_PROMOTE_KNIGHT;
+      break;
+    case BISHOP:
+      kind = MOVE_KIND_PROMOTE_BISHOP;
+      break;
+    case ROOK:
+      kind = MOVE_KIND_PROMOTE_ROOK;
+      break;
+    case QUEEN:
+      kind = MOVE_KIND_PROMOTE_QUEEN;
+      break;
+    default:
+      return SOURCE_MOVE_CODE;
+    }
+    break;
+  case KINGSIDE_CASTLE:
+    return MOVE_KIND_KINGSIDE_CASTLE << MOVE_KIND_SHIFT;
+  case QUEENSIDE_CASTLE:
+    return MOVE_KIND_QUEENSIDE_CASTLE << MOVE_KIND_SHIFT;
+  case NULL_MOVE:
+    return MOVE_KIND_NULL << MOVE_KIND_SHIFT;
+  case UNKNOWN_MOVE:
+  default:
+    return SOURCE_MOVE_CODE;
+  }
+  if (!on_board(move->from_col, move->from_rank) ||
+      !on_board(move->to_col, move->to_rank)) {
+    return SOURCE_MOVE_CODE;
+  }
+  return square_number(move->from_col, move->from_rank) |
+         (square_number(move->to_col, move->to_rank) << MOVE_SQUARE_BITS) |
+         (kind << MOVE_KIND_SHIFT);
+}
+
+static void write_source_move(const BinaryWriter *writer, const Move *move) {
+  FILE *fp = writer->output->fp;
+
+  if (write_string_reference(fp, &writer->output->moves,
+                             (const char *)move->move)) {
+    putc(move->class, fp);
+    putc(move->piece_to_move, fp);
+    putc(move->from_col, fp);
+    putc(move->from_rank, fp);
+    putc(move->to_col, fp);
+    putc(move->to_rank, fp);
+  }
+}
+
+static void write_move_sequence(const BinaryWriter *writer, const Move *moves);
+
+/* The variations of move to be written.
+ * Split variations are output as separate games.
+ */
+static const Variation *variations_written(const BinaryWriter *writer,
+                                           const Move *move) {
+  if (writer->keep_variations && !writer->split_variants) {
+    return move->Variants;
+  } else {
+    return NULL;
+  }
+}
+
+static void write_annotations(const BinaryWriter *writer, const Move *move) {
+  FILE *fp = writer->output->fp;
+  unsigned long count = 0;
+  const Nag *nags = writer->keep_NAGs ? move->NAGs : NULL;
+  const Variation *variants = variations_written(writer, move);
+
+  for (const Nag *nag = nags; nag != NULL; nag = nag->next) {
+    count++;
+  }
+  write_varint(fp, count);
+  for (; nags != NULL; nags = nags->next) {
+    write_string_list(fp, nags->text);
+    write_comment_list(writer, nags->comments);
+  }
+  write_move_comments(writer, move);
+  (void)write_string_reference(fp, &writer->output->strings,
+                               move->terminating_result);
+  count = 0;
+  for (const Variation *variant = variants; variant != NULL;
+       variant = variant->next) {
+    count++;
+  }
+  write_varint(fp, count);
+  for (; variants != NULL; variants = variants->next) {
+    write_comment_list(writer, variants->prefix_comment);
+    write_move_sequence(writer, variants->moves);
+    write_comment_list(writer, variants->suffix_comment);
+  }
+}
+
+static bool has_annotations(const BinaryWriter *writer, const Move *move) {
+  return ((writer->keep_NAGs || writer->keep_comments) &&
+          move->NAGs != NULL) ||
+         (writer->keep_comments && move->comment_list != NULL) ||
+         move->terminating_result != NULL ||
+         variations_written(writer, move) != NULL ||
+         (!writer->keep_variations && writer->keep_comments &&
+          move->Variants != NULL);
+}
+
+static void write_move_sequence(const BinaryWriter *writer, const Move *moves) {
+  FILE *fp = writer->output->fp;
+  unsigned long count = 0;
+
+  for (const Move *move = moves; move != NULL; move = move->next) {
+    count++;
+  }
+  write_varint(fp, count);
+  for (; moves != NULL; moves = moves->next) {
+    unsigned code =
+        writer->source_moves ? SOURCE_MOVE_CODE : encode_move(moves);
+    bool annotated = has_annotations(writer, moves);
+
+    if (annotated) {
+      code |= MOVE_ANNOTATED;
+    }
+    putc(code & 0xff, fp);
+    putc(code >> 8, fp);
+    if ((code & ~MOVE_ANNOTATED) == SOURCE_MOVE_CODE) {
+      write_source_move(writer, moves);
+    }
+    if (annotated) {
+      write_annotations(writer, moves);
+    }
+  }
+}
+
+/* Whether the tag is to be written.
+ * The tags describing the starting position are always kept,
+ * as the moves could not be replayed without them, as is the
+ * result, which is the only record of it in a game without moves.
+ */
+static bool binary_tag_wanted(const BinaryWriter *writer, TagName tag) {
+  const StateInfo *globals = writer->globals;
+
+  if (writer->all_tags || tag == FEN_TAG || tag == SETUP_TAG ||
+      tag == VARIANT_TAG || tag == RESULT_TAG) {
+    return true;
+  } else if (is_suppressed_tag(globals, tag)) {
+    return false;
+  }
+  switch (globals->tag_output_format) {
+  case ALL_TAGS:
+    return true;
+  case SEVEN_TAG_ROSTER:
+    switch (tag) {
+    case EVENT_TAG:
+    case SITE_TAG:
+    case DATE_TAG:
+    case ROUND_TAG:
+    case WHITE_TAG:
+    case BLACK_TAG:
+    case RESULT_TAG:
+      return true;
+    case ECO_TAG:
+    case OPENING_TAG:
+    case VARIATION_TAG:
+    case SUB_VARIATION_TAG:
+      return globals->add_ECO && !globals->parsing_ECO_file;
+    default:
+      return false;
+    }
+  case NO_TAGS:
+  default:
+    return false;
+  }
+}
+
+/* Write the name and value of a tag of a game. */
+static void write_tag(const BinaryWriter *writer, TagName tag,
+                      const char *value) {
+  FILE *fp = writer->output->fp;
+
+  (void)write_string_reference(fp, &writer->output->strings,
+                               tag_header_string(writer->globals, tag));
+  (void)write_string_reference(fp, &writer->output->strings, value);
+}
+
+static void write_game(const BinaryWriter *writer, char **tags,
+                       const ExtraTag *extra_tags, unsigned num_extra_tags,
+                       const CommentList *prefix_comment, const Move *moves,
+                       unsigned long start_line, unsigned long end_line) {
+  FILE *fp = writer->output->fp;
+  unsigned long count = 0;
+
+  putc(BINARY_GAME_RECORD, fp);
+  write_varint(fp, start_line);
+  write_varint(fp, end_line);
+  for (int tag = 0; tag < ORIGINAL_NUMBER_OF_TAGS; tag++) {
+    if (tags[tag] != NULL && binary_tag_wanted(writer, tag)) {
+      count++;
+    }
+  }
+  for (unsigned i = 0; i < num_extra_tags; i++) {
+    if (binary_tag_wanted(writer, extra_tags[i].tag)) {
+      count++;
+    }
+  }
+  write_varint(fp, count);
+  for (int tag = 0; tag < ORIGINAL_NUMBER_OF_TAGS; tag++) {
+    if (tags[tag] != NULL && binary_tag_wanted(writer, tag)) {
+      write_tag(writer, tag, tags[tag]);
+    }
+  }
+  for (unsigned i = 0; i < num_extra_tags; i++) {
+    if (binary_tag_wanted(writer, extra_tags[i].tag)) {
+      write_tag(writer, extra_tags[i].tag, extra_tags[i].value);
+    }
+  }
+  write_comment_list(writer, prefix_comment);
+  write_move_sequence(writer, moves);
+  writer->output->end = ftell(fp);
+}
+
+/* Output game in the binary format. */
+void output_binary_game(const StateInfo *globals, const Game *game,
+                        FILE *outputfile) {
+  BinaryWriter writer;
+
+  writer.globals = globals;
+  writer.output = find_binary_output(outputfile);
+  writer.keep_comments = globals->keep_comments;
+  writer.keep_NAGs = globals->keep_NAGs;
+  writer.keep_variations = globals->keep_variations;
+  writer.split_variants = globals->split_variants;
+  writer.all_tags = false;
+  writer.source_moves = false;
+  write_game(&writer, game->tags, game->extra_tags, game->num_extra_tags,
+             game->prefix_comment, game->moves, game->start_line,
+             game->end_line);
+}
+
+/* Write to fp all that the parser found of a game, with its moves
+ * as they were before being applied, so that reading it back
+ * is equivalent to parsing it again.
+ */
+void write_parsed_game(const StateInfo *globals, const GameHeader *game_header,
+                       const Move *moves, unsigned long start_line,
+                       unsigned long end_line, FILE *fp) {
+  BinaryWriter writer;
+
+  writer.globals = globals;
+  writer.output = find_binary_output(fp);
+  writer.keep_comments = true;
+  writer.keep_NAGs = true;
+  writer.keep_variations = true;
+  writer.split_variants = false;
+  writer.all_tags = true;
+  writer.source_moves = true;
+  write_game(&writer, game_header->Tags, game_header->extra_tags,
+             game_header->num_extra_tags, game_header->prefix_comment, moves,
+             start_line, end_line);
+}
+
+/* Report that the binary input is unreadable, and exit. */
+static void corrupt_binary_input(const StateInfo *globals) {
+  fprintf(globals->logfile, "The binary game file %s is corrupt.\n",
+          globals->current_input_file);
+  exit(1);
+}
+
+static unsigned long read_number(const StateInfo *globals, FILE *fp) {
+  unsigned long value;
+
+  if (!read_varint(fp, &value)) {
+    corrupt_binary_input(globals);
+  }
+  return value;
+}
+
+static char *read_literal(const StateInfo *globals, FILE *fp) {
+  unsigned long length = read_number(globals, fp);
+  char *str;
+
+  if (length > MAX_BINARY_STRING_LENGTH) {
+    corrupt_binary_input(globals);
+  }
+  str = (char *)malloc_or_die(length + 1);
+  if (fread(str, 1, length, fp) != length) {
+    corrupt_binary_input(globals);
+  }
+  str[length] = '\0';
+  return str;
+}
+
+/* Return the index in table of the string referred to next,
+ * reading it if it is new to the table, or -1 for no string.
+ */
+static long read_string_index(const StateInfo *globals, FILE *fp,
+                              StringTable *table) {
+  unsigned long reference = read_number(globals, fp);
+
+  if (reference == NO_STRING_REFERENCE) {
+    return -1;
+  } else if (reference == NEW_STRING_REFERENCE) {
+    char *str = read_literal(globals, fp);
+
+    add_string(table, str, false);
+    (void)free((void *)str);
+    return (long)table->num_strings - 1;
+  } else if (reference - FIRST_STRING_REFERENCE < table->num_strings) {
+    return (long)(reference - FIRST_STRING_REFERENCE);
+  } else {
+    corrupt_binary_input(globals);
+    return -1;
+  }
+}
+
+/* Return a copy of the string referred to next, or NULL. */
+static char *read_string_reference(const StateInfo *globals, FILE *fp) {
+  long index = read_string_index(globals, fp, &input_strings);
+
+  return index < 0 ? NULL : copy_string(input_strings.strings[index]);
+}
+
+static StringList *read_string_list(const StateInfo *globals, FILE *fp) {
+  StringList *list = NULL;
+
+  for (unsigned long count = read_number(globals, fp); count > 0; count--) {
+    list = save_string_list_item(list, read_literal(globals, fp));
+  }
+  return list;
+}
+
+static CommentList *read_comment_list(const StateInfo *globals, FILE *fp) {
+  CommentList *head = NULL, *tail = NULL;
+
+  for (unsigned long count = read_number(globals, fp); count > 0; count--) {
+    CommentList *comment = (CommentList *)malloc_or_die(sizeof(*comment));
+
+    comment->comment = read_string_list(globals, fp);
+    comment->next = NULL;
+    if (tail == NULL) {
+      head = comment;
+    } else {
+      tail->next = comment;
+    }
+    tail = comment;
+  }
+  return head;
+}
+
+/* Fill in move from its code, giving it the long algebraic
+ * text that decode_move would have given the same move.
+ */
+static void decode_move_code(const StateInfo *globals, unsigned code,
+                             Move *move) {
+  static const char promotion_letters[] = "NBRQ";
+  unsigned from = code & MOVE_SQUARE_MASK;
+  unsigned to = (code >> MOVE_SQUARE_BITS) & MOVE_SQUARE_MASK;
+  MoveKind kind = (code >> MOVE_KIND_SHIFT) & MOVE_KIND_MASK;
+
+  move->from_col = move->from_rank = 0;
+  move->to_col = move->to_rank = 0;
+  switch (kind) {
+  case MOVE_KIND_NORMAL:
+  case MOVE_KIND_PROMOTE_KNIGHT:
+  case MOVE_KIND_PROMOTE_BISHOP:
+  case MOVE_KIND_PROMOTE_ROOK:
+  case MOVE_KIND_PROMOTE_QUEEN:
+    if (from == to) {
+      corrupt_binary_input(globals);
+    }
+    move->from_col = 'a' + (from % 8);
+    move->from_rank = '1' + (from / 8);
+    move->to_col = 'a' + (to % 8);
+    move->to_rank = '1' + (to / 8);
+    move->piece_to_move = PAWN;
+    move->move[0] = move->from_col;
+    move->move[1] = move->from_rank;
+    move->move[2] = move->to_col;
+    move->move[3] = move->to_rank;
+    if (kind == MOVE_KIND_NORMAL) {
+      move->class = PAWN_MOVE;
+      move->move[4] = '\0';
+    } else {
+      move->class = PAWN_MOVE_WITH_PROMOTION;
+      move->move[4] = promotion_letters[kind - MOVE_KIND_PROMOTE_KNIGHT];
+      move->move[5] = '\0';
+    }
+    break;
+  case MOVE_KIND_KINGSIDE_CASTLE:
+    move->class = KINGSIDE_CASTLE;
+    strcpy((char *)move->move, "O-O");
+    break;
+  case MOVE_KIND_QUEENSIDE_CASTLE:
+    move->class = QUEENSIDE_CASTLE;
+    strcpy((char *)move->move, "O-O-O");
+    break;
+  case MOVE_KIND_NULL:
+  default:
+    move->class = NULL_MOVE;
+    strcpy((char *)move->move, NULL_MOVE_STRING);
+    break;
+  }
+}
+
+/* Fill in move from the reference to its source form that follows. */
+static void read_source_move(const StateInfo *globals, FILE *fp, Move *move) {
+  unsigned long previous = input_moves.num_strings;
+  long index = read_string_index(globals, fp, &input_moves);
+  unsigned char *details;
+
+  if (index < 0 || strlen(input_moves.strings[index]) > MAX_MOVE_LEN) {
+    corrupt_binary_input(globals);
+  }
+  details = &input_moves.details[index * MOVE_DETAILS_LENGTH];
+  if (input_moves.num_strings != previous &&
+      fread(details, 1, MOVE_DETAILS_LENGTH, fp) != MOVE_DETAILS_LENGTH) {
+    corrupt_binary_input(globals);
+  }
+  strcpy((char *)move->move, input_moves.strings[index]);
+  move->class = (MoveClass)details[0];
+  move->piece_to_move = (Piece)details[1];
+  move->from_col = (Col)details[2];
+  move->from_rank = (Rank)details[3];
+  move->to_col = (Col)details[4];
+  move->to_rank = (Rank)details[5];
+}
+
+static Move *read_move_sequence(const StateInfo *globals, FILE *fp);
+
+static void read_annotations(const StateInfo *globals, FILE *fp, Move *move) {
+  Nag *last_nag = NULL;
+  Variation *last_variant = NULL;
+
+  for (unsigned long count = read_number(globals, fp); count > 0; count--) {
+    Nag *nag = (Nag *)malloc_or_die(sizeof(*nag));
+
+    nag->text = read_string_list(globals, fp);
+    nag->comments = read_comment_list(globals, fp);
+    nag->next = NULL;
+    if (last_nag == NULL) {
+      move->NAGs = nag;
+    } else {
+      last_nag->next = nag;
+    }
+    last_nag = nag;
+  }
+  move->comment_list = read_comment_list(globals, fp);
+  move->terminating_result = read_string_reference(globals, fp);
+  for (unsigned long count = read_number(globals, fp); count > 0; count--) {
+    Variation *variant = (Variation *)malloc_or_die(sizeof(*variant));
+
+    variant->prefix_comment = read_comment_list(globals, fp);
+    variant->moves = read_move_sequence(globals, fp);
+    variant->suffix_comment = read_comment_list(globals, fp);
+    variant->next = NULL;
+    if (last_variant == NULL) {
+      move->Variants = variant;
+    } else {
+      last_variant->next = variant;
+    }
+    last_variant = variant;
+  }
+}
+
+static Move *read_move_sequence(const StateInfo *globals, FILE *fp) {
+  Move *head = NULL, *tail = NULL;
+
+  for (unsigned long count = read_number(globals, fp); count > 0; count--) {
+    int low = getc(fp);
+    int high = getc(fp);
+    unsigned code;
+    Move *move;
+
+    if (low == EOF || high == EOF) {
+      corrupt_binary_input(globals);
+    }
+    code = (unsigned)low | ((unsigned)high << 8);
+    move = new_move_structure();
+    if ((code & ~MOVE_ANNOTATED) == SOURCE_MOVE_CODE) {
+      read_source_move(globals, fp, move);
+    } else {
+      decode_move_code(globals, code, move);
+    }
+    if (code & MOVE_ANNOTATED) {
+      read_annotations(globals, fp, move);
+    }
+    if (tail == NULL) {
+      head = move;
+    } else {
+      tail->next = move;
+    }
+    tail = move;
+  }
+  return head;
+}
+
+/* Whether fp starts with the header of a binary game file.
+ * fp is left at its start, regardless.
+ */
+bool is_binary_game_file(FILE *fp) {
+  char magic[BINARY_MAGIC_LENGTH];
+  bool binary = fread(magic, 1, BINARY_MAGIC_LENGTH, fp) ==
+                    BINARY_MAGIC_LENGTH &&
+                memcmp(magic, BINARY_MAGIC, BINARY_MAGIC_LENGTH) == 0;
+
+  rewind(fp);
+  return binary;
+}
+
+/* Whether there is another game to be read from the binary file fp.
+ * Any file headers preceding it are consumed.
+ */
+bool binary_game_follows(const StateInfo *globals, FILE *fp) {
+  int ch;
+
+  while ((ch = getc(fp)) == BINARY_MAGIC[0]) {
+    char magic[BINARY_MAGIC_LENGTH];
+    int version;
+
+    magic[0] = (char)ch;
+    if (fread(&magic[1], 1, BINARY_MAGIC_LENGTH - 1, fp) !=
+            BINARY_MAGIC_LENGTH - 1 ||
+        memcmp(magic, BINARY_MAGIC, BINARY_MAGIC_LENGTH) != 0) {
+      corrupt_binary_input(globals);
+    }
+    version = getc(fp);
+    if (version != BINARY_VERSION) {
+      fprintf(globals->logfile,
+              "Unsupported version %d of the binary game format in %s.\n",
+              version, globals->current_input_file);
+      exit(1);
+    }
+    clear_string_table(&input_strings);
+    clear_string_table(&input_moves);
+  }
+  if (ch == EOF) {
+    return false;
+  } else if (ch != BINARY_GAME_RECORD) {
+    corrupt_binary_input(globals);
+  }
+  (void)ungetc(ch, fp);
+  return true;
+}
+
+/* Read the next game from fp, which binary_game_follows has found.
+ * Its tags and prefix comment are stored in game_header, the lines
+ * of its source in start_line and end_line, and its moves returned.
+ */
+Move *read_binary_game(StateInfo *globals, GameHeader *game_header, FILE *fp,
+                       unsigned long *start_line, unsigned long *end_line) {
+  unsigned long num_tags;
+
+  if (getc(fp) != BINARY_GAME_RECORD) {
+    corrupt_binary_input(globals);
+  }
+  *start_line = read_number(globals, fp);
+  *end_line = read_number(globals, fp);
+  for (num_tags = read_number(globals, fp); num_tags > 0; num_tags--) {
+    char *name = read_string_reference(globals, fp);
+    char *value = read_string_reference(globals, fp);
+    TagName tag;
+
+    if (name == NULL || value == NULL) {
+      corrupt_binary_input(globals);
+    }
+    tag = identify_or_add_tag(globals, name);
+    set_game_tag(globals, game_header, tag, value);
+    (void)free((void *)name);
+  }
+  game_header->prefix_comment = read_comment_list(globals, fp);
+  return read_move_sequence(globals, fp);
+}
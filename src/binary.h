@@ -0,0 +1,53 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* A compact binary representation of games, selected for output
+ * with -Wbin. Tags and comments are held as counted strings, with
+ * the strings of tag names, tag values and results that have already
+ * occurred in the file replaced by references to their first
+ * occurrence. Moves are held as the squares between which they are
+ * made, so that they can be replayed when the file is read back in
+ * without having to decode their text. Moves that have not been
+ * decoded to squares are held in their source form.
+ * Files in this format are recognised when they are named as inputs.
+ */
+#ifndef BINARY_H
+#define BINARY_H
+
+#include "typedef.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* The suffix of files written in the binary format. */
+#define BINARY_FILE_SUFFIX ".pgnb"
+
+bool binary_game_follows(const StateInfo *globals, FILE *fp);
+bool is_binary_game_file(FILE *fp);
+void output_binary_game(const StateInfo *globals, const Game *game,
+                        FILE *outputfile);
+Move *read_binary_game(StateInfo *globals, GameHeader *game_header, FILE *fp,
+                       unsigned long *start_line, unsigned long *end_line);
+void write_parsed_game(const StateInfo *globals, const GameHeader *game_header,
+                       const Move *moves, unsigned long start_line,
+                       unsigned long end_line, FILE *fp);
+
+#endif // BINARY_H
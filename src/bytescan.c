@@ -0,0 +1,142 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "bytescan.h"
+
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define BLOCK_SIZE 32
+typedef __m256i Block;
+
+/* Aligned loads may read beyond the ends of a string, which is
+ * safe but is reported by AddressSanitizer and ThreadSanitizer.
+ */
+__attribute__((no_sanitize("address", "thread"))) static inline Block
+load_aligned(const unsigned char *p) {
+  return _mm256_load_si256((const Block *)p);
+}
+
+static inline Block load_unaligned(const unsigned char *p) {
+  return _mm256_loadu_si256((const Block *)p);
+}
+
+static inline Block broadcast(unsigned char ch) {
+  return _mm256_set1_epi8((char)ch);
+}
+
+/* The bits of the positions of block that hold first or second. */
+static inline unsigned matches(Block block, Block first, Block second) {
+  return (unsigned)_mm256_movemask_epi8(
+      _mm256_or_si256(_mm256_cmpeq_epi8(block, first),
+                      _mm256_cmpeq_epi8(block, second)));
+}
+#elif defined(__SSE2__)
+#define BLOCK_SIZE 16
+typedef __m128i Block;
+
+/* Aligned loads may read beyond the ends of a string, which is
+ * safe but is reported by AddressSanitizer and ThreadSanitizer.
+ */
+__attribute__((no_sanitize("address", "thread"))) static inline Block
+load_aligned(const unsigned char *p) {
+  return _mm_load_si128((const Block *)p);
+}
+
+static inline Block load_unaligned(const unsigned char *p) {
+  return _mm_loadu_si128((const Block *)p);
+}
+
+static inline Block broadcast(unsigned char ch) {
+  return _mm_set1_epi8((char)ch);
+}
+
+/* The bits of the positions of block that hold first or second. */
+static inline unsigned matches(Block block, Block first, Block second) {
+  return (unsigned)_mm_movemask_epi8(_mm_or_si128(
+      _mm_cmpeq_epi8(block, first), _mm_cmpeq_epi8(block, second)));
+}
+#endif
+
+/* Return a pointer to the first occurrence of first or second in the
+ * string str, or to its terminating '\0' if there is neither.
+ */
+const unsigned char *find_delimiter(const unsigned char *str,
+                                    unsigned char first,
+                                    unsigned char second) {
+#ifdef BLOCK_SIZE
+  /* Aligned blocks never cross a page boundary, so the whole of the
+   * blocks holding str may be read, even beyond its ends.
+   */
+  const unsigned char *block =
+      (const unsigned char *)((uintptr_t)str & ~(uintptr_t)(BLOCK_SIZE - 1));
+  const Block firsts = broadcast(first), seconds = broadcast(second);
+  const Block ends = broadcast('\0');
+  Block contents = load_aligned(block);
+  unsigned found = (matches(contents, firsts, seconds) |
+                    matches(contents, ends, ends)) >>
+                   (str - block);
+
+  if (found != 0) {
+    return str + __builtin_ctz(found);
+  }
+  for (;;) {
+    block += BLOCK_SIZE;
+    contents = load_aligned(block);
+    found = matches(contents, firsts, seconds) | matches(contents, ends, ends);
+    if (found != 0) {
+      return block + __builtin_ctz(found);
+    }
+  }
+#else
+  while (*str != first && *str != second && *str != '\0') {
+    str++;
+  }
+  return str;
+#endif
+}
+
+/* Return the index of the first '\n' or '\r' in the length characters
+ * of text, or length if there is neither.
+ */
+size_t find_line_end(const unsigned char *text, size_t length) {
+  size_t i = 0;
+
+#ifdef BLOCK_SIZE
+  const Block newlines = broadcast('\n'), returns = broadcast('\r');
+
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE) {
+    unsigned found = matches(load_unaligned(text + i), newlines, returns);
+
+    if (found != 0) {
+      return i + __builtin_ctz(found);
+    }
+  }
+#endif
+  while (i < length && text[i] != '\n' && text[i] != '\r') {
+    i++;
+  }
+  return i;
+}
@@ -0,0 +1,38 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Searches of lines and the input buffer for the characters that end
+ * the longer symbols of the lexical analyser: line ends, the ends of
+ * comments and the ends of strings.
+ * Where the compiler targets them, they compare 32 (AVX2) or 16 (SSE2)
+ * characters at a time, and otherwise one at a time.
+ */
+#ifndef BYTESCAN_H
+#define BYTESCAN_H
+
+#include <stddef.h>
+
+const unsigned char *find_delimiter(const unsigned char *str,
+                                    unsigned char first,
+                                    unsigned char second);
+size_t find_line_end(const unsigned char *text, size_t length);
+
+#endif // BYTESCAN_H
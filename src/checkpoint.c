@@ -0,0 +1,377 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "checkpoint.h"
+
+#include "grammar.h"
+#include "hashing.h"
+#include "lex.h"
+#include "mymalloc.h"
+#include "postings.h"
+#include "typedef.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* A checkpoint file holds little-endian values:
+ *     magic (4 bytes), version (4),
+ *     the number of input files (4) and their names,
+ *     the file number (4), offset (8), line (8) and column (4)
+ *     of the start of the next game,
+ *     the numbers of games processed, matched and not matched (8 each),
+ *     the number of ranges of --selectonly and --skipmatching
+ *     passed (4 each),
+ *     whether the current file has been noted in the duplicate file (1),
+ *     the lengths of the output, non-matching and duplicate files,
+ *     plus one, or 0 if there is none (8 each),
+ *     the number of tags (4) and their names,
+ * followed by the tables written by save_hash_tables.
+ * Strings are held as their length (4) followed by their characters.
+ */
+static const char CHECKPOINT_MAGIC[4] = {'P', 'G', 'N', 'K'};
+#define CHECKPOINT_VERSION 1
+/* The number of output files whose lengths are saved. */
+#define NUM_CHECKPOINT_OUTPUTS 3
+/* A limit on the length of strings, against corrupt files. */
+#define MAX_CHECKPOINT_STRING 0x100000
+
+/* When the next checkpoint is due. */
+static time_t next_checkpoint_time = 0;
+/* Whether the input has been found not to be repositionable. */
+static bool checkpoint_warning_given = false;
+
+static void write_string(FILE *fp, const char *str) {
+  size_t length = strlen(str);
+
+  write_fixed(fp, 4, length);
+  (void)fwrite(str, 1, length, fp);
+}
+
+/* Read a string written by write_string, or return NULL. */
+static char *read_string(FILE *fp) {
+  unsigned long length;
+  char *str;
+
+  if (!read_fixed(fp, 4, &length) || length > MAX_CHECKPOINT_STRING) {
+    return NULL;
+  }
+  str = (char *)malloc_or_die(length + 1);
+  if (fread(str, 1, length, fp) != length) {
+    (void)free((void *)str);
+    return NULL;
+  }
+  str[length] = '\0';
+  return str;
+}
+
+/* Return the number of ranges of list before range. */
+static unsigned long ranges_passed(const game_number *list,
+                                   const game_number *range) {
+  unsigned long passed = 0;
+
+  for (; list != NULL && list != range; list = list->next) {
+    passed++;
+  }
+  return passed;
+}
+
+/* Return the range of list after passed ranges. */
+static game_number *range_after(game_number *list, unsigned long passed) {
+  for (; list != NULL && passed > 0; passed--) {
+    list = list->next;
+  }
+  return list;
+}
+
+/* The output files whose lengths are saved. */
+static void checkpoint_outputs(const StateInfo *globals,
+                               FILE *outputs[NUM_CHECKPOINT_OUTPUTS]) {
+  outputs[0] = globals->check_only ? NULL : globals->outputfile;
+  outputs[1] = globals->non_matching_file;
+  outputs[2] = globals->duplicate_file;
+}
+
+static void checkpoint_error(const StateInfo *globals, const char *problem) {
+  fprintf(globals->logfile, "--%s %s.\n",
+          globals->resume_file != NULL ? "resume" : "checkpoint", problem);
+  exit(1);
+}
+
+/* Check that the state of the run can be saved and restored,
+ * and that the output files can be repositioned.
+ */
+static void check_checkpoint_settings(const StateInfo *globals) {
+  FILE *outputs[NUM_CHECKPOINT_OUTPUTS];
+
+  if (globals->games_per_file > 0 || globals->ECO_level > 0) {
+    checkpoint_error(globals, "cannot be used with -# or -E");
+  } else if (globals->build_index || globals->use_game_cache) {
+    checkpoint_error(globals, "cannot be used with --buildindex or --cache");
+  } else if (globals->use_virtual_hash_table) {
+    checkpoint_error(globals, "cannot be used with -Z");
+  } else if (input_file_name(0) == NULL) {
+    checkpoint_error(globals, "requires named input files");
+  }
+  checkpoint_outputs(globals, outputs);
+  for (int i = 0; i < NUM_CHECKPOINT_OUTPUTS; i++) {
+    if (outputs[i] == stdout) {
+      checkpoint_error(globals, "requires output to named files, such as -o");
+    } else if (outputs[i] != NULL && ftell(outputs[i]) < 0) {
+      checkpoint_error(globals,
+                       "requires output files that are not compressed");
+    }
+  }
+}
+
+/* Restore the state of the run from the checkpoint file of --resume. */
+static void resume_from_checkpoint(StateInfo *globals,
+                                   GameHeader *game_header) {
+  FILE *fp = fopen(globals->resume_file, "rb");
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  unsigned long value, file_number, num_tags, passed_output, passed_skip;
+  unsigned long lengths[NUM_CHECKPOINT_OUTPUTS];
+  InputPosition position;
+  FILE *outputs[NUM_CHECKPOINT_OUTPUTS];
+  int noted;
+  bool ok = true;
+
+  if (fp == NULL) {
+    fprintf(globals->logfile, "Unable to open the checkpoint file %s.\n",
+            globals->resume_file);
+    exit(1);
+  }
+  if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) ||
+      memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+      !read_fixed(fp, 4, &value) || value != CHECKPOINT_VERSION) {
+    fprintf(globals->logfile, "%s is not a checkpoint file.\n",
+            globals->resume_file);
+    exit(1);
+  }
+  /* The input files must be the same. */
+  ok = read_fixed(fp, 4, &value);
+  for (unsigned long i = 0; ok && i < value; i++) {
+    char *name = read_string(fp);
+
+    ok = name != NULL && input_file_name(i) != NULL &&
+         strcmp(name, input_file_name(i)) == 0;
+    (void)free((void *)name);
+  }
+  if (!ok || input_file_name(value) != NULL) {
+    fprintf(globals->logfile,
+            "The input files are not those of the checkpoint %s.\n",
+            globals->resume_file);
+    exit(1);
+  }
+  ok = read_fixed(fp, 4, &file_number) &&
+       read_fixed(fp, 8, &position.offset) &&
+       read_fixed(fp, 8, &position.line_number) &&
+       read_fixed(fp, 4, &position.column) &&
+       read_fixed(fp, 8, &globals->num_games_processed) &&
+       read_fixed(fp, 8, &globals->num_games_matched) &&
+       read_fixed(fp, 8, &globals->num_non_matching_games) &&
+       read_fixed(fp, 4, &passed_output) &&
+       read_fixed(fp, 4, &passed_skip) && (noted = getc(fp)) != EOF;
+  for (int i = 0; ok && i < NUM_CHECKPOINT_OUTPUTS; i++) {
+    ok = read_fixed(fp, 8, &lengths[i]);
+  }
+  ok = ok && read_fixed(fp, 4, &num_tags);
+  for (unsigned long i = 0; ok && i < num_tags; i++) {
+    char *name = read_string(fp);
+
+    /* Tags are numbered in the order in which they were first seen. */
+    ok = name != NULL &&
+         (unsigned long)identify_or_add_tag(globals, name) == i;
+    (void)free((void *)name);
+  }
+  ok = ok && restore_hash_tables(fp);
+  (void)fclose(fp);
+  if (!ok) {
+    fprintf(globals->logfile, "The checkpoint file %s is not valid.\n",
+            globals->resume_file);
+    exit(1);
+  }
+
+  globals->next_game_number_to_output =
+      range_after(globals->matching_game_numbers, passed_output);
+  globals->next_game_number_to_skip =
+      range_after(globals->skip_game_numbers, passed_skip);
+  checkpoint_outputs(globals, outputs);
+  for (int i = 0; i < NUM_CHECKPOINT_OUTPUTS; i++) {
+    if ((outputs[i] != NULL) != (lengths[i] != 0)) {
+      fprintf(globals->logfile,
+              "The output files are not those of the checkpoint %s.\n",
+              globals->resume_file);
+      exit(1);
+    }
+    /* Discard whatever was written after the checkpoint. */
+    if (outputs[i] != NULL &&
+        (fflush(outputs[i]) != 0 ||
+         ftruncate(fileno(outputs[i]), (off_t)(lengths[i] - 1)) != 0 ||
+         fseek(outputs[i], (long)(lengths[i] - 1), SEEK_SET) != 0)) {
+      fprintf(globals->logfile,
+              "Unable to restore the output files of the checkpoint %s.\n",
+              globals->resume_file);
+      exit(1);
+    }
+  }
+  if (!resume_input(globals, game_header, file_number, position)) {
+    fprintf(globals->logfile, "Unable to reposition the input in %s.\n",
+            input_file_name(file_number) != NULL ? input_file_name(file_number)
+                                                 : globals->resume_file);
+    exit(1);
+  }
+  set_duplicate_file_notes_current_file(globals, noted != 0);
+  if (globals->verbosity > 1) {
+    fprintf(globals->logfile, "Resuming after game %lu at line %lu of %s.\n",
+            globals->num_games_processed, position.line_number,
+            globals->current_input_file);
+  }
+}
+
+/* Check the settings for --checkpoint and --resume, and restore
+ * the state of the run from the checkpoint of --resume.
+ * This follows the opening of the first input file.
+ */
+void start_checkpoints(StateInfo *globals, GameHeader *game_header) {
+  if (globals->checkpoint_file == NULL && globals->resume_file == NULL) {
+    return;
+  }
+  check_checkpoint_settings(globals);
+  if (globals->resume_file != NULL) {
+    resume_from_checkpoint(globals, game_header);
+  }
+  next_checkpoint_time = time(NULL) + globals->checkpoint_interval;
+}
+
+/* Write the state of the run at the end of the current game
+ * to the checkpoint file, by way of a temporary file so that
+ * the previous checkpoint remains valid until it is replaced.
+ * The input is resumed at position.
+ */
+static void write_checkpoint(const StateInfo *globals,
+                             InputPosition position) {
+  char *temporary_name = (char *)malloc_or_die(
+      strlen(globals->checkpoint_file) + sizeof(".tmp"));
+  FILE *outputs[NUM_CHECKPOINT_OUTPUTS];
+  unsigned num_files = 0, num_tags = number_of_tags();
+  FILE *fp;
+
+  /* The output must be on disk before the checkpoint that refers to it. */
+  checkpoint_outputs(globals, outputs);
+  for (int i = 0; i < NUM_CHECKPOINT_OUTPUTS; i++) {
+    if (outputs[i] != NULL) {
+      (void)fflush(outputs[i]);
+      (void)fsync(fileno(outputs[i]));
+    }
+  }
+  sprintf(temporary_name, "%s.tmp", globals->checkpoint_file);
+  fp = fopen(temporary_name, "wb");
+  if (fp == NULL) {
+    fprintf(globals->logfile, "Unable to write the checkpoint file %s.\n",
+            temporary_name);
+    (void)free((void *)temporary_name);
+    return;
+  }
+  (void)fwrite(CHECKPOINT_MAGIC, 1, sizeof(CHECKPOINT_MAGIC), fp);
+  write_fixed(fp, 4, CHECKPOINT_VERSION);
+  while (input_file_name(num_files) != NULL) {
+    num_files++;
+  }
+  write_fixed(fp, 4, num_files);
+  for (unsigned i = 0; i < num_files; i++) {
+    write_string(fp, input_file_name(i));
+  }
+  write_fixed(fp, 4, current_file_number());
+  write_fixed(fp, 8, position.offset);
+  write_fixed(fp, 8, position.line_number);
+  write_fixed(fp, 4, position.column);
+  write_fixed(fp, 8, globals->num_games_processed);
+  write_fixed(fp, 8, globals->num_games_matched);
+  write_fixed(fp, 8, globals->num_non_matching_games);
+  write_fixed(fp, 4,
+                 ranges_passed(globals->matching_game_numbers,
+                               globals->next_game_number_to_output));
+  write_fixed(fp, 4,
+                 ranges_passed(globals->skip_game_numbers,
+                               globals->next_game_number_to_skip));
+  putc(duplicate_file_notes_current_file(globals) ? 1 : 0, fp);
+  for (int i = 0; i < NUM_CHECKPOINT_OUTPUTS; i++) {
+    write_fixed(fp, 8,
+                   outputs[i] != NULL ? (unsigned long)ftell(outputs[i]) + 1
+                                      : 0);
+  }
+  write_fixed(fp, 4, num_tags);
+  for (unsigned tag = 0; tag < num_tags; tag++) {
+    write_string(fp, tag_header_string(globals, tag));
+  }
+  save_hash_tables(fp);
+  if (fflush(fp) != 0 || fsync(fileno(fp)) != 0 || ferror(fp)) {
+    fprintf(globals->logfile, "Unable to write the checkpoint file %s.\n",
+            temporary_name);
+    (void)fclose(fp);
+    (void)remove(temporary_name);
+  } else {
+    (void)fclose(fp);
+    if (rename(temporary_name, globals->checkpoint_file) != 0) {
+      fprintf(globals->logfile, "Unable to write the checkpoint file %s.\n",
+              globals->checkpoint_file);
+    }
+  }
+  (void)free((void *)temporary_name);
+}
+
+/* Write a checkpoint at the end of a game, if one is due. */
+void note_game_for_checkpoint(StateInfo *globals) {
+  if (globals->checkpoint_file == NULL || time(NULL) < next_checkpoint_time) {
+    return;
+  }
+  if (input_can_be_repositioned()) {
+    InputPosition position;
+
+    /* The input is resumed just after the game's result, which is
+     * only known while the lexer holds the line of the result.
+     */
+    if (next_symbol_position(&position)) {
+      write_checkpoint(globals, position);
+      next_checkpoint_time = time(NULL) + globals->checkpoint_interval;
+    }
+  } else {
+    if (!checkpoint_warning_given) {
+      fprintf(globals->logfile,
+              "No checkpoint can be written while reading %s, as it is "
+              "compressed or binary.\n",
+              globals->current_input_file);
+      checkpoint_warning_given = true;
+    }
+    next_checkpoint_time = time(NULL) + globals->checkpoint_interval;
+  }
+}
+
+/* Remove the checkpoint of a run that has completed. */
+void finish_checkpoints(const StateInfo *globals) {
+  if (globals->checkpoint_file != NULL) {
+    (void)remove(globals->checkpoint_file);
+  }
+}
@@ -0,0 +1,43 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Checkpoints of long runs (--checkpoint and --resume).
+ * With --checkpoint file, a snapshot of the run is written to file at
+ * the end of a game every --checkpointinterval seconds (default 60):
+ * the position of the next game in the input, the game counters, the
+ * lengths of the output files, the tag names seen and the hash tables
+ * of duplicate detection. The ECO table is not saved, as it is read
+ * from the ECO file again. A run started with --resume file and the
+ * same arguments truncates the output files to their saved lengths
+ * and continues from the saved position, so that its output is the
+ * same as that of an uninterrupted run.
+ * The checkpoint file is removed when the run completes.
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "typedef.h"
+
+void finish_checkpoints(const StateInfo *globals);
+void note_game_for_checkpoint(StateInfo *globals);
+void start_checkpoints(StateInfo *globals, GameHeader *game_header);
+
+#endif // CHECKPOINT_H
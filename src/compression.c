@@ -0,0 +1,1176 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* For fopencookie. */
+#define _GNU_SOURCE
+
+#include "compression.h"
+
+#include "defs.h"
+#include "mymalloc.h"
+#include "typedef.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* The initial size of the buffer of compressed bytes. */
+#define COMPRESSED_CHUNK_SIZE (64 * 1024)
+/* The size of the blocks into which streams are decompressed. */
+#define DECOMPRESSED_BLOCK_SIZE (256 * 1024)
+/* The decompressing thread waits once this much is waiting to be read. */
+#define MAX_QUEUED_BYTES (16 * 1024 * 1024)
+/* Limits on the zstd frames decompressed in parallel. Larger frames,
+ * and those whose size is not recorded, are decompressed as a stream.
+ */
+#define MAX_PARALLEL_FRAMES 16
+#define MAX_PARALLEL_FRAME_SIZE (64 * 1024 * 1024)
+
+/* The first bytes of the files of each format. */
+static const unsigned char GZIP_MAGIC[] = {0x1f, 0x8b};
+static const unsigned char BZIP2_MAGIC[] = {'B', 'Z', 'h'};
+static const unsigned char XZ_MAGIC[] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+static const unsigned char ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+#define MAX_MAGIC_LENGTH sizeof(XZ_MAGIC)
+
+/* A block of decompressed input. */
+typedef struct Block {
+  char *data;
+  size_t length;
+  struct Block *next;
+} Block;
+
+/* The outcome of passing some compressed bytes to a decoder. */
+typedef enum { STEP_OK, STEP_END_OF_STREAM, STEP_ERROR } StepResult;
+
+struct DecompressedInput {
+  /* For reporting errors. */
+  const StateInfo *globals;
+  FILE *fp;
+  Compression compression;
+#ifdef HAVE_ZLIB
+  z_stream gzip;
+#endif
+#ifdef HAVE_BZIP2
+  bz_stream bzip2;
+#endif
+#ifdef HAVE_LZMA
+  lzma_stream xz;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_DCtx *zstd;
+#endif
+  /* Compressed bytes that have been read but not yet decoded
+   * are in in[in_start] to in[in_end - 1].
+   */
+  unsigned char *in;
+  size_t in_start, in_end, in_size;
+  /* Whether the decoder is between streams, or frames. */
+  bool stream_ended;
+  /* Whether the decoder has reached the end of its input. */
+  bool input_finished;
+  /* The number of zstd frames to decompress together. */
+  unsigned parallel_frames;
+  /* A description of any error in the compressed input. */
+  const char *error;
+  bool error_reported;
+
+  /* The decompressed blocks waiting to be read. */
+  Block *queue_head, *queue_tail;
+  size_t queued_bytes;
+  /* Whether all blocks have been queued. */
+  bool finished;
+  /* The block being read, and the position within it. */
+  Block *current;
+  size_t current_index;
+#ifdef HAVE_PTHREAD
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  bool cancelled;
+#endif
+};
+
+/* Return the number of processors available, up to limit. */
+static unsigned processor_count(unsigned limit) {
+  unsigned count = 1;
+
+#if defined(HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (processors > (long)limit) {
+    count = limit;
+  } else if (processors > 1) {
+    count = (unsigned)processors;
+  }
+#endif
+  return count;
+}
+
+static bool has_magic(const unsigned char *bytes, size_t length,
+                      const unsigned char *magic, size_t magic_length) {
+  return length >= magic_length && memcmp(bytes, magic, magic_length) == 0;
+}
+
+/* Return the compression of fp, judged by its first bytes.
+ * fp is left at its start, regardless.
+ */
+Compression detect_compression(FILE *fp) {
+  unsigned char bytes[MAX_MAGIC_LENGTH];
+  size_t length = fread(bytes, 1, sizeof(bytes), fp);
+  Compression compression = COMPRESSION_NONE;
+
+  if (has_magic(bytes, length, GZIP_MAGIC, sizeof(GZIP_MAGIC))) {
+    compression = COMPRESSION_GZIP;
+  } else if (has_magic(bytes, length, BZIP2_MAGIC, sizeof(BZIP2_MAGIC))) {
+    compression = COMPRESSION_BZIP2;
+  } else if (has_magic(bytes, length, XZ_MAGIC, sizeof(XZ_MAGIC))) {
+    compression = COMPRESSION_XZ;
+  } else if (has_magic(bytes, length, ZSTD_MAGIC, sizeof(ZSTD_MAGIC))) {
+    compression = COMPRESSION_ZSTD;
+  }
+  rewind(fp);
+  return compression;
+}
+
+static const char *compression_name(Compression compression) {
+  switch (compression) {
+  case COMPRESSION_GZIP:
+    return "gzip";
+  case COMPRESSION_BZIP2:
+    return "bzip2";
+  case COMPRESSION_XZ:
+    return "xz";
+  case COMPRESSION_ZSTD:
+    return "zstd";
+  case COMPRESSION_NONE:
+  default:
+    return "no compression";
+  }
+}
+
+/* Read more compressed bytes into input->in, making room for them
+ * if necessary. Return false if there are no more.
+ */
+static bool read_compressed(DecompressedInput *input) {
+  size_t length;
+
+  if (input->in_start > 0) {
+    memmove(input->in, &input->in[input->in_start],
+            input->in_end - input->in_start);
+    input->in_end -= input->in_start;
+    input->in_start = 0;
+  }
+  if (input->in_end == input->in_size) {
+    input->in_size *= 2;
+    input->in = (unsigned char *)realloc_or_die((void *)input->in,
+                                                input->in_size);
+  }
+  length = fread(&input->in[input->in_end], 1,
+                 input->in_size - input->in_end, input->fp);
+  if (length == 0 && ferror(input->fp)) {
+    input->error = "it could not be read";
+  }
+  input->in_end += length;
+  return length > 0;
+}
+
+/* Prepare the decoder for the start of a stream.
+ * Return false if that is not possible.
+ */
+static bool start_decoder(DecompressedInput *input) {
+  switch (input->compression) {
+#ifdef HAVE_ZLIB
+  case COMPRESSION_GZIP:
+    memset(&input->gzip, 0, sizeof(input->gzip));
+    /* Accept the gzip format only. */
+    return inflateInit2(&input->gzip, 16 + MAX_WBITS) == Z_OK;
+#endif
+#ifdef HAVE_BZIP2
+  case COMPRESSION_BZIP2:
+    memset(&input->bzip2, 0, sizeof(input->bzip2));
+    return BZ2_bzDecompressInit(&input->bzip2, 0, 0) == BZ_OK;
+#endif
+#ifdef HAVE_LZMA
+  case COMPRESSION_XZ: {
+    lzma_stream initial = LZMA_STREAM_INIT;
+
+    input->xz = initial;
+    return lzma_stream_decoder(&input->xz, UINT64_MAX, 0) == LZMA_OK;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case COMPRESSION_ZSTD:
+    if (input->zstd == NULL) {
+      input->zstd = ZSTD_createDCtx();
+    } else {
+      (void)ZSTD_DCtx_reset(input->zstd, ZSTD_reset_session_only);
+    }
+    return input->zstd != NULL;
+#endif
+  default:
+    return false;
+  }
+}
+
+static void end_decoder(DecompressedInput *input) {
+  switch (input->compression) {
+#ifdef HAVE_ZLIB
+  case COMPRESSION_GZIP:
+    (void)inflateEnd(&input->gzip);
+    break;
+#endif
+#ifdef HAVE_BZIP2
+  case COMPRESSION_BZIP2:
+    (void)BZ2_bzDecompressEnd(&input->bzip2);
+    break;
+#endif
+#ifdef HAVE_LZMA
+  case COMPRESSION_XZ:
+    lzma_end(&input->xz);
+    break;
+#endif
+#ifdef HAVE_ZSTD
+  case COMPRESSION_ZSTD:
+    (void)ZSTD_freeDCtx(input->zstd);
+    input->zstd = NULL;
+    break;
+#endif
+  default:
+    break;
+  }
+}
+
+/* Decode as much of the in_length bytes at in as possible into
+ * the out_space bytes at out. Set in_used and out_used to the number
+ * of bytes consumed and produced.
+ */
+static StepResult decode_step(DecompressedInput *input,
+                              const unsigned char *in, size_t in_length,
+                              size_t *in_used, char *out, size_t out_space,
+                              size_t *out_used) {
+  switch (input->compression) {
+#ifdef HAVE_ZLIB
+  case COMPRESSION_GZIP: {
+    z_stream *stream = &input->gzip;
+    int result;
+
+    /* The lengths are limited by the block and buffer sizes. */
+    stream->next_in = (Bytef *)in;
+    stream->avail_in = (uInt)in_length;
+    stream->next_out = (Bytef *)out;
+    stream->avail_out = (uInt)out_space;
+    result = inflate(stream, Z_NO_FLUSH);
+    *in_used = in_length - stream->avail_in;
+    *out_used = out_space - stream->avail_out;
+    if (result == Z_STREAM_END) {
+      return STEP_END_OF_STREAM;
+    } else if (result == Z_OK || result == Z_BUF_ERROR) {
+      return STEP_OK;
+    } else {
+      return STEP_ERROR;
+    }
+  }
+#endif
+#ifdef HAVE_BZIP2
+  case COMPRESSION_BZIP2: {
+    bz_stream *stream = &input->bzip2;
+    int result;
+
+    stream->next_in = (char *)in;
+    stream->avail_in = (unsigned)in_length;
+    stream->next_out = out;
+    stream->avail_out = (unsigned)out_space;
+    result = BZ2_bzDecompress(stream);
+    *in_used = in_length - stream->avail_in;
+    *out_used = out_space - stream->avail_out;
+    if (result == BZ_STREAM_END) {
+      return STEP_END_OF_STREAM;
+    } else if (result == BZ_OK) {
+      return STEP_OK;
+    } else {
+      return STEP_ERROR;
+    }
+  }
+#endif
+#ifdef HAVE_LZMA
+  case COMPRESSION_XZ: {
+    lzma_stream *stream = &input->xz;
+    lzma_ret result;
+
+    stream->next_in = in;
+    stream->avail_in = in_length;
+    stream->next_out = (uint8_t *)out;
+    stream->avail_out = out_space;
+    result = lzma_code(stream, LZMA_RUN);
+    *in_used = in_length - stream->avail_in;
+    *out_used = out_space - stream->avail_out;
+    if (result == LZMA_STREAM_END) {
+      return STEP_END_OF_STREAM;
+    } else if (result == LZMA_OK || result == LZMA_BUF_ERROR) {
+      return STEP_OK;
+    } else {
+      return STEP_ERROR;
+    }
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case COMPRESSION_ZSTD: {
+    ZSTD_inBuffer from = {in, in_length, 0};
+    ZSTD_outBuffer to = {out, out_space, 0};
+    size_t result = ZSTD_decompressStream(input->zstd, &to, &from);
+
+    *in_used = from.pos;
+    *out_used = to.pos;
+    if (ZSTD_isError(result)) {
+      return STEP_ERROR;
+    } else if (result == 0) {
+      return STEP_END_OF_STREAM;
+    } else {
+      return STEP_OK;
+    }
+  }
+#endif
+  default:
+    *in_used = *out_used = 0;
+    return STEP_ERROR;
+  }
+}
+
+static Block *new_block(size_t size) {
+  Block *block = (Block *)malloc_or_die(sizeof(*block));
+
+  block->data = (char *)malloc_or_die(size > 0 ? size : 1);
+  block->length = 0;
+  block->next = NULL;
+  return block;
+}
+
+static void free_block(Block *block) {
+  (void)free((void *)block->data);
+  (void)free((void *)block);
+}
+
+/* Add block to the queue waiting to be read.
+ * When decompressing on a separate thread, wait for the reader
+ * to catch up if the queue is long.
+ */
+static void queue_block(DecompressedInput *input, Block *block) {
+  if (block->length == 0) {
+    free_block(block);
+    return;
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&input->lock);
+  while (!input->cancelled && input->queued_bytes > 0 &&
+         input->queued_bytes + block->length > MAX_QUEUED_BYTES) {
+    pthread_cond_wait(&input->changed, &input->lock);
+  }
+#endif
+  if (input->queue_tail == NULL) {
+    input->queue_head = block;
+  } else {
+    input->queue_tail->next = block;
+  }
+  input->queue_tail = block;
+  input->queued_bytes += block->length;
+#ifdef HAVE_PTHREAD
+  pthread_cond_broadcast(&input->changed);
+  pthread_mutex_unlock(&input->lock);
+#endif
+}
+
+/* Decompress a block of the input as a stream.
+ * Stop at the end of a zstd frame, so that any that follow can be
+ * decompressed in parallel.
+ */
+static void decode_stream_block(DecompressedInput *input) {
+  Block *block = new_block(DECOMPRESSED_BLOCK_SIZE);
+
+  while (block->length < DECOMPRESSED_BLOCK_SIZE && !input->input_finished) {
+    size_t in_used, out_used;
+    StepResult result;
+
+    if (input->in_start == input->in_end && !read_compressed(input)) {
+      if (!input->stream_ended && input->error == NULL) {
+        input->error = "it is incomplete";
+      }
+      input->input_finished = true;
+      break;
+    }
+    if (input->stream_ended) {
+      /* Another stream follows. */
+      end_decoder(input);
+      if (!start_decoder(input)) {
+        input->error = "its decoder could not be started";
+        input->input_finished = true;
+        break;
+      }
+      input->stream_ended = false;
+    }
+    result = decode_step(input, &input->in[input->in_start],
+                         input->in_end - input->in_start, &in_used,
+                         &block->data[block->length],
+                         DECOMPRESSED_BLOCK_SIZE - block->length, &out_used);
+    input->in_start += in_used;
+    block->length += out_used;
+    if (result == STEP_ERROR) {
+      input->error = "it is corrupt";
+      input->input_finished = true;
+    } else if (result == STEP_END_OF_STREAM) {
+      input->stream_ended = true;
+      if (input->compression == COMPRESSION_ZSTD) {
+        break;
+      }
+    }
+  }
+  queue_block(input, block);
+}
+
+#ifdef HAVE_ZSTD
+/* A zstd frame to be decompressed in full. */
+typedef struct {
+  const unsigned char *src;
+  size_t src_size;
+  Block *block;
+  bool ok;
+} FrameJob;
+
+static void decode_frame(FrameJob *job) {
+  size_t result = ZSTD_decompress(job->block->data, job->block->length,
+                                  job->src, job->src_size);
+
+  job->ok = !ZSTD_isError(result) && result == job->block->length;
+}
+
+#ifdef HAVE_PTHREAD
+static void *frame_thread(void *arg) {
+  decode_frame((FrameJob *)arg);
+  return NULL;
+}
+#endif
+
+/* Decompress the complete zstd frames at the start of the input
+ * whose decompressed sizes are recorded in them, in parallel.
+ * Return false if the first frame is not one of them.
+ */
+static bool decode_zstd_frames(DecompressedInput *input) {
+  FrameJob jobs[MAX_PARALLEL_FRAMES];
+  unsigned num_jobs = 0;
+  size_t offset = input->in_start;
+  size_t total = 0;
+
+  while (num_jobs < input->parallel_frames && total < MAX_QUEUED_BYTES) {
+    size_t frame_size, content_size;
+
+    while (ZSTD_isError(frame_size = ZSTD_findFrameCompressedSize(
+                            &input->in[offset], input->in_end - offset))) {
+      /* The frame is incomplete, so read more of it. */
+      size_t start = input->in_start;
+
+      if (input->in_end - offset >= MAX_PARALLEL_FRAME_SIZE ||
+          !read_compressed(input)) {
+        break;
+      }
+      offset -= start;
+    }
+    if (ZSTD_isError(frame_size)) {
+      break;
+    }
+    content_size = ZSTD_getFrameContentSize(&input->in[offset], frame_size);
+    if (content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+        content_size == ZSTD_CONTENTSIZE_ERROR ||
+        content_size > MAX_PARALLEL_FRAME_SIZE) {
+      break;
+    }
+    /* The frame is located once the buffer has stopped moving. */
+    jobs[num_jobs].src = NULL;
+    jobs[num_jobs].src_size = frame_size;
+    jobs[num_jobs].block = new_block(content_size);
+    jobs[num_jobs].block->length = content_size;
+    jobs[num_jobs].ok = false;
+    total += content_size;
+    offset += frame_size;
+    num_jobs++;
+  }
+  if (num_jobs == 0) {
+    return false;
+  }
+  /* The buffer is no longer moving, so the frames can be located. */
+  offset = input->in_start;
+  for (unsigned i = 0; i < num_jobs; i++) {
+    jobs[i].src = &input->in[offset];
+    offset += jobs[i].src_size;
+  }
+#ifdef HAVE_PTHREAD
+  {
+    pthread_t threads[MAX_PARALLEL_FRAMES];
+    bool started[MAX_PARALLEL_FRAMES];
+
+    for (unsigned i = 1; i < num_jobs; i++) {
+      started[i] =
+          pthread_create(&threads[i], NULL, frame_thread, &jobs[i]) == 0;
+    }
+    decode_frame(&jobs[0]);
+    for (unsigned i = 1; i < num_jobs; i++) {
+      if (started[i]) {
+        (void)pthread_join(threads[i], NULL);
+      } else {
+        decode_frame(&jobs[i]);
+      }
+    }
+  }
+#else
+  for (unsigned i = 0; i < num_jobs; i++) {
+    decode_frame(&jobs[i]);
+  }
+#endif
+  input->in_start = offset;
+  for (unsigned i = 0; i < num_jobs; i++) {
+    if (input->error != NULL || !jobs[i].ok) {
+      input->error = "it is corrupt";
+      input->input_finished = true;
+      free_block(jobs[i].block);
+    } else {
+      queue_block(input, jobs[i].block);
+    }
+  }
+  return true;
+}
+#endif
+
+/* Decompress the next part of the input and queue it to be read. */
+static void decode_input(DecompressedInput *input) {
+#ifdef HAVE_ZSTD
+  if (input->compression == COMPRESSION_ZSTD && input->stream_ended &&
+      (input->in_start < input->in_end || read_compressed(input)) &&
+      decode_zstd_frames(input)) {
+    return;
+  }
+#endif
+  decode_stream_block(input);
+}
+
+#ifdef HAVE_PTHREAD
+static void *decompression_thread(void *arg) {
+  DecompressedInput *input = (DecompressedInput *)arg;
+  bool cancelled = false;
+
+  while (!input->input_finished && !cancelled) {
+    decode_input(input);
+    pthread_mutex_lock(&input->lock);
+    cancelled = input->cancelled;
+    pthread_mutex_unlock(&input->lock);
+  }
+  pthread_mutex_lock(&input->lock);
+  input->finished = true;
+  pthread_cond_broadcast(&input->changed);
+  pthread_mutex_unlock(&input->lock);
+  return NULL;
+}
+#endif
+
+/* Start decompressing fp, which is compressed with compression.
+ * Return NULL if that is not possible.
+ */
+DecompressedInput *open_decompressed_input(const StateInfo *globals, FILE *fp,
+                                           Compression compression) {
+  DecompressedInput *input =
+      (DecompressedInput *)malloc_or_die(sizeof(*input));
+
+  memset(input, 0, sizeof(*input));
+  input->globals = globals;
+  input->fp = fp;
+  input->compression = compression;
+  if (!start_decoder(input)) {
+    fprintf(globals->logfile,
+            "Unable to read %s, as it is compressed with %s, which is not "
+            "supported by this version of pgn-extract.\n",
+            globals->current_input_file, compression_name(compression));
+    (void)free((void *)input);
+    return NULL;
+  }
+  input->in_size = COMPRESSED_CHUNK_SIZE;
+  input->in = (unsigned char *)malloc_or_die(input->in_size);
+  /* zstd frames are looked for at the start of the input. */
+  input->stream_ended = compression == COMPRESSION_ZSTD;
+  input->parallel_frames = processor_count(MAX_PARALLEL_FRAMES);
+#ifdef HAVE_PTHREAD
+  pthread_mutex_init(&input->lock, NULL);
+  pthread_cond_init(&input->changed, NULL);
+  if (pthread_create(&input->thread, NULL, decompression_thread, input) !=
+      0) {
+    fprintf(globals->logfile,
+            "Unable to start a thread to decompress %s.\n",
+            globals->current_input_file);
+    exit(1);
+  }
+#endif
+  return input;
+}
+
+/* Return the next block of decompressed input, or NULL if there
+ * are no more.
+ */
+static Block *next_block(DecompressedInput *input) {
+  Block *block;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&input->lock);
+  while (input->queue_head == NULL && !input->finished) {
+    pthread_cond_wait(&input->changed, &input->lock);
+  }
+#else
+  while (input->queue_head == NULL && !input->input_finished) {
+    decode_input(input);
+  }
+#endif
+  block = input->queue_head;
+  if (block != NULL) {
+    input->queue_head = block->next;
+    if (input->queue_head == NULL) {
+      input->queue_tail = NULL;
+    }
+    input->queued_bytes -= block->length;
+  }
+#ifdef HAVE_PTHREAD
+  pthread_cond_broadcast(&input->changed);
+  pthread_mutex_unlock(&input->lock);
+#endif
+  if (block == NULL && input->error != NULL && !input->error_reported) {
+    fprintf(input->globals->logfile,
+            "Unable to decompress all of %s, as %s.\n",
+            input->globals->current_input_file, input->error);
+    input->error_reported = true;
+  }
+  return block;
+}
+
+/* Read up to length bytes of decompressed input into buffer.
+ * Return the number read, which is only 0 at the end of the input.
+ */
+size_t read_decompressed_input(DecompressedInput *input, char *buffer,
+                               size_t length) {
+  size_t copied = 0;
+
+  while (copied < length) {
+    size_t available;
+
+    if (input->current == NULL ||
+        input->current_index == input->current->length) {
+      if (input->current != NULL) {
+        free_block(input->current);
+      }
+      input->current = next_block(input);
+      input->current_index = 0;
+      if (input->current == NULL) {
+        break;
+      }
+    }
+    available = input->current->length - input->current_index;
+    if (available > length - copied) {
+      available = length - copied;
+    }
+    memcpy(&buffer[copied], &input->current->data[input->current_index],
+           available);
+    input->current_index += available;
+    copied += available;
+  }
+  return copied;
+}
+
+/* Stop decompressing input and release it.
+ * Its file is left for the caller to close.
+ */
+void close_decompressed_input(DecompressedInput *input) {
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&input->lock);
+  input->cancelled = true;
+  pthread_cond_broadcast(&input->changed);
+  pthread_mutex_unlock(&input->lock);
+  (void)pthread_join(input->thread, NULL);
+  pthread_cond_destroy(&input->changed);
+  pthread_mutex_destroy(&input->lock);
+#endif
+  end_decoder(input);
+  while (input->queue_head != NULL) {
+    Block *block = input->queue_head;
+
+    input->queue_head = block->next;
+    free_block(block);
+  }
+  if (input->current != NULL) {
+    free_block(input->current);
+  }
+  (void)free((void *)input->in);
+  (void)free((void *)input);
+}
+
+/* Compressed output.
+ * Output is gathered into blocks that are compressed independently
+ * by a pool of threads, each into a complete gzip member, bzip2 or
+ * xz stream, or zstd frame. The results are written in order, and
+ * their concatenation is a valid file of the format.
+ * The blocks are held in a ring of slots, which are filled, compressed
+ * and written in turn.
+ */
+#define OUTPUT_BLOCK_SIZE (1024 * 1024)
+#define MAX_COMPRESSION_THREADS 16
+
+typedef enum {
+  SLOT_EMPTY,
+  SLOT_FILLED,
+  SLOT_COMPRESSING,
+  SLOT_COMPRESSED
+} SlotState;
+
+typedef struct {
+  /* Only changed and examined with the lock held, when there are
+   * compressing threads.
+   */
+  SlotState state;
+  /* Whether the slot has been submitted but not yet written, as seen
+   * by the thread that writes the output.
+   */
+  bool pending;
+  char *data;
+  size_t length;
+  unsigned char *compressed;
+  size_t compressed_size, compressed_length;
+  bool ok;
+} OutputSlot;
+
+typedef struct {
+  const StateInfo *globals;
+  char *filename;
+  FILE *fp;
+  Compression compression;
+  int level;
+  OutputSlot *slots;
+  unsigned num_slots;
+  /* The slot being filled, and the next to be compressed. */
+  unsigned filling, next_to_compress;
+  /* Whether any block has been compressed. */
+  bool block_compressed;
+  bool failed;
+  /* The number of compressing threads: 0 if blocks are compressed
+   * as they are filled.
+   */
+  unsigned num_threads;
+#ifdef HAVE_PTHREAD
+  pthread_t threads[MAX_COMPRESSION_THREADS];
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  bool closing;
+#endif
+} CompressedOutput;
+
+/* Return the compression indicated by the suffix of filename. */
+Compression compression_of_file_name(const char *filename) {
+  const char *suffix = strrchr(filename, '.');
+
+  if (suffix == NULL) {
+    return COMPRESSION_NONE;
+  } else if (strcmp(suffix, ".gz") == 0) {
+    return COMPRESSION_GZIP;
+  } else if (strcmp(suffix, ".bz2") == 0) {
+    return COMPRESSION_BZIP2;
+  } else if (strcmp(suffix, ".xz") == 0) {
+    return COMPRESSION_XZ;
+  } else if (strcmp(suffix, ".zst") == 0) {
+    return COMPRESSION_ZSTD;
+  } else {
+    return COMPRESSION_NONE;
+  }
+}
+
+/* Return the file name suffix for the compression format
+ * named by format, or NULL if it is not known.
+ */
+const char *compressed_file_suffix(const char *format) {
+  if (strcmp(format, "gz") == 0 || strcmp(format, "gzip") == 0) {
+    return ".gz";
+  } else if (strcmp(format, "bz2") == 0 || strcmp(format, "bzip2") == 0) {
+    return ".bz2";
+  } else if (strcmp(format, "xz") == 0) {
+    return ".xz";
+  } else if (strcmp(format, "zst") == 0 || strcmp(format, "zstd") == 0) {
+    return ".zst";
+  } else {
+    return NULL;
+  }
+}
+
+/* Whether compressed output in the given format is possible. */
+static bool output_supported(Compression compression) {
+#ifndef HAVE_FOPENCOOKIE
+  return false;
+#else
+  switch (compression) {
+#ifdef HAVE_ZLIB
+  case COMPRESSION_GZIP:
+    return true;
+#endif
+#ifdef HAVE_BZIP2
+  case COMPRESSION_BZIP2:
+    return true;
+#endif
+#ifdef HAVE_LZMA
+  case COMPRESSION_XZ:
+    return true;
+#endif
+#ifdef HAVE_ZSTD
+  case COMPRESSION_ZSTD:
+    return true;
+#endif
+  default:
+    return false;
+  }
+#endif
+}
+
+#ifdef HAVE_FOPENCOOKIE
+/* Limit level to the range of levels of a compressor.
+ * 0 selects the default level.
+ */
+static int compression_level(int level, int default_level, int max_level) {
+  if (level <= 0) {
+    return default_level;
+  } else if (level > max_level) {
+    return max_level;
+  } else {
+    return level;
+  }
+}
+
+/* Make room for size bytes of compressed output in slot. */
+static void reserve_compressed(OutputSlot *slot, size_t size) {
+  if (slot->compressed_size < size) {
+    slot->compressed_size = size;
+    slot->compressed = (unsigned char *)realloc_or_die(
+        (void *)slot->compressed, slot->compressed_size);
+  }
+}
+
+/* Compress the contents of slot. */
+static void compress_block(const CompressedOutput *output,
+                           OutputSlot *slot) {
+  slot->ok = false;
+  slot->compressed_length = 0;
+  switch (output->compression) {
+#ifdef HAVE_ZLIB
+  case COMPRESSION_GZIP: {
+    z_stream stream;
+
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream,
+                     compression_level(output->level, Z_DEFAULT_COMPRESSION,
+                                       Z_BEST_COMPRESSION),
+                     Z_DEFLATED, 16 + MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) == Z_OK) {
+      reserve_compressed(slot, deflateBound(&stream, slot->length));
+      stream.next_in = (Bytef *)slot->data;
+      stream.avail_in = (uInt)slot->length;
+      stream.next_out = slot->compressed;
+      stream.avail_out = (uInt)slot->compressed_size;
+      slot->ok = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+      slot->compressed_length = stream.total_out;
+      (void)deflateEnd(&stream);
+    }
+    break;
+  }
+#endif
+#ifdef HAVE_BZIP2
+  case COMPRESSION_BZIP2: {
+    unsigned length = (unsigned)(slot->length + slot->length / 100 + 600);
+
+    reserve_compressed(slot, length);
+    slot->ok = BZ2_bzBuffToBuffCompress(
+                   (char *)slot->compressed, &length, slot->data,
+                   (unsigned)slot->length,
+                   compression_level(output->level, 9, 9), 0, 0) == BZ_OK;
+    slot->compressed_length = length;
+    break;
+  }
+#endif
+#ifdef HAVE_LZMA
+  case COMPRESSION_XZ: {
+    size_t length = 0;
+
+    reserve_compressed(slot, lzma_stream_buffer_bound(slot->length));
+    slot->ok =
+        lzma_easy_buffer_encode(
+            (uint32_t)compression_level(output->level, LZMA_PRESET_DEFAULT, 9),
+            LZMA_CHECK_CRC64, NULL, (const uint8_t *)slot->data,
+            slot->length, slot->compressed, &length,
+            slot->compressed_size) == LZMA_OK;
+    slot->compressed_length = length;
+    break;
+  }
+#endif
+#ifdef HAVE_ZSTD
+  case COMPRESSION_ZSTD: {
+    size_t length;
+
+    reserve_compressed(slot, ZSTD_compressBound(slot->length));
+    length = ZSTD_compress(
+        slot->compressed, slot->compressed_size, slot->data, slot->length,
+        compression_level(output->level, ZSTD_CLEVEL_DEFAULT,
+                          ZSTD_maxCLevel()));
+    slot->ok = !ZSTD_isError(length);
+    slot->compressed_length = slot->ok ? length : 0;
+    break;
+  }
+#endif
+  default:
+    break;
+  }
+}
+
+#ifdef HAVE_PTHREAD
+static void *compression_thread(void *arg) {
+  CompressedOutput *output = (CompressedOutput *)arg;
+
+  pthread_mutex_lock(&output->lock);
+  for (;;) {
+    OutputSlot *slot = &output->slots[output->next_to_compress];
+
+    if (slot->state == SLOT_FILLED) {
+      slot->state = SLOT_COMPRESSING;
+      output->next_to_compress =
+          (output->next_to_compress + 1) % output->num_slots;
+      pthread_mutex_unlock(&output->lock);
+      compress_block(output, slot);
+      pthread_mutex_lock(&output->lock);
+      slot->state = SLOT_COMPRESSED;
+      pthread_cond_broadcast(&output->changed);
+    } else if (output->closing) {
+      break;
+    } else {
+      pthread_cond_wait(&output->changed, &output->lock);
+    }
+  }
+  pthread_mutex_unlock(&output->lock);
+  return NULL;
+}
+#endif
+
+/* Write the compressed contents of slot once it has been
+ * compressed, and empty it.
+ */
+static void write_slot(CompressedOutput *output, OutputSlot *slot) {
+#ifdef HAVE_PTHREAD
+  if (output->num_threads > 0) {
+    pthread_mutex_lock(&output->lock);
+    while (slot->state != SLOT_COMPRESSED) {
+      pthread_cond_wait(&output->changed, &output->lock);
+    }
+    slot->state = SLOT_EMPTY;
+    pthread_mutex_unlock(&output->lock);
+  }
+#endif
+  if (!slot->ok || fwrite(slot->compressed, 1, slot->compressed_length,
+                          output->fp) != slot->compressed_length) {
+    output->failed = true;
+  }
+  slot->length = 0;
+  slot->pending = false;
+}
+
+/* Pass the slot being filled for compression and move on to the next,
+ * writing out its previous contents first.
+ */
+static void submit_block(CompressedOutput *output) {
+  OutputSlot *slot = &output->slots[output->filling];
+
+  if (output->num_threads == 0) {
+    compress_block(output, slot);
+  }
+#ifdef HAVE_PTHREAD
+  else {
+    pthread_mutex_lock(&output->lock);
+    slot->state = SLOT_FILLED;
+    pthread_cond_broadcast(&output->changed);
+    pthread_mutex_unlock(&output->lock);
+  }
+#endif
+  slot->pending = true;
+  output->block_compressed = true;
+  output->filling = (output->filling + 1) % output->num_slots;
+  slot = &output->slots[output->filling];
+  if (slot->pending) {
+    write_slot(output, slot);
+  }
+}
+
+static ssize_t write_compressed(void *cookie, const char *buffer,
+                                size_t length) {
+  CompressedOutput *output = (CompressedOutput *)cookie;
+  size_t written = 0;
+
+  while (written < length) {
+    OutputSlot *slot = &output->slots[output->filling];
+    size_t space = OUTPUT_BLOCK_SIZE - slot->length;
+
+    if (space == 0) {
+      submit_block(output);
+    } else {
+      if (space > length - written) {
+        space = length - written;
+      }
+      memcpy(&slot->data[slot->length], &buffer[written], space);
+      slot->length += space;
+      written += space;
+    }
+  }
+  return output->failed ? -1 : (ssize_t)length;
+}
+
+static int close_compressed(void *cookie) {
+  CompressedOutput *output = (CompressedOutput *)cookie;
+  int result;
+
+  /* An empty block makes an empty file valid. */
+  if (output->slots[output->filling].length > 0 ||
+      !output->block_compressed) {
+    submit_block(output);
+  }
+  /* Write the remaining blocks, oldest first. */
+  for (unsigned i = 0; i < output->num_slots; i++) {
+    OutputSlot *slot =
+        &output->slots[(output->filling + i) % output->num_slots];
+
+    if (slot->pending) {
+      write_slot(output, slot);
+    }
+  }
+#ifdef HAVE_PTHREAD
+  if (output->num_threads > 0) {
+    pthread_mutex_lock(&output->lock);
+    output->closing = true;
+    pthread_cond_broadcast(&output->changed);
+    pthread_mutex_unlock(&output->lock);
+    for (unsigned i = 0; i < output->num_threads; i++) {
+      (void)pthread_join(output->threads[i], NULL);
+    }
+  }
+  pthread_cond_destroy(&output->changed);
+  pthread_mutex_destroy(&output->lock);
+#endif
+  result = fclose(output->fp);
+  if (output->failed || result != 0) {
+    fprintf(output->globals->logfile, "Error writing the output file %s.\n",
+            output->filename);
+    result = EOF;
+  }
+  for (unsigned i = 0; i < output->num_slots; i++) {
+    (void)free((void *)output->slots[i].data);
+    (void)free((void *)output->slots[i].compressed);
+  }
+  (void)free((void *)output->slots);
+  (void)free((void *)output->filename);
+  (void)free((void *)output);
+  return result;
+}
+#endif
+
+/* Open filename for writing, or for appending if append is true,
+ * with output compressed in the given format.
+ * Return NULL if the file cannot be opened.
+ */
+FILE *open_compressed_output(const StateInfo *globals, const char *filename,
+                             bool append, Compression compression) {
+  if (!output_supported(compression)) {
+    fprintf(globals->logfile,
+            "Unable to write %s, as compressing output with %s is not "
+            "supported by this version of pgn-extract.\n",
+            filename, compression_name(compression));
+    exit(1);
+  }
+#ifdef HAVE_FOPENCOOKIE
+  {
+    cookie_io_functions_t functions = {NULL, write_compressed, NULL,
+                                       close_compressed};
+    CompressedOutput *output;
+    FILE *fp = fopen(filename, append ? "ab" : "wb");
+
+    if (fp == NULL) {
+      return NULL;
+    }
+    output = (CompressedOutput *)malloc_or_die(sizeof(*output));
+    memset(output, 0, sizeof(*output));
+    output->globals = globals;
+    output->filename = copy_string(filename);
+    output->fp = fp;
+    output->compression = compression;
+    output->level = globals->compression_level;
+#ifdef HAVE_PTHREAD
+    /* A single thread still overlaps compression with the rest
+     * of the work.
+     */
+    output->num_threads = processor_count(MAX_COMPRESSION_THREADS);
+#endif
+    /* Enough slots for every thread to be busy while others are
+     * filled and written.
+     */
+    output->num_slots = output->num_threads > 0 ? 2 * output->num_threads : 1;
+    output->slots =
+        (OutputSlot *)malloc_or_die(output->num_slots * sizeof(OutputSlot));
+    memset(output->slots, 0, output->num_slots * sizeof(OutputSlot));
+    for (unsigned i = 0; i < output->num_slots; i++) {
+      output->slots[i].data = (char *)malloc_or_die(OUTPUT_BLOCK_SIZE);
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&output->lock, NULL);
+    pthread_cond_init(&output->changed, NULL);
+    for (unsigned i = 0; i < output->num_threads; i++) {
+      if (pthread_create(&output->threads[i], NULL, compression_thread,
+                         output) != 0) {
+        fprintf(globals->logfile,
+                "Unable to start a thread to compress %s.\n", filename);
+        exit(1);
+      }
+    }
+#endif
+    return fopencookie(output, "w", functions);
+  }
+#else
+  return NULL;
+#endif
+}
@@ -0,0 +1,66 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Compressed input and output files.
+ * Input files compressed with gzip, bzip2, xz or zstd are recognised
+ * from their first bytes and decompressed as they are read.
+ * Where threads are available, decompression takes place on a
+ * separate thread, ahead of the lexical analyser, and the independent
+ * frames of a zstd file are decompressed in parallel.
+ * Output files whose names end in .gz, .bz2, .xz or .zst are written
+ * compressed, with blocks of the output compressed in parallel.
+ * Support for each format depends on its library being found when
+ * pgn-extract is built: HAVE_ZLIB, HAVE_BZIP2, HAVE_LZMA and HAVE_ZSTD.
+ * Compressed output also requires HAVE_FOPENCOOKIE.
+ */
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include "typedef.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+  COMPRESSION_NONE,
+  COMPRESSION_GZIP,
+  COMPRESSION_BZIP2,
+  COMPRESSION_XZ,
+  COMPRESSION_ZSTD
+} Compression;
+
+/* The length of the longest suffix of a compressed file's name. */
+#define MAX_COMPRESSED_SUFFIX_LENGTH 4
+
+typedef struct DecompressedInput DecompressedInput;
+
+void close_decompressed_input(DecompressedInput *input);
+const char *compressed_file_suffix(const char *format);
+Compression compression_of_file_name(const char *filename);
+Compression detect_compression(FILE *fp);
+FILE *open_compressed_output(const StateInfo *globals, const char *filename,
+                             bool append, Compression compression);
+DecompressedInput *open_decompressed_input(const StateInfo *globals, FILE *fp,
+                                           Compression compression);
+size_t read_decompressed_input(DecompressedInput *input, char *buffer,
+                               size_t length);
+
+#endif // COMPRESSION_H
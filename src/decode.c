@@ -114,17 +114,14 @@ bool is_check(char c) { return (c == '+') || (c == '#'); }
  * has been gleaned from the move.
  */
 Move *new_move_structure(void) {
-  Move *move = (Move *)malloc_or_die(sizeof(Move));
+  Move *move = (Move *)malloc_for(MEMORY_MOVE, sizeof(Move));
 
   move->terminating_result = NULL;
   move->piece_to_move = EMPTY;
   move->captured_piece = EMPTY;
   move->promoted_piece = EMPTY;
   move->check_status = NOCHECK;
-  move->epd = NULL;
-  move->fen_suffix = NULL;
-  move->zobrist = ~0;
-  move->evaluation = 0;
+  move->annotations = NULL;
   move->NAGs = NULL;
   move->comment_list = NULL;
   move->Variants = NULL;
@@ -133,6 +130,64 @@ Move *new_move_structure(void) {
   return move;
 }
 
+/* The annotations of a move that has none. */
+static const MoveAnnotations no_annotations = {NULL, NULL, ~(uint64_t)0, 0};
+
+/* Return the annotations of move, which are allocated
+ * on their first use.
+ */
+MoveAnnotations *annotate_move(Move *move) {
+  if (move->annotations == NULL) {
+    move->annotations =
+        (MoveAnnotations *)malloc_for(MEMORY_MOVE, sizeof(*move->annotations));
+    *move->annotations = no_annotations;
+  }
+  return move->annotations;
+}
+
+/* Set the EPD and FEN suffix of the annotations of move.
+ * The strings are held after the annotations, in the same allocation,
+ * which only grows if the strings of an earlier call were shorter.
+ */
+void annotate_move_FEN(Move *move, const char *epd, const char *fen_suffix) {
+  MoveAnnotations *annotations = move->annotations;
+  size_t epd_length = strlen(epd) + 1;
+  size_t suffix_length = strlen(fen_suffix) + 1;
+  size_t old_size = 0;
+  char *text;
+
+  if (annotations != NULL) {
+    old_size = sizeof(*annotations);
+    if (annotations->epd != NULL) {
+      old_size += strlen(annotations->epd) + 1 +
+                  strlen(annotations->fen_suffix) + 1;
+    }
+  }
+  if (old_size < sizeof(*annotations) + epd_length + suffix_length) {
+    annotations = (MoveAnnotations *)realloc_for(
+        MEMORY_MOVE, (void *)annotations, old_size,
+        sizeof(*annotations) + epd_length + suffix_length);
+    if (move->annotations == NULL) {
+      *annotations = no_annotations;
+    }
+    move->annotations = annotations;
+  }
+  text = (char *)(annotations + 1);
+  memcpy(text, epd, epd_length);
+  memcpy(text + epd_length, fen_suffix, suffix_length);
+  annotations->epd = text;
+  annotations->fen_suffix = text + epd_length;
+}
+
+/* Return the annotations of move, whether or not any have been set. */
+const MoveAnnotations *move_annotations(const Move *move) {
+  if (move->annotations != NULL) {
+    return move->annotations;
+  } else {
+    return &no_annotations;
+  }
+}
+
 /* Work out whatever can be gleaned from move_string of
  * the starting and ending points of the given move.
  * The move may be any legal string.
@@ -397,7 +452,7 @@ Move *decode_move(const StateInfo *globals,
 Move *decode_algebraic(Move *move_details, Board *board) {
   int from_r = RankConvert(move_details->from_rank);
   int from_c = ColConvert(move_details->from_col);
-  Piece piece_to_move = EXTRACT_PIECE(board->board[from_r][from_c]);
+  Piece piece_to_move = EXTRACT_PIECE(BOARD_SQUARE(board, from_r, from_c));
 
   if (piece_to_move != EMPTY) {
     /* Check for the special case of castling. */
@@ -28,11 +28,14 @@
 
 Move *new_move_structure(void);
 Piece is_piece(const unsigned char *move);
+MoveAnnotations *annotate_move(Move *move);
+void annotate_move_FEN(Move *move, const char *epd, const char *fen_suffix);
 Move *decode_move(const StateInfo *globals, const unsigned char *move_string);
 Move *decode_algebraic(Move *move_details, Board *board);
 bool is_check(char c);
 bool is_col(char c);
 bool is_rank(char c);
+const MoveAnnotations *move_annotations(const Move *move);
 bool move_seems_valid(const unsigned char *move_string);
 
 #endif // DECODE_H
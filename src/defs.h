@@ -111,12 +111,31 @@ typedef char Col;
  */
 typedef uint64_t HashCode;
 
+/* The contents of a square of a Board: OFF, EMPTY or a coloured piece.
+ * Every one of these fits in a byte, which keeps a whole Board
+ * within three cache lines so that the copies made while checking
+ * the legality of moves are cheap.
+ */
+typedef uint8_t Square;
+
 typedef struct {
-  Piece board[HEDGE + BOARDSIZE + HEDGE][HEDGE + BOARDSIZE + HEDGE];
+  Square squares[HEDGE + BOARDSIZE + HEDGE][HEDGE + BOARDSIZE + HEDGE];
+  /* NB: @@@
+   * This value is based on a relatively weak hashing approach
+   * that really needs updating to properly use the Zobrist hash.
+   */
+  HashCode weak_hash_value;
+  /* Provision for storing a Zobrist hash value. However,
+   * this is only set if globals->add_hashcode_comments.
+   * At some point, it should supersede the weak_hash_value.
+   */
+  uint64_t zobrist;
   /* Who has the next move. */
   Colour to_move;
   /* The current move number. */
   unsigned move_number;
+  /* The half-move clock since the last pawn move or capture. */
+  unsigned int halfmove_clock;
   /* Rook starting columns for the 4 castling options.
    * This accommodates Chess960.
    */
@@ -135,20 +154,14 @@ typedef struct {
   bool EnPassant;
   Rank ep_rank;
   Col ep_col;
-  /* NB: @@@
-   * This value is based on a relatively weak hashing approach
-   * that really needs updating to properly use the Zobrist hash.
-   */
-  HashCode weak_hash_value;
-  /* Provision for storing a Zobrist hash value. However,
-   * this is only set if globals->add_hashcode_comments.
-   * At some point, it should supersede the weak_hash_value.
-   */
-  uint64_t zobrist;
-  /* The half-move clock since the last pawn move or capture. */
-  unsigned int halfmove_clock;
 } Board;
 
+/* Access the square at the given board indices (as from RankConvert
+ * and ColConvert) of a Board, and a whole rank of it.
+ */
+#define BOARD_SQUARE(board, r, c) ((board)->squares[r][c])
+#define BOARD_RANK(board, r) ((const Square *)(board)->squares[r])
+
 /* Define a type that can be used to create a list of possible source
  * squares for a move.
  */
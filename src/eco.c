@@ -21,6 +21,7 @@
 
 #include "eco.h"
 
+#include "compression.h"
 #include "defs.h"
 #include "grammar.h"
 #include "mymalloc.h"
@@ -50,6 +51,20 @@ static unsigned maximum_half_moves = ECO_HALF_MOVE_LIMIT;
 #define ECO_TABLE_SIZE 4096
 static EcoLog **EcoTable;
 
+/* The ECO output files (-E) that are open, most recently used first.
+ * They are kept open between games because reopening a compressed file
+ * starts a new compressed stream for every game.
+ * Only a few are kept open, as each compressed file has its own
+ * buffers and threads, and the least recently used is closed when
+ * another is needed.
+ */
+#define MAX_OPEN_ECO_FILES 8
+static struct {
+  char *filename;
+  FILE *fp;
+} open_eco_files[MAX_OPEN_ECO_FILES];
+static unsigned num_open_eco_files = 0;
+
 #if INCLUDE_UNUSED_FUNCTIONS
 
 static void dumpEcoTable(void) {
@@ -124,7 +139,8 @@ void initEcoTable(void) {
   /* Avoid multiple calls. */
   if (EcoTable == NULL) {
     int i;
-    EcoTable = (EcoLog **)malloc_or_die(ECO_TABLE_SIZE * sizeof(EcoLog *));
+    EcoTable = (EcoLog **)malloc_for(MEMORY_ECO,
+                                     ECO_TABLE_SIZE * sizeof(EcoLog *));
 
     for (i = 0; i < ECO_TABLE_SIZE; i++) {
       EcoTable[i] = NULL;
@@ -187,7 +203,7 @@ void save_eco_details(const StateInfo *globals, const Game *game_details,
 
   if (can_save) {
     /* First occurrence, so add it to the log. */
-    entry = (EcoLog *)malloc_or_die(sizeof(*entry));
+    entry = (EcoLog *)malloc_for(MEMORY_ECO, sizeof(*entry));
 
     entry->required_hash_value = game_details->final_hash_value;
     entry->cumulative_hash_value = game_details->cumulative_hash_value;
@@ -275,6 +291,43 @@ EcoLog *eco_matches(const Board *board, HashCode cumulative_hash_value,
   return possible;
 }
 
+/* Return the open ECO output file called filename, opening it for
+ * appending if it is not already open.
+ */
+static FILE *find_eco_output_file(const StateInfo *globals,
+                                  const char *filename) {
+  unsigned ix;
+  char *name;
+  FILE *fp;
+
+  for (ix = 0; ix < num_open_eco_files; ix++) {
+    if (strcmp(open_eco_files[ix].filename, filename) == 0) {
+      break;
+    }
+  }
+  if (ix < num_open_eco_files) {
+    name = open_eco_files[ix].filename;
+    fp = open_eco_files[ix].fp;
+  } else {
+    if (num_open_eco_files == MAX_OPEN_ECO_FILES) {
+      /* Close the least recently used. */
+      num_open_eco_files--;
+      (void)fclose(open_eco_files[num_open_eco_files].fp);
+      (void)free((void *)open_eco_files[num_open_eco_files].filename);
+    }
+    name = copy_string(filename);
+    fp = must_open_file(globals, filename, "a");
+    ix = num_open_eco_files;
+    num_open_eco_files++;
+  }
+  /* Move it to the front. */
+  memmove(&open_eco_files[1], &open_eco_files[0],
+          ix * sizeof(open_eco_files[0]));
+  open_eco_files[0].filename = name;
+  open_eco_files[0].fp = fp;
+  return fp;
+}
+
 /* Depending upon the ECO_level and the eco string of the
  * current game, open the correctly named ECO file.
  */
@@ -285,7 +338,9 @@ open_eco_output_file(const StateInfo *globals, EcoDivision ECO_level,
                                          */
   static const char suffix[] = ".pgn";
 
-  enum { MAXNAME = MAX_ECO_LEVEL + sizeof(suffix) - 1 };
+  enum {
+    MAXNAME = MAX_ECO_LEVEL + sizeof(suffix) - 1 + MAX_COMPRESSED_SUFFIX_LENGTH
+  };
   static char filename[MAXNAME + 1];
 
   if ((eco == NULL) || !isalpha((int)*eco)) {
@@ -303,5 +358,17 @@ open_eco_output_file(const StateInfo *globals, EcoDivision ECO_level,
     filename[ECO_level] = '\0';
     strcat(filename, suffix);
   }
-  return must_open_file(globals, filename, "a");
+  strcat(filename, globals->compressed_output_suffix);
+  return find_eco_output_file(globals, filename);
+}
+
+/* Close all of the ECO output files, which completes any that are
+ * compressed.
+ */
+void close_eco_output_files(void) {
+  for (unsigned i = 0; i < num_open_eco_files; i++) {
+    (void)fclose(open_eco_files[i].fp);
+    (void)free((void *)open_eco_files[i].filename);
+  }
+  num_open_eco_files = 0;
 }
@@ -47,6 +47,7 @@ typedef struct EcoLog {
 EcoLog *eco_matches(const Board *board, HashCode cumulative_hash_value,
                     unsigned half_moves_played);
 bool add_ECO(Game game_details);
+void close_eco_output_files(void);
 FILE *open_eco_output_file(const StateInfo *globals, EcoDivision ECO_level,
                            const char *eco);
 void initEcoTable(void);
@@ -312,6 +312,9 @@ static void insert_pattern(const StateInfo *globals, FENPatternMatch *node,
   }
 }
 
+/* Return whether there are any FEN patterns to match. */
+bool fen_patterns_present(void) { return pattern_tree != NULL; }
+
 /*
  * Try to match the board against one of the FEN patterns.
  * Return NULL if no match, otherwise a possible label for the
@@ -552,7 +555,7 @@ convert_board_to_text(const Board *board)
     /* Allow space for a full board and '/' separators in between. */
     char *text = (char *) malloc_or_die(8 * 8 + 8);
     for (rank = LASTRANK; rank >= FIRSTRANK; rank--) {
-        const Piece *rankP = board->board[RankConvert(rank)];
+        const Square *rankP = BOARD_RANK(board, RankConvert(rank));
         Col col;
         for (col = FIRSTCOL; col <= LASTCOL; col++) {
             int coloured_piece = rankP[ColConvert(col)];
@@ -576,7 +579,7 @@ convert_board_to_text(const Board *board)
 
 /* Build a basic EPD string from rank of the given board. */
 static void convert_rank_to_text(const Board *board, Rank rank, char *text) {
-  const Piece *rankP = board->board[RankConvert(rank)];
+  const Square *rankP = BOARD_RANK(board, RankConvert(rank));
   int ix = 0;
   Col col;
   for (col = FIRSTCOL; col <= LASTCOL; col++) {
@@ -28,6 +28,7 @@
 
 void add_fen_pattern(const StateInfo *globals, const char *fen_pattern,
                      bool add_reverse, const char *label);
+bool fen_patterns_present(void);
 const char *pattern_match_board(const StateInfo *globals, const Board *board);
 
 #endif // FENMATCHER_H
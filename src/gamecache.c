@@ -0,0 +1,373 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "gamecache.h"
+
+#include "binary.h"
+#include "defs.h"
+#include "mymalloc.h"
+#include "postings.h"
+#include "typedef.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* A cache file starts with a fixed-length header of
+ * little-endian values:
+ *     magic (4 bytes), version (4), flags (4),
+ *     size (8) and modification time (8) of the cached file,
+ *     FNV-1a hash of the whole of the cached file (8).
+ * This is followed by the games of the file, written by
+ * write_parsed_game in the binary game format.
+ * The moves of the games are held as they were before they were
+ * applied, so that replaying them recomputes everything that
+ * depends on the selection criteria of the run, such as the hash
+ * codes of the positions and whether the game is valid.
+ */
+static const char GAME_CACHE_MAGIC[4] = {'P', 'G', 'N', 'C'};
+#define GAME_CACHE_VERSION 1
+#define GAME_CACHE_HEADER_LENGTH (4 + 4 + 4 + 8 + 8 + 8)
+
+/* Header flags: settings that change what the parser makes of a file. */
+#define CACHE_KEEP_COMMENTS 0x01
+#define CACHE_NESTED_COMMENTS 0x02
+#define CACHE_FIX_TAG_STRINGS 0x04
+#define CACHE_LICHESS_COMMENT_FIX 0x08
+
+typedef struct {
+  unsigned long flags;
+  unsigned long size;
+  unsigned long mtime;
+  unsigned long hash;
+} CacheHeader;
+
+/* State for building the cache of the current input file. */
+static FILE *cache_being_built = NULL;
+static char *cache_being_built_name = NULL;
+static char *file_being_cached = NULL;
+/* The state of the cached file when the cache was started. */
+static struct stat cached_file_info;
+/* Whether a game has been started but not yet cached.
+ * A game continuing from one input file into the next
+ * prevents both from being cached.
+ */
+static bool game_in_progress = false;
+/* Whether an error has been reported in the file being cached.
+ * Its messages would be lost, or their positions in the file,
+ * were its games read from the cache.
+ */
+static bool error_reported = false;
+/* Whether a game of the file being cached was rejected before all
+ * of its moves were checked, so that errors in them could be reported
+ * by a later run that would only find them in the cache.
+ */
+static bool game_unchecked = false;
+
+static unsigned long settings_flags(const StateInfo *globals) {
+  unsigned long flags = 0;
+
+  if (globals->keep_comments) {
+    flags |= CACHE_KEEP_COMMENTS;
+  }
+  if (globals->allow_nested_comments) {
+    flags |= CACHE_NESTED_COMMENTS;
+  }
+  if (globals->fix_tag_strings) {
+    flags |= CACHE_FIX_TAG_STRINGS;
+  }
+  if (globals->lichess_comment_fix) {
+    flags |= CACHE_LICHESS_COMMENT_FIX;
+  }
+  return flags;
+}
+
+/* Return the name of the cache file for input_file with the given suffix. */
+static char *cache_file_name(const char *input_file, const char *suffix) {
+  char *name = (char *)malloc_or_die(strlen(input_file) + strlen(suffix) + 1);
+  strcpy(name, input_file);
+  strcat(name, suffix);
+  return name;
+}
+
+static void write_cache_header(FILE *fp, const CacheHeader *header) {
+  (void)fwrite(GAME_CACHE_MAGIC, 1, sizeof(GAME_CACHE_MAGIC), fp);
+  write_fixed(fp, 4, GAME_CACHE_VERSION);
+  write_fixed(fp, 4, header->flags);
+  write_fixed(fp, 8, header->size);
+  write_fixed(fp, 8, header->mtime);
+  write_fixed(fp, 8, header->hash);
+}
+
+static bool read_cache_header(FILE *fp, CacheHeader *header) {
+  char magic[sizeof(GAME_CACHE_MAGIC)];
+  unsigned long version;
+
+  return fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+         memcmp(magic, GAME_CACHE_MAGIC, sizeof(magic)) == 0 &&
+         read_fixed(fp, 4, &version) && version == GAME_CACHE_VERSION &&
+         read_fixed(fp, 4, &header->flags) &&
+         read_fixed(fp, 8, &header->size) &&
+         read_fixed(fp, 8, &header->mtime) &&
+         read_fixed(fp, 8, &header->hash);
+}
+
+/* Set hash to the FNV-1a hash of the whole of input_file.
+ * Return false if it could not be read.
+ */
+static bool hash_input_file(const char *input_file, unsigned long *hash) {
+  FILE *fp = fopen(input_file, "rb");
+  unsigned char buffer[BUFSIZ];
+  size_t length;
+  bool ok;
+
+  if (fp == NULL) {
+    return false;
+  }
+  *hash = 0xcbf29ce484222325UL;
+  while ((length = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    for (size_t i = 0; i < length; i++) {
+      *hash = (*hash ^ buffer[i]) * 0x100000001b3UL;
+    }
+  }
+  ok = !ferror(fp);
+  (void)fclose(fp);
+  return ok;
+}
+
+/* Whether the cache with the given header describes input_file in
+ * its current state, given by info.
+ * The contents of a file whose modification time alone has changed
+ * are checked against the hash.
+ */
+static bool cache_current(const StateInfo *globals, const char *input_file,
+                          const struct stat *info, CacheHeader *header) {
+  unsigned long hash;
+
+  if (header->flags != settings_flags(globals) ||
+      header->size != (unsigned long)info->st_size) {
+    return false;
+  } else if (header->mtime == (unsigned long)info->st_mtime) {
+    return true;
+  } else if (hash_input_file(input_file, &hash) && hash == header->hash) {
+    header->mtime = (unsigned long)info->st_mtime;
+    return true;
+  } else {
+    return false;
+  }
+}
+
+/* If input_file has a cache that is current, return it open
+ * at its first game. Otherwise return NULL.
+ */
+FILE *open_game_cache(const StateInfo *globals, const char *input_file) {
+  char *name;
+  FILE *fp;
+  struct stat info;
+  CacheHeader header;
+
+  if (!globals->use_game_cache || globals->build_index || game_in_progress) {
+    return NULL;
+  }
+  name = cache_file_name(input_file, GAME_CACHE_SUFFIX);
+  fp = fopen(name, "rb");
+  if (fp == NULL) {
+    /* There is no cache. */
+  } else if (!read_cache_header(fp, &header) ||
+             stat(input_file, &info) != 0) {
+    /* The cache will be replaced. */
+    (void)fclose(fp);
+    fp = NULL;
+  } else {
+    unsigned long mtime = header.mtime;
+
+    if (!cache_current(globals, input_file, &info, &header)) {
+      if (globals->verbosity > 1) {
+        fprintf(globals->logfile,
+                "%s is out of date, so it will be rebuilt.\n", name);
+      }
+      (void)fclose(fp);
+      fp = NULL;
+    } else if (header.mtime != mtime) {
+      /* Record the new modification time, to save checking the
+       * contents again.
+       */
+      FILE *update = fopen(name, "r+b");
+
+      if (update != NULL) {
+        write_cache_header(update, &header);
+        (void)fclose(update);
+      }
+    }
+  }
+  if (fp != NULL && globals->verbosity > 1) {
+    fprintf(globals->logfile, "Reading the games of %s from %s\n",
+            input_file, name);
+  }
+  (void)free((void *)name);
+  return fp;
+}
+
+/* Start building a cache of the games of input_file, which is about
+ * to be parsed. The cache is written to a temporary file that replaces
+ * any existing cache when the whole of input_file has been read.
+ */
+void start_game_cache(const StateInfo *globals, const char *input_file) {
+  char *name;
+
+  if (!globals->use_game_cache || globals->build_index || game_in_progress ||
+      cache_being_built != NULL) {
+    return;
+  }
+  if (stat(input_file, &cached_file_info) != 0) {
+    return;
+  }
+  name = cache_file_name(input_file, GAME_CACHE_SUFFIX ".tmp");
+  cache_being_built = fopen(name, "w+b");
+  if (cache_being_built == NULL) {
+    fprintf(globals->logfile, "Unable to write the cache file %s.\n", name);
+    (void)free((void *)name);
+  } else {
+    CacheHeader header = {0, 0, 0, 0};
+
+    /* The header is completed when the cache is. */
+    write_cache_header(cache_being_built, &header);
+    cache_being_built_name = name;
+    file_being_cached = copy_string(input_file);
+    error_reported = false;
+    game_unchecked = false;
+  }
+}
+
+/* Whether the games being parsed are being cached. */
+bool game_cache_being_built(void) { return cache_being_built != NULL; }
+
+/* Note that the parser has found the start of a game. */
+void start_cached_game(void) {
+  if (cache_being_built != NULL) {
+    game_in_progress = true;
+  }
+}
+
+/* Note that an error has been reported while reading or processing
+ * the games of the input file.
+ */
+void note_cache_diagnostic(void) {
+  if (cache_being_built != NULL) {
+    error_reported = true;
+  }
+}
+
+/* Note whether all of the moves of the game just processed were checked. */
+void note_cached_game_checked(bool moves_checked) {
+  if (cache_being_built != NULL && !moves_checked) {
+    game_unchecked = true;
+  }
+}
+
+/* Add the game just parsed to the cache being built. */
+void cache_parsed_game(const StateInfo *globals, const GameHeader *game_header,
+                       const Move *moves, unsigned long start_line,
+                       unsigned long end_line) {
+  if (cache_being_built != NULL && game_in_progress) {
+    write_parsed_game(globals, game_header, moves, start_line, end_line,
+                      cache_being_built);
+  }
+  game_in_progress = false;
+}
+
+/* Close the cache being built, keeping it only if complete. */
+static void close_game_cache(const StateInfo *globals, bool complete) {
+  struct stat info;
+  CacheHeader header;
+
+  if (cache_being_built == NULL) {
+    return;
+  }
+  if (!complete) {
+    /* The reason has already been reported. */
+  } else if (error_reported || game_unchecked) {
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile,
+              "The cache of %s was not written because %s.\n",
+              file_being_cached,
+              error_reported ? "errors were reported in it"
+                             : "not all of its games were checked");
+    }
+    complete = false;
+  } else if (stat(file_being_cached, &info) != 0 ||
+             info.st_size != cached_file_info.st_size ||
+             info.st_mtime != cached_file_info.st_mtime ||
+             !hash_input_file(file_being_cached, &header.hash)) {
+    fprintf(globals->logfile,
+            "The cache of %s was not written because the file changed "
+            "while it was being read.\n",
+            file_being_cached);
+    complete = false;
+  } else {
+    header.flags = settings_flags(globals);
+    header.size = (unsigned long)info.st_size;
+    header.mtime = (unsigned long)info.st_mtime;
+    rewind(cache_being_built);
+    write_cache_header(cache_being_built, &header);
+  }
+  complete = !ferror(cache_being_built) && complete;
+  complete = fclose(cache_being_built) == 0 && complete;
+  cache_being_built = NULL;
+  if (complete) {
+    char *name = cache_file_name(file_being_cached, GAME_CACHE_SUFFIX);
+
+    if (rename(cache_being_built_name, name) != 0) {
+      fprintf(globals->logfile, "Unable to write the cache file %s.\n", name);
+      complete = false;
+    } else if (globals->verbosity > 1) {
+      fprintf(globals->logfile, "Wrote the cache file %s.\n", name);
+    }
+    (void)free((void *)name);
+  }
+  if (!complete) {
+    (void)remove(cache_being_built_name);
+  }
+  (void)free((void *)cache_being_built_name);
+  cache_being_built_name = NULL;
+  (void)free((void *)file_being_cached);
+  file_being_cached = NULL;
+}
+
+/* The current input file has been read to its end. */
+void terminate_game_cache(const StateInfo *globals) {
+  if (cache_being_built != NULL && game_in_progress &&
+      globals->verbosity > 1) {
+    fprintf(globals->logfile,
+            "The cache of %s was not written because its final game "
+            "continues into the next file.\n",
+            file_being_cached);
+  }
+  close_game_cache(globals, !game_in_progress);
+}
+
+/* Discard any cache that is incomplete because processing
+ * stopped before the end of its file.
+ */
+void finish_game_cache(const StateInfo *globals) {
+  close_game_cache(globals, false);
+}
@@ -0,0 +1,55 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Caches of the games parsed from input files.
+ * With --cache, the games parsed from file.pgn are written in the
+ * binary game format to file.pgn.cache, along with the size,
+ * modification time and a hash of the contents of file.pgn.
+ * A later run with --cache reads the games from the cache instead
+ * of parsing file.pgn again, for as long as it is unchanged.
+ * A file is only cached if no errors were reported in it and the
+ * moves of all of its games were checked, as the positions of errors
+ * in the file are not cached.
+ */
+#ifndef GAMECACHE_H
+#define GAMECACHE_H
+
+#include "typedef.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* The suffix added to the name of an input file for its cache. */
+#define GAME_CACHE_SUFFIX ".cache"
+
+void cache_parsed_game(const StateInfo *globals, const GameHeader *game_header,
+                       const Move *moves, unsigned long start_line,
+                       unsigned long end_line);
+void finish_game_cache(const StateInfo *globals);
+bool game_cache_being_built(void);
+void note_cache_diagnostic(void);
+void note_cached_game_checked(bool moves_checked);
+FILE *open_game_cache(const StateInfo *globals, const char *input_file);
+void start_cached_game(void);
+void start_game_cache(const StateInfo *globals, const char *input_file);
+void terminate_game_cache(const StateInfo *globals);
+
+#endif // GAMECACHE_H
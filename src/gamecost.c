@@ -0,0 +1,173 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "gamecost.h"
+
+#include "lex.h"
+#include "mymalloc.h"
+#include "typedef.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+  double seconds;
+  unsigned long moves;
+  unsigned long bytes;
+  unsigned long allocations;
+  const char *filename;
+  unsigned long start_line, end_line;
+  unsigned long game_number;
+} GameCost;
+
+/* The most expensive games so far, as a min-heap on seconds
+ * so that the cheapest of them is the one to be replaced.
+ */
+static GameCost *slow_games = NULL;
+static unsigned num_slow_games = 0;
+
+/* The state at the start of the current game. */
+static struct timespec game_start_time;
+static unsigned long game_start_offset;
+static unsigned long game_start_allocations;
+
+/* Note the start of the parsing of a game. */
+void start_game_cost(void) {
+  clock_gettime(CLOCK_MONOTONIC, &game_start_time);
+  game_start_offset = current_symbol_position().offset;
+  game_start_allocations = allocations_made();
+}
+
+/* Return the number of moves of moves, including its variations. */
+static unsigned long count_moves(const Move *moves) {
+  unsigned long count = 0;
+
+  for (; moves != NULL; moves = moves->next) {
+    count++;
+    for (const Variation *variation = moves->Variants; variation != NULL;
+         variation = variation->next) {
+      count += count_moves(variation->moves);
+    }
+  }
+  return count;
+}
+
+static void swap_costs(unsigned i, unsigned j) {
+  GameCost temp = slow_games[i];
+
+  slow_games[i] = slow_games[j];
+  slow_games[j] = temp;
+}
+
+/* Restore the heap below slow_games[i]. */
+static void sift_down(unsigned i) {
+  for (;;) {
+    unsigned smallest = i;
+    unsigned left = 2 * i + 1, right = 2 * i + 2;
+
+    if (left < num_slow_games &&
+        slow_games[left].seconds < slow_games[smallest].seconds) {
+      smallest = left;
+    }
+    if (right < num_slow_games &&
+        slow_games[right].seconds < slow_games[smallest].seconds) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    swap_costs(i, smallest);
+    i = smallest;
+  }
+}
+
+/* Record the cost of game, which has just been processed,
+ * if it is among the most expensive so far.
+ */
+void record_game_cost(const StateInfo *globals, const Game *game) {
+  struct timespec end;
+  GameCost cost;
+
+  if (globals->slow_games_to_report == 0) {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  cost.seconds = (double)(end.tv_sec - game_start_time.tv_sec) +
+                 (double)(end.tv_nsec - game_start_time.tv_nsec) / 1e9;
+  if (num_slow_games == globals->slow_games_to_report &&
+      cost.seconds <= slow_games[0].seconds) {
+    return;
+  }
+  cost.moves = count_moves(game->moves);
+  cost.bytes = current_symbol_position().offset - game_start_offset;
+  cost.allocations = allocations_made() - game_start_allocations;
+  cost.filename = globals->current_input_file;
+  cost.start_line = game->start_line;
+  cost.end_line = game->end_line;
+  cost.game_number = globals->num_games_processed;
+
+  if (slow_games == NULL) {
+    slow_games = (GameCost *)malloc_or_die(globals->slow_games_to_report *
+                                           sizeof(*slow_games));
+  }
+  if (num_slow_games < globals->slow_games_to_report) {
+    /* Add it to the heap. */
+    unsigned i = num_slow_games++;
+
+    slow_games[i] = cost;
+    while (i > 0 && slow_games[(i - 1) / 2].seconds > slow_games[i].seconds) {
+      swap_costs(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  } else {
+    /* Replace the cheapest. */
+    slow_games[0] = cost;
+    sift_down(0);
+  }
+}
+
+static int compare_costs(const void *a, const void *b) {
+  double first = ((const GameCost *)a)->seconds;
+  double second = ((const GameCost *)b)->seconds;
+
+  return first < second ? 1 : first > second ? -1 : 0;
+}
+
+/* Report the most expensive games to fp, the slowest first. */
+void report_slow_games(const StateInfo *globals, FILE *fp) {
+  if (num_slow_games == 0) {
+    return;
+  }
+  qsort(slow_games, num_slow_games, sizeof(*slow_games), compare_costs);
+  fprintf(fp, "The %u slowest game%s:\n", num_slow_games,
+          num_slow_games == 1 ? "" : "s");
+  fprintf(fp, "%10s %8s %10s %12s  %s\n", "seconds", "moves", "bytes",
+          "allocations", "game");
+  for (unsigned i = 0; i < num_slow_games; i++) {
+    const GameCost *cost = &slow_games[i];
+
+    fprintf(fp, "%10.6f %8lu %10lu %12lu  %s:%lu-%lu (game %lu)\n",
+            cost->seconds, cost->moves, cost->bytes, cost->allocations,
+            cost->filename, cost->start_line, cost->end_line,
+            cost->game_number);
+  }
+}
@@ -0,0 +1,40 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* The cost of processing each game, for --slowgames.
+ * The wall time, the number of moves including those of variations,
+ * the bytes of input and the number of allocations of each game are
+ * measured from the start of its parsing to the end of its processing,
+ * and the most expensive games are reported at the end of the run with
+ * their file and lines, so that they can be found and set aside.
+ */
+#ifndef GAMECOST_H
+#define GAMECOST_H
+
+#include "typedef.h"
+
+#include <stdio.h>
+
+void record_game_cost(const StateInfo *globals, const Game *game);
+void report_slow_games(const StateInfo *globals, FILE *fp);
+void start_game_cost(void);
+
+#endif // GAMECOST_H
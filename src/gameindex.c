@@ -0,0 +1,1389 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "gameindex.h"
+
+#include "apply.h"
+#include "lex.h"
+#include "material.h"
+#include "moves.h"
+#include "mymalloc.h"
+#include "postings.h"
+#include "taglist.h"
+#include "typedef.h"
+#include "zobrist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Each index file starts with a fixed-length header of
+ * little-endian values:
+ *     magic (4 bytes), version (4),
+ *     size (8) and modification time (8) of the indexed file,
+ *     hash of the final INDEX_TAIL_WINDOW bytes of the indexed file (8),
+ *     number of games (8), flags (4), a parameter specific to
+ *     the kind of index (4).
+ * The hash allows an index to be used with a file to which games
+ * have been appended since it was indexed, and for --updateindex
+ * to add just the appended games to it.
+ *
+ * In a game index this is followed by an entry for each game, consisting
+ * of three numbers written with write_varint:
+ *     the difference between the byte offset of the line on which the
+ *         game starts and that of the previous game;
+ *     the difference between the line numbers of the two games;
+ *     the game's column within its first line, shifted left one bit,
+ *         with the bottom bit set if the game matched when indexed.
+ *
+ * In a position index it is followed by a postings table whose keys are
+ * the polyglot hashcodes (8 bytes, most significant first) of the
+ * positions reached in each game, including its variations.
+ * The parameter is the ply limit on the positions (0 for no limit).
+ *
+ * In a tag index it is followed by a postings table of the values of
+ * the tags that are most often used for selection. The form of the keys
+ * is determined by add_tag_index_keys.
+ *
+ * In a material index it is followed by a record for each game of
+ * the runs of positions in its main line with the same material,
+ * written with write_varint:
+ *     the number of runs; the number of positions;
+ *     for each run, the difference between the numbers of its first
+ *         position and that of the previous run, followed by
+ *         MATERIAL_SIGNATURE_LENGTH bytes of material signature.
+ */
+static const char GAME_INDEX_MAGIC[4] = {'P', 'G', 'N', 'I'};
+static const char POSITION_INDEX_MAGIC[4] = {'P', 'G', 'N', 'P'};
+static const char TAG_INDEX_MAGIC[4] = {'P', 'G', 'N', 'T'};
+static const char MATERIAL_INDEX_MAGIC[4] = {'P', 'G', 'N', 'M'};
+#define INDEX_VERSION 2
+/* The number of bytes at the end of an indexed file whose hash
+ * is held in the header.
+ */
+#define INDEX_TAIL_WINDOW (64 * 1024)
+/* --updateindex appends a segment to the postings table of a position
+ * or tag index. Once there are more than this many they are merged.
+ */
+#define MAX_INDEX_SEGMENTS 8
+
+/* Header flags. */
+/* The per-game match bits reflect a run without selection criteria. */
+#define INDEX_MATCHES_KNOWN 0x01
+/* Settings in force when the index was built that affect either where
+ * games start or whether they match.
+ */
+#define INDEX_NESTED_COMMENTS 0x02
+#define INDEX_NULL_MOVES 0x04
+#define INDEX_KEEP_BROKEN 0x08
+#define INDEX_BAD_RESULTS 0x10
+#define INDEX_MATCH_SETTINGS                                                   \
+  (INDEX_NULL_MOVES | INDEX_KEEP_BROKEN | INDEX_BAD_RESULTS)
+/* The final game continued into the next input file, so it
+ * cannot be skipped by moving to the end of the file.
+ */
+#define INDEX_OPEN_ENDED 0x20
+/* The positions of variations were included. */
+#define INDEX_VARIATIONS 0x40
+
+typedef struct {
+  /* Size and modification time of the indexed file. */
+  unsigned long size;
+  long mtime;
+  unsigned long tail_hash;
+  unsigned long num_games;
+  unsigned flags;
+  unsigned parameter;
+} IndexHeader;
+
+typedef struct {
+  InputPosition position;
+  bool matches;
+} IndexEntry;
+
+/* How much of its input file an index covers. */
+typedef enum {
+  INDEX_OUT_OF_DATE,
+  INDEX_UP_TO_DATE,
+  /* Games have been appended to the file since it was indexed. */
+  INDEX_OF_PREFIX
+} IndexCoverage;
+
+/* What --updateindex can do with the existing indexes of a file. */
+typedef enum {
+  /* They must be built from scratch. */
+  UPDATE_NOT_POSSIBLE,
+  UPDATE_NOT_NEEDED,
+  /* The games from a given position onwards must be added. */
+  UPDATE_FROM_POSITION
+} IndexUpdate;
+
+static void close_index_being_read(void);
+static bool companion_index_current(const StateInfo *globals,
+                                    const char *input_file,
+                                    const char *suffix, const char magic[4],
+                                    const IndexHeader *game_header,
+                                    unsigned flags, unsigned parameter);
+static bool count_input_lines(const char *input_file, unsigned long from,
+                              unsigned long to, unsigned long *lines);
+static bool hash_input_tail(const char *input_file, unsigned long size,
+                            unsigned long *hash, int *last_byte);
+static char *index_file_name(const char *input_file, const char *suffix);
+static IndexCoverage index_coverage(const char *input_file,
+                                    const struct stat *info,
+                                    const IndexHeader *header);
+static void add_candidates(OrdinalSet *games);
+static void load_position_candidates(const StateInfo *globals,
+                                     const char *input_file,
+                                     const IndexHeader *game_header);
+static void load_material_candidates(const StateInfo *globals,
+                                     const char *input_file,
+                                     const IndexHeader *game_header);
+static void load_tag_candidates(const StateInfo *globals,
+                                const char *input_file,
+                                const IndexHeader *game_header);
+static void merge_index_segments(const StateInfo *globals, const char *name,
+                                 const char magic[4],
+                                 const IndexHeader *header);
+static FILE *open_index_file(const StateInfo *globals, const char *name,
+                             const char magic[4], IndexHeader *header);
+static FILE *open_index_for_writing(const StateInfo *globals,
+                                    const char *name);
+static IndexUpdate open_index_for_update(const StateInfo *globals,
+                                         const char *input_file,
+                                         InputPosition *resume);
+static FILE *open_game_data_index(const StateInfo *globals,
+                                  const char *input_file, const char *suffix,
+                                  const char magic[4],
+                                  const IndexHeader *game_header,
+                                  IndexHeader *header);
+static bool read_material_record(FILE *fp);
+static void open_index_for_reading(const StateInfo *globals,
+                                   unsigned file_number);
+static bool read_entry(FILE *fp, IndexEntry *entry);
+static void read_index_entry(const StateInfo *globals);
+static bool read_index_header(FILE *fp, const char magic[4],
+                              IndexHeader *header);
+static unsigned settings_flags(const StateInfo *globals);
+static bool start_index(const StateInfo *globals, GameHeader *game_header,
+                        unsigned file_number);
+static void terminate_index(const StateInfo *globals, bool complete);
+static void write_index_header(FILE *fp, const char magic[4],
+                               const IndexHeader *header);
+static void write_material_index(const StateInfo *globals,
+                                 const IndexHeader *header);
+static void write_postings_index(const StateInfo *globals,
+                                 const char *suffix, const char magic[4],
+                                 const IndexHeader *header,
+                                 PostingsBuilder *builder);
+
+/* State for building the indexes of the current input file. */
+static FILE *index_being_built = NULL;
+static char *index_being_built_name = NULL;
+static unsigned file_being_indexed = 0;
+static bool index_started = false;
+static unsigned long games_indexed = 0;
+static InputPosition last_indexed_position;
+static unsigned index_flags = 0;
+static bool index_open_ended = false;
+/* Whether games are being added to existing indexes by --updateindex,
+ * and how many they held already.
+ */
+static bool index_appending = false;
+static unsigned long games_previously_indexed = 0;
+static PostingsBuilder *positions_being_built = NULL;
+static PostingsBuilder *tags_being_built = NULL;
+/* The material records of the games indexed so far. */
+static FILE *material_being_built = NULL;
+/* The material runs of the game being indexed, or being
+ * checked against the material index.
+ */
+static MaterialRun *game_material = NULL;
+static unsigned num_material_runs = 0;
+static unsigned max_material_runs = 0;
+static unsigned num_material_positions = 0;
+/* Where the game currently being parsed started. */
+static InputPosition game_start_position;
+static unsigned game_start_file = 0;
+/* Whether the game currently being parsed is to be indexed. */
+static bool game_start_noted = false;
+
+/* State for reading the index of the current input file. */
+static FILE *index_being_read = NULL;
+static char *index_being_read_name = NULL;
+static bool index_checked = false;
+static unsigned file_being_read = 0;
+static unsigned long games_in_index = 0;
+static IndexHeader index_read_header;
+static unsigned long entries_read = 0;
+/* The number within the file (from 0) of the next game to start. */
+static unsigned long next_game_ordinal = 0;
+static IndexEntry current_entry;
+static bool index_matches_known = false;
+static bool index_read_open_ended = false;
+/* If using_candidates, only the games in candidates can match. */
+static bool using_candidates = false;
+static OrdinalSet candidates = {NULL, 0, 0};
+
+/* Return whether any criteria are in force that will
+ * cause a valid game not to be matched.
+ */
+bool selection_criteria_present(const StateInfo *globals) {
+  return globals->check_tags || globals->positional_variations ||
+         globals->check_move_bounds || globals->match_only_checkmate ||
+         globals->match_only_stalemate ||
+         globals->match_only_insufficient_material ||
+         globals->match_underpromotion || globals->keep_only_commented_games ||
+         globals->check_for_repetition > 0 ||
+         globals->check_for_N_move_rule > 0 ||
+         globals->setup_status != SETUP_TAG_OK || globals->delete_same_setup ||
+         globals->suppress_duplicates || globals->suppress_originals ||
+         textual_variations_present() || material_criteria_present();
+}
+
+/* Return the settings that influence the content of an index. */
+static unsigned settings_flags(const StateInfo *globals) {
+  unsigned flags = 0;
+
+  if (globals->allow_nested_comments) {
+    flags |= INDEX_NESTED_COMMENTS;
+  }
+  if (globals->allow_null_moves) {
+    flags |= INDEX_NULL_MOVES;
+  }
+  if (globals->keep_broken_games) {
+    flags |= INDEX_KEEP_BROKEN;
+  }
+  if (globals->reject_inconsistent_results) {
+    flags |= INDEX_BAD_RESULTS;
+  }
+  return flags;
+}
+
+/* Return the name of the index file for input_file with the given suffix. */
+static char *index_file_name(const char *input_file, const char *suffix) {
+  char *name =
+      (char *)malloc_or_die(strlen(input_file) + strlen(suffix) + 1);
+  strcpy(name, input_file);
+  strcat(name, suffix);
+  return name;
+}
+
+static void write_index_header(FILE *fp, const char magic[4],
+                               const IndexHeader *header) {
+  fwrite(magic, 4, 1, fp);
+  write_fixed(fp, 4, INDEX_VERSION);
+  write_fixed(fp, 8, header->size);
+  write_fixed(fp, 8, (unsigned long)header->mtime);
+  write_fixed(fp, 8, header->tail_hash);
+  write_fixed(fp, 8, header->num_games);
+  write_fixed(fp, 4, header->flags);
+  write_fixed(fp, 4, header->parameter);
+}
+
+/* Read the header of an index.
+ * Return false if it is not the header of the kind of index
+ * identified by magic, in the current format.
+ */
+static bool read_index_header(FILE *fp, const char magic[4],
+                              IndexHeader *header) {
+  char file_magic[4];
+  unsigned long version, mtime, flags, parameter;
+
+  if (fread(file_magic, sizeof(file_magic), 1, fp) != 1 ||
+      memcmp(file_magic, magic, sizeof(file_magic)) != 0 ||
+      !read_fixed(fp, 4, &version) || version != INDEX_VERSION ||
+      !read_fixed(fp, 8, &header->size) || !read_fixed(fp, 8, &mtime) ||
+      !read_fixed(fp, 8, &header->tail_hash) ||
+      !read_fixed(fp, 8, &header->num_games) ||
+      !read_fixed(fp, 4, &flags) || !read_fixed(fp, 4, &parameter)) {
+    return false;
+  }
+  header->mtime = (long)mtime;
+  header->flags = (unsigned)flags;
+  header->parameter = (unsigned)parameter;
+  return true;
+}
+
+/* Open the index file name, of the kind identified by magic, and read its
+ * header. Return NULL if there is no such file or it is not usable.
+ */
+static FILE *open_index_file(const StateInfo *globals, const char *name,
+                             const char magic[4], IndexHeader *header) {
+  FILE *fp = fopen(name, "rb");
+
+  if (fp == NULL) {
+    /* There is no index. */
+  } else if (!read_index_header(fp, magic, header)) {
+    fprintf(globals->logfile, "%s is not a usable index file.\n", name);
+    (void)fclose(fp);
+    fp = NULL;
+  }
+  return fp;
+}
+
+/* Set hash to the FNV-1a hash of the INDEX_TAIL_WINDOW bytes of
+ * input_file that precede offset size, or all of them if there are
+ * fewer. If last_byte is not NULL, set it to the byte before size,
+ * or EOF if size is 0.
+ * Return false if they could not be read.
+ */
+static bool hash_input_tail(const char *input_file, unsigned long size,
+                            unsigned long *hash, int *last_byte) {
+  FILE *fp = fopen(input_file, "rb");
+  unsigned long start = size > INDEX_TAIL_WINDOW ? size - INDEX_TAIL_WINDOW : 0;
+  unsigned long remaining = size - start;
+  int ch = EOF;
+
+  if (fp == NULL) {
+    return false;
+  }
+  *hash = 0xcbf29ce484222325UL;
+  if (fseek(fp, (long)start, SEEK_SET) != 0) {
+    remaining = 1;
+  }
+  for (; remaining > 0 && (ch = getc(fp)) != EOF; remaining--) {
+    *hash = (*hash ^ (unsigned long)ch) * 0x100000001b3UL;
+  }
+  (void)fclose(fp);
+  if (last_byte != NULL) {
+    *last_byte = ch;
+  }
+  return remaining == 0;
+}
+
+/* Count the newlines of input_file between offsets from and to. */
+static bool count_input_lines(const char *input_file, unsigned long from,
+                              unsigned long to, unsigned long *lines) {
+  FILE *fp = fopen(input_file, "rb");
+  char buffer[BUFSIZ];
+  bool ok;
+
+  *lines = 0;
+  if (fp == NULL) {
+    return false;
+  }
+  ok = fseek(fp, (long)from, SEEK_SET) == 0;
+  while (ok && from < to) {
+    size_t wanted = to - from < sizeof(buffer) ? to - from : sizeof(buffer);
+    size_t length = fread(buffer, 1, wanted, fp);
+
+    if (length == 0) {
+      ok = false;
+    }
+    for (size_t i = 0; i < length; i++) {
+      if (buffer[i] == '\n') {
+        (*lines)++;
+      }
+    }
+    from += length;
+  }
+  (void)fclose(fp);
+  return ok;
+}
+
+/* Return how much of input_file, described by info, is covered by
+ * the index with the given header.
+ */
+static IndexCoverage index_coverage(const char *input_file,
+                                    const struct stat *info,
+                                    const IndexHeader *header) {
+  unsigned long hash;
+
+  if (header->size > (unsigned long)info->st_size) {
+    return INDEX_OUT_OF_DATE;
+  } else if (header->size == (unsigned long)info->st_size &&
+             header->mtime == (long)info->st_mtime) {
+    return INDEX_UP_TO_DATE;
+  } else if (!hash_input_tail(input_file, header->size, &hash, NULL) ||
+             hash != header->tail_hash) {
+    /* The indexed part of the file has been changed. */
+    return INDEX_OUT_OF_DATE;
+  } else if (header->size == (unsigned long)info->st_size) {
+    return INDEX_UP_TO_DATE;
+  } else {
+    return INDEX_OF_PREFIX;
+  }
+}
+
+/* Read an entry of the game index fp, following the one in entry,
+ * into entry.
+ */
+static bool read_entry(FILE *fp, IndexEntry *entry) {
+  unsigned long offset, lines, column;
+
+  if (!read_varint(fp, &offset) || !read_varint(fp, &lines) ||
+      !read_varint(fp, &column)) {
+    return false;
+  }
+  entry->position.offset += offset;
+  entry->position.line_number += lines;
+  entry->position.column = column >> 1;
+  entry->matches = (column & 1) != 0;
+  return true;
+}
+
+/* Whether the index of input_file with the given suffix was
+ * written along with the game index whose header is game_header,
+ * with the given flags and parameter.
+ */
+static bool companion_index_current(const StateInfo *globals,
+                                    const char *input_file,
+                                    const char *suffix, const char magic[4],
+                                    const IndexHeader *game_header,
+                                    unsigned flags, unsigned parameter) {
+  char *name = index_file_name(input_file, suffix);
+  IndexHeader header;
+  FILE *fp = open_index_file(globals, name, magic, &header);
+  bool current = false;
+
+  if (fp != NULL) {
+    current = header.size == game_header->size &&
+              header.tail_hash == game_header->tail_hash &&
+              header.num_games == game_header->num_games &&
+              header.flags == flags && header.parameter == parameter;
+    (void)fclose(fp);
+  }
+  (void)free((void *)name);
+  return current;
+}
+
+/* For --updateindex, see whether the existing indexes of input_file
+ * can be extended with the games appended to it since they were
+ * built. If so, open its game index ready for the new entries and
+ * set resume to the position at which the new games start.
+ */
+static IndexUpdate open_index_for_update(const StateInfo *globals,
+                                         const char *input_file,
+                                         InputPosition *resume) {
+  char *name = index_file_name(input_file, GAME_INDEX_SUFFIX);
+  FILE *fp = fopen(name, "r+b");
+  IndexUpdate update = UPDATE_NOT_POSSIBLE;
+  IndexHeader header;
+  IndexCoverage coverage = INDEX_OUT_OF_DATE;
+  IndexEntry entry = {{0, 0, 0}, false};
+  struct stat info;
+  unsigned long hash, lines;
+  int last_byte = EOF;
+
+  if (fp == NULL) {
+    /* There is no index. */
+  } else if (!read_index_header(fp, GAME_INDEX_MAGIC, &header) ||
+             stat(input_file, &info) != 0) {
+    /* The index will be replaced. */
+  } else if (header.flags != index_flags) {
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile,
+              "%s was built with different settings, so it will be "
+              "rebuilt.\n",
+              name);
+    }
+  } else if ((coverage = index_coverage(input_file, &info, &header)) ==
+                 INDEX_OUT_OF_DATE ||
+             !hash_input_tail(input_file, header.size, &hash, &last_byte) ||
+             last_byte != '\n') {
+    /* Only the addition of complete lines can be dealt with. */
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile, "%s is out of date, so it will be rebuilt.\n",
+              name);
+    }
+  } else if (!companion_index_current(globals, input_file, TAG_INDEX_SUFFIX,
+                                      TAG_INDEX_MAGIC, &header, header.flags,
+                                      0) ||
+             ((index_flags & INDEX_MATCHES_KNOWN) != 0 &&
+              (!companion_index_current(
+                   globals, input_file, POSITION_INDEX_SUFFIX,
+                   POSITION_INDEX_MAGIC, &header,
+                   header.flags | (globals->keep_variations ? INDEX_VARIATIONS
+                                                            : 0),
+                   globals->index_ply_limit) ||
+               !companion_index_current(
+                   globals, input_file, MATERIAL_INDEX_SUFFIX,
+                   MATERIAL_INDEX_MAGIC, &header, header.flags, 0)))) {
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile,
+              "The indexes of %s are incomplete, so they will be rebuilt.\n",
+              input_file);
+    }
+  } else if (coverage == INDEX_UP_TO_DATE) {
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile, "%s is up to date.\n", name);
+    }
+    update = UPDATE_NOT_NEEDED;
+  } else {
+    bool ok = true;
+
+    /* Find the last entry, after which the new ones will follow. */
+    for (unsigned long i = 0; ok && i < header.num_games; i++) {
+      ok = read_entry(fp, &entry);
+    }
+    if (ok && header.num_games > 0) {
+      ok = count_input_lines(input_file, entry.position.offset, header.size,
+                             &lines);
+      lines += entry.position.line_number - 1;
+    } else if (ok) {
+      ok = count_input_lines(input_file, 0, header.size, &lines);
+    }
+    if (ok && fseek(fp, ftell(fp), SEEK_SET) == 0) {
+      resume->offset = header.size;
+      resume->line_number = lines + 1;
+      resume->column = 0;
+      games_indexed = games_previously_indexed = header.num_games;
+      last_indexed_position = entry.position;
+      index_being_built = fp;
+      index_being_built_name = name;
+      index_appending = true;
+      return UPDATE_FROM_POSITION;
+    }
+    fprintf(globals->logfile, "The index file %s is damaged.\n", name);
+  }
+  if (fp != NULL) {
+    (void)fclose(fp);
+  }
+  (void)free((void *)name);
+  return update;
+}
+
+/* Start building the indexes for the given input file.
+ * Return true if the input has been repositioned past games that
+ * are already indexed.
+ */
+static bool start_index(const StateInfo *globals, GameHeader *game_header,
+                        unsigned file_number) {
+  const char *input_file = input_file_name(file_number);
+  IndexHeader header = {0, 0, 0, 0, 0, 0};
+  IndexUpdate update = UPDATE_NOT_POSSIBLE;
+  InputPosition resume;
+
+  index_started = true;
+  file_being_indexed = file_number;
+  games_indexed = games_previously_indexed = 0;
+  index_open_ended = false;
+  index_appending = false;
+  last_indexed_position.offset = 0;
+  last_indexed_position.line_number = 0;
+  last_indexed_position.column = 0;
+  if (input_file == NULL) {
+    fprintf(globals->logfile, "Unable to build an index of stdin.\n");
+    return false;
+  } else if (input_is_compressed()) {
+    fprintf(globals->logfile,
+            "Unable to build an index of the compressed file %s.\n",
+            input_file);
+    return false;
+  }
+  index_flags = settings_flags(globals);
+  if (!selection_criteria_present(globals) &&
+      globals->first_game_number <= 1 &&
+      globals->matching_game_numbers == NULL &&
+      globals->skip_game_numbers == NULL) {
+    index_flags |= INDEX_MATCHES_KNOWN;
+  }
+  if (globals->update_index) {
+    update = open_index_for_update(globals, input_file, &resume);
+  }
+  if (update == UPDATE_NOT_NEEDED) {
+    if (!seek_input_end()) {
+      fprintf(globals->logfile, "Unable to reposition the input in %s.\n",
+              input_file);
+      exit(1);
+    }
+    return true;
+  } else if (update == UPDATE_NOT_POSSIBLE) {
+    index_being_built_name = index_file_name(input_file, GAME_INDEX_SUFFIX);
+    index_being_built = fopen(index_being_built_name, "wb");
+    if (index_being_built == NULL) {
+      fprintf(globals->logfile, "Unable to write the index file %s.\n",
+              index_being_built_name);
+      (void)free((void *)index_being_built_name);
+      index_being_built_name = NULL;
+      return false;
+    }
+    /* The header is written properly once all the games are known. */
+    write_index_header(index_being_built, GAME_INDEX_MAGIC, &header);
+  }
+  if ((index_flags & INDEX_MATCHES_KNOWN) != 0) {
+    /* The positions of a game are only played out in full when
+     * there are no criteria that might stop it early.
+     */
+    positions_being_built = new_postings_builder();
+    material_being_built = tmpfile();
+    if (material_being_built == NULL) {
+      fprintf(globals->logfile,
+              "Unable to create a temporary file for the material index.\n");
+    }
+  }
+  num_material_runs = num_material_positions = 0;
+  tags_being_built = new_postings_builder();
+  if (update == UPDATE_FROM_POSITION) {
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile, "Adding to %s from line %lu.\n",
+              index_being_built_name, resume.line_number);
+    }
+    if (!seek_input_position(globals, game_header, resume)) {
+      fprintf(globals->logfile, "Unable to reposition the input in %s.\n",
+              input_file);
+      exit(1);
+    }
+    return true;
+  }
+  return false;
+}
+
+/* Open the index file name for writing, positioned at its end
+ * if games are being added to it.
+ */
+static FILE *open_index_for_writing(const StateInfo *globals,
+                                    const char *name) {
+  FILE *fp = fopen(name, index_appending ? "r+b" : "wb");
+
+  if (fp == NULL) {
+    fprintf(globals->logfile, "Unable to write the index file %s.\n", name);
+  } else if (index_appending && fseek(fp, 0, SEEK_END) != 0) {
+    fprintf(globals->logfile, "Unable to write the index file %s.\n", name);
+    (void)fclose(fp);
+    fp = NULL;
+  }
+  return fp;
+}
+
+/* Write the postings of builder to the index of the file being
+ * indexed with the given suffix. When adding to an existing index,
+ * they form a new segment of its postings table.
+ */
+static void write_postings_index(const StateInfo *globals,
+                                 const char *suffix, const char magic[4],
+                                 const IndexHeader *header,
+                                 PostingsBuilder *builder) {
+  const char *input_file = input_file_name(file_being_indexed);
+  char *name = index_file_name(input_file, suffix);
+  FILE *fp = open_index_for_writing(globals, name);
+
+  if (fp != NULL) {
+    bool ok;
+
+    if (!index_appending) {
+      write_index_header(fp, magic, header);
+      ok = write_postings(builder, fp, 0);
+    } else if (games_indexed == games_previously_indexed) {
+      /* There is nothing to add. */
+      ok = true;
+    } else {
+      ok = write_postings(builder, fp, ftell(fp));
+    }
+    rewind(fp);
+    write_index_header(fp, magic, header);
+    ok = !ferror(fp) && ok;
+    if (fclose(fp) != 0 || !ok) {
+      fprintf(globals->logfile, "Error writing the index file %s.\n", name);
+      (void)remove(name);
+    } else if (index_appending) {
+      merge_index_segments(globals, name, magic, header);
+    }
+  }
+  (void)free((void *)name);
+}
+
+/* If the postings table of the index file name has too many
+ * segments, replace it with a single segment.
+ * The replacement is written separately and renamed, so that
+ * anything already reading the index is unaffected.
+ */
+static void merge_index_segments(const StateInfo *globals, const char *name,
+                                 const char magic[4],
+                                 const IndexHeader *header) {
+  FILE *fp = fopen(name, "rb");
+  PostingsTable *table = fp != NULL ? read_postings_table(fp) : NULL;
+
+  if (table != NULL && postings_segments(table) > MAX_INDEX_SEGMENTS) {
+    char *merged_name = index_file_name(name, ".tmp");
+    FILE *merged = fopen(merged_name, "wb");
+    PostingsBuilder *builder = new_postings_builder();
+    bool ok = merged != NULL && copy_postings(table, builder);
+
+    if (ok) {
+      write_index_header(merged, magic, header);
+      ok = write_postings(builder, merged, 0);
+      ok = !ferror(merged) && ok;
+    }
+    if (merged != NULL) {
+      ok = fclose(merged) == 0 && ok;
+    }
+    if (ok && rename(merged_name, name) == 0) {
+      if (globals->verbosity > 1) {
+        fprintf(globals->logfile, "Merged the %u segments of %s.\n",
+                postings_segments(table), name);
+      }
+    } else {
+      fprintf(globals->logfile, "Unable to merge the segments of %s.\n",
+              name);
+      (void)remove(merged_name);
+    }
+    free_postings_builder(builder);
+    (void)free((void *)merged_name);
+  }
+  if (table != NULL) {
+    close_postings_table(table);
+  }
+  if (fp != NULL) {
+    (void)fclose(fp);
+  }
+}
+
+/* Write the material records of the file being indexed to its
+ * material index.
+ */
+static void write_material_index(const StateInfo *globals,
+                                 const IndexHeader *header) {
+  const char *input_file = input_file_name(file_being_indexed);
+  char *name = index_file_name(input_file, MATERIAL_INDEX_SUFFIX);
+  FILE *fp = open_index_for_writing(globals, name);
+
+  if (fp != NULL) {
+    char buffer[BUFSIZ];
+    size_t length;
+    bool ok;
+
+    if (!index_appending) {
+      write_index_header(fp, MATERIAL_INDEX_MAGIC, header);
+    }
+    rewind(material_being_built);
+    while ((length = fread(buffer, 1, sizeof(buffer), material_being_built)) >
+           0) {
+      (void)fwrite(buffer, 1, length, fp);
+    }
+    rewind(fp);
+    write_index_header(fp, MATERIAL_INDEX_MAGIC, header);
+    ok = !ferror(material_being_built) && !ferror(fp);
+    if (fclose(fp) != 0 || !ok) {
+      fprintf(globals->logfile, "Error writing the index file %s.\n", name);
+      (void)remove(name);
+    }
+  }
+  (void)free((void *)name);
+}
+
+/* Finish the indexes currently being built.
+ * They are only kept if the whole of their input file has been read.
+ */
+static void terminate_index(const StateInfo *globals, bool complete) {
+  if (index_being_built != NULL) {
+    const char *input_file = input_file_name(file_being_indexed);
+    struct stat info;
+    IndexHeader header;
+
+    if (!complete) {
+      fprintf(globals->logfile,
+              "The index of %s was not %s because the file was not "
+              "read to its end.\n",
+              input_file, index_appending ? "updated" : "written");
+    } else if (stat(input_file, &info) != 0 ||
+               !hash_input_tail(input_file, (unsigned long)info.st_size,
+                                &header.tail_hash, NULL)) {
+      fprintf(globals->logfile, "Unable to determine the size of %s.\n",
+              input_file);
+      complete = false;
+    } else {
+      if (index_open_ended) {
+        index_flags |= INDEX_OPEN_ENDED;
+      }
+      header.size = (unsigned long)info.st_size;
+      header.mtime = (long)info.st_mtime;
+      header.num_games = games_indexed;
+      header.flags = index_flags;
+      header.parameter = 0;
+      rewind(index_being_built);
+      write_index_header(index_being_built, GAME_INDEX_MAGIC, &header);
+      if (ferror(index_being_built)) {
+        fprintf(globals->logfile, "Error writing the index file %s.\n",
+                index_being_built_name);
+        complete = false;
+      }
+    }
+    (void)fclose(index_being_built);
+    index_being_built = NULL;
+    if (!complete) {
+      /* An index being added to is left as it was, as the header
+       * still describes only its original entries.
+       */
+      if (!index_appending) {
+        (void)remove(index_being_built_name);
+      }
+    } else {
+      if (positions_being_built != NULL) {
+        IndexHeader position_header = header;
+
+        position_header.parameter = globals->index_ply_limit;
+        if (globals->keep_variations) {
+          position_header.flags |= INDEX_VARIATIONS;
+        }
+        write_postings_index(globals, POSITION_INDEX_SUFFIX,
+                             POSITION_INDEX_MAGIC, &position_header,
+                             positions_being_built);
+      }
+      if (material_being_built != NULL) {
+        write_material_index(globals, &header);
+      }
+      write_postings_index(globals, TAG_INDEX_SUFFIX, TAG_INDEX_MAGIC,
+                           &header, tags_being_built);
+      if (globals->verbosity > 1) {
+        unsigned long games_added = games_indexed - games_previously_indexed;
+
+        fprintf(globals->logfile, "%lu game%s %s %s.\n", games_added,
+                games_added == 1 ? "" : "s",
+                index_appending ? "added to" : "indexed in",
+                index_being_built_name);
+      }
+    }
+    (void)free((void *)index_being_built_name);
+    index_being_built_name = NULL;
+  }
+  index_appending = false;
+  if (positions_being_built != NULL) {
+    free_postings_builder(positions_being_built);
+    positions_being_built = NULL;
+  }
+  if (tags_being_built != NULL) {
+    free_postings_builder(tags_being_built);
+    tags_being_built = NULL;
+  }
+  if (material_being_built != NULL) {
+    (void)fclose(material_being_built);
+    material_being_built = NULL;
+  }
+}
+
+/* Remember where the game about to be parsed starts, for --buildindex.
+ * Finish the indexes of the previous file if this game starts a new one.
+ * Return true if, instead, the input has been repositioned past games
+ * that are already indexed, for --updateindex.
+ */
+bool note_game_start(const StateInfo *globals, GameHeader *game_header) {
+  game_start_position = current_symbol_position();
+  game_start_file = current_file_number();
+  game_start_noted = true;
+  if (!index_started || game_start_file != file_being_indexed) {
+    /* The previous file was read in its entirety. */
+    terminate_index(globals, true);
+    if (start_index(globals, game_header, game_start_file)) {
+      game_start_noted = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Add the position on board, reached after ply half-moves, to the
+ * positions of the game being indexed.
+ */
+void index_position(const StateInfo *globals, const Board *board,
+                    unsigned ply) {
+  if (positions_being_built != NULL && game_start_noted &&
+      (globals->index_ply_limit == 0 || ply <= globals->index_ply_limit)) {
+    uint64_t hash = generate_zobrist_hash_from_board(board);
+    unsigned char key[sizeof(hash)];
+
+    for (int i = sizeof(key) - 1; i >= 0; i--) {
+      key[i] = (unsigned char)(hash & 0xff);
+      hash >>= 8;
+    }
+    add_posting(positions_being_built, key, sizeof(key), games_indexed);
+  }
+}
+
+/* Add the material of board to the runs of the main line of
+ * the game being indexed. initial indicates whether it is the
+ * starting position.
+ */
+void index_material(const Board *board, bool initial) {
+  if (material_being_built != NULL && game_start_noted) {
+    unsigned char signature[MATERIAL_SIGNATURE_LENGTH];
+
+    if (initial) {
+      num_material_runs = num_material_positions = 0;
+    }
+    material_signature(board, signature);
+    if (num_material_runs == 0 ||
+        memcmp(game_material[num_material_runs - 1].signature, signature,
+               sizeof(signature)) != 0) {
+      if (num_material_runs == max_material_runs) {
+        max_material_runs = max_material_runs == 0 ? 8 : 2 * max_material_runs;
+        game_material = (MaterialRun *)realloc_or_die(
+            (void *)game_material, max_material_runs * sizeof(*game_material));
+      }
+      game_material[num_material_runs].first_position = num_material_positions;
+      memcpy(game_material[num_material_runs].signature, signature,
+             sizeof(signature));
+      num_material_runs++;
+    }
+    num_material_positions++;
+  }
+}
+
+/* Add the values of the tags of the game being indexed to its file's
+ * tag index.
+ */
+void index_tags(char *tags[]) {
+  if (tags_being_built != NULL && game_start_noted) {
+    add_tag_index_keys(tags, tags_being_built, games_indexed);
+  }
+}
+
+/* Add the game just processed to the index of its file.
+ * matched indicates whether it matched the selection criteria.
+ */
+void record_indexed_game(const StateInfo *globals, bool matched) {
+  if (!game_start_noted) {
+    /* The game is not from a NORMALFILE. */
+    return;
+  }
+  game_start_noted = false;
+  if (index_being_built != NULL) {
+    write_varint(index_being_built, game_start_position.offset -
+                                        last_indexed_position.offset);
+    write_varint(index_being_built, game_start_position.line_number -
+                                        last_indexed_position.line_number);
+    write_varint(index_being_built,
+                 (game_start_position.column << 1) | (matched ? 1 : 0));
+    last_indexed_position = game_start_position;
+    games_indexed++;
+    if (material_being_built != NULL) {
+      unsigned previous = 0;
+
+      write_varint(material_being_built, num_material_runs);
+      write_varint(material_being_built, num_material_positions);
+      for (unsigned run = 0; run < num_material_runs; run++) {
+        write_varint(material_being_built,
+                     game_material[run].first_position - previous);
+        previous = game_material[run].first_position;
+        (void)fwrite(game_material[run].signature, 1,
+                     MATERIAL_SIGNATURE_LENGTH, material_being_built);
+      }
+      num_material_runs = num_material_positions = 0;
+    }
+    if (current_file_number() != game_start_file) {
+      /* The game ran on into the next file. */
+      index_open_ended = true;
+    }
+  }
+}
+
+/* All input has been processed, so finish any index being built. */
+void finish_game_indexes(const StateInfo *globals) {
+  /* Once the final file has been read, current_file_number moves
+   * beyond it.
+   */
+  terminate_index(globals, current_file_number() != file_being_indexed);
+  close_index_being_read();
+}
+
+static void close_index_being_read(void) {
+  if (index_being_read != NULL) {
+    (void)fclose(index_being_read);
+    index_being_read = NULL;
+  }
+  if (index_being_read_name != NULL) {
+    (void)free((void *)index_being_read_name);
+    index_being_read_name = NULL;
+  }
+  using_candidates = false;
+  clear_ordinal_set(&candidates);
+}
+
+/* Restrict the candidate games to those in games, which is cleared. */
+static void add_candidates(OrdinalSet *games) {
+  if (!using_candidates) {
+    clear_ordinal_set(&candidates);
+    candidates = *games;
+    using_candidates = true;
+  } else {
+    intersect_ordinal_sets(&candidates, games);
+    clear_ordinal_set(games);
+  }
+  games->ordinals = NULL;
+  games->num_ordinals = games->max_ordinals = 0;
+}
+
+/* Open the index of input_file with the given suffix, which must
+ * have been written along with its game index, whose header is
+ * game_header.
+ * Return NULL if there is no usable index.
+ */
+static FILE *open_game_data_index(const StateInfo *globals,
+                                  const char *input_file, const char *suffix,
+                                  const char magic[4],
+                                  const IndexHeader *game_header,
+                                  IndexHeader *header) {
+  char *name = index_file_name(input_file, suffix);
+  FILE *fp = open_index_file(globals, name, magic, header);
+
+  if (fp != NULL && (header->size != game_header->size ||
+                     header->tail_hash != game_header->tail_hash ||
+                     header->num_games != game_header->num_games)) {
+    fprintf(globals->logfile, "Ignoring the out of date index %s.\n", name);
+    (void)fclose(fp);
+    fp = NULL;
+  }
+  (void)free((void *)name);
+  return fp;
+}
+
+/* If the only positions of interest are polyglot hashcodes, use the
+ * position index of input_file, if there is one, to find the games
+ * that could contain them.
+ */
+static void load_position_candidates(const StateInfo *globals,
+                                     const char *input_file,
+                                     const IndexHeader *game_header) {
+  uint64_t *codes;
+  unsigned num_codes;
+  unsigned depth;
+  FILE *fp;
+  IndexHeader header;
+
+  if (!globals->positional_variations) {
+    return;
+  }
+  num_codes = polyglot_codes_for_index(&codes);
+  if (num_codes == 0) {
+    return;
+  }
+  depth = globals->depth_of_positional_search != 0
+              ? globals->depth_of_positional_search
+              : DEFAULT_POSITIONAL_DEPTH;
+  fp = open_game_data_index(globals, input_file, POSITION_INDEX_SUFFIX,
+                            POSITION_INDEX_MAGIC, game_header, &header);
+  if (fp == NULL) {
+    /* There is no usable index. */
+  } else if ((header.parameter != 0 && depth > header.parameter) ||
+             (globals->keep_variations &&
+              ((header.flags & INDEX_VARIATIONS) == 0 ||
+               (header.parameter != 0 &&
+                DEFAULT_POSITIONAL_DEPTH > header.parameter)))) {
+    /* The index does not hold every position that might be searched. */
+  } else {
+    PostingsTable *table = read_postings_table(fp);
+
+    if (table == NULL) {
+      fprintf(globals->logfile, "The position index of %s is damaged.\n",
+              input_file);
+    } else {
+      OrdinalSet games = {NULL, 0, 0};
+
+      for (unsigned i = 0; i < num_codes; i++) {
+        uint64_t hash = codes[i];
+        unsigned char key[sizeof(hash)];
+
+        for (int k = sizeof(key) - 1; k >= 0; k--) {
+          key[k] = (unsigned char)(hash & 0xff);
+          hash >>= 8;
+        }
+        lookup_postings(table, key, sizeof(key), key, sizeof(key), false,
+                        &games);
+      }
+      normalise_ordinal_set(&games);
+      add_candidates(&games);
+      close_postings_table(table);
+    }
+  }
+  if (fp != NULL) {
+    (void)fclose(fp);
+  }
+  (void)free((void *)codes);
+}
+
+/* Read the next game's record from the material index fp into
+ * game_material. Return false if it is damaged.
+ */
+static bool read_material_record(FILE *fp) {
+  unsigned long runs, positions, first_position = 0;
+
+  if (!read_varint(fp, &runs) || !read_varint(fp, &positions) ||
+      runs > positions) {
+    return false;
+  }
+  if (runs > max_material_runs) {
+    max_material_runs = (unsigned)runs;
+    game_material = (MaterialRun *)realloc_or_die(
+        (void *)game_material, max_material_runs * sizeof(*game_material));
+  }
+  for (unsigned run = 0; run < runs; run++) {
+    unsigned long difference;
+
+    if (!read_varint(fp, &difference) ||
+        fread(game_material[run].signature, 1, MATERIAL_SIGNATURE_LENGTH,
+              fp) != MATERIAL_SIGNATURE_LENGTH) {
+      return false;
+    }
+    first_position += difference;
+    game_material[run].first_position = (unsigned)first_position;
+  }
+  num_material_runs = (unsigned)runs;
+  num_material_positions = (unsigned)positions;
+  return first_position < positions || runs == 0;
+}
+
+/* Use the material index of input_file, if there is one, to find the
+ * games that could match the material criteria, without playing
+ * their moves.
+ */
+static void load_material_candidates(const StateInfo *globals,
+                                     const char *input_file,
+                                     const IndexHeader *game_header) {
+  FILE *fp;
+  IndexHeader header;
+
+  if (!material_criteria_present()) {
+    return;
+  }
+  fp = open_game_data_index(globals, input_file, MATERIAL_INDEX_SUFFIX,
+                            MATERIAL_INDEX_MAGIC, game_header, &header);
+  if (fp != NULL) {
+    OrdinalSet games = {NULL, 0, 0};
+    bool ok = true;
+
+    for (unsigned long ordinal = 0; ok && ordinal < header.num_games;
+         ordinal++) {
+      ok = read_material_record(fp);
+      if (ok && material_runs_match(globals, game_material, num_material_runs,
+                                    num_material_positions)) {
+        add_ordinal(&games, ordinal);
+      }
+    }
+    if (ok) {
+      add_candidates(&games);
+    } else {
+      fprintf(globals->logfile, "The material index of %s is damaged.\n",
+              input_file);
+    }
+    clear_ordinal_set(&games);
+    (void)fclose(fp);
+  }
+}
+
+/* Use the tag index of input_file, if there is one, to find the
+ * games that could match the tag criteria.
+ */
+static void load_tag_candidates(const StateInfo *globals,
+                                const char *input_file,
+                                const IndexHeader *game_header) {
+  FILE *fp;
+  IndexHeader header;
+
+  if (!globals->check_tags) {
+    return;
+  }
+  fp = open_game_data_index(globals, input_file, TAG_INDEX_SUFFIX,
+                            TAG_INDEX_MAGIC, game_header, &header);
+  if (fp != NULL) {
+    PostingsTable *table = read_postings_table(fp);
+
+    if (table == NULL) {
+      fprintf(globals->logfile, "The tag index of %s is damaged.\n",
+              input_file);
+    } else {
+      OrdinalSet games = {NULL, 0, 0};
+
+      if (tag_index_candidates(globals, table, &games)) {
+        add_candidates(&games);
+      }
+      clear_ordinal_set(&games);
+      close_postings_table(table);
+    }
+    (void)fclose(fp);
+  }
+}
+
+/* Look for up-to-date indexes of the given input file. */
+static void open_index_for_reading(const StateInfo *globals,
+                                   unsigned file_number) {
+  const char *input_file = input_file_name(file_number);
+  struct stat info;
+  IndexHeader *header = &index_read_header;
+  IndexCoverage coverage;
+
+  close_index_being_read();
+  index_checked = true;
+  file_being_read = file_number;
+  games_in_index = 0;
+  entries_read = 0;
+  next_game_ordinal = 0;
+  current_entry.position.offset = 0;
+  current_entry.position.line_number = 0;
+  current_entry.position.column = 0;
+  current_entry.matches = false;
+
+  if (input_file == NULL || input_is_compressed() ||
+      stat(input_file, &info) != 0) {
+    return;
+  }
+  index_being_read_name = index_file_name(input_file, GAME_INDEX_SUFFIX);
+  index_being_read = open_index_file(globals, index_being_read_name,
+                                     GAME_INDEX_MAGIC, header);
+  if (index_being_read == NULL) {
+    close_index_being_read();
+  } else if ((coverage = index_coverage(input_file, &info, header)) ==
+             INDEX_OUT_OF_DATE) {
+    fprintf(globals->logfile, "Ignoring the out of date index %s.\n",
+            index_being_read_name);
+    close_index_being_read();
+  } else if ((header->flags & INDEX_NESTED_COMMENTS) !=
+             (settings_flags(globals) & INDEX_NESTED_COMMENTS)) {
+    fprintf(globals->logfile,
+            "Ignoring the index %s as it was built with a different "
+            "setting of --nestedcomments.\n",
+            index_being_read_name);
+    close_index_being_read();
+  } else {
+    games_in_index = header->num_games;
+    /* When games have been appended to the file, the final indexed
+     * game cannot be skipped by moving to the end of the file, and
+     * the games after it are not indexed.
+     */
+    index_read_open_ended = (header->flags & INDEX_OPEN_ENDED) != 0 ||
+                            coverage == INDEX_OF_PREFIX;
+    if (coverage == INDEX_OF_PREFIX && globals->verbosity > 1) {
+      fprintf(globals->logfile,
+              "%s only covers the first %lu bytes of %s.\n",
+              index_being_read_name, header->size, input_file);
+    }
+    index_matches_known =
+        (header->flags & INDEX_MATCHES_KNOWN) != 0 &&
+        (header->flags & INDEX_MATCH_SETTINGS) ==
+            (settings_flags(globals) & INDEX_MATCH_SETTINGS) &&
+        !selection_criteria_present(globals);
+    if ((header->flags & INDEX_MATCH_SETTINGS) ==
+        (settings_flags(globals) & INDEX_MATCH_SETTINGS)) {
+      load_position_candidates(globals, input_file, header);
+      load_material_candidates(globals, input_file, header);
+    }
+    load_tag_candidates(globals, input_file, header);
+    if (using_candidates && globals->verbosity > 1) {
+      fprintf(globals->logfile, "%lu of %lu games in %s are candidates.\n",
+              candidates.num_ordinals, games_in_index, input_file);
+    }
+  }
+}
+
+/* Read the next entry of the index. */
+static void read_index_entry(const StateInfo *globals) {
+  if (!read_entry(index_being_read, &current_entry)) {
+    fprintf(globals->logfile, "The index file %s is damaged.\n",
+            index_being_read_name);
+    exit(1);
+  }
+  entries_read++;
+}
+
+/* Return what is known about whether the current entry matches. */
+static IndexedMatch current_entry_match(void) {
+  if (using_candidates &&
+      !ordinal_set_contains(&candidates, entries_read - 1)) {
+    return INDEXED_NON_MATCH;
+  } else if (!index_matches_known) {
+    return INDEXED_MATCH_UNKNOWN;
+  } else if (current_entry.matches) {
+    return INDEXED_MATCH;
+  } else {
+    return INDEXED_NON_MATCH;
+  }
+}
+
+/* Return whether the indexes of the current input file narrow down
+ * the games that could match the positions being searched for.
+ */
+bool indexed_candidates_present(void) { return using_candidates; }
+
+/* A game is about to be parsed.
+ * Return true if the current input file has an index entry for it,
+ * in which case match is set from the entry.
+ */
+bool indexed_game_at_start(const StateInfo *globals, IndexedMatch *match) {
+  unsigned file_number = current_file_number();
+  unsigned long ordinal;
+  InputPosition position;
+
+  if (!index_checked || file_number != file_being_read) {
+    open_index_for_reading(globals, file_number);
+  }
+  if (index_being_read == NULL) {
+    return false;
+  }
+  ordinal = next_game_ordinal++;
+  if (ordinal >= games_in_index) {
+    return false;
+  }
+  while (entries_read <= ordinal) {
+    read_index_entry(globals);
+  }
+  position = current_symbol_position();
+  if (position.offset != current_entry.position.offset ||
+      position.line_number != current_entry.position.line_number ||
+      position.column != current_entry.position.column) {
+    fprintf(globals->logfile,
+            "The index %s does not match its file at line %lu, so it will "
+            "not be used.\n",
+            index_being_read_name, position.line_number);
+    close_index_being_read();
+    return false;
+  }
+  *match = current_entry_match();
+  return true;
+}
+
+/* Return whether the game of the current index entry may be skipped. */
+bool indexed_game_skippable(void) {
+  return !(index_read_open_ended && entries_read == games_in_index);
+}
+
+/* Move on to the index entry for the game following the current one.
+ * Return false if there are no more.
+ */
+bool next_indexed_game(const StateInfo *globals, IndexedMatch *match) {
+  if (index_being_read == NULL || entries_read >= games_in_index) {
+    next_game_ordinal = games_in_index;
+    return false;
+  }
+  read_index_entry(globals);
+  next_game_ordinal = entries_read - 1;
+  *match = current_entry_match();
+  return true;
+}
+
+/* Position the input at the start of the game of the current
+ * index entry, or at the end of the file if the index has been
+ * exhausted by next_indexed_game.
+ */
+void seek_to_indexed_game(const StateInfo *globals, GameHeader *game_header) {
+  bool ok;
+
+  if (next_game_ordinal >= entries_read) {
+    ok = seek_input_end();
+  } else {
+    ok = seek_input_position(globals, game_header, current_entry.position);
+  }
+  if (!ok) {
+    fprintf(globals->logfile, "Unable to reposition the input in %s.\n",
+            globals->current_input_file);
+    exit(1);
+  }
+}
@@ -0,0 +1,70 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Sidecar indexes of the games in an input file.
+ * With --buildindex, the position of every game in file.pgn is written
+ * to file.pgn.idx. When a later run only wants a selection of the games
+ * by number, the index allows the games of no interest to be skipped
+ * without being parsed. The positions reached in each game are also
+ * written to file.pgn.pos, so that games that cannot contain a position
+ * being searched for with -H can be skipped in the same way. Similarly,
+ * the values of the most commonly selected tags are written to
+ * file.pgn.tag for the resolution of -t and -T criteria, and the
+ * material reached in each game to file.pgn.mat for -y and -z.
+ * With --updateindex, indexes of a file to which games have since been
+ * appended are extended with just the new games.
+ */
+#ifndef GAMEINDEX_H
+#define GAMEINDEX_H
+
+#include "typedef.h"
+
+#include <stdbool.h>
+
+/* The suffixes added to the name of an input file for its indexes. */
+#define GAME_INDEX_SUFFIX ".idx"
+#define POSITION_INDEX_SUFFIX ".pos"
+#define TAG_INDEX_SUFFIX ".tag"
+#define MATERIAL_INDEX_SUFFIX ".mat"
+
+/* What the index knows about whether a game would match. */
+typedef enum {
+  /* The index was not built with comparable criteria. */
+  INDEXED_MATCH_UNKNOWN,
+  INDEXED_MATCH,
+  INDEXED_NON_MATCH
+} IndexedMatch;
+
+void finish_game_indexes(const StateInfo *globals);
+bool indexed_candidates_present(void);
+bool indexed_game_at_start(const StateInfo *globals, IndexedMatch *match);
+bool indexed_game_skippable(void);
+void index_material(const Board *board, bool initial);
+void index_position(const StateInfo *globals, const Board *board,
+                    unsigned ply);
+void index_tags(char *tags[]);
+bool next_indexed_game(const StateInfo *globals, IndexedMatch *match);
+bool note_game_start(const StateInfo *globals, GameHeader *game_header);
+void record_indexed_game(const StateInfo *globals, bool matched);
+void seek_to_indexed_game(const StateInfo *globals, GameHeader *game_header);
+bool selection_criteria_present(const StateInfo *globals);
+
+#endif // GAMEINDEX_H
@@ -22,14 +22,21 @@
 #include "grammar.h"
 
 #include "apply.h"
+#include "checkpoint.h"
+#include "compression.h"
 #include "defs.h"
 #include "eco.h"
+#include "gamecache.h"
+#include "gamecost.h"
+#include "gameindex.h"
 #include "hashing.h"
+#include "intern.h"
 #include "lex.h"
 #include "material.h"
 #include "moves.h"
 #include "mymalloc.h"
 #include "output.h"
+#include "progress.h"
 #include "taglist.h"
 #include "tokens.h"
 #include "typedef.h"
@@ -40,15 +47,17 @@
 
 static TokenType current_symbol = NO_TOKEN;
 
+/* The input file of the last game written to the duplicate file,
+ * so that each change of file is noted there.
+ */
+static const char *last_duplicate_input_file = NULL;
+
 /* Keep track of which RAV level we are at.
  * This is used to check whether a TERMINATING_RESULT is the final one
  * and whether NULL_MOVEs are allowed.
  */
 static unsigned RAV_level = 0;
 
-/* How often to report processing rate. */
-static unsigned PROGRESS_RATE = 1000;
-
 static void parse_opt_game_list(StateInfo *globals, GameHeader *game_header,
                                 SourceFileType file_type);
 static bool parse_game(StateInfo *globals, GameHeader *game_header,
@@ -82,7 +91,10 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
                            Move *move_list, unsigned long start_line,
                            unsigned long end_line);
 static bool finished_processing(const StateInfo *globals);
-static void free_tags(GameHeader *game_header);
+static void account_for_unread_game(StateInfo *globals, IndexedMatch match);
+static bool indexed_game_wanted(const StateInfo *globals, IndexedMatch match);
+static bool skip_unwanted_games(StateInfo *globals, GameHeader *game_header);
+static void free_tags(const StateInfo *globals, GameHeader *game_header);
 static CommentList *merge_comment_lists(CommentList *prefix,
                                         CommentList *suffix);
 static void output_game(const StateInfo *globals, GameHeader *game_header,
@@ -91,50 +103,87 @@ static void split_variants(const StateInfo *globals, GameHeader *game_header,
                            Game *game, FILE *outputfile, unsigned depth);
 
 /* Initialise the game header structure to contain
- * space for the default number of tags.
- * The space will have to be increased if new tags are
- * identified in the program source.
+ * space for the tags known in advance.
+ * The values of any others are held in its extra_tags.
  */
 GameHeader new_game_header() {
   unsigned i;
-  GameHeader game_header = {NULL, 0, NULL};
+  GameHeader game_header = {NULL, NULL, 0, 0, NULL};
 
-  game_header.header_tags_length = ORIGINAL_NUMBER_OF_TAGS;
-  game_header.Tags = (char **)malloc_or_die(game_header.header_tags_length *
-                                            sizeof(*game_header.Tags));
+  game_header.Tags = (char **)malloc_for(
+      MEMORY_TAG, ORIGINAL_NUMBER_OF_TAGS * sizeof(*game_header.Tags));
 
-  for (i = 0; i < game_header.header_tags_length; i++) {
+  for (i = 0; i < ORIGINAL_NUMBER_OF_TAGS; i++) {
     game_header.Tags[i] = (char *)NULL;
   }
 
   return game_header;
 }
 
-void increase_game_header_tags_length(const StateInfo *globals,
-                                      GameHeader *game_header,
-                                      unsigned new_length) {
-  unsigned i;
+/* Set the value of tag in game_header, replacing any that it
+ * already has.
+ * Tags other than those known in advance are kept in order of
+ * their index, which is usually the order in which they arrive.
+ */
+void set_game_tag(const StateInfo *globals, GameHeader *game_header,
+                  unsigned tag, char *value) {
+  unsigned slot;
 
-  if (new_length <= game_header->header_tags_length) {
-    fprintf(globals->logfile, "Internal error: inappropriate length %d ",
-            new_length);
-    fprintf(globals->logfile, " passed to increase_game_header_tags().\n");
-    exit(1);
+  if (tag < ORIGINAL_NUMBER_OF_TAGS) {
+    if (game_header->Tags[tag] != NULL) {
+      release_tag_value(globals, tag, game_header->Tags[tag]);
+    }
+    if (interned_tag(globals, tag)) {
+      value = intern_tag_value(globals, tag, value);
+    }
+    game_header->Tags[tag] = value;
+    return;
+  }
+  slot = game_header->num_extra_tags;
+  while (slot > 0 && game_header->extra_tags[slot - 1].tag >= tag) {
+    slot--;
   }
-  game_header->Tags = (char **)realloc_or_die(
-      (void *)game_header->Tags, new_length * sizeof(*game_header->Tags));
-  for (i = game_header->header_tags_length; i < new_length; i++) {
-    game_header->Tags[i] = NULL;
+  if (slot < game_header->num_extra_tags &&
+      game_header->extra_tags[slot].tag == tag) {
+    (void)free((void *)game_header->extra_tags[slot].value);
+    game_header->extra_tags[slot].value = value;
+    return;
   }
-  game_header->header_tags_length = new_length;
+  if (game_header->num_extra_tags == game_header->extra_tags_allocated) {
+    size_t old_size =
+        game_header->extra_tags_allocated * sizeof(*game_header->extra_tags);
+
+    game_header->extra_tags_allocated =
+        game_header->extra_tags_allocated == 0
+            ? 4
+            : 2 * game_header->extra_tags_allocated;
+    game_header->extra_tags = (ExtraTag *)realloc_for(
+        MEMORY_TAG, (void *)game_header->extra_tags, old_size,
+        game_header->extra_tags_allocated * sizeof(*game_header->extra_tags));
+  }
+  memmove(&game_header->extra_tags[slot + 1], &game_header->extra_tags[slot],
+          (game_header->num_extra_tags - slot) *
+              sizeof(*game_header->extra_tags));
+  game_header->extra_tags[slot].tag = tag;
+  game_header->extra_tags[slot].value = value;
+  game_header->num_extra_tags++;
 }
 
-/* Try to open the given file. Error and exit on failure. */
+/* Try to open the given file. Error and exit on failure.
+ * A file opened for output whose name ends in the suffix of a
+ * compression format is written compressed.
+ */
 FILE *must_open_file(const StateInfo *globals, const char *filename,
                      const char *mode) {
   FILE *fp;
+  Compression compression =
+      *mode == 'r' ? COMPRESSION_NONE : compression_of_file_name(filename);
 
-  fp = fopen(filename, mode);
+  if (compression != COMPRESSION_NONE) {
+    fp = open_compressed_output(globals, filename, *mode == 'a', compression);
+  } else {
+    fp = fopen(filename, mode);
+  }
   if (fp == NULL) {
     fprintf(globals->logfile, "Unable to open the file: \"%s\"\n", filename);
     exit(1);
@@ -257,8 +306,9 @@ static FILE *select_output_file(const StateInfo *globals, StateInfo *GameState,
         }
         (void)fclose(GameState->outputfile);
       }
-      sprintf(filename, "%u%s", GameState->next_file_number,
-              output_file_suffix(GameState->output_format));
+      sprintf(filename, "%u%s%s", GameState->next_file_number,
+              output_file_suffix(GameState->output_format),
+              globals->compressed_output_suffix);
       GameState->outputfile = must_open_file(globals, filename, "w");
       GameState->next_file_number++;
       if (globals->json_format) {
@@ -269,10 +319,7 @@ static FILE *select_output_file(const StateInfo *globals, StateInfo *GameState,
     if (GameState->ECO_level > DONT_DIVIDE) {
       /* Open a file of the appropriate name. */
       if (GameState->outputfile != NULL) {
-        /* @@@ In practice, this might need refinement.
-         * Repeated opening and closing may prove inefficient.
-         */
-        (void)fclose(GameState->outputfile);
+        /* The ECO output files are kept open until the end of the run. */
         GameState->outputfile =
             open_eco_output_file(globals, GameState->ECO_level, eco);
       }
@@ -303,6 +350,110 @@ static bool in_game_number_range(unsigned long number, game_number *range) {
   return range != NULL && range->min <= number && number <= range->max;
 }
 
+/*
+ * Whether a game not yet read, of which what is known about
+ * whether it matches is given by match, would be output.
+ */
+static bool indexed_game_wanted(const StateInfo *globals, IndexedMatch match) {
+  unsigned long game_number = globals->num_games_processed + 1;
+  unsigned long match_number = globals->num_games_matched + 1;
+
+  if (game_number < globals->first_game_number) {
+    return false;
+  }
+  switch (match) {
+  case INDEXED_MATCH:
+    return !(globals->matching_game_numbers != NULL &&
+             !in_game_number_range(match_number,
+                                   globals->next_game_number_to_output)) &&
+           !(globals->skip_game_numbers != NULL &&
+             in_game_number_range(match_number,
+                                  globals->next_game_number_to_skip));
+  case INDEXED_NON_MATCH:
+    return false;
+  default:
+    return true;
+  }
+}
+
+/*
+ * Account for a game that is not to be read, in the
+ * same way as deal_with_game would have.
+ */
+static void account_for_unread_game(StateInfo *globals, IndexedMatch match) {
+  globals->num_games_processed++;
+  if (match == INDEXED_MATCH &&
+      globals->num_games_processed >= globals->first_game_number) {
+    globals->num_games_matched++;
+    if (globals->matching_game_numbers != NULL &&
+        !in_game_number_range(globals->num_games_matched,
+                              globals->next_game_number_to_output)) {
+      /* Not in the range to be output. */
+    } else if (globals->skip_game_numbers != NULL &&
+               in_game_number_range(globals->num_games_matched,
+                                    globals->next_game_number_to_skip) &&
+               globals->num_games_matched ==
+                   globals->next_game_number_to_skip->max) {
+      globals->next_game_number_to_skip =
+          globals->next_game_number_to_skip->next;
+    }
+    if (globals->matching_game_numbers != NULL &&
+        in_game_number_range(globals->num_games_matched,
+                             globals->next_game_number_to_output) &&
+        globals->num_games_matched ==
+            globals->next_game_number_to_output->max) {
+      globals->next_game_number_to_output =
+          globals->next_game_number_to_output->next;
+    }
+  }
+}
+
+/*
+ * A game is about to be parsed. If the current input file has an
+ * index and only a selection of games by number, or games containing
+ * particular positions, tag values or material, is wanted, use the
+ * index to move the input past any games that would not be output.
+ * Return true if the input has been repositioned.
+ */
+static bool skip_unwanted_games(StateInfo *globals, GameHeader *game_header) {
+  IndexedMatch match;
+  bool skipped = false;
+  bool selecting_by_number = globals->first_game_number > 1 ||
+                             globals->matching_game_numbers != NULL ||
+                             globals->skip_game_numbers != NULL;
+
+  if (globals->current_file_type != NORMALFILE || globals->parsing_ECO_file ||
+      !(selecting_by_number || globals->positional_variations ||
+        globals->check_tags || material_criteria_present())) {
+    return false;
+  }
+  /* Every game must be seen for these. */
+  if (globals->non_matching_file != NULL || globals->suppress_duplicates ||
+      globals->suppress_originals || globals->duplicate_file != NULL ||
+      globals->delete_same_setup) {
+    return false;
+  }
+  /* This must be called for every game to keep the index in step. */
+  if (!indexed_game_at_start(globals, &match)) {
+    return false;
+  }
+  if (!selecting_by_number && !indexed_candidates_present()) {
+    return false;
+  }
+  while (!finished_processing(globals) && indexed_game_skippable() &&
+         !indexed_game_wanted(globals, match)) {
+    account_for_unread_game(globals, match);
+    skipped = true;
+    if (!next_indexed_game(globals, &match)) {
+      break;
+    }
+  }
+  if (skipped) {
+    seek_to_indexed_game(globals, game_header);
+  }
+  return skipped;
+}
+
 static void parse_opt_game_list(StateInfo *globals, GameHeader *game_header,
                                 SourceFileType file_type) {
   Move *move_list = NULL;
@@ -310,10 +461,18 @@ static void parse_opt_game_list(StateInfo *globals, GameHeader *game_header,
 
   while (parse_game(globals, game_header, &move_list, &start_line, &end_line) &&
          !finished_processing(globals)) {
-    if (file_type == NORMALFILE) {
-      deal_with_game(globals, game_header, move_list, start_line, end_line);
-    } else if (file_type == CHECKFILE) {
+    if (file_type == NORMALFILE || file_type == CHECKFILE) {
+      /* NB: CHECKFILEs may be followed by NORMALFILEs. */
+      unsigned long num_games_matched = globals->num_games_matched;
+
       deal_with_game(globals, game_header, move_list, start_line, end_line);
+      if (globals->build_index) {
+        record_indexed_game(globals,
+                            globals->num_games_matched != num_games_matched);
+      }
+      if (file_type == NORMALFILE && globals->checkpoint_file != NULL) {
+        note_game_for_checkpoint(globals);
+      }
     } else if (file_type == ECOFILE) {
       if (move_list != NULL) {
         deal_with_ECO_line(globals, game_header, move_list);
@@ -323,7 +482,7 @@ static void parse_opt_game_list(StateInfo *globals, GameHeader *game_header,
       }
     } else {
       /* Unknown type. */
-      free_tags(game_header);
+      free_tags(globals, game_header);
       free_move_list(game_header, move_list);
     }
     move_list = NULL;
@@ -334,6 +493,20 @@ static void parse_opt_game_list(StateInfo *globals, GameHeader *game_header,
   }
 }
 
+/* Whether the current input file has been noted in the duplicate file,
+ * for a checkpoint.
+ */
+bool duplicate_file_notes_current_file(const StateInfo *globals) {
+  return last_duplicate_input_file != NULL &&
+         last_duplicate_input_file == globals->current_input_file;
+}
+
+/* Restore the state saved by duplicate_file_notes_current_file. */
+void set_duplicate_file_notes_current_file(const StateInfo *globals,
+                                           bool noted) {
+  last_duplicate_input_file = noted ? globals->current_input_file : NULL;
+}
+
 /* Parse a game and return a pointer to any valid list of moves
  * in returned_move_list.
  */
@@ -353,6 +526,38 @@ parse_game(StateInfo *globals, GameHeader *game_header,
   *returned_move_list = NULL;
   /* Skip over any junk between games. */
   current_symbol = skip_to_next_game(globals, game_header, current_symbol);
+  if (current_symbol == BINARY_GAME) {
+    /* Games in binary files are read whole and are not indexed. */
+    if (globals->slow_games_to_report > 0) {
+      start_game_cost();
+    }
+    *returned_move_list =
+        next_binary_game(globals, game_header, start_line, end_line);
+    current_symbol = NO_TOKEN;
+    return true;
+  }
+  if (current_symbol != EOF_TOKEN) {
+    start_cached_game();
+  }
+  if (globals->build_index) {
+    while (current_symbol != EOF_TOKEN &&
+           globals->current_file_type == NORMALFILE &&
+           !globals->parsing_ECO_file &&
+           note_game_start(globals, game_header)) {
+      /* The input has moved on past the games already indexed. */
+      current_symbol = skip_to_next_game(globals, game_header, NO_TOKEN);
+    }
+  } else if (!game_cache_being_built()) {
+    /* Games are not skipped while the whole file is being cached. */
+    while (current_symbol != EOF_TOKEN &&
+           skip_unwanted_games(globals, game_header)) {
+      /* The input is now at the start of a later game. */
+      current_symbol = skip_to_next_game(globals, game_header, NO_TOKEN);
+    }
+  }
+  if (globals->slow_games_to_report > 0) {
+    start_game_cost();
+  }
   prefix_comment = parse_opt_comment_list(globals, game_header);
   if (prefix_comment != NULL) {
     /* Free this here, as it is hard to
@@ -405,6 +610,7 @@ parse_game(StateInfo *globals, GameHeader *game_header,
     } else {
       fprintf(globals->logfile, "Missing result.\n");
       report_details(game_header, globals->logfile);
+      note_cache_diagnostic();
     }
     /* something_found = true; */
   } else {
@@ -424,6 +630,10 @@ parse_game(StateInfo *globals, GameHeader *game_header,
     }
     *returned_move_list = NULL;
   }
+  if (current_symbol != EOF_TOKEN) {
+    cache_parsed_game(globals, game_header, *returned_move_list, *start_line,
+                      *end_line);
+  }
   return current_symbol != EOF_TOKEN;
 }
 
@@ -463,15 +673,15 @@ static bool chess960_setup(Board *board) {
     Piece white_pawn = MAKE_COLOURED_PIECE(WHITE, PAWN);
     Piece black_pawn = MAKE_COLOURED_PIECE(BLACK, PAWN);
     for (int c = ColConvert('a'); c <= ColConvert('h') && probable; c++) {
-      probable = board->board[white_r][c] == white_pawn &&
-                 board->board[black_r][c] == black_pawn;
+      probable = BOARD_SQUARE(board, white_r, c) == white_pawn &&
+                 BOARD_SQUARE(board, black_r, c) == black_pawn;
       /* Make sure the back rank is full and identical pieces
        * are opposite each other.
        */
       if (probable) {
-        probable = board->board[white_r - 1][c] != EMPTY &&
-                   EXTRACT_PIECE(board->board[white_r - 1][c]) ==
-                       EXTRACT_PIECE(board->board[black_r + 1][c]);
+        probable = BOARD_SQUARE(board, white_r - 1, c) != EMPTY &&
+                   EXTRACT_PIECE(BOARD_SQUARE(board, white_r - 1, c)) ==
+                       EXTRACT_PIECE(BOARD_SQUARE(board, black_r + 1, c));
       }
     }
     if (probable) {
@@ -480,14 +690,14 @@ static bool chess960_setup(Board *board) {
        * pieces are identically paired.
        */
       white_r = RankConvert('1');
-      probable = board->board[white_r][ColConvert('a')] != W(ROOK) ||
-                 board->board[white_r][ColConvert('b')] != W(KNIGHT) ||
-                 board->board[white_r][ColConvert('c')] != W(BISHOP) ||
-                 board->board[white_r][ColConvert('d')] != W(QUEEN) ||
-                 board->board[white_r][ColConvert('e')] != W(KING) ||
-                 board->board[white_r][ColConvert('f')] != W(BISHOP) ||
-                 board->board[white_r][ColConvert('g')] != W(KNIGHT) ||
-                 board->board[white_r][ColConvert('h')] != W(ROOK);
+      probable = BOARD_SQUARE(board, white_r, ColConvert('a')) != W(ROOK) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('b')) != W(KNIGHT) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('c')) != W(BISHOP) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('d')) != W(QUEEN) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('e')) != W(KING) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('f')) != W(BISHOP) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('g')) != W(KNIGHT) ||
+                 BOARD_SQUARE(board, white_r, ColConvert('h')) != W(ROOK);
     }
     return probable;
   } else {
@@ -505,8 +715,8 @@ bool parse_tag(StateInfo *globals, GameHeader *game_header) {
     if (current_symbol == STRING) {
       char *tag_string = yylval.token_string;
 
-      if (tag_index < game_header->header_tags_length) {
-        game_header->Tags[tag_index] = tag_string;
+      if (tag_index < number_of_tags()) {
+        set_game_tag(globals, game_header, tag_index, tag_string);
       } else {
         print_error_context(globals, globals->logfile);
         fprintf(globals->logfile,
@@ -653,7 +863,7 @@ bool parse_opt_move_number(StateInfo *globals, GameHeader *game_header) {
 static void parse_opt_NAG_list(StateInfo *globals, GameHeader *game_header,
                                Move *move_details) {
   while (current_symbol == NAG) {
-    Nag *details = (Nag *)malloc_or_die(sizeof(*details));
+    Nag *details = (Nag *)malloc_for(MEMORY_MOVE, sizeof(*details));
     details->text = NULL;
     details->comments = NULL;
     details->next = NULL;
@@ -699,7 +909,7 @@ static Variation *parse_variant(StateInfo *globals, GameHeader *game_header) {
     Move *moves;
 
     RAV_level++;
-    variation = (Variation *)malloc_or_die(sizeof(Variation));
+    variation = (Variation *)malloc_for(MEMORY_MOVE, sizeof(Variation));
 
     current_symbol = next_token(globals, game_header);
     prefix_comment = parse_opt_comment_list(globals, game_header);
@@ -776,16 +986,22 @@ static void setup_for_new_game(void) {
   RAV_level = 0;
 }
 
-/* Discard any data held in the game_header->Tags structure. */
-static void free_tags(GameHeader *game_header) {
+/* Discard any data held in the game_header->Tags structure
+ * and its extra_tags.
+ */
+static void free_tags(const StateInfo *globals, GameHeader *game_header) {
   unsigned tag;
 
-  for (tag = 0; tag < game_header->header_tags_length; tag++) {
+  for (tag = 0; tag < ORIGINAL_NUMBER_OF_TAGS; tag++) {
     if (game_header->Tags[tag] != NULL) {
-      free(game_header->Tags[tag]);
+      release_tag_value(globals, tag, game_header->Tags[tag]);
       game_header->Tags[tag] = NULL;
     }
   }
+  for (tag = 0; tag < game_header->num_extra_tags; tag++) {
+    free(game_header->extra_tags[tag].value);
+  }
+  game_header->num_extra_tags = 0;
 }
 
 /* Discard data from a gathered game. */
@@ -854,12 +1070,9 @@ void free_move_list(GameHeader *game_header, Move *move_list) {
     free_comment_list(game_header, nextMove->comment_list);
     free_variation(game_header, nextMove->Variants);
 
-    if (nextMove->epd != NULL) {
-      (void)free((void *)nextMove->epd);
-    }
-    if (nextMove->fen_suffix != NULL) {
-      (void)free((void *)nextMove->fen_suffix);
-      nextMove->fen_suffix = NULL;
+    if (nextMove->annotations != NULL) {
+      /* Its strings are held in the same allocation. */
+      (void)free((void *)nextMove->annotations);
     }
     if (nextMove->terminating_result != NULL) {
       (void)free((void *)nextMove->terminating_result);
@@ -876,7 +1089,7 @@ StringList *save_string_list_item(StringList *list, const char *str) {
   if (str != NULL && *str != '\0') {
     StringList *new_item;
 
-    new_item = (StringList *)malloc_or_die(sizeof(*new_item));
+    new_item = (StringList *)malloc_for(MEMORY_COMMENT, sizeof(*new_item));
     new_item->str = str;
     new_item->next = NULL;
     if (list == NULL) {
@@ -1034,7 +1247,8 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
 
   /* Fill in the information currently known. */
   current_game.tags = game_header->Tags;
-  current_game.tags_length = game_header->header_tags_length;
+  current_game.extra_tags = game_header->extra_tags;
+  current_game.num_extra_tags = game_header->num_extra_tags;
   current_game.prefix_comment = game_header->prefix_comment;
   current_game.moves = move_list;
   current_game.moves_checked = false;
@@ -1043,6 +1257,9 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
   current_game.position_counts = NULL;
   current_game.start_line = start_line;
   current_game.end_line = end_line;
+  if (globals->build_index) {
+    index_tags(current_game.tags);
+  }
 
   /* Determine whether or not this game is wanted, on the
    * basis of the various selection criteria available.
@@ -1067,8 +1284,7 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
    * been checked.
    */
   if (consistent_FEN_tags(globals, game_header, &current_game) &&
-      check_tag_details_not_ECO(globals, current_game.tags,
-                                current_game.tags_length, true) &&
+      check_tag_details_not_ECO(globals, &current_game, true) &&
       check_setup_tag(globals, current_game.tags) &&
       check_duplicate_setup(globals, game_header, &current_game) &&
       apply_move_list(globals, game_header, &current_game, &plycount,
@@ -1126,10 +1342,8 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
 
         /* See if we wish to separate out duplicates. */
         if ((original_filename != NULL) && (globals->duplicate_file != NULL)) {
-          static const char *last_input_file = NULL;
-
           outputfile = globals->duplicate_file;
-          if ((last_input_file != globals->current_input_file) &&
+          if ((last_duplicate_input_file != globals->current_input_file) &&
               (globals->current_input_file != NULL)) {
             if (globals->keep_comments) {
               /* Record which file this and succeeding
@@ -1141,7 +1355,7 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
               print_str(globals, game_header, outputfile, " }");
               terminate_line(globals, outputfile);
             }
-            last_input_file = globals->current_input_file;
+            last_duplicate_input_file = globals->current_input_file;
           }
           if (globals->keep_comments) {
             print_str(globals, game_header, outputfile, "{ First found in: ");
@@ -1193,6 +1407,9 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
           globals->next_game_number_to_output->next;
     }
   }
+  note_game_memory_use();
+  record_game_cost(globals, &current_game);
+  note_cached_game_checked(current_game.moves_checked);
 
   /* Game is finished with, so free everything. */
   if (game_header->prefix_comment != NULL) {
@@ -1203,16 +1420,13 @@ static void deal_with_game(StateInfo *globals, GameHeader *game_header,
    */
   game_header->prefix_comment = NULL;
 
-  free_tags(game_header);
+  free_tags(globals, game_header);
   free_move_list(game_header, current_game.moves);
   if (current_game.position_counts != NULL) {
     free_position_count_list(current_game.position_counts);
     current_game.position_counts = NULL;
   }
-  if (globals->verbosity != 0 &&
-      (globals->num_games_processed % PROGRESS_RATE) == 0) {
-    fprintf(stderr, "Games: %lu\r", globals->num_games_processed);
-  }
+  note_progress(globals);
 }
 
 /*
@@ -1349,7 +1563,8 @@ static void deal_with_ECO_line(const StateInfo *globals,
 
   /* Fill in the information currently known. */
   current_game.tags = game_header->Tags;
-  current_game.tags_length = game_header->header_tags_length;
+  current_game.extra_tags = game_header->extra_tags;
+  current_game.num_extra_tags = game_header->num_extra_tags;
   current_game.prefix_comment = game_header->prefix_comment;
   current_game.moves = move_list;
   current_game.moves_checked = false;
@@ -1379,7 +1594,7 @@ static void deal_with_ECO_line(const StateInfo *globals,
    */
   game_header->prefix_comment = NULL;
 
-  free_tags(game_header);
+  free_tags(globals, game_header);
   free_move_list(game_header, current_game.moves);
 }
 
@@ -28,15 +28,17 @@ int yyparse(StateInfo *globals, GameHeader *game_header,
             SourceFileType file_type);
 void free_string_list(StringList *list);
 GameHeader new_game_header();
-void increase_game_header_tags_length(const StateInfo *globals,
-                                      GameHeader *game_header,
-                                      unsigned new_length);
 void report_details(GameHeader *game_header, FILE *outfp);
 void append_comments_to_move(GameHeader *game_header, Move *move,
                              CommentList *Comment);
 /* The following function is used for linking list items together. */
 StringList *save_string_list_item(StringList *list, const char *str);
 void free_comment_list(GameHeader *game_header, CommentList *comment_list);
+bool duplicate_file_notes_current_file(const StateInfo *globals);
+void set_duplicate_file_notes_current_file(const StateInfo *globals,
+                                           bool noted);
+void set_game_tag(const StateInfo *globals, GameHeader *game_header,
+                  unsigned tag, char *value);
 
 /* Provide access to the global state that has been set
  * through command line arguments.
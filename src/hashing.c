@@ -24,6 +24,7 @@
 #include "defs.h"
 #include "lex.h"
 #include "mymalloc.h"
+#include "postings.h"
 #include "taglist.h"
 #include "typedef.h"
 #include "zobrist.h"
@@ -213,7 +214,8 @@ void free_position_count_list(PositionCount *position_counts) {
  * This will have a single entry at its head.
  */
 PositionCount *new_position_count_list(const Board *board) {
-  PositionCount *head = (PositionCount *)malloc_or_die(sizeof(*head));
+  PositionCount *head =
+      (PositionCount *)malloc_for(MEMORY_HASH, sizeof(*head));
   head->hash_value = board->weak_hash_value;
   head->to_move = board->to_move;
   head->castling_rights = encode_castling_rights(board);
@@ -236,7 +238,8 @@ PositionCount *copy_position_count_list(PositionCount *original) {
   PositionCount *copy = NULL;
   PositionCount *tail = NULL;
   while (original != NULL) {
-    PositionCount *entry = (PositionCount *)malloc_or_die(sizeof(*entry));
+    PositionCount *entry =
+        (PositionCount *)malloc_for(MEMORY_HASH, sizeof(*entry));
     entry->hash_value = original->hash_value;
     entry->to_move = original->to_move;
     entry->castling_rights = original->castling_rights;
@@ -261,8 +264,8 @@ void init_duplicate_hash_table(const StateInfo *globals) {
   int i;
 
   if (globals->use_virtual_hash_table) {
-    VirtualLogTable = (LogHeaderEntry *)malloc_or_die(LOG_TABLE_SIZE *
-                                                      sizeof(*VirtualLogTable));
+    VirtualLogTable = (LogHeaderEntry *)malloc_for(
+        MEMORY_HASH, LOG_TABLE_SIZE * sizeof(*VirtualLogTable));
     for (i = 0; i < LOG_TABLE_SIZE; i++) {
       VirtualLogTable[i].head = VirtualLogTable[i].tail = -1;
     }
@@ -271,7 +274,8 @@ void init_duplicate_hash_table(const StateInfo *globals) {
       fprintf(globals->logfile, "Unable to open %s\n", VIRTUAL_FILE);
     }
   } else {
-    LogTable = (HashLog **)malloc_or_die(LOG_TABLE_SIZE * sizeof(*LogTable));
+    LogTable = (HashLog **)malloc_for(MEMORY_HASH,
+                                      LOG_TABLE_SIZE * sizeof(*LogTable));
     for (i = 0; i < LOG_TABLE_SIZE; i++) {
       LogTable[i] = NULL;
     }
@@ -471,7 +475,7 @@ const char *previous_occurance(const StateInfo *globals, Game game_details,
 
       if (!duplicate) {
         /* First occurrence, so add it to the log. */
-        entry = (HashLog *)malloc_or_die(sizeof(*entry));
+        entry = (HashLog *)malloc_for(MEMORY_HASH, sizeof(*entry));
 
         if (!globals->fuzzy_match_duplicates) {
           /* Store the two hash values. */
@@ -537,7 +541,7 @@ bool check_duplicate_setup(const StateInfo *globals, GameHeader *game_header,
       if (found) {
         keep = false;
       } else {
-        HashLog *entry = (HashLog *)malloc_or_die(sizeof(*entry));
+        HashLog *entry = (HashLog *)malloc_for(MEMORY_HASH, sizeof(*entry));
         /* We don't include the cumulative hash value as this
          * is the starting position.
          */
@@ -555,3 +559,85 @@ bool check_duplicate_setup(const StateInfo *globals, GameHeader *game_header,
   }
   return keep;
 }
+
+/* Marks the end of the entries of a table in a checkpoint. */
+#define END_OF_TABLE 0xffffffff
+
+/* Write the non-empty lists of table to fp, in order. */
+static void save_hash_table(FILE *fp, HashLog **table, unsigned size) {
+  for (unsigned ix = 0; ix < size; ix++) {
+    if (table[ix] != NULL) {
+      unsigned count = 0;
+
+      for (const HashLog *entry = table[ix]; entry != NULL;
+           entry = entry->next) {
+        count++;
+      }
+      write_fixed(fp, 4, ix);
+      write_fixed(fp, 4, count);
+      for (const HashLog *entry = table[ix]; entry != NULL;
+           entry = entry->next) {
+        write_fixed(fp, 8, entry->final_hash_value);
+        write_fixed(fp, 8, entry->cumulative_hash_value);
+        write_fixed(fp, 4, entry->file_number);
+      }
+    }
+  }
+  write_fixed(fp, 4, END_OF_TABLE);
+}
+
+/* Read the lists of table written by save_hash_table. */
+static bool restore_hash_table(FILE *fp, HashLog **table, unsigned size) {
+  unsigned long ix, count, value, final_hash_value, cumulative_hash_value;
+
+  while (read_fixed(fp, 4, &ix) && ix != END_OF_TABLE) {
+    HashLog **tail;
+
+    if (ix >= size || table[ix] != NULL || !read_fixed(fp, 4, &count)) {
+      return false;
+    }
+    tail = &table[ix];
+    for (; count > 0; count--) {
+      HashLog *entry = (HashLog *)malloc_for(MEMORY_HASH, sizeof(*entry));
+
+      entry->next = NULL;
+      *tail = entry;
+      tail = &entry->next;
+      if (!read_fixed(fp, 8, &final_hash_value) ||
+          !read_fixed(fp, 8, &cumulative_hash_value) ||
+          !read_fixed(fp, 4, &value)) {
+        return false;
+      }
+      entry->final_hash_value = final_hash_value;
+      entry->cumulative_hash_value = cumulative_hash_value;
+      entry->file_number = (unsigned)value;
+    }
+  }
+  return ix == END_OF_TABLE;
+}
+
+/* Write the tables of duplicate games and starting positions to fp,
+ * for a checkpoint (--checkpoint).
+ * The virtual hash table is not saved.
+ */
+void save_hash_tables(FILE *fp) {
+  save_hash_table(fp, LogTable, LogTable != NULL ? LOG_TABLE_SIZE : 0);
+  save_hash_table(fp, polyglot_codes_of_interest, SETUP_TABLE_SIZE);
+  putc(standard_start_seen ? 1 : 0, fp);
+}
+
+/* Read the tables written by save_hash_tables into the empty tables
+ * (--resume). Return false if fp does not hold valid tables.
+ */
+bool restore_hash_tables(FILE *fp) {
+  unsigned log_table_size = LogTable != NULL ? LOG_TABLE_SIZE : 0;
+  int seen;
+
+  if (!restore_hash_table(fp, LogTable, log_table_size) ||
+      !restore_hash_table(fp, polyglot_codes_of_interest, SETUP_TABLE_SIZE) ||
+      (seen = getc(fp)) == EOF) {
+    return false;
+  }
+  standard_start_seen = seen != 0;
+  return true;
+}
@@ -29,6 +29,7 @@
 #include "typedef.h"
 
 #include <stdbool.h>
+#include <stdio.h>
 
 typedef struct HashLog {
   /* Store both the final position hash value and
@@ -66,6 +67,8 @@ void init_duplicate_hash_table(const StateInfo *globals);
 PositionCount *new_position_count_list(const Board *board);
 const char *previous_occurance(const StateInfo *globals, Game game_details,
                                unsigned plycount);
+bool restore_hash_tables(FILE *fp);
+void save_hash_tables(FILE *fp);
 unsigned update_position_counts(PositionCount *position_counts,
                                 const Board *board);
 
@@ -0,0 +1,265 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "intern.h"
+
+#include "mymalloc.h"
+#include "taglist.h"
+#include "typedef.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The state of the match of a value against the tag criteria. */
+#define MATCH_UNKNOWN (-1)
+
+/* A value held for a tag.
+ * It is allocated together with its text, and its address found
+ * from that of the text.
+ */
+typedef struct InternedValue {
+  /* The hash of text. */
+  uint64_t hash;
+  /* The number of game headers holding text. */
+  unsigned references;
+  /* Whether the value is in its tag's table.
+   * A value that is evicted while it is in use is freed when
+   * it is released.
+   */
+  bool in_table;
+  /* Whether text matches the positive [1] and negative [0]
+   * tag criteria, or MATCH_UNKNOWN.
+   */
+  signed char matches[2];
+  /* The next value in the same bucket. */
+  struct InternedValue *next;
+  /* The neighbours of the value in order of use. */
+  struct InternedValue *newer, *older;
+  char text[];
+} InternedValue;
+
+/* The values of a tag, hashed into num_buckets buckets, and
+ * listed from the most to the least recently used.
+ */
+typedef struct {
+  InternedValue **buckets;
+  uint64_t num_buckets;
+  unsigned num_values;
+  InternedValue *newest, *oldest;
+} InternTable;
+
+static InternTable *intern_tables[ORIGINAL_NUMBER_OF_TAGS];
+
+/* Return the value whose text is at text. */
+static InternedValue *value_of_text(const char *text) {
+  return (InternedValue *)(void *)(text - offsetof(InternedValue, text));
+}
+
+/* Return the FNV-1a hash of text. */
+static uint64_t hash_text(const char *text) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  for (; *text != '\0'; text++) {
+    hash = (hash ^ (unsigned char)*text) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/* Return the table of tag, creating it on its first use. */
+static InternTable *intern_table(const StateInfo *globals, TagName tag) {
+  InternTable *table = intern_tables[tag];
+
+  if (table == NULL) {
+    table = (InternTable *)malloc_for(MEMORY_TAG, sizeof(*table));
+    /* At least twice as many buckets as values. */
+    table->num_buckets = 1;
+    while (table->num_buckets < 2 * (uint64_t)globals->interned_tag_values) {
+      table->num_buckets *= 2;
+    }
+    table->buckets = (InternedValue **)malloc_for(
+        MEMORY_TAG, table->num_buckets * sizeof(*table->buckets));
+    memset(table->buckets, 0, table->num_buckets * sizeof(*table->buckets));
+    table->num_values = 0;
+    table->newest = table->oldest = NULL;
+    intern_tables[tag] = table;
+  }
+  return table;
+}
+
+/* Remove value from the order of use of table. */
+static void unlink_value(InternTable *table, InternedValue *value) {
+  if (value->newer != NULL) {
+    value->newer->older = value->older;
+  } else {
+    table->newest = value->older;
+  }
+  if (value->older != NULL) {
+    value->older->newer = value->newer;
+  } else {
+    table->oldest = value->newer;
+  }
+}
+
+/* Make value the most recently used of table. */
+static void make_newest(InternTable *table, InternedValue *value) {
+  value->newer = NULL;
+  value->older = table->newest;
+  if (table->newest != NULL) {
+    table->newest->newer = value;
+  } else {
+    table->oldest = value;
+  }
+  table->newest = value;
+}
+
+/* Remove the least recently used value of table to make room
+ * for another.
+ */
+static void evict_oldest(InternTable *table) {
+  InternedValue *value = table->oldest;
+  InternedValue **link =
+      &table->buckets[value->hash & (table->num_buckets - 1)];
+
+  while (*link != value) {
+    link = &(*link)->next;
+  }
+  *link = value->next;
+  unlink_value(table, value);
+  table->num_values--;
+  value->in_table = false;
+  if (value->references == 0) {
+    (void)free((void *)value);
+  }
+}
+
+/* Return the interned copy of value, a string allocated for tag,
+ * which is either freed or used for the copy.
+ */
+char *intern_tag_value(const StateInfo *globals, TagName tag, char *value) {
+  InternTable *table = intern_table(globals, tag);
+  uint64_t hash = hash_text(value);
+  InternedValue **bucket = &table->buckets[hash & (table->num_buckets - 1)];
+  InternedValue *interned;
+  size_t len;
+
+  for (interned = *bucket; interned != NULL; interned = interned->next) {
+    if (interned->hash == hash && strcmp(interned->text, value) == 0) {
+      (void)free((void *)value);
+      if (table->newest != interned) {
+        unlink_value(table, interned);
+        make_newest(table, interned);
+      }
+      interned->references++;
+      return interned->text;
+    }
+  }
+  if (table->num_values == globals->interned_tag_values) {
+    evict_oldest(table);
+  }
+  len = strlen(value);
+  interned =
+      (InternedValue *)malloc_for(MEMORY_TAG, sizeof(*interned) + len + 1);
+  memcpy(interned->text, value, len + 1);
+  (void)free((void *)value);
+  interned->hash = hash;
+  interned->references = 1;
+  interned->in_table = true;
+  interned->matches[0] = interned->matches[1] = MATCH_UNKNOWN;
+  interned->next = *bucket;
+  *bucket = interned;
+  make_newest(table, interned);
+  table->num_values++;
+  return interned->text;
+}
+
+/* Whether the values of tag are interned.
+ * Only tags that are never set or changed by the program are,
+ * so that all of their values in a game header are interned.
+ */
+bool interned_tag(const StateInfo *globals, TagName tag) {
+  if (globals->interned_tag_values == 0) {
+    return false;
+  }
+  switch (tag) {
+  case ANNOTATOR_TAG:
+  case BLACK_TAG:
+  case BLACK_ELO_TAG:
+  case BLACK_TITLE_TAG:
+  case BLACK_TYPE_TAG:
+  case DATE_TAG:
+  case EVENT_TAG:
+  case EVENT_DATE_TAG:
+  case EVENT_SPONSOR_TAG:
+  case MODE_TAG:
+  case ROUND_TAG:
+  case SECTION_TAG:
+  case SITE_TAG:
+  case STAGE_TAG:
+  case TERMINATION_TAG:
+  case TIME_CONTROL_TAG:
+  case UTC_DATE_TAG:
+  case WHITE_TAG:
+  case WHITE_ELO_TAG:
+  case WHITE_TITLE_TAG:
+  case WHITE_TYPE_TAG:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* Whether the match of the interned value against the positive or
+ * negative tag criteria is known and, if so, set wanted to it.
+ */
+bool known_tag_match(const char *value, bool positive_match, bool *wanted) {
+  signed char match = value_of_text(value)->matches[positive_match];
+
+  if (match == MATCH_UNKNOWN) {
+    return false;
+  } else {
+    *wanted = match != 0;
+    return true;
+  }
+}
+
+/* Keep the result of matching the interned value against the
+ * positive or negative tag criteria.
+ */
+void note_tag_match(const char *value, bool positive_match, bool wanted) {
+  value_of_text(value)->matches[positive_match] = wanted ? 1 : 0;
+}
+
+/* Release value, the value of tag in a game header. */
+void release_tag_value(const StateInfo *globals, TagName tag, char *value) {
+  if (interned_tag(globals, tag)) {
+    InternedValue *interned = value_of_text(value);
+
+    interned->references--;
+    if (interned->references == 0 && !interned->in_table) {
+      (void)free((void *)interned);
+    }
+  } else {
+    (void)free((void *)value);
+  }
+}
@@ -0,0 +1,46 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Interning of tag values (--interntags).
+ * The values of tags that are set only from the input, such as
+ * Event, Site, the players' names, TimeControl and Termination,
+ * repeat across many games. With --interntags N, each of those tags
+ * keeps a table of its N most recently seen values, so that games
+ * with the same value share a single copy of it, found by its hash.
+ * The result of matching an interned value against the tag criteria
+ * is kept with it, so that it is found once for each value rather
+ * than once for each game.
+ */
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "taglist.h"
+#include "typedef.h"
+
+#include <stdbool.h>
+
+char *intern_tag_value(const StateInfo *globals, TagName tag, char *value);
+bool interned_tag(const StateInfo *globals, TagName tag);
+bool known_tag_match(const char *value, bool positive_match, bool *wanted);
+void note_tag_match(const char *value, bool positive_match, bool wanted);
+void release_tag_value(const StateInfo *globals, TagName tag, char *value);
+
+#endif // INTERN_H
@@ -21,8 +21,12 @@
 
 #include "lex.h"
 
+#include "binary.h"
+#include "bytescan.h"
+#include "compression.h"
 #include "decode.h"
 #include "defs.h"
+#include "gamecache.h"
 #include "grammar.h"
 #include "lines.h"
 #include "mymalloc.h"
@@ -34,6 +38,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #if defined(__BORLANDC__) || defined(_MSC_VER)
 #include <io.h>
 #ifndef R_OK
@@ -47,9 +52,8 @@
 static bool extract_yytext(const StateInfo *globals,
                            const unsigned char *symbol_start,
                            const unsigned char *linep);
-static int identify_tag(const char *tag_string);
-static TagName make_new_tag(const StateInfo *globals, GameHeader *game_header,
-                            const char *tag);
+static int identify_tag(const char *tag_string, size_t len);
+static TagName make_new_tag(const char *tag, size_t len);
 static bool open_input(StateInfo *globals, const char *infile);
 static bool open_input_file(StateInfo *globals, int file_number);
 /* When a move is saved, what is known of its source and destination coordinates
@@ -59,10 +63,21 @@ static void save_k_castle(const StateInfo *globals);
 static void save_move(const StateInfo *globals, const unsigned char *move);
 static void save_q_castle(const StateInfo *globals);
 static void save_string(const char *result);
-static void terminate_input(void);
+static void save_text(const unsigned char *text, size_t len);
+static void terminate_input(const StateInfo *globals);
 
 static unsigned long line_number = 0;
 static unsigned long line_position = 0;
+/* The byte offset within the input file of the start of the current line. */
+static unsigned long line_start_offset = 0;
+/* The line currently being tokenised by get_next_symbol, and the
+ * next character in it to be examined.
+ * These are at file scope so that seek_input_position can reposition them.
+ */
+static char *current_line = NULL;
+static unsigned char *current_linep = NULL;
+/* Where the most recent symbol started within current_line. */
+static unsigned long symbol_start_position = 0;
 /* Keep track of the Recursive Annotation Variation level. */
 static unsigned RAV_level = 0;
 /* Keep track of the last move found. */
@@ -74,6 +89,10 @@ static unsigned games_in_file = 0;
  * This is intialised in init_lex_tables.
  */
 static FILE *yyin = NULL;
+/* Whether yyin is a binary game file rather than PGN. */
+static bool binary_input = false;
+/* The decompressed contents of yyin, if it is compressed. */
+static DecompressedInput *decompressed_input = NULL;
 
 /* Define space for holding matched tokens. */
 #define MAX_YYTEXT 100
@@ -87,6 +106,77 @@ static TokenType ChTab[MAX_CHAR];
 /* A boolean array as to whether a character is allowed in a move or not. */
 static short MoveChars[MAX_CHAR];
 
+/* The states of the DFA with which get_next_symbol recognises the
+ * symbols that make up most of the move text: moves, move numbers,
+ * results, NAGs and annotations, check symbols and runs of white
+ * space and dots.
+ * Each is recognised whole with one table lookup per character.
+ * Other symbols, such as tags, strings and comments, and anything
+ * that the DFA does not accept, are dealt with by way of ChTab.
+ */
+typedef enum {
+  SCAN_DEAD,
+  SCAN_START,
+  SCAN_WHITESPACE,
+  SCAN_DOTS,
+  SCAN_CHECK,
+  SCAN_ANNOTATION,
+  SCAN_NAG,
+  SCAN_MOVE,
+  /* Z0 and -- are null moves. */
+  SCAN_Z,
+  SCAN_DASH,
+  SCAN_NULL_MOVE,
+  /* 0 can start 0-1, 0-0 and 0-0-0. */
+  SCAN_ZERO,
+  SCAN_ZERO_DASH,
+  SCAN_BLACK_WINS,
+  SCAN_KING_CASTLE,
+  SCAN_KING_CASTLE_DASH,
+  SCAN_QUEEN_CASTLE,
+  /* 1 can start 1-0, 1/2 and 1/2-1/2. */
+  SCAN_ONE,
+  SCAN_ONE_DASH,
+  SCAN_WHITE_WINS,
+  SCAN_ONE_SLASH,
+  SCAN_HALF,
+  SCAN_HALF_DASH,
+  SCAN_HALF_DASH_ONE,
+  SCAN_HALF_DASH_ONE_SLASH,
+  SCAN_DRAW,
+  SCAN_NUMBER,
+  SCAN_NUMBER_DOTS,
+  NUM_SCAN_STATES
+} ScanState;
+
+/* The kinds of symbol recognised by the accepting states of the DFA. */
+typedef enum {
+  SCANNED_NOTHING,
+  SCANNED_WHITESPACE,
+  SCANNED_DOTS,
+  SCANNED_CHECK,
+  SCANNED_ANNOTATION,
+  SCANNED_NAG,
+  SCANNED_MOVE,
+  SCANNED_NULL_MOVE,
+  SCANNED_MOVE_NUMBER,
+  SCANNED_WHITE_WINS,
+  SCANNED_BLACK_WINS,
+  SCANNED_DRAW,
+  SCANNED_KING_CASTLE,
+  SCANNED_QUEEN_CASTLE
+} ScannedSymbol;
+
+/* The most classes of character that the DFA distinguishes. */
+#define MAX_SCAN_CLASSES 64
+/* The class of each character, for ScanTransitions.
+ * Characters in the same class have the same transitions.
+ */
+static unsigned char ScanClass[MAX_CHAR];
+static unsigned char ScanTransitions[NUM_SCAN_STATES][MAX_SCAN_CLASSES];
+/* The symbol recognised on reaching each state. */
+static ScannedSymbol ScanAccepts[NUM_SCAN_STATES];
+
 /* Define a table to hold the list of tag strings.
  * This is initialised in init_list_of_known_tags().
  * As new tags are encountered, the list is expanded,
@@ -94,6 +184,23 @@ static short MoveChars[MAX_CHAR];
  */
 static const char **TagList;
 static unsigned tag_list_length = 0;
+/* The original tags are found through a perfect hash of their names
+ * into KnownTagSlots, whose seed is chosen by init_known_tag_slots so
+ * that no two of them share a slot.
+ * Each slot holds the _TAG value of its tag, or NO_TAG.
+ */
+#define KNOWN_TAG_SLOTS 256
+#define NO_TAG (-1)
+static int KnownTagSlots[KNOWN_TAG_SLOTS];
+static unsigned known_tag_seed = 0;
+/* The tags added to TagList are found through a hash table with
+ * linear probing, which is doubled in size when half full.
+ * Each slot holds the index of its tag in TagList, or NO_TAG.
+ */
+#define INITIAL_NEW_TAG_SLOTS 64
+static int *NewTagSlots = NULL;
+static unsigned new_tag_slots = 0;
+static unsigned new_tags = 0;
 /* Which tags, if any, are to be suppressed in the output.
  * The indices are the same as for TagList.
  */
@@ -101,16 +208,90 @@ static bool *suppressed_tags;
 /* Nested comment depth: globals->allow_nested_comments. */
 static unsigned comment_depth = 0;
 
+/* The hash of the len characters of the tag name tag_string. */
+static unsigned tag_name_hash(const char *tag_string, size_t len,
+                              unsigned seed) {
+  /* FNV-1a. */
+  unsigned hash = 2166136261u ^ seed;
+
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (unsigned char)tag_string[i]) * 16777619u;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/* Whether the tag name tag_string of len characters is tag. */
+static bool is_tag_name(const char *tag, const char *tag_string, size_t len) {
+  return strncmp(tag, tag_string, len) == 0 && tag[len] == '\0';
+}
+
+/* Find a seed for the hash of the original tags under which
+ * each has a different slot in KnownTagSlots.
+ */
+static void init_known_tag_slots(void) {
+  bool collision;
+
+  do {
+    collision = false;
+    for (unsigned slot = 0; slot < KNOWN_TAG_SLOTS; slot++) {
+      KnownTagSlots[slot] = NO_TAG;
+    }
+    for (int tag = 0; tag < ORIGINAL_NUMBER_OF_TAGS && !collision; tag++) {
+      unsigned slot = tag_name_hash(TagList[tag], strlen(TagList[tag]),
+                                    known_tag_seed) %
+                      KNOWN_TAG_SLOTS;
+
+      if (KnownTagSlots[slot] == NO_TAG) {
+        KnownTagSlots[slot] = tag;
+      } else {
+        collision = true;
+        known_tag_seed++;
+      }
+    }
+  } while (collision);
+}
+
+/* Enter tag_index, of a tag added to TagList, in NewTagSlots. */
+static void add_new_tag_slot(unsigned tag_index) {
+  const char *tag = TagList[tag_index];
+  unsigned slot = tag_name_hash(tag, strlen(tag), known_tag_seed) &
+                  (new_tag_slots - 1);
+
+  while (NewTagSlots[slot] != NO_TAG) {
+    slot = (slot + 1) & (new_tag_slots - 1);
+  }
+  NewTagSlots[slot] = tag_index;
+}
+
+/* Make room in NewTagSlots for another tag. */
+static void grow_new_tag_slots(void) {
+  if (2 * (new_tags + 1) > new_tag_slots) {
+    new_tag_slots =
+        new_tag_slots == 0 ? INITIAL_NEW_TAG_SLOTS : 2 * new_tag_slots;
+    (void)free((void *)NewTagSlots);
+    NewTagSlots = (int *)malloc_for(MEMORY_TAG,
+                                    new_tag_slots * sizeof(*NewTagSlots));
+    for (unsigned slot = 0; slot < new_tag_slots; slot++) {
+      NewTagSlots[slot] = NO_TAG;
+    }
+    for (unsigned tag = ORIGINAL_NUMBER_OF_TAGS; tag < tag_list_length;
+         tag++) {
+      add_new_tag_slot(tag);
+    }
+  }
+}
+
 /* Initialise the TagList. This should be stored in alphabetical order,
  * by virtue of the order in which the _TAG values are defined.
  */
 static void init_list_of_known_tags(void) {
   unsigned i;
   tag_list_length = ORIGINAL_NUMBER_OF_TAGS;
-  TagList = (const char **)malloc_or_die(tag_list_length * sizeof(*TagList));
+  TagList = (const char **)malloc_for(MEMORY_TAG,
+                                       tag_list_length * sizeof(*TagList));
   /* false by default. */
-  suppressed_tags =
-      (bool *)malloc_or_die(tag_list_length * sizeof(*suppressed_tags));
+  suppressed_tags = (bool *)malloc_for(
+      MEMORY_TAG, tag_list_length * sizeof(*suppressed_tags));
   /* Be paranoid and put a string in every entry. */
   for (i = 0; i < tag_list_length; i++) {
     TagList[i] = "";
@@ -164,26 +345,32 @@ static void init_list_of_known_tags(void) {
   TagList[WHITE_TITLE_TAG] = "WhiteTitle";
   TagList[WHITE_TYPE_TAG] = "WhiteType";
   TagList[WHITE_USCF_TAG] = "WhiteUSCF";
+  init_known_tag_slots();
 }
 
 /* Extend TagList to accomodate a new tag string.
  * Return the current value of tag_list_length as its
  * index, having incremented its value.
  */
-static TagName make_new_tag(const StateInfo *globals, GameHeader *game_header,
-                            const char *tag) {
+static TagName make_new_tag(const char *tag, size_t len) {
   unsigned tag_index = tag_list_length;
+  char *tag_string = (char *)malloc_for(MEMORY_TAG, len + 1);
+
+  memcpy(tag_string, tag, len);
+  tag_string[len] = '\0';
+  grow_new_tag_slots();
   tag_list_length++;
-  TagList = (const char **)realloc_or_die((void *)TagList,
-                                          tag_list_length * sizeof(*TagList));
-  suppressed_tags = (bool *)realloc_or_die(
-      (void *)suppressed_tags, tag_list_length * sizeof(*suppressed_tags));
-  TagList[tag_index] = copy_string(tag);
+  TagList = (const char **)realloc_for(MEMORY_TAG, (void *)TagList,
+                                       tag_index * sizeof(*TagList),
+                                       tag_list_length * sizeof(*TagList));
+  suppressed_tags = (bool *)realloc_for(
+      MEMORY_TAG, (void *)suppressed_tags,
+      tag_index * sizeof(*suppressed_tags),
+      tag_list_length * sizeof(*suppressed_tags));
+  TagList[tag_index] = tag_string;
   suppressed_tags[tag_index] = false;
-  /* Ensure that the game header's tags array can accommodate
-   * the new tag.
-   */
-  increase_game_header_tags_length(globals, game_header, tag_list_length);
+  add_new_tag_slot(tag_index);
+  new_tags++;
   return tag_index;
 }
 
@@ -207,14 +394,166 @@ bool is_suppressed_tag(const StateInfo *globals, TagName tag) {
   }
 }
 
-/* Don't include the given tag on output. */
-void suppress_tag(const StateInfo *globals, GameHeader *game_header,
-                  const char *tag_string) {
-  int tag_item = identify_tag(tag_string);
+/* Return the number of tags known, which are numbered from 0. */
+unsigned number_of_tags(void) { return tag_list_length; }
+
+/* Return the _TAG value of tag_string, adding it to TagList
+ * if it is not already there.
+ */
+TagName identify_or_add_tag(const StateInfo *globals, const char *tag_string) {
+  size_t len = strlen(tag_string);
+  int tag_item = identify_tag(tag_string, len);
   if (tag_item < 0) {
-    tag_item = make_new_tag(globals, game_header, tag_string);
+    tag_item = make_new_tag(tag_string, len);
+  }
+  return tag_item;
+}
+
+/* Don't include the given tag on output. */
+void suppress_tag(const StateInfo *globals, const char *tag_string) {
+  suppressed_tags[identify_or_add_tag(globals, tag_string)] = true;
+}
+
+/* Add the transition from state from to state to on each character
+ * of chars in the transitions table of init_symbol_scanner.
+ */
+static void add_scan_transitions(unsigned char transitions[][MAX_CHAR],
+                                 ScanState from, const char *chars,
+                                 ScanState to) {
+  for (; *chars != '\0'; chars++) {
+    transitions[from][(unsigned char)*chars] = to;
+  }
+}
+
+/* Build the DFA of get_next_symbol from ChTab and MoveChars.
+ * The transitions are first defined on every character and then
+ * compressed into classes of the characters with the same transitions,
+ * of which there are only a few.
+ */
+static void init_symbol_scanner(void) {
+  static unsigned char transitions[NUM_SCAN_STATES][MAX_CHAR];
+  /* A character of each class. */
+  unsigned char class_member[MAX_SCAN_CLASSES];
+  unsigned num_classes = 0;
+
+  memset(transitions, SCAN_DEAD, sizeof(transitions));
+  for (int ch = 1; ch < MAX_CHAR; ch++) {
+    switch (ChTab[ch]) {
+    case WHITESPACE:
+      transitions[SCAN_START][ch] = SCAN_WHITESPACE;
+      transitions[SCAN_WHITESPACE][ch] = SCAN_WHITESPACE;
+      break;
+    case DOT:
+      transitions[SCAN_START][ch] = SCAN_DOTS;
+      transitions[SCAN_DOTS][ch] = SCAN_DOTS;
+      break;
+    case CHECK_SYMBOL:
+      transitions[SCAN_START][ch] = SCAN_CHECK;
+      transitions[SCAN_CHECK][ch] = SCAN_CHECK;
+      break;
+    case ANNOTATE:
+      transitions[SCAN_START][ch] = SCAN_ANNOTATION;
+      transitions[SCAN_ANNOTATION][ch] = SCAN_ANNOTATION;
+      break;
+    case ALPHA:
+      if (MoveChars[ch]) {
+        transitions[SCAN_START][ch] = SCAN_MOVE;
+      }
+      break;
+    default:
+      break;
+    }
+    if (MoveChars[ch]) {
+      transitions[SCAN_MOVE][ch] = SCAN_MOVE;
+    }
+    if (isdigit(ch)) {
+      transitions[SCAN_START][ch] = SCAN_NUMBER;
+      transitions[SCAN_NAG][ch] = SCAN_NAG;
+      transitions[SCAN_ZERO][ch] = SCAN_NUMBER;
+      transitions[SCAN_ONE][ch] = SCAN_NUMBER;
+      transitions[SCAN_NUMBER][ch] = SCAN_NUMBER;
+    }
+  }
+  add_scan_transitions(transitions, SCAN_START, "$", SCAN_NAG);
+  add_scan_transitions(transitions, SCAN_START, "Z", SCAN_Z);
+  add_scan_transitions(transitions, SCAN_Z, "0", SCAN_NULL_MOVE);
+  add_scan_transitions(transitions, SCAN_START, "-", SCAN_DASH);
+  add_scan_transitions(transitions, SCAN_DASH, "-", SCAN_NULL_MOVE);
+  /* Move numbers may be followed by dots. */
+  add_scan_transitions(transitions, SCAN_ZERO, ".", SCAN_NUMBER_DOTS);
+  add_scan_transitions(transitions, SCAN_ONE, ".", SCAN_NUMBER_DOTS);
+  add_scan_transitions(transitions, SCAN_NUMBER, ".", SCAN_NUMBER_DOTS);
+  add_scan_transitions(transitions, SCAN_NUMBER_DOTS, ".", SCAN_NUMBER_DOTS);
+  add_scan_transitions(transitions, SCAN_START, "0", SCAN_ZERO);
+  add_scan_transitions(transitions, SCAN_ZERO, "-", SCAN_ZERO_DASH);
+  add_scan_transitions(transitions, SCAN_ZERO_DASH, "1", SCAN_BLACK_WINS);
+  add_scan_transitions(transitions, SCAN_ZERO_DASH, "0", SCAN_KING_CASTLE);
+  add_scan_transitions(transitions, SCAN_KING_CASTLE, "-",
+                       SCAN_KING_CASTLE_DASH);
+  add_scan_transitions(transitions, SCAN_KING_CASTLE_DASH, "0",
+                       SCAN_QUEEN_CASTLE);
+  add_scan_transitions(transitions, SCAN_START, "1", SCAN_ONE);
+  add_scan_transitions(transitions, SCAN_ONE, "-", SCAN_ONE_DASH);
+  add_scan_transitions(transitions, SCAN_ONE_DASH, "0", SCAN_WHITE_WINS);
+  add_scan_transitions(transitions, SCAN_ONE, "/", SCAN_ONE_SLASH);
+  add_scan_transitions(transitions, SCAN_ONE_SLASH, "2", SCAN_HALF);
+  add_scan_transitions(transitions, SCAN_HALF, "-", SCAN_HALF_DASH);
+  add_scan_transitions(transitions, SCAN_HALF_DASH, "1", SCAN_HALF_DASH_ONE);
+  add_scan_transitions(transitions, SCAN_HALF_DASH_ONE, "/",
+                       SCAN_HALF_DASH_ONE_SLASH);
+  add_scan_transitions(transitions, SCAN_HALF_DASH_ONE_SLASH, "2", SCAN_DRAW);
+
+  for (int state = 0; state < NUM_SCAN_STATES; state++) {
+    ScanAccepts[state] = SCANNED_NOTHING;
+  }
+  ScanAccepts[SCAN_WHITESPACE] = SCANNED_WHITESPACE;
+  ScanAccepts[SCAN_DOTS] = SCANNED_DOTS;
+  ScanAccepts[SCAN_CHECK] = SCANNED_CHECK;
+  ScanAccepts[SCAN_ANNOTATION] = SCANNED_ANNOTATION;
+  ScanAccepts[SCAN_NAG] = SCANNED_NAG;
+  ScanAccepts[SCAN_MOVE] = SCANNED_MOVE;
+  ScanAccepts[SCAN_NULL_MOVE] = SCANNED_NULL_MOVE;
+  ScanAccepts[SCAN_ZERO] = SCANNED_MOVE_NUMBER;
+  ScanAccepts[SCAN_BLACK_WINS] = SCANNED_BLACK_WINS;
+  ScanAccepts[SCAN_KING_CASTLE] = SCANNED_KING_CASTLE;
+  ScanAccepts[SCAN_QUEEN_CASTLE] = SCANNED_QUEEN_CASTLE;
+  ScanAccepts[SCAN_ONE] = SCANNED_MOVE_NUMBER;
+  ScanAccepts[SCAN_WHITE_WINS] = SCANNED_WHITE_WINS;
+  ScanAccepts[SCAN_HALF] = SCANNED_DRAW;
+  ScanAccepts[SCAN_DRAW] = SCANNED_DRAW;
+  ScanAccepts[SCAN_NUMBER] = SCANNED_MOVE_NUMBER;
+  ScanAccepts[SCAN_NUMBER_DOTS] = SCANNED_MOVE_NUMBER;
+
+  /* Compress the transitions. */
+  for (int ch = 0; ch < MAX_CHAR; ch++) {
+    unsigned class = 0;
+
+    while (class < num_classes) {
+      int state = 0;
+
+      while (state < NUM_SCAN_STATES &&
+             transitions[state][ch] ==
+                 transitions[state][class_member[class]]) {
+        state++;
+      }
+      if (state == NUM_SCAN_STATES) {
+        break;
+      }
+      class++;
+    }
+    if (class == num_classes) {
+      if (num_classes == MAX_SCAN_CLASSES) {
+        fprintf(stderr, "Internal error: too many classes of character in "
+                        "init_symbol_scanner.\n");
+        exit(1);
+      }
+      class_member[num_classes++] = (unsigned char)ch;
+      for (int state = 0; state < NUM_SCAN_STATES; state++) {
+        ScanTransitions[state][class] = transitions[state][ch];
+      }
+    }
+    ScanClass[ch] = (unsigned char)class;
   }
-  suppressed_tags[tag_item] = true;
 }
 
 /* Initialise ChTab[], the classification of the initial characters
@@ -327,13 +666,15 @@ void init_lex_tables(void) {
   MoveChars['0'] = 1;
   /* Allow a trailing p for ep. */
   MoveChars['p'] = 1;
+
+  init_symbol_scanner();
 }
 
 /* Starting from linep in line, gather up the string until
  * the closing quote.  Skip over the closing quote.
  * NB: This token is only used for tags, which are notoriously
  * error prone, so there is some code attempting recovery
- * if requested.
+ * if requested. Its value is counted by --memstats as a tag.
  */
 LinePair gather_string(const StateInfo *globals, char *line,
                        unsigned char *linep) {
@@ -344,8 +685,11 @@ LinePair gather_string(const StateInfo *globals, char *line,
   bool end_of_string = false;
 
   do {
-    ch = *linep++;
-    len++;
+    const unsigned char *delimiter = find_delimiter(linep, '"', '\\');
+
+    len += delimiter - linep + 1;
+    linep = (unsigned char *)delimiter + 1;
+    ch = *delimiter;
     if (ch == '\\') {
       /* Escape the next character. */
       ch = *linep++;
@@ -355,10 +699,9 @@ LinePair gather_string(const StateInfo *globals, char *line,
         print_error_context(globals, globals->logfile);
         end_of_string = true;
       }
-    } else if (ch == '"' || ch == '\0') {
-      end_of_string = true;
     } else {
-      /* Ordinary character. */
+      /* The closing quote or the end of the line. */
+      end_of_string = true;
     }
   } while (!end_of_string);
 
@@ -396,7 +739,7 @@ LinePair gather_string(const StateInfo *globals, char *line,
         linep = lookahead;
       }
       /* Replace any previous closing double quotes with single quotes. */
-      str = (char *)malloc_or_die(len + 1);
+      str = (char *)malloc_for(MEMORY_TAG, len + 1);
       unsigned char *p = linep - len - 1;
       int i = 0;
       while (p < linep - 1) {
@@ -414,7 +757,7 @@ LinePair gather_string(const StateInfo *globals, char *line,
     } else {
       /* The last one doesn't belong in the string. */
       len--;
-      str = (char *)malloc_or_die(len + 1);
+      str = (char *)malloc_for(MEMORY_TAG, len + 1);
       strncpy(str, (const char *)(linep - len - 1), len);
       str[len] = '\0';
     }
@@ -422,7 +765,7 @@ LinePair gather_string(const StateInfo *globals, char *line,
     /* The last one doesn't belong in the string. */
     len--;
     /* Allocate space for the result. */
-    str = (char *)malloc_or_die(len + 1);
+    str = (char *)malloc_for(MEMORY_TAG, len + 1);
     strncpy(str, (const char *)(linep - len - 1), len);
     str[len] = '\0';
   }
@@ -436,10 +779,13 @@ LinePair gather_string(const StateInfo *globals, char *line,
     /* Too far. */
     if (!globals->skipping_current_game) {
       fprintf(globals->logfile, "Missing closing quote in %s\n", line);
+      note_cache_diagnostic();
     }
+    /* Move back to the null, which has been passed over however
+     * short the string is, so that the rest of the line is not read.
+     */
+    linep--;
     if (len > 1) {
-      /* Move back to the null. */
-      linep--;
       str[len - 1] = '\0';
     }
   } else {
@@ -472,20 +818,21 @@ static LinePair gather_comment(const StateInfo *globals,
   StringList *current_comment = NULL;
   /* The pointer to be returned. */
   CommentList *comment;
+  /* Nested comments start with '{'. */
+  const unsigned char nesting = globals->allow_nested_comments ? '{' : '}';
 
   /* globals->allow_nested_comments. */
   comment_depth++;
 
   do {
     /* Restart a new segment. */
-    len = 0;
+    const unsigned char *segment = linep;
+
     do {
+      linep = (unsigned char *)find_delimiter(linep, '}', nesting);
       ch = *linep++;
-      len++;
       if (ch == '{') {
-        if (globals->allow_nested_comments) {
-          comment_depth++;
-        }
+        comment_depth++;
       } else if (ch == '}') {
         if (globals->allow_nested_comments) {
           if (comment_depth > 1) {
@@ -498,6 +845,7 @@ static LinePair gather_comment(const StateInfo *globals,
         /* No further action. */
       }
     } while ((ch != '}') && (ch != '\0'));
+    len = linep - segment;
     if (ch == '}') {
       comment_depth--;
     }
@@ -520,7 +868,7 @@ static LinePair gather_comment(const StateInfo *globals,
         start++;
       }
       /* Allocate space for the result. */
-      comment_str = (char *)malloc_or_die(end - start + 1);
+      comment_str = (char *)malloc_for(MEMORY_COMMENT, end - start + 1);
       strncpy(comment_str, (const char *)(str + start), end - start);
       comment_str[end - start] = '\0';
       current_comment = save_string_list_item(current_comment, comment_str);
@@ -533,17 +881,22 @@ static LinePair gather_comment(const StateInfo *globals,
   if (comment_depth > 0) {
     fprintf(globals->logfile, "Missing end of a nested comment.\n");
     report_details(game_header, globals->logfile);
+    note_cache_diagnostic();
   }
 
-  /* Set up the structure to be returned. */
-  comment = (CommentList *)malloc_or_die(sizeof(*comment));
-  comment->comment = current_comment;
-  comment->next = NULL;
-  yylval.comment = comment;
-
+  if (globals->keep_comments) {
+    /* Set up the structure to be returned. */
+    comment = (CommentList *)malloc_for(MEMORY_COMMENT, sizeof(*comment));
+    comment->comment = current_comment;
+    comment->next = NULL;
+    yylval.comment = comment;
+    resulting_line.token = COMMENT;
+  } else {
+    /* The comment is skipped, as with single-line comments. */
+    resulting_line.token = NO_TOKEN;
+  }
   resulting_line.line = line;
   resulting_line.linep = linep;
-  resulting_line.token = COMMENT;
   return resulting_line;
 }
 
@@ -577,7 +930,7 @@ static LinePair gather_single_line_comment(const StateInfo *globals,
     }
 
     /* Allocate space for the result. */
-    comment_str = (char *)malloc_or_die(end - start + 1);
+    comment_str = (char *)malloc_for(MEMORY_COMMENT, end - start + 1);
     /* NB: Single-line comments are currently converted to multi-line
      * comment format.
      * On the off-chance that one might contain a curly bracket, 'escape'
@@ -597,7 +950,7 @@ static LinePair gather_single_line_comment(const StateInfo *globals,
     current_comment = save_string_list_item(current_comment, comment_str);
 
     /* Set up the comment structure to be returned. */
-    comment = (CommentList *)malloc_or_die(sizeof(*comment));
+    comment = (CommentList *)malloc_for(MEMORY_COMMENT, sizeof(*comment));
     comment->comment = current_comment;
     comment->next = NULL;
     yylval.comment = comment;
@@ -611,97 +964,25 @@ static LinePair gather_single_line_comment(const StateInfo *globals,
   return resulting_line;
 }
 
-/* Remember that 0 can start 0-1 and 0-0.
- * Remember that 1 can start 1-0 and 1/2.
+/* Look up the len characters of tag_string, which need not be
+ * terminated, in TagList[] and return its _TAG value or -1 if it
+ * isn't there.
+ * The original tags are found through their perfect hash, and any
+ * further tags identified in the source files through NewTagSlots.
  */
-static LinePair gather_possible_numeric(const StateInfo *globals, char *line,
-                                        unsigned char *linep,
-                                        char initial_digit) {
-  LinePair resulting_line;
-  TokenType token = MOVE_NUMBER;
-  /* Keep a record of where this token started. */
-  const unsigned char *symbol_start = linep - 1;
-
-  if (initial_digit == '0') {
-    /* Could be castling or a result. */
-    if (strncmp((const char *)linep, "-1", 2) == 0) {
-      token = TERMINATING_RESULT;
-      save_string("0-1");
-      linep += 2;
-    } else if (strncmp((const char *)linep, "-0-0", 4) == 0) {
-      token = MOVE;
-      save_q_castle(globals);
-      linep += 4;
-    } else if (strncmp((const char *)linep, "-0", 2) == 0) {
-      token = MOVE;
-      save_k_castle(globals);
-      linep += 2;
-    } else {
-      /* MOVE_NUMBER */
-    }
-  } else if (initial_digit == '1') {
-    if (strncmp((const char *)linep, "-0", 2) == 0) {
-      token = TERMINATING_RESULT;
-      save_string("1-0");
-      linep += 2;
-    } else if (strncmp((const char *)linep, "/2", 2) == 0) {
-      token = TERMINATING_RESULT;
-      linep += 2;
-      /* Check for the full form. */
-      if (strncmp((const char *)linep, "-1/2", 4) == 0) {
-        token = TERMINATING_RESULT;
-        linep += 4;
-      }
-      /* Make sure that the full form of the draw result
-       * is saved.
-       */
-      save_string("1/2-1/2");
-    } else {
-      /* MOVE_NUMBER */
-    }
-  } else {
-    /* MOVE_NUMBER */
-  }
-  if (token == MOVE_NUMBER) {
-    /* Gather the remaining digits. */
-    while (isdigit((unsigned)*linep)) {
-      linep++;
-    }
+static int identify_tag(const char *tag_string, size_t len) {
+  unsigned hash = tag_name_hash(tag_string, len, known_tag_seed);
+  int tag = KnownTagSlots[hash % KNOWN_TAG_SLOTS];
+
+  if (tag != NO_TAG && is_tag_name(TagList[tag], tag_string, len)) {
+    return tag;
   }
-  if (token == MOVE_NUMBER) {
-    /* Fill out the fields of yylval. */
-    if (extract_yytext(globals, symbol_start, linep)) {
-      yylval.move_number = 0;
-      (void)sscanf((const char *)yytext, "%u", &yylval.move_number);
-      /* Skip any trailing dots. */
-      while (*linep == '.') {
-        linep++;
+  if (new_tags > 0) {
+    for (unsigned slot = hash & (new_tag_slots - 1);
+         NewTagSlots[slot] != NO_TAG; slot = (slot + 1) & (new_tag_slots - 1)) {
+      if (is_tag_name(TagList[NewTagSlots[slot]], tag_string, len)) {
+        return NewTagSlots[slot];
       }
-    } else {
-      token = NO_TOKEN;
-    }
-  } else {
-    /* TERMINATING_RESULT and MOVE have already been dealt with. */
-  }
-  resulting_line.line = line;
-  resulting_line.linep = linep;
-  resulting_line.token = token;
-  return resulting_line;
-}
-
-/* Look up tag_string in TagList[] and return its _TAG
- * value or -1 if it isn't there.
- * Although the strings are sorted initially, further
- * tags identified in the source files will be appended
- * without further sorting. So we cannot use a binary
- * search on the list.
- */
-static int identify_tag(const char *tag_string) {
-  unsigned tag_index;
-
-  for (tag_index = 0; tag_index < tag_list_length; tag_index++) {
-    if (strcmp(tag_string, TagList[tag_index]) == 0) {
-      return tag_index;
     }
   }
   /* Not found. */
@@ -739,21 +1020,16 @@ LinePair gather_tag(const StateInfo *globals, GameHeader *game_header,
     /* The last one wasn't part of the tag. */
     linep--;
     if (len > 0) {
-      int tag_item;
-      char *tag_string;
+      /* The name is identified where it lies in the line. */
+      const char *tag_string = (const char *)(linep - len);
+      int tag_item = identify_tag(tag_string, len);
 
-      /* Allocate space for the result. */
-      tag_string = (char *)malloc_or_die(len + 1);
-      strncpy((char *)tag_string, (const char *)(linep - len), len);
-      tag_string[len] = '\0';
-      tag_item = identify_tag(tag_string);
       if (tag_item < 0) {
-        tag_item = make_new_tag(globals, game_header, tag_string);
+        tag_item = make_new_tag(tag_string, len);
       }
       if (tag_item >= 0 && ((unsigned)tag_item) < tag_list_length) {
         yylval.tag_index = tag_item;
         resulting_line.token = TAG;
-        (void)free((void *)tag_string);
       } else {
         fprintf(globals->logfile,
                 "Internal error: invalid tag index %d in gather_tag.\n",
@@ -784,21 +1060,179 @@ static bool extract_yytext(const StateInfo *globals,
   } else {
     strncpy((char *)yytext, (const char *)symbol_start, MAX_YYTEXT);
     yytext[MAX_YYTEXT] = '\0';
-    if (!globals->skipping_current_game)
+    if (!globals->skipping_current_game) {
       fprintf(globals->logfile, "Symbol %s exceeds length of %u.\n", yytext,
               MAX_YYTEXT);
+      note_cache_diagnostic();
+    }
     Ok = false;
   }
   return Ok;
 }
 
+/* Whether the symbol from symbol_start to linep fits in yytext,
+ * reporting it if not.
+ */
+static bool symbol_fits(const StateInfo *globals,
+                        const unsigned char *symbol_start,
+                        const unsigned char *linep) {
+  return linep - symbol_start < MAX_YYTEXT ||
+         extract_yytext(globals, symbol_start, linep);
+}
+
+/* Run the DFA of init_symbol_scanner from symbol_start and return
+ * the kind of the longest symbol that it recognises, with *symbol_end
+ * set to the character following it.
+ * Return SCANNED_NOTHING if there is no such symbol.
+ */
+static ScannedSymbol scan_symbol(const unsigned char *symbol_start,
+                                 const unsigned char **symbol_end) {
+  const unsigned char *linep = symbol_start;
+  ScannedSymbol scanned = SCANNED_NOTHING;
+  unsigned state = SCAN_START;
+
+  /* The class of the end of the line leads to SCAN_DEAD from every state. */
+  while ((state = ScanTransitions[state][ScanClass[*linep]]) != SCAN_DEAD) {
+    linep++;
+    if (ScanAccepts[state] != SCANNED_NOTHING) {
+      scanned = ScanAccepts[state];
+      *symbol_end = linep;
+    }
+  }
+  return scanned;
+}
+
+/* Return the token for the symbol of kind scanned, which runs from
+ * symbol_start to current_linep, and save its value in yylval.
+ */
+static TokenType scanned_token(const StateInfo *globals,
+                               ScannedSymbol scanned,
+                               const unsigned char *symbol_start) {
+  TokenType token = NO_TOKEN;
+
+  switch (scanned) {
+  case SCANNED_WHITESPACE:
+  case SCANNED_DOTS:
+    break;
+  case SCANNED_CHECK:
+    /* Allow ++ */
+    token = CHECK_SYMBOL;
+    break;
+  case SCANNED_ANNOTATION:
+    /* Don't return anything in case of error. */
+    if (symbol_fits(globals, symbol_start, current_linep)) {
+      unsigned char second =
+          current_linep - symbol_start > 1 ? symbol_start[1] : '\0';
+
+      if (symbol_start[0] == '!') {
+        save_string(second == '!' ? "$3" : second == '?' ? "$5" : "$1");
+      } else {
+        save_string(second == '!' ? "$6" : second == '?' ? "$4" : "$2");
+      }
+      token = NAG;
+    }
+    break;
+  case SCANNED_NAG:
+    if (symbol_fits(globals, symbol_start, current_linep)) {
+      save_text(symbol_start, current_linep - symbol_start);
+      token = NAG;
+    }
+    break;
+  case SCANNED_MOVE:
+    if (extract_yytext(globals, symbol_start, current_linep)) {
+      /* Only classify it as a move if it
+       * seems to be a complete move.
+       */
+      bool ok;
+      if (move_seems_valid(yytext)) {
+        save_move(globals, yytext);
+        token = MOVE;
+        ok = true;
+      } else if (*symbol_start == 'e') {
+        /* Consider for possible en passant notation. */
+        const int num_ep_strings = 2;
+        const char *ep[] = {
+            "e.p.",
+            "ep",
+        };
+        int epi = 0;
+        while (epi < num_ep_strings &&
+               strncmp((const char *)symbol_start, ep[epi],
+                       strlen(ep[epi])) != 0) {
+          epi++;
+        }
+        if (epi < num_ep_strings) {
+          /* Accept. */
+          /* PGN has no representation for ep, so just accept without
+           * checking. */
+          ok = true;
+          current_linep = ((unsigned char *)symbol_start) + strlen(ep[epi]);
+        } else {
+          ok = false;
+        }
+      } else {
+        ok = false;
+      }
+      if (!ok && !globals->skipping_current_game) {
+        line_position = current_linep - (unsigned char *)current_line;
+        print_error_context(globals, globals->logfile);
+        fprintf(globals->logfile, "Unknown move text %s.\n", yytext);
+      }
+    }
+    break;
+  case SCANNED_NULL_MOVE:
+    save_move(globals, (const unsigned char *)NULL_MOVE_STRING);
+    token = MOVE;
+    break;
+  case SCANNED_MOVE_NUMBER: {
+    /* Any trailing dots are part of the symbol. */
+    const unsigned char *digit = symbol_start;
+    unsigned move_number = 0;
+
+    while (isdigit(*digit)) {
+      move_number = 10 * move_number + (*digit - '0');
+      digit++;
+    }
+    if (symbol_fits(globals, symbol_start, digit)) {
+      yylval.move_number = move_number;
+      token = MOVE_NUMBER;
+    }
+    break;
+  }
+  case SCANNED_WHITE_WINS:
+    save_string("1-0");
+    token = TERMINATING_RESULT;
+    break;
+  case SCANNED_BLACK_WINS:
+    save_string("0-1");
+    token = TERMINATING_RESULT;
+    break;
+  case SCANNED_DRAW:
+    /* Make sure that the full form of the draw result
+     * is saved.
+     */
+    save_string("1/2-1/2");
+    token = TERMINATING_RESULT;
+    break;
+  case SCANNED_KING_CASTLE:
+    save_k_castle(globals);
+    token = MOVE;
+    break;
+  case SCANNED_QUEEN_CASTLE:
+    save_q_castle(globals);
+    token = MOVE;
+    break;
+  case SCANNED_NOTHING:
+    break;
+  }
+  return token;
+}
+
 /* Identify the next symbol.
  * Don't take any action on EOF -- leave that to next_token.
  */
 static TokenType get_next_symbol(const StateInfo *globals,
                                  GameHeader *game_header) {
-  static char *line = NULL;
-  static unsigned char *linep = NULL;
   /* The token to be returned. */
   TokenType token;
   LinePair resulting_line;
@@ -809,133 +1243,81 @@ static TokenType get_next_symbol(const StateInfo *globals,
 
     /* Clear any remaining symbol. */
     *yytext = '\0';
-    if (line == NULL) {
-      line = next_input_line(globals, game_header, yyin);
-      linep = (unsigned char *)line;
-      if (line != NULL) {
+    if (current_line == NULL) {
+      current_line = next_input_line(globals, game_header, yyin);
+      current_linep = (unsigned char *)current_line;
+      if (current_line != NULL) {
         token = NO_TOKEN;
       } else {
         token = EOF_TOKEN;
       }
     } else {
-      int next_char = *linep & 0x0ff;
+      int next_char = *current_linep & 0x0ff;
+      const unsigned char *symbol_end;
+      ScannedSymbol scanned;
 
       /* Remember where we start. */
-      symbol_start = linep;
-      linep++;
+      symbol_start = current_linep;
+      symbol_start_position = symbol_start - (unsigned char *)current_line;
+      scanned = scan_symbol(symbol_start, &symbol_end);
+      if (scanned != SCANNED_NOTHING) {
+        current_linep = (unsigned char *)symbol_end;
+        token = scanned_token(globals, scanned, symbol_start);
+        line_position = current_linep - (unsigned char *)current_line;
+        continue;
+      }
+      current_linep++;
       token = ChTab[next_char];
 
       switch (token) {
-      case WHITESPACE:
-        while (ChTab[(unsigned)*linep] == WHITESPACE) {
-          linep++;
-        }
-        token = NO_TOKEN;
-        break;
       case TAG_START:
-        resulting_line = gather_tag(globals, game_header, line, linep);
+        resulting_line =
+            gather_tag(globals, game_header, current_line, current_linep);
         /* Pick up where we are now. */
-        line = resulting_line.line;
-        linep = resulting_line.linep;
+        current_line = resulting_line.line;
+        current_linep = resulting_line.linep;
         token = resulting_line.token;
         break;
       case TAG_END:
         // token = NO_TOKEN;
         break;
       case DOUBLE_QUOTE:
-        resulting_line = gather_string(globals, line, linep);
+        resulting_line = gather_string(globals, current_line, current_linep);
         /* Pick up where we are now. */
-        line = resulting_line.line;
-        linep = resulting_line.linep;
+        current_line = resulting_line.line;
+        current_linep = resulting_line.linep;
         token = resulting_line.token;
         break;
       case COMMENT_START:
-        resulting_line = gather_comment(globals, game_header, line, linep);
+        resulting_line =
+            gather_comment(globals, game_header, current_line, current_linep);
         /* Pick up where we are now. */
-        line = resulting_line.line;
-        linep = resulting_line.linep;
+        current_line = resulting_line.line;
+        current_linep = resulting_line.linep;
         token = resulting_line.token;
         break;
       case COMMENT_END:
         if (!globals->skipping_current_game) {
           fprintf(globals->logfile, "Unmatched comment end on line %lu.\n",
                   line_number);
+          note_cache_diagnostic();
         }
         token = NO_TOKEN;
         break;
-      case NAG:
-        while (isdigit((unsigned)*linep)) {
-          linep++;
-        }
-        if (extract_yytext(globals, symbol_start, linep)) {
-          save_string((const char *)yytext);
-        } else {
-          token = NO_TOKEN;
-        }
-        break;
-      case ANNOTATE:
-        /* Don't return anything in case of error. */
-        token = NO_TOKEN;
-        while (ChTab[(unsigned)*linep] == ANNOTATE) {
-          linep++;
-        }
-        if (extract_yytext(globals, symbol_start, linep)) {
-          switch (yytext[0]) {
-          case '!':
-            switch (yytext[1]) {
-            case '!':
-              save_string("$3");
-              break;
-            case '?':
-              save_string("$5");
-              break;
-            default:
-              save_string("$1");
-              break;
-            }
-            token = NAG;
-            break;
-          case '?':
-            switch (yytext[1]) {
-            case '!':
-              save_string("$6");
-              break;
-            case '?':
-              save_string("$4");
-              break;
-            default:
-              save_string("$2");
-              break;
-            }
-            token = NAG;
-            break;
-          }
-        }
-        break;
-      case CHECK_SYMBOL:
-        /* Allow ++ */
-        while (ChTab[(unsigned)*linep] == CHECK_SYMBOL) {
-          linep++;
-        }
-        break;
-      case DOT:
-        while (ChTab[(unsigned)*linep] == DOT)
-          linep++;
-        token = NO_TOKEN;
-        break;
       case SEMICOLON:
         resulting_line =
-            gather_single_line_comment(globals, game_header, line, linep);
+            gather_single_line_comment(globals, game_header, current_line,
+                                       current_linep);
         /* Pick up where we are now. */
-        line = resulting_line.line;
-        linep = resulting_line.linep;
+        current_line = resulting_line.line;
+        current_linep = resulting_line.linep;
         token = resulting_line.token;
         break;
       case PERCENT:
-        if (symbol_start == (const unsigned char *)line) {
+        if (symbol_start == (const unsigned char *)current_line) {
           /* Discard the rest of the line. */
-          line = next_input_line(globals, game_header, yyin);
-          linep = (unsigned char *)line;
+          current_line = next_input_line(globals, game_header, yyin);
+          current_linep = (unsigned char *)current_line;
           token = NO_TOKEN;
         } else {
           /* Prior to v22-02 the position of % was not checked. */
@@ -943,97 +1325,29 @@ static TokenType get_next_symbol(const StateInfo *globals,
         break;
       case ESCAPE:
         /* @@@ What to do about this? */
-        if (*linep != '\0') {
-          linep++;
+        if (*current_linep != '\0') {
+          current_linep++;
         }
         token = NO_TOKEN;
         break;
       case ALPHA:
-        /* Not all ALPHAs are move characters. */
-        if (MoveChars[next_char]) {
-          /* Scan through the possible move characters. */
-          while (MoveChars[*linep & 0x0ff]) {
-            linep++;
-          }
-          if (extract_yytext(globals, symbol_start, linep)) {
-            /* Only classify it as a move if it
-             * seems to be a complete move.
-             */
-            bool ok;
-            if (move_seems_valid(yytext)) {
-              save_move(globals, yytext);
-              token = MOVE;
-              ok = true;
-            } else if (next_char == 'e') {
-              /* Consider for possible en passant notation. */
-              const int num_ep_strings = 2;
-              const char *ep[] = {
-                  "e.p.",
-                  "ep",
-              };
-              int epi = 0;
-              while (epi < num_ep_strings &&
-                     strncmp((const char *)symbol_start, ep[epi],
-                             strlen(ep[epi])) != 0) {
-                epi++;
-              }
-              if (epi < num_ep_strings) {
-                /* Accept. */
-                /* PGN has no representation for ep, so just accept without
-                 * checking. */
-                ok = true;
-                token = NO_TOKEN;
-                linep = ((unsigned char *)symbol_start) + strlen(ep[epi]);
-              } else {
-                ok = false;
-              }
-            } else {
-              ok = false;
-            }
-            if (!ok) {
-              if (!globals->skipping_current_game) {
-                line_position = linep - (unsigned char *)line;
-                print_error_context(globals, globals->logfile);
-                fprintf(globals->logfile, "Unknown move text %s.\n", yytext);
-              }
-              token = NO_TOKEN;
-            }
-          } else {
-            token = NO_TOKEN;
-          }
-        } else if (next_char == 'Z' && *linep == '0') {
-          linep++;
-          save_move(globals, (const unsigned char *)NULL_MOVE_STRING);
-          token = MOVE;
-        } else {
-          if (!globals->skipping_current_game) {
-            line_position = linep - (unsigned char *)line;
-            print_error_context(globals, globals->logfile);
-            fprintf(globals->logfile, "Unknown character %c (Hex: %x).\n",
-                    next_char, next_char);
-            fprintf(globals->logfile, "%s\n", line);
-            for (unsigned i = 0; i < line_position - 1; i++) {
-              fputc(' ', globals->logfile);
-            }
-            fputc('^', globals->logfile);
-            fputc('\n', globals->logfile);
-          }
-          /* Skip any sequence of them. */
-          while (ChTab[(unsigned)*linep] == ERROR_TOKEN) {
-            linep++;
+        /* Moves and Z0 have been recognised by scan_symbol. */
+        if (!globals->skipping_current_game) {
+          line_position = current_linep - (unsigned char *)current_line;
+          print_error_context(globals, globals->logfile);
+          fprintf(globals->logfile, "Unknown character %c (Hex: %x).\n",
+                  next_char, next_char);
+          fprintf(globals->logfile, "%s\n", current_line);
+          for (unsigned i = 0; i < line_position - 1; i++) {
+            fputc(' ', globals->logfile);
           }
+          fputc('^', globals->logfile);
+          fputc('\n', globals->logfile);
+        }
+        /* Skip any sequence of them. */
+        while (ChTab[(unsigned)*current_linep] == ERROR_TOKEN) {
+          current_linep++;
         }
-        break;
-      case DIGIT:
-        /* Remember that 0 can start 0-1 and 0-0.
-         * Remember that 1 can start 1-0 and 1/2.
-         */
-        resulting_line =
-            gather_possible_numeric(globals, line, linep, next_char);
-        /* Pick up where we are now. */
-        line = resulting_line.line;
-        linep = resulting_line.linep;
-        token = resulting_line.token;
         break;
       case EOF_TOKEN:
         break;
@@ -1045,7 +1359,7 @@ static TokenType get_next_symbol(const StateInfo *globals,
           RAV_level--;
         } else {
           if (!globals->skipping_current_game) {
-            line_position = linep - (unsigned char *)line;
+            line_position = current_linep - (unsigned char *)current_line;
             print_error_context(globals, globals->logfile);
             fprintf(globals->logfile, "Too many ')' found.\n");
           }
@@ -1057,28 +1371,23 @@ static TokenType get_next_symbol(const StateInfo *globals,
         token = TERMINATING_RESULT;
         break;
       case DASH:
-        if (ChTab[(unsigned)*linep] == DASH) {
-          linep++;
-          save_move(globals, (const unsigned char *)NULL_MOVE_STRING);
-          token = MOVE;
-        } else {
-          line_position = linep - (unsigned char *)line;
-          fprintf(globals->logfile, "Single '-' not allowed.\n");
-          print_error_context(globals, globals->logfile);
-          token = NO_TOKEN;
-        }
+        /* -- has been recognised by scan_symbol. */
+        line_position = current_linep - (unsigned char *)current_line;
+        fprintf(globals->logfile, "Single '-' not allowed.\n");
+        print_error_context(globals, globals->logfile);
+        token = NO_TOKEN;
         break;
       case SLASH:
         /* Possible /ep annotation. */
-        if (linep[0] == 'e' && linep[1] == 'p') {
+        if (current_linep[0] == 'e' && current_linep[1] == 'p') {
           /* PGN has no representation for ep, so just accept without checking.
            */
-          linep += 2;
+          current_linep += 2;
           token = NO_TOKEN;
         } else {
           token = NO_TOKEN;
           if (!globals->skipping_current_game) {
-            line_position = linep - (unsigned char *)line;
+            line_position = current_linep - (unsigned char *)current_line;
             print_error_context(globals, globals->logfile);
             fprintf(globals->logfile, "Single '/' not allowed.");
           }
@@ -1086,35 +1395,35 @@ static TokenType get_next_symbol(const StateInfo *globals,
         break;
       case EOS:
         /* End of the string. */
-        line = next_input_line(globals, game_header, yyin);
-        linep = (unsigned char *)line;
+        current_line = next_input_line(globals, game_header, yyin);
+        current_linep = (unsigned char *)current_line;
         token = NO_TOKEN;
         break;
       case ERROR_TOKEN:
         if (!globals->skipping_current_game) {
-          line_position = linep - (unsigned char *)line;
+          line_position = current_linep - (unsigned char *)current_line;
           print_error_context(globals, globals->logfile);
           fprintf(globals->logfile, "Unknown character %c (Hex: %x).\n",
                   next_char, next_char);
         }
         /* Skip any sequence of them. */
-        while (ChTab[(unsigned)*linep] == ERROR_TOKEN) {
-          linep++;
+        while (ChTab[(unsigned)*current_linep] == ERROR_TOKEN) {
+          current_linep++;
         }
         break;
       case OPERATOR:
-        line_position = linep - (unsigned char *)line;
+        line_position = current_linep - (unsigned char *)current_line;
         print_error_context(globals, globals->logfile);
         fprintf(globals->logfile, "Operator in illegal context: %c.\n",
                 *symbol_start);
         /* Skip any sequence of them. */
-        while (ChTab[(unsigned)*linep] == OPERATOR)
-          linep++;
+        while (ChTab[(unsigned)*current_linep] == OPERATOR)
+          current_linep++;
         token = NO_TOKEN;
         break;
       default:
         if (!globals->skipping_current_game) {
-          line_position = linep - (unsigned char *)line;
+          line_position = current_linep - (unsigned char *)current_line;
           print_error_context(globals, globals->logfile);
           fprintf(globals->logfile,
                   "Internal error: Missing case for %d on char %x.\n", token,
@@ -1124,22 +1433,40 @@ static TokenType get_next_symbol(const StateInfo *globals,
         break;
       }
     }
-    line_position = linep - (unsigned char *)line;
+    line_position = current_linep - (unsigned char *)current_line;
   } while (token == NO_TOKEN);
   return token;
 }
 
+/* Return the next symbol of the current input file.
+ * Binary game files consist only of BINARY_GAME symbols.
+ */
+static TokenType next_file_symbol(const StateInfo *globals,
+                                  GameHeader *game_header) {
+  if (binary_input) {
+    return binary_game_follows(globals, yyin) ? BINARY_GAME : EOF_TOKEN;
+  } else {
+    return get_next_symbol(globals, game_header);
+  }
+}
+
 TokenType next_token(StateInfo *globals, GameHeader *game_header) {
-  TokenType token = get_next_symbol(globals, game_header);
+  TokenType token = next_file_symbol(globals, game_header);
 
   /* Don't call yywrap if parsing the ECO file. */
   while ((token == EOF_TOKEN) && !globals->parsing_ECO_file &&
          !yywrap(globals)) {
-    token = get_next_symbol(globals, game_header);
+    token = next_file_symbol(globals, game_header);
   }
   return token;
 }
 
+/* Read the game of the BINARY_GAME symbol just returned by next_token. */
+Move *next_binary_game(StateInfo *globals, GameHeader *game_header,
+                       unsigned long *start_line, unsigned long *end_line) {
+  return read_binary_game(globals, game_header, yyin, start_line, end_line);
+}
+
 /* Return true if token is one to skip when looking for
  * the start or end of a game.
  */
@@ -1148,6 +1475,7 @@ static bool skip_token(TokenType token) {
   case TERMINATING_RESULT:
   case TAG:
   case MOVE:
+  case BINARY_GAME:
   case EOF_TOKEN:
     return false;
   default:
@@ -1234,10 +1562,24 @@ unsigned current_file_number(void) { return current_file_num; }
 static size_t input_buffer_index = 0;
 static size_t input_buffer_limit = 0;
 static char input_buffer[INPUT_BUFFER_LEN];
+/* The byte offset within the input file of input_buffer[0]. */
+static unsigned long input_buffer_offset = 0;
+
+/* Discard any buffered input, the next character of which
+ * will be read from the given offset of the input file.
+ */
+static void reset_input_buffer(unsigned long offset) {
+  input_buffer_index = input_buffer_limit = 0;
+  input_buffer_offset = offset;
+}
 
 /* Fill the input buffer to its limit, if possible. */
 static void fill_input_buffer(FILE *fpin) {
-  if (!feof(fpin)) {
+  input_buffer_offset += input_buffer_limit;
+  if (fpin == yyin && decompressed_input != NULL) {
+    input_buffer_limit = read_decompressed_input(
+        decompressed_input, (char *)input_buffer, INPUT_BUFFER_LEN);
+  } else if (!feof(fpin)) {
     input_buffer_limit =
         fread(input_buffer, sizeof(*input_buffer), INPUT_BUFFER_LEN, fpin);
   } else {
@@ -1274,35 +1616,49 @@ static void unget_char(const StateInfo *globals, GameHeader *game_header, int c,
   }
 }
 
-/* Read a single line of input. */
-#define INIT_LINE_LENGTH 100
-#define LINE_INCREMENT 100
-
+/* Read a single line of input.
+ * Every character other than '\n' and '\r' belongs to the line,
+ * including 0xff (y-diaeresis in Latin-1), which was once mistaken for
+ * EOF and ended the line, and with it any string or comment.
+ */
 char *read_line(const StateInfo *globals, GameHeader *game_header, FILE *fpin) {
   char *line = NULL;
-  unsigned len = 0;
-  unsigned max_length;
+  size_t len = 0;
   int ch;
 
-  ch = get_next_char(fpin);
-  if (ch != EOF) {
-    line = (char *)malloc_or_die(INIT_LINE_LENGTH + 1);
-    max_length = INIT_LINE_LENGTH;
-    while ((ch != '\n') && (ch != '\r') && (ch != EOF)) {
-      /* Another character to add. */
-      if (len == max_length) {
-        line = (char *)realloc_or_die((void *)line,
-                                      max_length + LINE_INCREMENT + 1);
-        if (line == NULL) {
-          return NULL;
-        }
-        max_length += LINE_INCREMENT;
+  if (input_buffer_index == input_buffer_limit) {
+    fill_input_buffer(fpin);
+  }
+  if (input_buffer_index != input_buffer_limit) {
+    bool end_of_line = false;
+
+    /* Copy the line out of the input buffer a run at a time,
+     * as it may continue beyond the end of the buffer.
+     */
+    while (!end_of_line) {
+      size_t available = input_buffer_limit - input_buffer_index;
+      size_t run = find_line_end(
+          (const unsigned char *)input_buffer + input_buffer_index, available);
+
+      if (line == NULL) {
+        line = (char *)malloc_for(MEMORY_LEXER_STRING, run + 1);
+      } else {
+        line = (char *)realloc_for(MEMORY_LEXER_STRING, (void *)line,
+                                   len + 1, len + run + 1);
+      }
+      memcpy(line + len, input_buffer + input_buffer_index, run);
+      len += run;
+      input_buffer_index += run;
+      if (run < available) {
+        end_of_line = true;
+      } else {
+        fill_input_buffer(fpin);
+        end_of_line = input_buffer_index == input_buffer_limit;
       }
-      line[len] = ch;
-      len++;
-      ch = get_next_char(fpin);
     }
     line[len] = '\0';
+    /* Skip the end of the line. */
+    ch = get_next_char(fpin);
     if (ch == '\r') {
       /* Try to avoid double counting lines in dos-format files. */
       ch = get_next_char(fpin);
@@ -1419,11 +1775,27 @@ void add_filename_to_source_list(
   list_of_files.files[list_of_files.num_files] = (char *)NULL;
 }
 
-/* Use infile as the input source. */
+/* Use infile as the input source.
+ * A compressed file is decompressed as it is read.
+ */
 static bool open_input(StateInfo *globals, const char *infile) {
   yyin = fopen(infile, "rb");
   if (yyin != NULL) {
+    Compression compression = detect_compression(yyin);
+
+    reset_input_buffer(0);
     globals->current_input_file = infile;
+    if (compression != COMPRESSION_NONE) {
+      binary_input = false;
+      decompressed_input = open_decompressed_input(globals, yyin, compression);
+      if (decompressed_input == NULL) {
+        (void)fclose(yyin);
+        yyin = NULL;
+        return false;
+      }
+    } else {
+      binary_input = is_binary_game_file(yyin);
+    }
     if (globals->verbosity > 1) {
       fprintf(globals->logfile, "Processing %s\n", globals->current_input_file);
     }
@@ -1436,17 +1808,36 @@ bool open_eco_file(StateInfo *globals, const char *eco_file) {
   return open_input(globals, eco_file);
 }
 
-/* Open the input file whose number is the argument. */
+/* Open the input file whose number is the argument.
+ * With --cache, its games are read from its cache if that is current,
+ * and otherwise a cache is built as it is parsed.
+ * Its lines are numbered from 1, whatever was read before it,
+ * such as a -t file.
+ */
 static bool open_input_file(StateInfo *globals, int file_number) {
-  /* Depending on the type of file, ensure that the
-   * current_file_type is set correctly.
-   */
-  if (open_input(globals, list_of_files.files[file_number])) {
-    globals->current_file_type = list_of_files.file_type[file_number];
-    return true;
+  const char *infile = list_of_files.files[file_number];
+
+  reset_line_number();
+  yyin = open_game_cache(globals, infile);
+  if (yyin != NULL) {
+    reset_input_buffer(0);
+    binary_input = true;
+    globals->current_input_file = infile;
+    if (globals->verbosity > 1) {
+      fprintf(globals->logfile, "Processing %s\n", globals->current_input_file);
+    }
+  } else if (open_input(globals, infile)) {
+    if (!binary_input) {
+      start_game_cache(globals, infile);
+    }
   } else {
     return false;
   }
+  /* Depending on the type of file, ensure that the
+   * current_file_type is set correctly.
+   */
+  globals->current_file_type = list_of_files.file_type[file_number];
+  return true;
 }
 
 /* Open the first input file. */
@@ -1456,6 +1847,8 @@ bool open_first_file(StateInfo *globals) {
   if (list_of_files.num_files == 0) {
     /* Use standard input. */
     yyin = stdin;
+    reset_input_buffer(0);
+    reset_line_number();
     globals->current_input_file = "stdin";
     /* @@@ Should this be set?
     globals->current_file_type = NORMALFILE;
@@ -1483,8 +1876,12 @@ const char *input_file_name(unsigned file_number) {
   }
 }
 
-/* Give some error information. */
+/* Give some error information.
+ * Errors stop the file being read from being cached, as the
+ * information is lost when its games are read from a cache.
+ */
 void print_error_context(const StateInfo *globals, FILE *fp) {
+  note_cache_diagnostic();
   if (globals->current_input_file != NULL) {
     fprintf(fp, "File %s: ", globals->current_input_file);
   }
@@ -1494,16 +1891,21 @@ void print_error_context(const StateInfo *globals, FILE *fp) {
   fprintf(fp, "Line number: %lu character %lu\n", line_number, pos);
 }
 
-/* Make the given str accessible. */
-static void save_string(const char *str) {
-  const size_t len = strlen(str);
+/* Make a copy of the len characters of text accessible. */
+static void save_text(const unsigned char *text, size_t len) {
   char *token;
 
-  token = (char *)malloc_or_die(len + 1);
-  strcpy(token, str);
+  token = (char *)malloc_for(MEMORY_LEXER_STRING, len + 1);
+  memcpy(token, text, len);
+  token[len] = '\0';
   yylval.token_string = token;
 }
 
+/* Make the given str accessible. */
+static void save_string(const char *str) {
+  save_text((const unsigned char *)str, strlen(str));
+}
+
 /* Return the next line of input from fp. */
 char *next_input_line(const StateInfo *globals, GameHeader *game_header,
                       FILE *fp) {
@@ -1514,6 +1916,7 @@ char *next_input_line(const StateInfo *globals, GameHeader *game_header,
     (void)free((void *)line);
   }
 
+  line_start_offset = input_buffer_offset + input_buffer_index;
   line = read_line(globals, game_header, fp);
 
   if (line != NULL) {
@@ -1536,7 +1939,7 @@ int yywrap(StateInfo *globals) {
     time_to_exit = 1;
   } else {
     /* Close the input files.  */
-    terminate_input();
+    terminate_input(globals);
     /* See if there is another. */
     current_file_num++;
     if (input_file_name(current_file_num) == NULL) {
@@ -1556,7 +1959,6 @@ int yywrap(StateInfo *globals) {
       globals->current_file_type = list_of_files.file_type[current_file_num];
       restart_lex_for_new_game();
       games_in_file = 0;
-      reset_line_number();
     }
   }
   return time_to_exit;
@@ -1565,13 +1967,170 @@ int yywrap(StateInfo *globals) {
 /* Return the current line number. */
 unsigned long get_line_number(void) { return line_number; }
 
+/* Return the position in the current input file of the most
+ * recent symbol.
+ * Symbols that might start a game are never split across lines,
+ * so this is only meaningful following one of those.
+ */
+InputPosition current_symbol_position(void) {
+  InputPosition position;
+
+  position.offset = line_start_offset;
+  position.line_number = line_number;
+  position.column = symbol_start_position;
+  return position;
+}
+
+/* Set position to the point just after the symbol most recently
+ * read, from which lexing would continue.
+ * Return false if the current line has been exhausted, so there is
+ * no such point until the next line is read.
+ */
+bool next_symbol_position(InputPosition *position) {
+  if (current_line == NULL || current_linep == NULL) {
+    return false;
+  }
+  position->offset = line_start_offset;
+  position->line_number = line_number;
+  position->column =
+      (unsigned long)(current_linep - (const unsigned char *)current_line);
+  return true;
+}
+
+/* Reposition the input at the given position, previously obtained
+ * from current_symbol_position or next_symbol_position for the
+ * current input file.
+ * Return true if this was possible, false otherwise.
+ */
+bool seek_input_position(const StateInfo *globals, GameHeader *game_header,
+                         InputPosition position) {
+  if (yyin == NULL || yyin == stdin || decompressed_input != NULL ||
+      fseek(yyin, (long)position.offset, SEEK_SET) != 0) {
+    return false;
+  }
+  reset_input_buffer(position.offset);
+  line_number = position.line_number - 1;
+  current_line = next_input_line(globals, game_header, yyin);
+  if (current_line == NULL || position.column > strlen(current_line)) {
+    fprintf(globals->logfile,
+            "Internal error: invalid seek to line %lu of %s.\n",
+            position.line_number, globals->current_input_file);
+    exit(1);
+  }
+  current_linep = (unsigned char *)current_line + position.column;
+  line_position = position.column;
+  comment_depth = 0;
+  restart_lex_for_new_game();
+  return true;
+}
+
+/* Reposition the input at the end of the current input file,
+ * so that the next symbol will move on to the next file.
+ */
+bool seek_input_end(void) {
+  if (yyin == NULL || yyin == stdin || decompressed_input != NULL ||
+      fseek(yyin, 0, SEEK_END) != 0) {
+    return false;
+  }
+  reset_input_buffer((unsigned long)ftell(yyin));
+  /* Force get_next_symbol to ask for a new line. */
+  current_line = NULL;
+  current_linep = NULL;
+  return true;
+}
+
+/* Whether the current input file is being decompressed. */
+bool input_is_compressed(void) { return decompressed_input != NULL; }
+
+/* Whether the input can be repositioned at a position obtained from
+ * current_symbol_position.
+ */
+bool input_can_be_repositioned(void) {
+  return yyin != NULL && yyin != stdin && decompressed_input == NULL &&
+         !binary_input;
+}
+
+/* Reposition the input at position in input file file_number,
+ * which must not be before the current one (--resume).
+ * Return true if this was possible.
+ */
+bool resume_input(StateInfo *globals, GameHeader *game_header,
+                  unsigned file_number, InputPosition position) {
+  if (file_number != (unsigned)current_file_num) {
+    if (file_number < (unsigned)current_file_num ||
+        input_file_name(file_number) == NULL) {
+      return false;
+    }
+    terminate_input(globals);
+    current_file_num = file_number;
+    if (!open_input_file(globals, current_file_num)) {
+      return false;
+    }
+    restart_lex_for_new_game();
+    games_in_file = 0;
+  }
+  return input_can_be_repositioned() &&
+         seek_input_position(globals, game_header, position);
+}
+
+/* The sizes of the input files, for input_progress. */
+static unsigned long *input_file_sizes = NULL;
+static unsigned long total_input_size = 0;
+
+/* Set *consumed to the number of bytes of the input files read so far
+ * and *total to their combined size, which is 0 if that is not known,
+ * as for stdin.
+ * A file read from its cache is taken to be read in proportion to
+ * its cache.
+ */
+void input_progress(unsigned long *consumed, unsigned long *total) {
+  struct stat info;
+
+  if (input_file_sizes == NULL && list_of_files.num_files > 0) {
+    input_file_sizes = (unsigned long *)malloc_or_die(
+        list_of_files.num_files * sizeof(*input_file_sizes));
+    for (unsigned i = 0; i < list_of_files.num_files; i++) {
+      input_file_sizes[i] = stat(list_of_files.files[i], &info) == 0
+                                ? (unsigned long)info.st_size
+                                : 0;
+      total_input_size += input_file_sizes[i];
+    }
+  }
+  *total = total_input_size;
+  *consumed = 0;
+  if (yyin == stdin) {
+    *consumed = line_start_offset;
+    return;
+  }
+  for (int i = 0; i < current_file_num; i++) {
+    *consumed += input_file_sizes[i];
+  }
+  if (yyin == NULL || (unsigned)current_file_num >= list_of_files.num_files) {
+    return;
+  }
+  if (fstat(fileno(yyin), &info) == 0 && info.st_size > 0) {
+    long position = ftell(yyin);
+
+    if (position > 0) {
+      *consumed += (unsigned long)((double)input_file_sizes[current_file_num] *
+                                   position / info.st_size);
+    }
+  }
+}
+
 /* Reset the file's line number. */
 void reset_line_number(void) {
   line_number = 0;
   line_position = 0;
 }
 
-static void terminate_input(void) {
+static void terminate_input(const StateInfo *globals) {
+  terminate_game_cache(globals);
+  binary_input = false;
+  if (decompressed_input != NULL) {
+    close_decompressed_input(decompressed_input);
+    decompressed_input = NULL;
+  }
   if ((yyin != stdin) && (yyin != NULL)) {
     (void)fclose(yyin);
     yyin = NULL;
@@ -51,6 +51,18 @@ typedef struct {
   unsigned max_files;
 } FILE_LIST;
 
+/* Define a type to hold a position in an input file,
+ * for random access to the start of a game.
+ */
+typedef struct {
+  /* Byte offset of the start of the line. */
+  unsigned long offset;
+  /* The number of the line. */
+  unsigned long line_number;
+  /* The offset of the symbol within the line. */
+  unsigned long column;
+} InputPosition;
+
 #if 1
 #define RUSSIAN_KNIGHT_OR_KING (0x008a)
 #define RUSSIAN_KING_SECOND_LETTER (0x00e0)
@@ -79,29 +91,42 @@ void add_filename_list_from_file(const StateInfo *globals,
                                  GameHeader *game_header, FILE *fp,
                                  SourceFileType file_type);
 unsigned current_file_number(void);
+InputPosition current_symbol_position(void);
 LinePair gather_tag(const StateInfo *globals, GameHeader *game_header,
                     char *line, unsigned char *linep);
 LinePair gather_string(const StateInfo *globals, char *line,
                        unsigned char *linep);
+TagName identify_or_add_tag(const StateInfo *globals, const char *tag_string);
 void init_lex_tables(void);
 const char *input_file_name(unsigned file_number);
 unsigned long get_line_number(void);
+bool input_can_be_repositioned(void);
+bool input_is_compressed(void);
+void input_progress(unsigned long *consumed, unsigned long *total);
 bool is_character_class(unsigned char ch, TokenType character_class);
 bool is_suppressed_tag(const StateInfo *globals, TagName tag);
+Move *next_binary_game(StateInfo *globals, GameHeader *game_header,
+                       unsigned long *start_line, unsigned long *end_line);
 char *next_input_line(const StateInfo *globals, GameHeader *game_header,
                       FILE *fp);
+bool next_symbol_position(InputPosition *position);
 TokenType next_token(StateInfo *globals, GameHeader *game_header);
+unsigned number_of_tags(void);
 bool open_eco_file(StateInfo *globals, const char *eco_file);
 bool open_first_file(StateInfo *globals);
 void print_error_context(const StateInfo *globals, FILE *fp);
 char *read_line(const StateInfo *globals, GameHeader *game_header, FILE *fpin);
 void reset_line_number(void);
 void restart_lex_for_new_game(void);
+bool resume_input(StateInfo *globals, GameHeader *game_header,
+                  unsigned file_number, InputPosition position);
 void save_assessment(const char *assess);
+bool seek_input_end(void);
+bool seek_input_position(const StateInfo *globals, GameHeader *game_header,
+                         InputPosition position);
 TokenType skip_to_next_game(StateInfo *globals, GameHeader *game_header,
                             TokenType token);
-void suppress_tag(const StateInfo *globals, GameHeader *game_header,
-                  const char *tag_string);
+void suppress_tag(const StateInfo *globals, const char *tag_string);
 const char *tag_header_string(const StateInfo *globals, TagName tag);
 void yyerror(const char *s);
 int yywrap(StateInfo *globals);
@@ -20,11 +20,19 @@
  */
 
 #include "argsfile.h"
+#include "checkpoint.h"
+#include "eco.h"
+#include "gamecache.h"
+#include "gamecost.h"
+#include "gameindex.h"
 #include "grammar.h"
 #include "hashing.h"
 #include "lex.h"
 #include "map.h"
+#include "mymalloc.h"
 #include "output.h"
+#include "perft.h"
+#include "progress.h"
 #include "taglist.h"
 #include "typedef.h"
 
@@ -114,6 +122,19 @@ static StateInfo GlobalState = {
     false,            /* delete_same_setup (--deletesamesetup) */
     false,            /* lichess_comment_fix (--lichesscommentfix) */
     false,            /* keep_only_commented_games (--only_commented_games) */
+    false,            /* build_index (--buildindex) */
+    0,                /* index_ply_limit (--indexply) */
+    false,            /* update_index (--updateindex) */
+    false,            /* use_game_cache (--cache) */
+    1,                /* position_sample_interval (--sampleply) */
+    false,            /* skip_positions_in_check (--skipchecks) */
+    0,                /* compression_level (--compresslevel) */
+    0,                /* perft_depth (--perft) */
+    false,            /* memory_statistics (--memstats) */
+    0,                /* slow_games_to_report (--slowgames) */
+    1,                /* progress_interval (--progressinterval) */
+    60,               /* checkpoint_interval (--checkpointinterval) */
+    0,                /* interned_tag_values (--interntags) */
     0,                /* split_depth_limit */
     NORMALFILE,       /* current_file_type */
     SETUP_TAG_OK,     /* setup_status */
@@ -122,6 +143,12 @@ static StateInfo GlobalState = {
     (char *)NULL,     /* FEN_comment_pattern (-Fpattern) */
     (char *)NULL,     /* drop_comment_pattern (--dropbefore) */
     (char *)NULL,     /* line_number_marker (--linenumbers) */
+    "",               /* compressed_output_suffix (--compress) */
+    (char *)NULL,     /* perft_fen (--perft) */
+    (char *)NULL,     /* perft_suite (--perftsuite) */
+    (char *)NULL,     /* heartbeat_file (--heartbeat) */
+    (char *)NULL,     /* checkpoint_file (--checkpoint) */
+    (char *)NULL,     /* resume_file (--resume) */
     (char *)NULL,     /* current_input_file */
     DEFAULT_ECO_FILE, /* eco_file (-e) */
     (FILE *)NULL,     /* outputfile (-o, -a). Default is stdout */
@@ -164,6 +191,15 @@ int main(int argc, char *argv[]) {
   /* Initialise the lexical analyser's tables. */
   init_lex_tables();
 
+  /* A resumed run must not truncate the output files that it continues,
+   * which are opened as their arguments are processed.
+   */
+  for (argnum = 1; argnum + 1 < argc; argnum++) {
+    if (strcmp(argv[argnum], "--resume") == 0) {
+      globals->resume_file = argv[argnum + 1];
+    }
+  }
+
   /* Allow for some arguments. */
   for (argnum = 1; argnum < argc;) {
     const char *argument = argv[argnum];
@@ -222,6 +258,19 @@ int main(int argc, char *argv[]) {
         if (argnum + 1 < argc) {
           possible_associated_value = argv[argnum + 1];
         }
+        if (strcmp(&argument[2], "perft") == 0) {
+          /* The only argument with two associated values. */
+          if (argnum + 2 >= argc ||
+              sscanf(argv[argnum + 2], "%u", &globals->perft_depth) != 1) {
+            fprintf(globals->logfile,
+                    "--perft requires a FEN position and a depth following "
+                    "it.\n");
+            exit(1);
+          }
+          globals->perft_fen = argv[argnum + 1];
+          argnum += 3;
+          break;
+        }
         /* Find out how many arguments were consumed
          * (1 or 2).
          */
@@ -354,13 +403,14 @@ int main(int argc, char *argv[]) {
   /* Make some adjustments to other settings if JSON output is required. */
   if (globals->json_format) {
     if (globals->output_format != EPD && globals->output_format != CM &&
+        globals->output_format != BIN && globals->output_format != POS &&
         globals->tsv_format == false && globals->ECO_level == DONT_DIVIDE) {
       globals->keep_comments = false;
       globals->keep_variations = false;
       globals->keep_results = false;
     } else {
       fprintf(globals->logfile, "JSON output is not currently supported "
-                                "with -E, -Wepd, -tsv or -Wcm\n");
+                                "with -E, -Wbin, -Wepd, -Wpos, -tsv or -Wcm\n");
       globals->json_format = false;
     }
   }
@@ -368,6 +418,7 @@ int main(int argc, char *argv[]) {
   /* Make some adjustments to other settings if TSV output is required. */
   if (globals->tsv_format) {
     if (globals->json_format == false && globals->output_format != CM &&
+        globals->output_format != BIN && globals->output_format != POS &&
         globals->separate_comment_lines == false) {
       globals->max_line_length = 0;
     } else {
@@ -378,6 +429,20 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  if (globals->perft_fen != NULL || globals->perft_suite != NULL) {
+    /* Check the move generator rather than processing games. */
+    bool ok = true;
+
+    if (globals->perft_fen != NULL) {
+      ok = perft_position(globals, &game_header, globals->perft_fen,
+                          globals->perft_depth);
+    }
+    if (globals->perft_suite != NULL) {
+      ok = perft_suite(globals, &game_header, globals->perft_suite) && ok;
+    }
+    return ok ? 0 : 1;
+  }
+
   /* Prepare the hash tables for duplicate detection. */
   init_duplicate_hash_table(globals);
 
@@ -400,8 +465,15 @@ int main(int argc, char *argv[]) {
   if (!open_first_file(globals)) {
     exit(1);
   }
+  start_checkpoints(globals, &game_header);
 
+  note_setup_memory_use();
+  start_progress(globals);
   yyparse(globals, &game_header, globals->current_file_type);
+  finish_progress(globals);
+  finish_checkpoints(globals);
+  finish_game_indexes(globals);
+  finish_game_cache(globals);
 
   /* @@@ I would prefer this to be somewhere else. */
   if (globals->json_format && !globals->check_only) {
@@ -422,6 +494,23 @@ int main(int argc, char *argv[]) {
             globals->num_games_matched == 1 ? "" : "s",
             globals->num_games_processed);
   }
+  if (globals->memory_statistics) {
+    report_memory_accounting(globals->logfile);
+  }
+  report_slow_games(globals, globals->logfile);
+  /* Close the output files, which completes any that are compressed. */
+  if (globals->ECO_level > DONT_DIVIDE) {
+    close_eco_output_files();
+  } else if (globals->outputfile != stdout && globals->outputfile != NULL) {
+    (void)fclose(globals->outputfile);
+  }
+  if (globals->duplicate_file != NULL) {
+    (void)fclose(globals->duplicate_file);
+  }
+  if (globals->non_matching_file != stdout &&
+      globals->non_matching_file != NULL) {
+    (void)fclose(globals->non_matching_file);
+  }
   if ((globals->logfile != stderr) && (globals->logfile != NULL)) {
     (void)fclose(globals->logfile);
   }
@@ -85,7 +85,7 @@ static MovePair *malloc_move(void) {
     move = move_pool;
     move_pool = move_pool->next;
   } else {
-    move = (MovePair *)malloc_or_die(sizeof(MovePair));
+    move = (MovePair *)malloc_for(MEMORY_MOVE_PAIR, sizeof(MovePair));
   }
   move->next = NULL;
   return move;
@@ -245,7 +245,8 @@ void make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col,
       } else if ((board->EnPassant) && (board->ep_rank == to_rank) &&
                  (board->ep_col == to_col)) {
         /* This is an ep capture. Remove the intermediate pawn. */
-        board->board[RankConvert(to_rank) - 1][ColConvert(to_col)] = EMPTY;
+        BOARD_SQUARE(board, RankConvert(to_rank) - 1, ColConvert(to_col)) =
+            EMPTY;
         board->weak_hash_value ^= hash_lookup(to_col, to_rank - 1, PAWN, BLACK);
         board->EnPassant = false;
       } else {
@@ -259,7 +260,8 @@ void make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col,
       } else if ((board->EnPassant) && (board->ep_rank == to_rank) &&
                  (board->ep_col == to_col)) {
         /* This is an ep capture. Remove the intermediate pawn. */
-        board->board[RankConvert(to_rank) + 1][ColConvert(to_col)] = EMPTY;
+        BOARD_SQUARE(board, RankConvert(to_rank) + 1, ColConvert(to_col)) =
+            EMPTY;
         board->weak_hash_value ^= hash_lookup(to_col, to_rank + 1, PAWN, WHITE);
         board->EnPassant = false;
       } else {
@@ -274,10 +276,10 @@ void make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col,
   } else {
     board->weak_hash_value ^= hash_lookup(from_col, from_rank, piece, colour);
   }
-  board->board[from_r][from_c] = EMPTY;
-  if (board->board[to_r][to_c] != EMPTY) {
+  BOARD_SQUARE(board, from_r, from_c) = EMPTY;
+  if (BOARD_SQUARE(board, to_r, to_c) != EMPTY) {
     /* Delete the removed piece from the hash value. */
-    Piece coloured_piece = board->board[to_r][to_c];
+    Piece coloured_piece = BOARD_SQUARE(board, to_r, to_c);
     Piece removed_piece;
     Colour removed_colour;
 
@@ -325,7 +327,7 @@ void make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col,
     board->halfmove_clock++;
   }
   /* Place the piece at its destination. */
-  board->board[to_r][to_c] = MAKE_COLOURED_PIECE(colour, piece);
+  BOARD_SQUARE(board, to_r, to_c) = MAKE_COLOURED_PIECE(colour, piece);
   /* Insert the moved piece into the hash value. */
   board->weak_hash_value ^= hash_lookup(to_col, to_rank, piece, colour);
   if (!board->EnPassant) {
@@ -339,11 +341,12 @@ void make_move(MoveClass class, Col from_col, Rank from_rank, Col to_col,
       /* It must be removed. */
       board->weak_hash_value ^=
           hash_lookup(castling_rook_col, from_rank, ROOK, colour);
-      board->board[from_r][ColConvert(castling_rook_col)] = EMPTY;
+      BOARD_SQUARE(board, from_r, ColConvert(castling_rook_col)) = EMPTY;
     }
     int rook_offset = (class == KINGSIDE_CASTLE ? -1 : 1);
     /* Place the rook at its destination. */
-    board->board[to_r][to_c + rook_offset] = MAKE_COLOURED_PIECE(colour, ROOK);
+    BOARD_SQUARE(board, to_r, to_c + rook_offset) =
+        MAKE_COLOURED_PIECE(colour, ROOK);
     board->weak_hash_value ^=
         hash_lookup(to_col + rook_offset, to_rank, ROOK, colour);
   }
@@ -368,16 +371,16 @@ MovePair *find_pawn_moves(Col from_col, Rank from_rank, Col to_col,
 
   if ((to_col != 0) && (to_rank != 0)) {
     /* We know the complete destination. */
-    if (board->board[to_r][to_c] == EMPTY) {
+    if (BOARD_SQUARE(board, to_r, to_c) == EMPTY) {
       /* Destination must be empty for this form. */
-      if (board->board[to_r - offset][to_c] == piece_to_move) {
+      if (BOARD_SQUARE(board, to_r - offset, to_c) == piece_to_move) {
         /* MovePair of one square. */
         move = append_move_pair(ToCol(to_c), ToRank(to_r - offset), to_col,
                                 to_rank, NULL);
-      } else if ((board->board[to_r - offset][to_c] == EMPTY) &&
+      } else if ((BOARD_SQUARE(board, to_r - offset, to_c) == EMPTY) &&
                  (to_rank == (colour == WHITE ? '4' : '5'))) {
         /* Special case of initial two square move. */
-        if (board->board[to_r - 2 * offset][to_c] == piece_to_move) {
+        if (BOARD_SQUARE(board, to_r - 2 * offset, to_c) == piece_to_move) {
           move = append_move_pair(ToCol(to_c), ToRank(to_r - 2 * offset),
                                   to_col, to_rank, NULL);
         }
@@ -386,13 +389,13 @@ MovePair *find_pawn_moves(Col from_col, Rank from_rank, Col to_col,
         /* Make sure that there is a valid pawn in position. */
         if (from_col != 0) {
           from_r = to_r - offset;
-          if (board->board[from_r][from_c] == piece_to_move) {
+          if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
             move = append_move_pair(ToCol(from_c), ToRank(from_r), to_col,
                                     ToRank(to_r), NULL);
           }
         }
       }
-    } else if (piece_is_colour(board->board[to_r][to_c],
+    } else if (piece_is_colour(BOARD_SQUARE(board, to_r, to_c),
                                OPPOSITE_COLOUR(colour))) {
       /* Capture on the destination square. */
       if (from_col != 0) {
@@ -401,7 +404,7 @@ MovePair *find_pawn_moves(Col from_col, Rank from_rank, Col to_col,
          */
         if (abs(from_col - to_col) == 1) {
           from_r = to_r - offset;
-          if (board->board[from_r][from_c] == piece_to_move) {
+          if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
             move = append_move_pair(ToCol(from_c), ToRank(from_r), to_col,
                                     to_rank, NULL);
           }
@@ -422,8 +425,8 @@ MovePair *find_pawn_moves(Col from_col, Rank from_rank, Col to_col,
          * veracity.
          */
         to_r = from_r - offset;
-        if (board->board[from_r][from_c] == piece_to_move) {
-          Piece occupant = board->board[to_r][to_c];
+        if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
+          Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
           if ((occupant != EMPTY) &&
               (piece_is_colour(occupant, OPPOSITE_COLOUR(colour)))) {
@@ -451,8 +454,8 @@ MovePair *find_pawn_moves(Col from_col, Rank from_rank, Col to_col,
         }
         for (from_r = start_rank; from_r != end_rank; from_r += offset) {
           to_r = from_r + offset;
-          if (board->board[from_r][from_c] == piece_to_move) {
-            Piece occupant = board->board[to_r][to_c];
+          if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
+            Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
             if ((occupant != EMPTY) &&
                 (piece_is_colour(occupant, OPPOSITE_COLOUR(colour)))) {
@@ -487,7 +490,7 @@ MovePair *find_knight_moves(Col to_col, Rank to_rank, Colour colour,
     int r = Knight_moves[ix] + to_r;
     int c = Knight_moves[ix + 1] + to_c;
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       move_list =
           append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
     }
@@ -515,9 +518,9 @@ MovePair *find_bishop_moves(Col to_col, Rank to_rank, Colour colour,
     do {
       r += Bishop_moves[ix];
       c += Bishop_moves[ix + 1];
-    } while (board->board[r][c] == EMPTY);
+    } while (BOARD_SQUARE(board, r, c) == EMPTY);
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       move_list =
           append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
     }
@@ -545,9 +548,9 @@ MovePair *find_rook_moves(Col to_col, Rank to_rank, Colour colour,
     do {
       r += Rook_moves[ix];
       c += Rook_moves[ix + 1];
-    } while (board->board[r][c] == EMPTY);
+    } while (BOARD_SQUARE(board, r, c) == EMPTY);
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       move_list =
           append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
     }
@@ -575,9 +578,9 @@ MovePair *find_queen_moves(Col to_col, Rank to_rank, Colour colour,
     do {
       r += Queen_moves[ix];
       c += Queen_moves[ix + 1];
-    } while (board->board[r][c] == EMPTY);
+    } while (BOARD_SQUARE(board, r, c) == EMPTY);
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       move_list =
           append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
     }
@@ -602,7 +605,7 @@ MovePair *find_king_moves(Col to_col, Rank to_rank, Colour colour,
     int r = King_moves[ix] + to_r;
     int c = King_moves[ix + 1] + to_c;
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       move_list =
           append_move_pair(ToCol(c), ToRank(r), to_col, to_rank, move_list);
       found = true;
@@ -630,7 +633,7 @@ MovePair *find_king_moves(Col to_col, Rank to_rank, Colour colour,
     if (possible_castling_move) {
       int c = ColConvert(COLBASE);
       for (char col = COLBASE; col < COLBASE + BOARDSIZE && !found; col++) {
-        if (board->board[to_r][c] == target_piece) {
+        if (BOARD_SQUARE(board, to_r, c) == target_piece) {
           move_list =
               append_move_pair(col, to_rank, to_col, to_rank, move_list);
           found = true;
@@ -662,15 +665,15 @@ static bool find_single_pawn_move(Col from_col, Rank from_rank, Col to_col,
 
   if ((to_col != 0) && (to_rank != 0)) {
     /* We know the complete destination. */
-    if (board->board[to_r][to_c] == EMPTY) {
+    if (BOARD_SQUARE(board, to_r, to_c) == EMPTY) {
       /* Destination must be empty for this form. */
-      if (board->board[to_r - offset][to_c] == piece_to_move) {
+      if (BOARD_SQUARE(board, to_r - offset, to_c) == piece_to_move) {
         /* MovePair of one square. */
         found = true;
-      } else if ((board->board[to_r - offset][to_c] == EMPTY) &&
+      } else if ((BOARD_SQUARE(board, to_r - offset, to_c) == EMPTY) &&
                  (to_rank == (colour == WHITE ? '4' : '5'))) {
         /* Special case of initial two square move. */
-        if (board->board[to_r - 2 * offset][to_c] == piece_to_move) {
+        if (BOARD_SQUARE(board, to_r - 2 * offset, to_c) == piece_to_move) {
           found = true;
         }
       } else if (board->EnPassant && (board->ep_rank == to_rank) &&
@@ -678,18 +681,18 @@ static bool find_single_pawn_move(Col from_col, Rank from_rank, Col to_col,
         /* Make sure that there is a valid pawn in position. */
         if (from_col != 0) {
           from_r = to_r - offset;
-          if (board->board[from_r][from_c] == piece_to_move) {
+          if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
             found = true;
           }
         }
       }
-    } else if (piece_is_colour(board->board[to_r][to_c],
+    } else if (piece_is_colour(BOARD_SQUARE(board, to_r, to_c),
                                OPPOSITE_COLOUR(colour))) {
       /* Capture on the destination square. */
       if (from_col != 0) {
         /* We know the from column. */
         from_r = to_r - offset;
-        if (board->board[from_r][from_c] == piece_to_move) {
+        if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
           found = true;
         }
       }
@@ -706,8 +709,8 @@ static bool find_single_pawn_move(Col from_col, Rank from_rank, Col to_col,
          * veracity.
          */
         to_r = from_r - offset;
-        if (board->board[from_r][from_c] == piece_to_move) {
-          Piece occupant = board->board[to_r][to_c];
+        if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
+          Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
           if ((occupant != EMPTY) &&
               (piece_is_colour(occupant, OPPOSITE_COLOUR(colour)))) {
@@ -734,8 +737,8 @@ static bool find_single_pawn_move(Col from_col, Rank from_rank, Col to_col,
         for (from_r = start_rank; from_r != end_rank && !found;
              from_r += offset) {
           to_r = from_r + offset;
-          if (board->board[from_r][from_c] == piece_to_move) {
-            Piece occupant = board->board[to_r][to_c];
+          if (BOARD_SQUARE(board, from_r, from_c) == piece_to_move) {
+            Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
             if ((occupant != EMPTY) &&
                 (piece_is_colour(occupant, OPPOSITE_COLOUR(colour)))) {
@@ -768,7 +771,7 @@ static bool find_single_knight_move(Col to_col, Rank to_rank, Colour colour,
     int r = Knight_moves[ix] + to_r;
     int c = Knight_moves[ix + 1] + to_c;
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       found = true;
     }
   }
@@ -795,9 +798,9 @@ static bool find_single_bishop_move(Col to_col, Rank to_rank, Colour colour,
     do {
       r += Bishop_moves[ix];
       c += Bishop_moves[ix + 1];
-    } while (board->board[r][c] == EMPTY);
+    } while (BOARD_SQUARE(board, r, c) == EMPTY);
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       found = true;
     }
   }
@@ -824,9 +827,9 @@ static bool find_single_rook_move(Col to_col, Rank to_rank, Colour colour,
     do {
       r += Rook_moves[ix];
       c += Rook_moves[ix + 1];
-    } while (board->board[r][c] == EMPTY);
+    } while (BOARD_SQUARE(board, r, c) == EMPTY);
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       found = true;
     }
   }
@@ -853,9 +856,9 @@ static bool find_single_queen_move(Col to_col, Rank to_rank, Colour colour,
     do {
       r += Queen_moves[ix];
       c += Queen_moves[ix + 1];
-    } while (board->board[r][c] == EMPTY);
+    } while (BOARD_SQUARE(board, r, c) == EMPTY);
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       found = true;
     }
   }
@@ -878,7 +881,7 @@ static bool find_single_king_move(Col to_col, Rank to_rank, Colour colour,
     int r = King_moves[ix] + to_r;
     int c = King_moves[ix + 1] + to_c;
 
-    if (board->board[r][c] == target_piece) {
+    if (BOARD_SQUARE(board, r, c) == target_piece) {
       found = true;
     }
   }
@@ -1194,7 +1197,7 @@ static bool knight_move(const StateInfo *globals, Move *move_details,
     Ok = false;
   } else if (move_list->next == NULL) {
     /* Only one possible.  Check for legality. */
-    Piece occupant = board->board[to_r][to_c];
+    Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
     if ((occupant == EMPTY) ||
         piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
@@ -1239,7 +1242,7 @@ static bool bishop_move(const StateInfo *globals, Move *move_details,
     Ok = false;
   } else if (move_list->next == NULL) {
     /* Only one possible.  Check for legality. */
-    Piece occupant = board->board[to_r][to_c];
+    Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
     if ((occupant == EMPTY) ||
         piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
@@ -1289,7 +1292,7 @@ static bool rook_move(const StateInfo *globals, Move *move_details,
       Ok = false;
     } else if (move_list->next == NULL) {
       /* Only one possible.  Check for legality. */
-      Piece occupant = board->board[to_r][to_c];
+      Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
       if ((occupant == EMPTY) ||
           piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
@@ -1336,7 +1339,7 @@ static bool queen_move(const StateInfo *globals, Move *move_details,
     Ok = false;
   } else if (move_list->next == NULL) {
     /* Only one possible.  Check for legality. */
-    Piece occupant = board->board[to_r][to_c];
+    Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
     if ((occupant == EMPTY) ||
         piece_is_colour(occupant, OPPOSITE_COLOUR(colour))) {
@@ -1374,13 +1377,14 @@ Col find_castling_king_col(Colour colour, const Board *board) {
   }
 
   /* Short-circuit check for standard chess. */
-  if ((board->board[king_r][ColConvert('e')] == coloured_king)) {
+  if ((BOARD_SQUARE(board, king_r, ColConvert('e')) == coloured_king)) {
     return 'e';
   } else {
     /* Search elsewhere. */
     Col king_col = FIRSTCOL;
     while (!found && king_col <= LASTCOL) {
-      if ((board->board[king_r][ColConvert(king_col)] == coloured_king)) {
+      if ((BOARD_SQUARE(board, king_r, ColConvert(king_col)) ==
+           coloured_king)) {
         found = true;
       } else {
         king_col++;
@@ -1418,7 +1422,8 @@ Col find_castling_rook_col(Colour colour, const Board *board,
 
   if (rook_col == '\0') {
     return '\0';
-  } else if ((board->board[rook_r][ColConvert(rook_col)] == coloured_rook)) {
+  } else if ((BOARD_SQUARE(board, rook_r, ColConvert(rook_col)) ==
+              coloured_rook)) {
     return rook_col;
   } else {
     return '\0';
@@ -1476,7 +1481,7 @@ static bool can_castle(MoveClass castling, Colour colour,
     bool check_again = true;
     while (Ok && check_again) {
       check_again = next_c != king_final_c;
-      if (board->board[king_r][next_c] == EMPTY) {
+      if (BOARD_SQUARE(board, king_r, next_c) == EMPTY) {
       } else if (next_c == rook_c) {
         /* Permitted. */
       } else {
@@ -1493,7 +1498,7 @@ static bool can_castle(MoveClass castling, Colour colour,
     bool check_again = true;
     while (Ok && check_again) {
       check_again = next_c != rook_final_c;
-      if (board->board[king_r][next_c] == EMPTY) {
+      if (BOARD_SQUARE(board, king_r, next_c) == EMPTY) {
         /* Ok. */
       } else if (next_c == king_c) {
         /* Permitted. */
@@ -1590,7 +1595,7 @@ static bool king_move(const StateInfo *globals, Move *move_details,
     /* Check for legality. */
     int to_r = RankConvert(to_rank);
     int to_c = ColConvert(to_col);
-    Piece occupant = board->board[to_r][to_c];
+    Piece occupant = BOARD_SQUARE(board, to_r, to_c);
 
     if (occupant == MAKE_COLOURED_PIECE(colour, ROOK)) {
       /* Possible Chess960 castling move. */
@@ -1853,13 +1858,13 @@ bool determine_move_details(const StateInfo *globals, GameHeader *game_header,
       int to_c = ColConvert(move_details->to_col);
 
       /* Keep track of any capture. */
-      if (board->board[to_r][to_c] != EMPTY) {
+      if (BOARD_SQUARE(board, to_r, to_c) != EMPTY) {
         if (class == KINGSIDE_CASTLE || class == QUEENSIDE_CASTLE) {
           /* Castling in Chess960 games looks like a rook capture. */
           move_details->captured_piece = EMPTY;
         } else {
           move_details->captured_piece =
-              EXTRACT_PIECE(board->board[to_r][to_c]);
+              EXTRACT_PIECE(BOARD_SQUARE(board, to_r, to_c));
         }
       } else if (move_details->class == ENPASSANT_PAWN_MOVE) {
         move_details->captured_piece = PAWN;
@@ -1897,12 +1902,12 @@ static MovePair *generate_single_moves(Colour colour, Piece piece,
   for (ix = 0; ix < 2 * num_directions; ix += 2) {
     int r = Piece_moves[ix] + from_r;
     int c = Piece_moves[ix + 1] + from_c;
-    Piece occupant = board->board[r][c];
+    Piece occupant = BOARD_SQUARE(board, r, c);
     bool Ok = false;
 
     if (occupant == OFF) {
       /* Not a valid move. */
-    } else if (board->board[r][c] == EMPTY) {
+    } else if (BOARD_SQUARE(board, r, c) == EMPTY) {
       Ok = true;
     } else if (EXTRACT_COLOUR(occupant) == target_colour) {
       Ok = true;
@@ -1943,7 +1948,7 @@ static MovePair *generate_multiple_moves(Colour colour, Piece piece,
   for (ix = 0; ix < 2 * num_directions; ix += 2) {
     int r = Piece_moves[ix] + from_r;
     int c = Piece_moves[ix + 1] + from_c;
-    Piece occupant = board->board[r][c];
+    Piece occupant = BOARD_SQUARE(board, r, c);
 
     /* Include EMPTY squares as possible moves. */
     while (occupant == EMPTY) {
@@ -1952,7 +1957,7 @@ static MovePair *generate_multiple_moves(Colour colour, Piece piece,
       /* Move on to the next square in this direction. */
       r += Piece_moves[ix];
       c += Piece_moves[ix + 1];
-      occupant = board->board[r][c];
+      occupant = BOARD_SQUARE(board, r, c);
     }
     /* We have come up against an obstruction. */
     if (occupant == OFF) {
@@ -1983,7 +1988,7 @@ static MovePair *generate_pawn_moves(Colour colour, const Board *board,
 
   /* Try single step ahead. */
   to_r = RankConvert(from_rank) + offset;
-  if (board->board[to_r][to_c] == EMPTY) {
+  if (BOARD_SQUARE(board, to_r, to_c) == EMPTY) {
     /* Fill in the details, and add it to the list. */
     moves =
         append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
@@ -1991,7 +1996,7 @@ static MovePair *generate_pawn_moves(Colour colour, const Board *board,
         ((colour == BLACK) && (from_rank == LASTRANK - 1))) {
       /* Try two steps. */
       to_r = RankConvert(from_rank) + 2 * offset;
-      if (board->board[to_r][to_c] == EMPTY) {
+      if (BOARD_SQUARE(board, to_r, to_c) == EMPTY) {
         moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r),
                                  moves);
       }
@@ -2000,14 +2005,14 @@ static MovePair *generate_pawn_moves(Colour colour, const Board *board,
   /* Try to the left. */
   to_r = RankConvert(from_rank + offset);
   to_c = ColConvert(from_col - 1);
-  if (board->board[to_r][to_c] == OFF) {
-  } else if (board->board[to_r][to_c] == EMPTY) {
+  if (BOARD_SQUARE(board, to_r, to_c) == OFF) {
+  } else if (BOARD_SQUARE(board, to_r, to_c) == EMPTY) {
     if (board->EnPassant && board->ep_rank == valid_ep_rank &&
         (ToRank(to_r) == board->ep_rank) && (ToCol(to_c) == board->ep_col)) {
       moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r),
                                moves);
     }
-  } else if (EXTRACT_COLOUR(board->board[to_r][to_c]) == target_colour) {
+  } else if (EXTRACT_COLOUR(BOARD_SQUARE(board, to_r, to_c)) == target_colour) {
     moves =
         append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
   } else {
@@ -2016,14 +2021,14 @@ static MovePair *generate_pawn_moves(Colour colour, const Board *board,
   /* Try to the right. */
   to_r = RankConvert(from_rank) + offset;
   to_c = ColConvert(from_col) + 1;
-  if (board->board[to_r][to_c] == OFF) {
-  } else if (board->board[to_r][to_c] == EMPTY) {
+  if (BOARD_SQUARE(board, to_r, to_c) == OFF) {
+  } else if (BOARD_SQUARE(board, to_r, to_c) == EMPTY) {
     if (board->EnPassant && board->ep_rank == valid_ep_rank &&
         (ToRank(to_r) == board->ep_rank) && (ToCol(to_c) == board->ep_col)) {
       moves = append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r),
                                moves);
     }
-  } else if (EXTRACT_COLOUR(board->board[to_r][to_c]) == target_colour) {
+  } else if (EXTRACT_COLOUR(BOARD_SQUARE(board, to_r, to_c)) == target_colour) {
     moves =
         append_move_pair(from_col, from_rank, ToCol(to_c), ToRank(to_r), moves);
   } else {
@@ -2056,7 +2061,7 @@ bool king_is_in_checkmate(const StateInfo *globals, Colour colour,
     for (col = FIRSTCOL; (col <= LASTCOL) && (moves == NULL); col++) {
       int r = RankConvert(rank);
       int c = ColConvert(col);
-      Piece occupant = board->board[r][c];
+      Piece occupant = BOARD_SQUARE(board, r, c);
 
       if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
         /* This square is occupied by a piece of the required colour. */
@@ -2115,7 +2120,7 @@ static unsigned approx_how_many_moves(Board *board) {
     for (col = FIRSTCOL; col <= LASTCOL; col++) {
       int r = RankConvert(rank);
       int c = ColConvert(col);
-      Piece occupant = board->board[r][c];
+      Piece occupant = BOARD_SQUARE(board, r, c);
       MovePair *moves = NULL;
 
       if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
@@ -2170,7 +2175,7 @@ MovePair *find_all_moves(const StateInfo *globals, const Board *board,
     int r = RankConvert(rank);
     for (col = FIRSTCOL; col <= LASTCOL; col++) {
       int c = ColConvert(col);
-      Piece occupant = board->board[r][c];
+      Piece occupant = BOARD_SQUARE(board, r, c);
 
       if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
         /* This square is occupied by a piece of the required colour. */
@@ -2185,7 +2190,8 @@ MovePair *find_all_moves(const StateInfo *globals, const Board *board,
            * by GenerateSingleMoves.
            */
           if (can_castle(KINGSIDE_CASTLE, colour, board)) {
-            MovePair *m = (MovePair *)malloc_or_die(sizeof(MovePair));
+            MovePair *m =
+                (MovePair *)malloc_for(MEMORY_MOVE_PAIR, sizeof(MovePair));
             m->from_col = find_castling_king_col(colour, board);
             m->from_rank = rank;
             m->to_col = 'g';
@@ -2195,7 +2201,8 @@ MovePair *find_all_moves(const StateInfo *globals, const Board *board,
             moves = m;
           }
           if (can_castle(QUEENSIDE_CASTLE, colour, board)) {
-            MovePair *m = (MovePair *)malloc_or_die(sizeof(MovePair));
+            MovePair *m =
+                (MovePair *)malloc_for(MEMORY_MOVE_PAIR, sizeof(MovePair));
             m->from_col = find_castling_king_col(colour, board);
             m->from_rank = rank;
             m->to_col = 'c';
@@ -2248,7 +2255,7 @@ bool at_least_one_move(const StateInfo *globals, const Board *board,
   for (Rank rank = LASTRANK; rank >= FIRSTRANK && !move_found; rank--) {
     int r = RankConvert(rank);
     for (Col col = FIRSTCOL; col <= LASTCOL && !move_found; col++) {
-      Piece occupant = board->board[r][ColConvert(col)];
+      Piece occupant = BOARD_SQUARE(board, r, ColConvert(col));
 
       if ((occupant != EMPTY) && (colour == EXTRACT_COLOUR(occupant))) {
         /* This square is occupied by a piece of the required colour. */
@@ -2305,3 +2312,139 @@ bool at_least_one_move(const StateInfo *globals, const Board *board,
   }
   return move_found;
 }
+
+/* Play a move generated for perft on board, including the placement
+ * of any promoted piece, and pass the move to the other side.
+ */
+static void play_perft_move(MoveClass class, Col from_col, Rank from_rank,
+                            Col to_col, Rank to_rank, Piece piece,
+                            Piece promoted_piece, Board *board) {
+  Colour colour = board->to_move;
+
+  make_move(class, from_col, from_rank, to_col, to_rank, piece, colour, board);
+  if (class == PAWN_MOVE_WITH_PROMOTION) {
+    make_move(class, to_col, to_rank, to_col, to_rank, promoted_piece, colour,
+              board);
+  }
+  board->to_move = OPPOSITE_COLOUR(colour);
+  if (board->to_move == WHITE) {
+    board->move_number++;
+  }
+}
+
+/* Count the leaves below a single move for perft, and report the
+ * count to divide, if it is not NULL.
+ */
+static unsigned long perft_move(const StateInfo *globals, const Board *board,
+                                unsigned depth, FILE *divide, MoveClass class,
+                                Col from_col, Rank from_rank, Col to_col,
+                                Rank to_rank, Piece piece,
+                                Piece promoted_piece) {
+  unsigned long nodes;
+
+  if (depth <= 1) {
+    nodes = 1;
+  } else {
+    Board next_board = *board;
+
+    play_perft_move(class, from_col, from_rank, to_col, to_rank, piece,
+                    promoted_piece, &next_board);
+    nodes = perft(globals, &next_board, depth - 1, NULL);
+  }
+  if (divide != NULL) {
+    fprintf(divide, "%c%c%c%c", from_col, from_rank, to_col, to_rank);
+    if (class == PAWN_MOVE_WITH_PROMOTION) {
+      fputc(promoted_piece == QUEEN    ? 'q'
+            : promoted_piece == ROOK   ? 'r'
+            : promoted_piece == BISHOP ? 'b'
+                                       : 'n',
+            divide);
+    }
+    fprintf(divide, ": %lu\n", nodes);
+  }
+  return nodes;
+}
+
+/* Count the positions reached by all sequences of depth legal moves
+ * from board (perft), for validating the move generator.
+ * If divide is not NULL, the count below each of the moves from board
+ * is reported to it.
+ */
+unsigned long perft(const StateInfo *globals, const Board *board,
+                    unsigned depth, FILE *divide) {
+  static const Piece promotions[] = {QUEEN, ROOK, BISHOP, KNIGHT};
+  Colour colour = board->to_move;
+  Rank promotion_rank = colour == WHITE ? LASTRANK : FIRSTRANK;
+  unsigned long nodes = 0;
+
+  if (depth == 0) {
+    return 1;
+  }
+  for (Rank rank = LASTRANK; rank >= FIRSTRANK; rank--) {
+    int r = RankConvert(rank);
+    for (Col col = FIRSTCOL; col <= LASTCOL; col++) {
+      Piece occupant = BOARD_SQUARE(board, r, ColConvert(col));
+      Piece piece;
+      MovePair *moves = NULL;
+
+      if (occupant == EMPTY || colour != EXTRACT_COLOUR(occupant)) {
+        continue;
+      }
+      piece = EXTRACT_PIECE(occupant);
+      switch (piece) {
+      case KING:
+      case KNIGHT:
+        moves = generate_single_moves(colour, piece, board, col, rank);
+        break;
+      case QUEEN:
+      case ROOK:
+      case BISHOP:
+        moves = generate_multiple_moves(colour, piece, board, col, rank);
+        break;
+      case PAWN:
+        moves = generate_pawn_moves(colour, board, col, rank);
+        break;
+      default:
+        fprintf(globals->logfile,
+                "Internal error: unknown piece %d in perft().\n", piece);
+      }
+      for (MovePair *m = moves; m != NULL; m = m->next) {
+        if (piece != PAWN) {
+          nodes += perft_move(globals, board, depth, divide, PIECE_MOVE,
+                              m->from_col, m->from_rank, m->to_col, m->to_rank,
+                              piece, EMPTY);
+        } else if (m->to_rank == promotion_rank) {
+          for (unsigned p = 0; p < sizeof(promotions) / sizeof(*promotions);
+               p++) {
+            nodes += perft_move(globals, board, depth, divide,
+                                PAWN_MOVE_WITH_PROMOTION, m->from_col,
+                                m->from_rank, m->to_col, m->to_rank, PAWN,
+                                promotions[p]);
+          }
+        } else {
+          bool en_passant =
+              m->from_col != m->to_col &&
+              BOARD_SQUARE(board, RankConvert(m->to_rank),
+                           ColConvert(m->to_col)) == EMPTY;
+
+          nodes += perft_move(
+              globals, board, depth, divide,
+              en_passant ? ENPASSANT_PAWN_MOVE : PAWN_MOVE, m->from_col,
+              m->from_rank, m->to_col, m->to_rank, PAWN, EMPTY);
+        }
+      }
+      free_move_pair_list(moves);
+      if (piece == KING) {
+        if (can_castle(KINGSIDE_CASTLE, colour, board)) {
+          nodes += perft_move(globals, board, depth, divide, KINGSIDE_CASTLE,
+                              col, rank, 'g', rank, KING, EMPTY);
+        }
+        if (can_castle(QUEENSIDE_CASTLE, colour, board)) {
+          nodes += perft_move(globals, board, depth, divide, QUEENSIDE_CASTLE,
+                              col, rank, 'c', rank, KING, EMPTY);
+        }
+      }
+    }
+  }
+  return nodes;
+}
@@ -57,5 +57,7 @@ MovePair *find_all_moves(const StateInfo *globals, const Board *board,
                          Colour colour);
 bool at_least_one_move(const StateInfo *globals, const Board *board,
                        Colour colour);
+unsigned long perft(const StateInfo *globals, const Board *board,
+                    unsigned depth, FILE *divide);
 
 #endif // MAP_H
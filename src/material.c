@@ -512,7 +512,7 @@ static void extract_pieces_from_board(int num_pieces[2][NUM_PIECE_VALUES],
       int r = RankConvert(rank);
       int c = ColConvert(col);
 
-      Piece coloured_piece = board->board[r][c];
+      Piece coloured_piece = BOARD_SQUARE(board, r, c);
       if (coloured_piece != EMPTY) {
         int p = EXTRACT_PIECE(coloured_piece);
         num_pieces[EXTRACT_COLOUR(coloured_piece)][p]++;
@@ -654,6 +654,61 @@ bool check_for_material_match(const StateInfo *globals, GameHeader *game_header,
   }
 }
 
+/* Return whether there are any material balances to match. */
+bool material_criteria_present(void) { return endings_to_match != NULL; }
+
+/* Set signature from the numbers of pieces on board. */
+void material_signature(const Board *board,
+                        unsigned char signature[MATERIAL_SIGNATURE_LENGTH]) {
+  int num_pieces[2][NUM_PIECE_VALUES];
+
+  extract_pieces_from_board(num_pieces, board);
+  for (Colour colour = BLACK; colour <= WHITE; colour++) {
+    for (Piece piece = PAWN; piece < KING; piece++) {
+      signature[colour * (KING - PAWN) + (piece - PAWN)] =
+          (unsigned char)num_pieces[colour][piece];
+    }
+  }
+}
+
+/* Would a game whose num_positions positions have the material
+ * of the given runs match one of the material criteria?
+ * This follows look_for_material_match, but without the need to
+ * play the moves.
+ */
+bool material_runs_match(const StateInfo *globals, const MaterialRun *runs,
+                         unsigned num_runs, unsigned num_positions) {
+  int num_pieces[2][NUM_PIECE_VALUES] = {{0}};
+
+  reset_match_depths(endings_to_match);
+  for (unsigned run = 0; run < num_runs; run++) {
+    unsigned end = run + 1 < num_runs ? runs[run + 1].first_position
+                                      : num_positions;
+
+    for (Colour colour = BLACK; colour <= WHITE; colour++) {
+      for (Piece piece = PAWN; piece < KING; piece++) {
+        num_pieces[colour][piece] =
+            runs[run].signature[colour * (KING - PAWN) + (piece - PAWN)];
+      }
+    }
+    for (unsigned position = runs[run].first_position; position < end;
+         position++) {
+      for (MaterialCriteria *details_to_find = endings_to_match;
+           details_to_find != NULL; details_to_find = details_to_find->next) {
+        bool white_matches =
+            material_match(globals, details_to_find, num_pieces, WHITE);
+        bool black_matches =
+            details_to_find->both_colours &&
+            material_match(globals, details_to_find, num_pieces, BLACK);
+        if (white_matches || black_matches) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
 /* Does the board's material match the constraints of details_to_find?
  * Return true if it does, false otherwise.
  */
@@ -51,6 +51,18 @@ typedef struct MaterialCriterias {
 } MaterialCriterias;
 */
 
+/* The number of counts in a material signature: those of the pawns,
+ * knights, bishops, rooks and queens of each colour.
+ */
+#define MATERIAL_SIGNATURE_LENGTH 10
+
+/* A sequence of positions in a game with the same material. */
+typedef struct {
+  /* The number (from 0) of the first position with this material. */
+  unsigned first_position;
+  unsigned char signature[MATERIAL_SIGNATURE_LENGTH];
+} MaterialRun;
+
 /* Character to separate a pattern from material constraints.
  * NB: This is used to add a material constraint to a FEN pattern.
  */
@@ -64,6 +76,11 @@ bool constraint_material_match(const StateInfo *globals,
                                MaterialCriteria *details_to_find,
                                const Board *board);
 bool insufficient_material(const Board *board);
+bool material_criteria_present(void);
+bool material_runs_match(const StateInfo *globals, const MaterialRun *runs,
+                         unsigned num_runs, unsigned num_positions);
+void material_signature(const Board *board,
+                        unsigned char signature[MATERIAL_SIGNATURE_LENGTH]);
 MaterialCriteria *process_material_description(const StateInfo *globals,
                                                const char *line,
                                                bool both_colours,
@@ -714,6 +714,9 @@ static bool is_insufficient_material(const Board *board) {
   return insufficient_material(board);
 }
 
+/* Return whether there are any textual variations to match. */
+bool textual_variations_present(void) { return games_to_keep != NULL; }
+
 /* Determine whether or not the current game is wanted.
  * It will be if it matches one of the current variations
  * and its tag details match those that we are interested in.
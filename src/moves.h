@@ -48,6 +48,7 @@ bool check_textual_variations(const StateInfo *globals,
                               const Game *game_details);
 bool is_stalemate(const StateInfo *globals, const Board *board,
                   const Move *moves);
+bool textual_variations_present(void);
 
 void free_move_list(GameHeader *game_header, Move *move_list);
 
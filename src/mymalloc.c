@@ -21,11 +21,57 @@
 
 #include "mymalloc.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif
+
+/* The accounting of allocations for --memstats.
+ * Frees are not seen here, so the heap in use is sampled from the
+ * allocator at the end of each game.
+ * Only the thread that starts the accounting counts its allocations,
+ * so those of the threads that decompress input and compress output
+ * are neither charged to games nor made concurrently with the counts.
+ */
+static _Thread_local bool accounting = false;
+
+typedef struct {
+  unsigned long allocations;
+  unsigned long long bytes;
+} MemoryUse;
+
+static MemoryUse memory_use[NUM_MEMORY_CATEGORIES];
+/* The totals over all categories. */
+static MemoryUse total_use;
+/* The totals before the first game, such as for the ECO table. */
+static MemoryUse setup_use;
+/* The totals at the end of the previous game. */
+static MemoryUse previous_game_use;
+/* The most used by a single game. */
+static MemoryUse most_game_use;
+static unsigned long games_seen = 0;
+#ifdef HAVE_MALLINFO2
+static size_t peak_heap_in_use = 0;
+#endif
+
+static const char *const category_names[NUM_MEMORY_CATEGORIES] = {
+    "other",        "lexer strings", "moves",      "comments", "tags",
+    "hash entries", "ECO",           "move pairs", "output"};
+
+static void account(MemoryCategory category, size_t nbytes) {
+  memory_use[category].allocations++;
+  memory_use[category].bytes += nbytes;
+  total_use.allocations++;
+  total_use.bytes += nbytes;
+}
 
 /* Allocate the required space or abort the program. */
-void *malloc_or_die(size_t nbytes) {
+void *malloc_or_die(size_t nbytes) { return malloc_for(MEMORY_OTHER, nbytes); }
+
+/* Allocate the required space for category or abort the program. */
+void *malloc_for(MemoryCategory category, size_t nbytes) {
   void *result;
 
   result = malloc(nbytes);
@@ -33,11 +79,22 @@ void *malloc_or_die(size_t nbytes) {
     perror("malloc or die");
     abort();
   }
+  if (accounting) {
+    account(category, nbytes);
+  }
   return result;
 }
 
 /* Allocate the required space or abort the program. */
 void *realloc_or_die(void *space, size_t nbytes) {
+  return realloc_for(MEMORY_OTHER, space, 0, nbytes);
+}
+
+/* Reallocate the required space for category or abort the program.
+ * old_size is the size of space, of which only the growth is counted.
+ */
+void *realloc_for(MemoryCategory category, void *space, size_t old_size,
+                  size_t nbytes) {
   void *result;
 
   result = realloc(space, nbytes);
@@ -45,5 +102,73 @@ void *realloc_or_die(void *space, size_t nbytes) {
     perror("realloc or die");
     abort();
   }
+  if (accounting) {
+    account(category, nbytes > old_size ? nbytes - old_size : 0);
+  }
   return result;
 }
+
+/* Return the number of allocations counted so far. */
+unsigned long allocations_made(void) { return total_use.allocations; }
+
+/* Count subsequent allocations of the calling thread
+ * (--memstats, --slowgames).
+ */
+void start_memory_accounting(void) { accounting = true; }
+
+/* Mark the start of the games, so that the allocations made in
+ * setting up are not attributed to the first game.
+ */
+void note_setup_memory_use(void) { setup_use = previous_game_use = total_use; }
+
+/* Record the allocations of the game just processed, and sample
+ * the heap in use, while the game is still held.
+ */
+void note_game_memory_use(void) {
+  if (accounting) {
+    unsigned long allocations =
+        total_use.allocations - previous_game_use.allocations;
+    unsigned long long bytes = total_use.bytes - previous_game_use.bytes;
+
+    if (allocations > most_game_use.allocations) {
+      most_game_use.allocations = allocations;
+    }
+    if (bytes > most_game_use.bytes) {
+      most_game_use.bytes = bytes;
+    }
+    previous_game_use = total_use;
+    games_seen++;
+#ifdef HAVE_MALLINFO2
+    struct mallinfo2 info = mallinfo2();
+
+    if (info.uordblks > peak_heap_in_use) {
+      peak_heap_in_use = info.uordblks;
+    }
+#endif
+  }
+}
+
+/* Report the allocations of each category, and per game, to fp. */
+void report_memory_accounting(FILE *fp) {
+  if (!accounting) {
+    return;
+  }
+  fprintf(fp, "%-16s %14s %16s\n", "memory use", "allocations", "bytes");
+  for (int category = 0; category < NUM_MEMORY_CATEGORIES; category++) {
+    fprintf(fp, "%-16s %14lu %16llu\n", category_names[category],
+            memory_use[category].allocations, memory_use[category].bytes);
+  }
+  fprintf(fp, "%-16s %14lu %16llu\n", "total", total_use.allocations,
+          total_use.bytes);
+  if (games_seen > 0) {
+    fprintf(fp, "%-16s %14.1f %16.1f\n", "mean per game",
+            (double)(previous_game_use.allocations - setup_use.allocations) /
+                games_seen,
+            (double)(previous_game_use.bytes - setup_use.bytes) / games_seen);
+    fprintf(fp, "%-16s %14lu %16llu\n", "most per game",
+            most_game_use.allocations, most_game_use.bytes);
+#ifdef HAVE_MALLINFO2
+    fprintf(fp, "Peak heap in use after a game: %zu bytes\n", peak_heap_in_use);
+#endif
+  }
+}
@@ -23,9 +23,37 @@
 #define MYMALLOC_H
 
 #include <stddef.h>
+#include <stdio.h>
 
+/* The subsystems to which allocations are attributed by --memstats.
+ * Allocations by malloc_or_die and realloc_or_die are MEMORY_OTHER.
+ * realloc_for is given the size of the space it replaces, so that only
+ * the growth is counted.
+ */
+typedef enum {
+  MEMORY_OTHER,
+  MEMORY_LEXER_STRING,
+  MEMORY_MOVE,
+  MEMORY_COMMENT,
+  MEMORY_TAG,
+  MEMORY_HASH,
+  MEMORY_ECO,
+  MEMORY_MOVE_PAIR,
+  MEMORY_OUTPUT,
+  NUM_MEMORY_CATEGORIES
+} MemoryCategory;
+
+unsigned long allocations_made(void);
 void *malloc_or_die(size_t nbytes);
+void *malloc_for(MemoryCategory category, size_t nbytes);
 void *realloc_or_die(void *space, size_t nbytes);
+void *realloc_for(MemoryCategory category, void *space, size_t old_size,
+                  size_t nbytes);
 char *copy_string(const char *str);
+char *copy_string_for(MemoryCategory category, const char *str);
+void start_memory_accounting(void);
+void note_setup_memory_use(void);
+void note_game_memory_use(void);
+void report_memory_accounting(FILE *fp);
 
 #endif // MYMALLOC_H
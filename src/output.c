@@ -22,10 +22,13 @@
 #include "output.h"
 
 #include "apply.h"
+#include "binary.h"
+#include "decode.h"
 #include "defs.h"
 #include "grammar.h"
 #include "lex.h"
 #include "mymalloc.h"
+#include "positions.h"
 #include "taglist.h"
 #include "typedef.h"
 
@@ -64,8 +67,7 @@ print_items_following_move(const StateInfo *globals, GameHeader *game_header,
                            FILE *outputfile, const Move *move_details,
                            unsigned move_number, bool white_to_move);
 static void output_STR(const StateInfo *globals, FILE *outfp, char **Tags);
-static void show_tags(const StateInfo *globals, FILE *outfp, char **Tags,
-                      int tags_length);
+static void show_tags(const StateInfo *globals, FILE *outfp, const Game *game);
 static char promoted_piece_letter(Piece piece);
 static void print_algebraic_game(const StateInfo *globals,
                                  GameHeader *game_header, Game *current_game,
@@ -173,6 +175,10 @@ OutputFormat which_output_format(const StateInfo *globals, const char *arg) {
                  {"XOLALG", XOLALG},
                  {"xolalg", XOLALG},
                  {"uci", UCI},
+                 {"bin", BIN},
+                 {"BIN", BIN},
+                 {"pos", POS},
+                 {"POS", POS},
                  {"cm", CM},
                  {"", SOURCE},
                  /* Add others before the terminating NULL. */
@@ -211,6 +217,8 @@ const char *output_file_suffix(OutputFormat format) {
   static const char EPD_suffix[] = ".epd";
   static const char FEN_suffix[] = ".fen";
   static const char CM_suffix[] = ".cm";
+  static const char BIN_suffix[] = BINARY_FILE_SUFFIX;
+  static const char POS_suffix[] = POSITION_RECORD_SUFFIX;
 
   switch (format) {
   case SOURCE:
@@ -228,6 +236,10 @@ const char *output_file_suffix(OutputFormat format) {
     return FEN_suffix;
   case CM:
     return CM_suffix;
+  case BIN:
+    return BIN_suffix;
+  case POS:
+    return POS_suffix;
   default:
     return PGN_suffix;
   }
@@ -264,21 +276,21 @@ static bool is_STR(TagName tag) {
  * The full Seven Tag Roster is printed unless
  * an element is explicitly suppressed..
  */
-static void output_tag(const StateInfo *globals, TagName tag, char **Tags,
-                       FILE *outfp) {
+static void output_tag_value(const StateInfo *globals, TagName tag,
+                             const char *value, FILE *outfp) {
   const char *tag_string;
 
   if (is_suppressed_tag(globals, tag)) {
-  } else if (Tags[tag] == NULL && globals->tsv_format) {
+  } else if (value == NULL && globals->tsv_format) {
     fputs("?\t", outfp);
-  } else if ((is_STR(tag)) || (Tags[tag] != NULL)) {
+  } else if ((is_STR(tag)) || (value != NULL)) {
     /* Must print STR elements and other non-NULL tags. */
     tag_string = select_tag_string(globals, tag);
 
     if (tag_string != NULL) {
       const char *tag_value;
-      if (Tags[tag] != NULL) {
-        tag_value = Tags[tag];
+      if (value != NULL) {
+        tag_value = value;
       } else {
         if (tag == DATE_TAG) {
           tag_value = "????.??.??";
@@ -299,6 +311,12 @@ static void output_tag(const StateInfo *globals, TagName tag, char **Tags,
   }
 }
 
+/* Output the tag held in the Tags structure. */
+static void output_tag(const StateInfo *globals, TagName tag, char **Tags,
+                       FILE *outfp) {
+  output_tag_value(globals, tag, Tags[tag], outfp);
+}
+
 /* Output the Seven Tag Roster. */
 static void output_STR(const StateInfo *globals, FILE *outfp, char **Tags) {
   unsigned tag_index;
@@ -320,49 +338,67 @@ static void output_STR(const StateInfo *globals, FILE *outfp, char **Tags) {
 /* Print out on outfp the current details.
  * These can be used in the case of an error.
  */
-static void show_tags(const StateInfo *globals, FILE *outfp, char **Tags,
-                      int tags_length) {
+static void show_tags(const StateInfo *globals, FILE *outfp, const Game *game) {
   int tag_index;
-  /* Take a copy of the Tags data, so that we can keep
+  /* Take a copy of the tag values, so that we can keep
    * track of what has been printed. This will make
    * it possible to print tags that were identified
    * in the source but are not defined with _TAG values.
    * See lex.c for how these extra tags are handled.
    */
-  char **copy_of_tags =
-      (char **)malloc_or_die(tags_length * sizeof(*copy_of_tags));
-  int i;
-  for (i = 0; i < tags_length; i++) {
-    copy_of_tags[i] = Tags[i];
+  const char *copy_of_tags[ORIGINAL_NUMBER_OF_TAGS];
+  const char **copy_of_extra_tags = NULL;
+  const int *order = TagOrder != NULL ? TagOrder : DefaultTagOrder;
+  unsigned i;
+
+  for (i = 0; i < ORIGINAL_NUMBER_OF_TAGS; i++) {
+    copy_of_tags[i] = game->tags[i];
+  }
+  if (game->num_extra_tags > 0) {
+    copy_of_extra_tags = (const char **)malloc_or_die(
+        game->num_extra_tags * sizeof(*copy_of_extra_tags));
+    for (i = 0; i < game->num_extra_tags; i++) {
+      copy_of_extra_tags[i] = game->extra_tags[i].value;
+    }
   }
 
-  /* Ensure that a tag ordering is available. */
-  if (TagOrder == NULL) {
-    /* None set by the user - use the default. */
-    /* Handle the standard tags.
-     * The end of the list is marked with a negative value.
-     */
-    for (tag_index = 0; DefaultTagOrder[tag_index] >= 0; tag_index++) {
-      TagName tag = DefaultTagOrder[tag_index];
-      output_tag(globals, tag, copy_of_tags, outfp);
-      copy_of_tags[tag] = (char *)NULL;
+  /* Handle the tags in the order set by the user, or the default
+   * ordering of the standard tags if none has been set.
+   * The end of the list is marked with a negative value.
+   */
+  for (tag_index = 0; order[tag_index] >= 0; tag_index++) {
+    TagName tag = order[tag_index];
+    const char **slot = NULL;
+
+    if (tag < ORIGINAL_NUMBER_OF_TAGS) {
+      slot = &copy_of_tags[tag];
+    } else {
+      for (i = 0; i < game->num_extra_tags && slot == NULL; i++) {
+        if (game->extra_tags[i].tag == (unsigned)tag) {
+          slot = &copy_of_extra_tags[i];
+        }
+      }
     }
-  } else {
-    for (tag_index = 0; TagOrder[tag_index] >= 0; tag_index++) {
-      TagName tag = TagOrder[tag_index];
-      output_tag(globals, tag, copy_of_tags, outfp);
-      copy_of_tags[tag] = (char *)NULL;
+    output_tag_value(globals, tag, slot != NULL ? *slot : NULL, outfp);
+    if (slot != NULL) {
+      *slot = NULL;
     }
   }
   /* Handle the remaining tags. */
   if (!globals->only_output_wanted_tags && !globals->tsv_format) {
-    for (tag_index = 0; tag_index < tags_length; tag_index++) {
-      if (copy_of_tags[tag_index] != NULL) {
-        output_tag(globals, tag_index, copy_of_tags, outfp);
+    for (i = 0; i < ORIGINAL_NUMBER_OF_TAGS; i++) {
+      if (copy_of_tags[i] != NULL) {
+        output_tag_value(globals, i, copy_of_tags[i], outfp);
+      }
+    }
+    for (i = 0; i < game->num_extra_tags; i++) {
+      if (copy_of_extra_tags[i] != NULL) {
+        output_tag_value(globals, game->extra_tags[i].tag,
+                         copy_of_extra_tags[i], outfp);
       }
     }
   }
-  (void)free(copy_of_tags);
+  (void)free((void *)copy_of_extra_tags);
   if (!globals->tsv_format) {
     putc('\n', outfp);
   }
@@ -458,7 +494,7 @@ void print_str(const StateInfo *globals, GameHeader *game_header, FILE *fp,
 static void print_space_separated_str(const StateInfo *globals,
                                       GameHeader *game_header, FILE *fp,
                                       const char *str) {
-  char *copy = copy_string(str);
+  char *copy = copy_string_for(MEMORY_OUTPUT, str);
   const char *chunk = strtok(copy, " ");
   while (chunk != NULL) {
     print_str(globals, game_header, fp, chunk);
@@ -659,7 +695,8 @@ static bool print_move(const StateInfo *globals, GameHeader *game_header,
            * char text, as the source may be 8-bit rather
            * than 7-bit.
            */
-          move_to_print = copy_string((const char *)move_text);
+          move_to_print =
+              copy_string_for(MEMORY_OUTPUT, (const char *)move_text);
           if (!globals->keep_checks) {
             /* Look for a check or mate symbol. */
             char *check = strchr((const char *)move_text, '+');
@@ -863,6 +900,7 @@ print_items_following_move(const StateInfo *globals, GameHeader *game_header,
   bool something_printed = false;
   Nag *nags = move_details->NAGs;
   Variation *variants = move_details->Variants;
+  const MoveAnnotations *annotations = move_annotations(move_details);
   if (move_details->comment_list != NULL && globals->keep_comments) {
     print_comment_list(globals, game_header, outputfile,
                        move_details->comment_list);
@@ -881,12 +919,12 @@ print_items_following_move(const StateInfo *globals, GameHeader *game_header,
         while (text != NULL) {
           if (globals->json_format) {
             fprintf(outputfile, "\"%s\"", text->str);
-            if (nags->next != NULL) {
+            if (text->next != NULL || nags->next != NULL) {
               fputs(", ", outputfile);
             }
           } else if (globals->tsv_format) {
             fprintf(outputfile, "%s", text->str);
-            if (nags->next != NULL) {
+            if (text->next != NULL || nags->next != NULL) {
               fputs(" ", outputfile);
             }
           } else {
@@ -911,13 +949,13 @@ print_items_following_move(const StateInfo *globals, GameHeader *game_header,
   if (globals->output_evaluation) {
     if (globals->json_format) {
       fprintf(outputfile, ", \"evaluation\" : \"%.2f\"",
-              move_details->evaluation);
+              annotations->evaluation);
     } else if (globals->tsv_format) {
-      fprintf(outputfile, "\t%.2f", move_details->evaluation);
+      fprintf(outputfile, "\t%.2f", annotations->evaluation);
     } else {
       const char valueSpace[] = "-012456789.00";
       char *evaluation = (char *)malloc_or_die(sizeof(valueSpace));
-      sprintf(evaluation, "%.2f", move_details->evaluation);
+      sprintf(evaluation, "%.2f", annotations->evaluation);
       if (strlen(evaluation) > strlen(valueSpace)) {
         fprintf(globals->logfile, "Internal error: Overflow in evaluation "
                                   "space in print_items_following_move()\n");
@@ -930,20 +968,20 @@ print_items_following_move(const StateInfo *globals, GameHeader *game_header,
     }
   }
   if (globals->add_FEN_comments) {
-    if (move_details->epd != NULL && move_details->fen_suffix != NULL) {
+    if (annotations->epd != NULL && annotations->fen_suffix != NULL) {
       if (globals->json_format) {
-        fprintf(outputfile, ", \"FEN\" : \"%s %s\"", move_details->epd,
-                move_details->fen_suffix);
+        fprintf(outputfile, ", \"FEN\" : \"%s %s\"", annotations->epd,
+                annotations->fen_suffix);
       } else if (globals->tsv_format) {
-        fprintf(outputfile, "\t%s\t%s", move_details->epd,
-                move_details->fen_suffix);
+        fprintf(outputfile, "\t%s\t%s", annotations->epd,
+                annotations->fen_suffix);
       } else {
         start_comment(globals, outputfile);
         print_space_separated_str(globals, game_header, outputfile,
-                                  move_details->epd);
+                                  annotations->epd);
         print_separator(globals, outputfile);
         print_space_separated_str(globals, game_header, outputfile,
-                                  move_details->fen_suffix);
+                                  annotations->fen_suffix);
         end_comment(globals, outputfile);
         something_printed = true;
       }
@@ -952,13 +990,13 @@ print_items_following_move(const StateInfo *globals, GameHeader *game_header,
   if (globals->add_hashcode_comments) {
     if (globals->json_format) {
       fprintf(outputfile, ", \"HashCode\" : \"");
-      fprintf(outputfile, "%016" PRIx64, move_details->zobrist);
+      fprintf(outputfile, "%016" PRIx64, annotations->zobrist);
       fprintf(outputfile, "\"");
     } else if (globals->tsv_format) {
-      fprintf(outputfile, "\t%016" PRIx64, move_details->zobrist);
+      fprintf(outputfile, "\t%016" PRIx64, annotations->zobrist);
     } else {
       char *hashcode = (char *)malloc_or_die(HASH_64_BIT_SPACE + 1);
-      sprintf(hashcode, "%016" PRIx64, move_details->zobrist);
+      sprintf(hashcode, "%016" PRIx64, annotations->zobrist);
       print_as_comment(globals, game_header, outputfile, hashcode);
       (void)free((void *)hashcode);
       something_printed = true;
@@ -1285,6 +1323,13 @@ void format_game(const StateInfo *globals, GameHeader *game_header,
       output_cm_game(globals, game_header, outputfile, move_number,
                      white_to_move, current_game);
       break;
+    case BIN:
+      output_binary_game(globals, current_game, outputfile);
+      break;
+    case POS:
+      output_position_records(globals, game_header, current_game, outputfile,
+                              initial_board);
+      break;
     default:
       fprintf(globals->logfile,
               "Internal error: unknown output type %d in format_game().\n",
@@ -1434,8 +1479,7 @@ static void print_algebraic_game(const StateInfo *globals,
   }
   /* Report details on the output. */
   if (globals->tag_output_format == ALL_TAGS) {
-    show_tags(globals, outputfile, current_game->tags,
-              current_game->tags_length);
+    show_tags(globals, outputfile, current_game);
   } else if (globals->tag_output_format == SEVEN_TAG_ROSTER) {
     output_STR(globals, outputfile, current_game->tags);
     if (globals->add_ECO && !globals->parsing_ECO_file) {
@@ -1524,22 +1568,22 @@ static void print_EPD_move_list(const StateInfo *globals,
 
     if (globals->tsv_format) {
       fprintf(outputfile, "%s\t", epd);
-      show_tags(globals, outputfile, current_game->tags,
-                current_game->tags_length);
+      show_tags(globals, outputfile, current_game);
       fputc('\n', outputfile);
     } else {
       fprintf(outputfile, "%s %s\n", epd, game_comment);
     }
   }
   while (move != NULL) {
-    if (move->epd != NULL) {
+    const char *move_epd = move_annotations(move)->epd;
+
+    if (move_epd != NULL) {
       if (globals->tsv_format) {
-        fprintf(outputfile, "%s\t", move->epd);
-        show_tags(globals, outputfile, current_game->tags,
-                  current_game->tags_length);
+        fprintf(outputfile, "%s\t", move_epd);
+        show_tags(globals, outputfile, current_game);
         fputc('\n', outputfile);
       } else {
-        fprintf(outputfile, "%s %s\n", move->epd, game_comment);
+        fprintf(outputfile, "%s %s\n", move_epd, game_comment);
       }
     } else {
       fprintf(globals->logfile, "Internal error: Missing EPD\n");
@@ -1613,8 +1657,7 @@ static void print_FEN_game(const StateInfo *globals, GameHeader *game_header,
   if (!globals->check_only) {
     /* Report details on the output. */
     if (globals->tag_output_format == ALL_TAGS) {
-      show_tags(globals, outputfile, current_game->tags,
-                current_game->tags_length);
+      show_tags(globals, outputfile, current_game);
     } else if (globals->tag_output_format == SEVEN_TAG_ROSTER) {
       output_STR(globals, outputfile, current_game->tags);
     } else if (globals->tag_output_format == NO_TAGS) {
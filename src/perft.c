@@ -0,0 +1,156 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "perft.h"
+
+#include "apply.h"
+#include "defs.h"
+#include "grammar.h"
+#include "map.h"
+#include "typedef.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The longest line of a perft suite. */
+#define MAX_SUITE_LINE 1024
+
+static double elapsed_seconds(const struct timespec *start) {
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) +
+         (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void report_speed(const StateInfo *globals, unsigned long nodes,
+                         double seconds) {
+  fprintf(globals->outputfile, "%lu nodes in %.3f seconds (%.0f nodes/s)\n",
+          nodes, seconds, seconds > 0 ? nodes / seconds : 0.0);
+}
+
+/* Report the perft count of each move from fen to depth (divide),
+ * and the total count with the speed of the move generator.
+ * Return false if fen is not a valid position.
+ */
+bool perft_position(const StateInfo *globals, GameHeader *game_header,
+                    const char *fen, unsigned depth) {
+  Board *board = new_fen_board(globals, game_header, fen);
+  struct timespec start;
+  unsigned long nodes;
+
+  if (board == NULL) {
+    return false;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  nodes = perft(globals, board, depth, globals->outputfile);
+  fprintf(globals->outputfile, "\n");
+  report_speed(globals, nodes, elapsed_seconds(&start));
+  free_board(board);
+  return true;
+}
+
+/* Check the perft counts of the positions of the EPD file filename.
+ * Each line holds a FEN position, which may omit the move counts,
+ * followed by the counts to check in the form
+ *     ;D1 20 ;D2 400 ...
+ * Blank lines and lines starting with # are ignored.
+ * Return true if all of the counts are correct.
+ */
+bool perft_suite(const StateInfo *globals, GameHeader *game_header,
+                 const char *filename) {
+  FILE *fp = must_open_file(globals, filename, "r");
+  char line[MAX_SUITE_LINE];
+  unsigned line_number = 0, positions = 0, failures = 0;
+  unsigned long total_nodes = 0;
+  double total_seconds = 0;
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    char fen[MAX_SUITE_LINE + sizeof(" 0 1")];
+    char *counts = strchr(line, ';');
+    size_t fen_length;
+    unsigned fields = 0;
+    Board *board;
+    unsigned depth;
+    unsigned long expected;
+    int consumed;
+    bool ok = true;
+
+    line_number++;
+    if (line[0] == '#' || counts == NULL) {
+      continue;
+    }
+    fen_length = counts - line;
+    while (fen_length > 0 && isspace((unsigned char)line[fen_length - 1])) {
+      fen_length--;
+    }
+    memcpy(fen, line, fen_length);
+    fen[fen_length] = '\0';
+    for (const char *c = fen; *c != '\0'; c++) {
+      if (*c == ' ') {
+        fields++;
+      }
+    }
+    /* EPD positions have no move counts. */
+    if (fields == 3) {
+      strcat(fen, " 0 1");
+    }
+    board = new_fen_board(globals, game_header, fen);
+    if (board == NULL) {
+      fprintf(globals->logfile, "Illegal position on line %u of %s.\n",
+              line_number, filename);
+      failures++;
+      continue;
+    }
+    positions++;
+    while (sscanf(counts, " ; D%u %lu%n", &depth, &expected, &consumed) ==
+           2) {
+      struct timespec start;
+      unsigned long nodes;
+
+      counts += consumed;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      nodes = perft(globals, board, depth, NULL);
+      total_seconds += elapsed_seconds(&start);
+      total_nodes += nodes;
+      if (nodes != expected) {
+        fprintf(globals->logfile,
+                "perft %u of %s is %lu rather than %lu.\n", depth, fen,
+                nodes, expected);
+        ok = false;
+      }
+    }
+    fprintf(globals->outputfile, "%-6s %s\n", ok ? "ok" : "FAILED", fen);
+    if (!ok) {
+      failures++;
+    }
+    free_board(board);
+  }
+  (void)fclose(fp);
+
+  fprintf(globals->outputfile, "%u position%s, %u failed: ", positions,
+          positions == 1 ? "" : "s", failures);
+  report_speed(globals, total_nodes, total_seconds);
+  return failures == 0;
+}
@@ -0,0 +1,252 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "positions.h"
+
+#include "apply.h"
+#include "defs.h"
+#include "map.h"
+#include "taglist.h"
+#include "typedef.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* The layout of a position record.
+ *     bytes 0-31: the board, one nibble per square, with the squares
+ *         numbered from 0 (a1) to 63 (h8) along the ranks and the even
+ *         square of each byte in its low nibble. Empty squares are 0,
+ *         white pieces 1 (pawn) to 6 (king) and black pieces the same
+ *         with 8 added;
+ *     byte 32: POSITION_ flags for the side to move and castling rights;
+ *     byte 33: the en-passant target square, or NO_SQUARE;
+ *     byte 34: the halfmove clock, limited to 255;
+ *     byte 35: the RESULT_ value of the game's Result tag;
+ *     bytes 36-37: the number of plies played before the position
+ *         since the start of the game, including any preceding the
+ *         position of a FEN tag;
+ *     bytes 38-39: the move played from the position, with the square
+ *         moved from in bits 0-5, the square moved to in bits 6-11 and
+ *         the PROMOTION_ value of the piece promoted to in bits 12-14.
+ * Numbers of more than one byte are little-endian.
+ * Castling moves are held as the move of the king, and null moves as 0.
+ */
+#define BOARD_BYTES 32
+#define FLAGS_BYTE 32
+#define EP_BYTE 33
+#define HALFMOVE_BYTE 34
+#define RESULT_BYTE 35
+#define PLY_BYTES 36
+#define MOVE_BYTES 38
+
+#define BLACK_PIECE 8
+#define NO_SQUARE 0xff
+
+#define POSITION_BLACK_TO_MOVE 0x01
+#define POSITION_WHITE_KINGSIDE 0x02
+#define POSITION_WHITE_QUEENSIDE 0x04
+#define POSITION_BLACK_KINGSIDE 0x08
+#define POSITION_BLACK_QUEENSIDE 0x10
+
+typedef enum {
+  RESULT_UNKNOWN,
+  RESULT_WHITE_WIN,
+  RESULT_BLACK_WIN,
+  RESULT_DRAW
+} ResultCode;
+
+typedef enum {
+  PROMOTION_NONE,
+  PROMOTION_KNIGHT,
+  PROMOTION_BISHOP,
+  PROMOTION_ROOK,
+  PROMOTION_QUEEN
+} PromotionCode;
+
+static unsigned square_number(Col col, Rank rank) {
+  return (col - FIRSTCOL) + BOARDSIZE * (rank - FIRSTRANK);
+}
+
+static ResultCode result_code(const char *result) {
+  if (result == NULL) {
+    return RESULT_UNKNOWN;
+  } else if (strcmp(result, "1-0") == 0) {
+    return RESULT_WHITE_WIN;
+  } else if (strcmp(result, "0-1") == 0) {
+    return RESULT_BLACK_WIN;
+  } else if (strcmp(result, "1/2-1/2") == 0) {
+    return RESULT_DRAW;
+  } else {
+    return RESULT_UNKNOWN;
+  }
+}
+
+/* Fill in the parts of record describing board. */
+static void encode_position(const Board *board, unsigned char *record) {
+  unsigned char flags = 0;
+
+  memset(record, 0, BOARD_BYTES);
+  for (Rank rank = FIRSTRANK; rank <= LASTRANK; rank++) {
+    for (Col col = FIRSTCOL; col <= LASTCOL; col++) {
+      Piece coloured_piece =
+          BOARD_SQUARE(board, RankConvert(rank), ColConvert(col));
+      Piece piece = EXTRACT_PIECE(coloured_piece);
+
+      if (piece >= PAWN && piece <= KING) {
+        unsigned square = square_number(col, rank);
+        unsigned nibble = piece - PAWN + 1;
+
+        if (EXTRACT_COLOUR(coloured_piece) == BLACK) {
+          nibble += BLACK_PIECE;
+        }
+        record[square / 2] |= nibble << (4 * (square % 2));
+      }
+    }
+  }
+  if (board->to_move == BLACK) {
+    flags |= POSITION_BLACK_TO_MOVE;
+  }
+  if (board->WKingCastle != '\0') {
+    flags |= POSITION_WHITE_KINGSIDE;
+  }
+  if (board->WQueenCastle != '\0') {
+    flags |= POSITION_WHITE_QUEENSIDE;
+  }
+  if (board->BKingCastle != '\0') {
+    flags |= POSITION_BLACK_KINGSIDE;
+  }
+  if (board->BQueenCastle != '\0') {
+    flags |= POSITION_BLACK_QUEENSIDE;
+  }
+  record[FLAGS_BYTE] = flags;
+  record[EP_BYTE] = board->EnPassant
+                        ? square_number(board->ep_col, board->ep_rank)
+                        : NO_SQUARE;
+  record[HALFMOVE_BYTE] =
+      board->halfmove_clock < 0xff ? board->halfmove_clock : 0xff;
+}
+
+/* Return the code of move, which has just been played by colour
+ * to reach board from a position in which the king of colour stood
+ * on king_col and king_rank.
+ */
+static unsigned encode_played_move(const Move *move, const Board *board,
+                                   Colour colour, Col king_col,
+                                   Rank king_rank) {
+  unsigned from, to;
+  PromotionCode promotion = PROMOTION_NONE;
+
+  switch (move->class) {
+  case KINGSIDE_CASTLE:
+  case QUEENSIDE_CASTLE:
+    from = square_number(king_col, king_rank);
+    to = colour == WHITE ? square_number(board->WKingCol, board->WKingRank)
+                         : square_number(board->BKingCol, board->BKingRank);
+    break;
+  case NULL_MOVE:
+    return 0;
+  default:
+    from = square_number(move->from_col, move->from_rank);
+    to = square_number(move->to_col, move->to_rank);
+    break;
+  }
+  if (move->class == PAWN_MOVE_WITH_PROMOTION) {
+    switch (move->promoted_piece) {
+    case KNIGHT:
+      promotion = PROMOTION_KNIGHT;
+      break;
+    case BISHOP:
+      promotion = PROMOTION_BISHOP;
+      break;
+    case ROOK:
+      promotion = PROMOTION_ROOK;
+      break;
+    default:
+      promotion = PROMOTION_QUEEN;
+      break;
+    }
+  }
+  return from | (to << 6) | ((unsigned)promotion << 12);
+}
+
+static void put_short(unsigned char *bytes, unsigned value) {
+  if (value > 0xffff) {
+    value = 0xffff;
+  }
+  bytes[0] = value & 0xff;
+  bytes[1] = (value >> 8) & 0xff;
+}
+
+/* Write a record for each position of the main line of game from
+ * which a move is played, replaying its moves from initial_board.
+ * With --sampleply N only every Nth position is written, starting
+ * with the first, and with --skipchecks positions in which the
+ * side to move is in check are omitted.
+ */
+void output_position_records(const StateInfo *globals,
+                             GameHeader *game_header, const Game *game,
+                             FILE *outputfile, Board *initial_board) {
+  Board *board = initial_board;
+  Move *move = game->moves;
+  ResultCode result = result_code(game->tags[RESULT_TAG]);
+  unsigned interval = globals->position_sample_interval > 0
+                          ? globals->position_sample_interval
+                          : 1;
+  /* The number of positions of the game seen so far. */
+  unsigned long positions = 0;
+
+  if (globals->check_only || board == NULL) {
+    return;
+  }
+  for (; move != NULL; move = move->next) {
+    unsigned char record[POSITION_RECORD_LENGTH];
+    unsigned plies = 2 * (board->move_number - 1) + (board->to_move == BLACK);
+    Colour colour = board->to_move;
+    Col king_col = colour == WHITE ? board->WKingCol : board->BKingCol;
+    Rank king_rank = colour == WHITE ? board->WKingRank : board->BKingRank;
+    bool wanted;
+
+    if (move->move[0] == '\0') {
+      continue;
+    }
+    if (globals->output_ply_limit >= 0 &&
+        plies >= (unsigned)globals->output_ply_limit) {
+      break;
+    }
+    wanted = positions % interval == 0 &&
+             !(globals->skip_positions_in_check &&
+               king_is_in_check(board, colour) != NOCHECK);
+    positions++;
+    if (wanted) {
+      encode_position(board, record);
+    }
+    if (!apply_move(globals, game_header, move, board)) {
+      break;
+    }
+    if (wanted) {
+      record[RESULT_BYTE] = result;
+      put_short(&record[PLY_BYTES], plies);
+      put_short(&record[MOVE_BYTES], encode_played_move(move, board, colour,
+                                                        king_col, king_rank));
+      (void)fwrite(record, 1, sizeof(record), outputfile);
+    }
+  }
+}
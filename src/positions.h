@@ -0,0 +1,43 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Fixed-size binary records of the positions of games, selected
+ * for output with -Wpos. Each position of the main line from which
+ * a move is played is written as POSITION_RECORD_LENGTH bytes holding
+ * the board, the move played and the result of the game, for use by
+ * programs that train on large numbers of positions.
+ */
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include "typedef.h"
+
+#include <stdio.h>
+
+/* The suffix of files of position records. */
+#define POSITION_RECORD_SUFFIX ".bpos"
+#define POSITION_RECORD_LENGTH 40
+
+void output_position_records(const StateInfo *globals,
+                             GameHeader *game_header, const Game *game,
+                             FILE *outputfile, Board *initial_board);
+
+#endif // POSITIONS_H
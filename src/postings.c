@@ -0,0 +1,762 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "postings.h"
+
+#include "mymalloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The layout of a postings table, written after any header
+ * of the file containing it.
+ * A table consists of one or more segments, each written by a call
+ * of write_postings. A segment is a sequence of blocks, each holding up to POSTINGS_BLOCK_KEYS keys
+ * in ascending order. A block starts with its number of keys, followed
+ * by, for each key:
+ *     the length of the prefix it shares with the previous key in the block;
+ *     the length of the remainder, followed by its bytes;
+ *     the number of ordinals, followed by the first ordinal and then
+ *         the differences between successive ordinals.
+ * All numbers are stored with write_varint.
+ * The blocks are followed by a directory holding, for each block,
+ * its file offset (8 bytes), and the length (1 byte) and bytes of its
+ * first key. The segment ends with the offset of the directory,
+ * the number of blocks, and the offset of the end of the previous
+ * segment, or 0 if it is the first (8 bytes each).
+ * Fixed-size numbers are little-endian.
+ * A key may occur in more than one segment.
+ */
+#define POSTINGS_BLOCK_KEYS 64
+#define POSTINGS_TRAILER_LENGTH 24
+
+/* Keys and ordinals are accumulated in memory up to this many bytes,
+ * before being sorted and written to a temporary file as a run.
+ * The runs are merged when the table is written.
+ */
+#define POSTINGS_RUN_SIZE (64 * 1024 * 1024)
+/* Each record is held as its key length (1 byte), its key,
+ * and its ordinal (8 bytes).
+ */
+#define RECORD_OVERHEAD 9
+
+struct PostingsBuilder {
+  /* The records of the current run. */
+  unsigned char *arena;
+  size_t arena_used;
+  size_t arena_size;
+  /* Offsets of the records in arena. */
+  size_t *records;
+  size_t num_records;
+  size_t max_records;
+  /* Runs already sorted and written out. */
+  FILE **runs;
+  unsigned num_runs;
+  unsigned max_runs;
+};
+
+typedef struct {
+  unsigned long num_blocks;
+  long *block_offsets;
+  /* The first key of each block. */
+  unsigned char (*first_keys)[MAX_POSTINGS_KEY];
+  unsigned char *first_key_lengths;
+} PostingsSegment;
+
+struct PostingsTable {
+  FILE *fp;
+  /* The segments, oldest first. */
+  PostingsSegment *segments;
+  unsigned num_segments;
+};
+
+/* The next record from a run during a merge. */
+typedef struct {
+  FILE *fp;
+  unsigned char key[MAX_POSTINGS_KEY];
+  unsigned key_length;
+  unsigned long ordinal;
+} RunReader;
+
+static int compare_keys(const unsigned char *key1, unsigned length1,
+                        const unsigned char *key2, unsigned length2);
+static int compare_records(const void *r1, const void *r2);
+static int compare_ordinals(const void *o1, const void *o2);
+static int compare_readers(const RunReader *r1, const RunReader *r2);
+static void flush_run(PostingsBuilder *builder);
+static bool read_block_key(FILE *fp, unsigned char *key,
+                           unsigned long *key_length, unsigned long *count);
+static bool read_run_record(RunReader *reader);
+static bool read_segment(FILE *fp, long end, PostingsSegment *segment,
+                         long *previous_end);
+static void sift_down(RunReader **heap, unsigned num_readers, unsigned i);
+
+/* The arena whose records are being sorted by compare_records. */
+static const unsigned char *sort_arena;
+
+/* Write value as a variable-length unsigned integer:
+ * 7 bits per byte, least significant first, with the top bit set
+ * on all but the last byte.
+ */
+void write_varint(FILE *fp, unsigned long value) {
+  while (value >= 0x80) {
+    putc((int)((value & 0x7f) | 0x80), fp);
+    value >>= 7;
+  }
+  putc((int)value, fp);
+}
+
+/* Read a value written by write_varint. */
+bool read_varint(FILE *fp, unsigned long *value) {
+  unsigned shift = 0;
+  int ch;
+
+  *value = 0;
+  do {
+    ch = getc(fp);
+    if (ch == EOF || shift >= 8 * sizeof(*value)) {
+      return false;
+    }
+    *value |= ((unsigned long)(ch & 0x7f)) << shift;
+    shift += 7;
+  } while (ch & 0x80);
+  return true;
+}
+
+/* Write value as a num_bytes little-endian number. */
+void write_fixed(FILE *fp, unsigned num_bytes, unsigned long value) {
+  for (unsigned i = 0; i < num_bytes; i++) {
+    putc((int)(value & 0xff), fp);
+    value >>= 8;
+  }
+}
+
+/* Read a num_bytes little-endian number into value. */
+bool read_fixed(FILE *fp, unsigned num_bytes, unsigned long *value) {
+  *value = 0;
+  for (unsigned i = 0; i < num_bytes; i++) {
+    int ch = getc(fp);
+    if (ch == EOF) {
+      return false;
+    }
+    *value |= ((unsigned long)ch) << (8 * i);
+  }
+  return true;
+}
+
+static int compare_keys(const unsigned char *key1, unsigned length1,
+                        const unsigned char *key2, unsigned length2) {
+  int cmp = memcmp(key1, key2, length1 < length2 ? length1 : length2);
+  if (cmp != 0) {
+    return cmp;
+  } else if (length1 != length2) {
+    return length1 < length2 ? -1 : 1;
+  } else {
+    return 0;
+  }
+}
+
+/* Order records by key and then ordinal. */
+static int compare_records(const void *r1, const void *r2) {
+  const unsigned char *record1 = sort_arena + *(const size_t *)r1;
+  const unsigned char *record2 = sort_arena + *(const size_t *)r2;
+  int cmp = compare_keys(record1 + 1, record1[0], record2 + 1, record2[0]);
+
+  if (cmp == 0) {
+    unsigned long ordinal1, ordinal2;
+    memcpy(&ordinal1, record1 + 1 + record1[0], sizeof(ordinal1));
+    memcpy(&ordinal2, record2 + 1 + record2[0], sizeof(ordinal2));
+    cmp = ordinal1 < ordinal2 ? -1 : ordinal1 > ordinal2 ? 1 : 0;
+  }
+  return cmp;
+}
+
+PostingsBuilder *new_postings_builder(void) {
+  PostingsBuilder *builder = (PostingsBuilder *)malloc_or_die(sizeof(*builder));
+
+  builder->arena_size = POSTINGS_RUN_SIZE;
+  builder->arena = (unsigned char *)malloc_or_die(builder->arena_size);
+  builder->arena_used = 0;
+  builder->max_records = POSTINGS_RUN_SIZE / (4 * RECORD_OVERHEAD);
+  builder->records =
+      (size_t *)malloc_or_die(builder->max_records * sizeof(size_t));
+  builder->num_records = 0;
+  builder->runs = NULL;
+  builder->num_runs = 0;
+  builder->max_runs = 0;
+  return builder;
+}
+
+void free_postings_builder(PostingsBuilder *builder) {
+  for (unsigned r = 0; r < builder->num_runs; r++) {
+    (void)fclose(builder->runs[r]);
+  }
+  (void)free((void *)builder->runs);
+  (void)free((void *)builder->records);
+  (void)free((void *)builder->arena);
+  (void)free((void *)builder);
+}
+
+/* Sort the records held in memory and write them out as a run. */
+static void flush_run(PostingsBuilder *builder) {
+  FILE *run;
+
+  if (builder->num_records == 0) {
+    return;
+  }
+  run = tmpfile();
+  if (run == NULL) {
+    perror("tmpfile");
+    abort();
+  }
+  sort_arena = builder->arena;
+  qsort(builder->records, builder->num_records, sizeof(size_t),
+        compare_records);
+  for (size_t r = 0; r < builder->num_records; r++) {
+    const unsigned char *record = builder->arena + builder->records[r];
+    fwrite(record, 1, RECORD_OVERHEAD + record[0], run);
+  }
+  if (fflush(run) != 0 || ferror(run)) {
+    perror("tmpfile");
+    abort();
+  }
+  rewind(run);
+  if (builder->num_runs == builder->max_runs) {
+    builder->max_runs = builder->max_runs == 0 ? 8 : 2 * builder->max_runs;
+    builder->runs = (FILE **)realloc_or_die(
+        (void *)builder->runs, builder->max_runs * sizeof(FILE *));
+  }
+  builder->runs[builder->num_runs++] = run;
+  builder->arena_used = 0;
+  builder->num_records = 0;
+}
+
+/* Record that key occurs in game number ordinal.
+ * Keys longer than MAX_POSTINGS_KEY are truncated.
+ */
+void add_posting(PostingsBuilder *builder, const unsigned char *key,
+                 unsigned key_length, unsigned long ordinal) {
+  unsigned char *record;
+
+  if (key_length > MAX_POSTINGS_KEY) {
+    key_length = MAX_POSTINGS_KEY;
+  }
+  if (builder->arena_used + RECORD_OVERHEAD + key_length >
+          builder->arena_size ||
+      builder->num_records == builder->max_records) {
+    flush_run(builder);
+  }
+  record = builder->arena + builder->arena_used;
+  record[0] = (unsigned char)key_length;
+  memcpy(record + 1, key, key_length);
+  memcpy(record + 1 + key_length, &ordinal, sizeof(ordinal));
+  builder->records[builder->num_records++] = builder->arena_used;
+  builder->arena_used += RECORD_OVERHEAD + key_length;
+}
+
+/* Read the next record of a run. Return false at its end. */
+static bool read_run_record(RunReader *reader) {
+  int length = getc(reader->fp);
+
+  if (length == EOF) {
+    return false;
+  }
+  reader->key_length = (unsigned)length;
+  if (fread(reader->key, 1, reader->key_length, reader->fp) !=
+          reader->key_length ||
+      fread(&reader->ordinal, sizeof(reader->ordinal), 1, reader->fp) != 1) {
+    return false;
+  }
+  return true;
+}
+
+static int compare_readers(const RunReader *r1, const RunReader *r2) {
+  int cmp = compare_keys(r1->key, r1->key_length, r2->key, r2->key_length);
+  if (cmp == 0) {
+    cmp = r1->ordinal < r2->ordinal ? -1 : r1->ordinal > r2->ordinal ? 1 : 0;
+  }
+  return cmp;
+}
+
+/* Restore the heap property of the merge below position i. */
+static void sift_down(RunReader **heap, unsigned num_readers, unsigned i) {
+  for (;;) {
+    unsigned smallest = i;
+    unsigned left = 2 * i + 1, right = 2 * i + 2;
+
+    if (left < num_readers && compare_readers(heap[left], heap[smallest]) < 0) {
+      smallest = left;
+    }
+    if (right < num_readers &&
+        compare_readers(heap[right], heap[smallest]) < 0) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    RunReader *temp = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = temp;
+    i = smallest;
+  }
+}
+
+/* Merge the runs of builder and write them to fp as a segment of
+ * a postings table. previous_end is the offset of the end of the
+ * table's previous segment in fp, or 0 if there is none.
+ * Return true if the writing was successful.
+ */
+bool write_postings(PostingsBuilder *builder, FILE *fp, long previous_end) {
+  RunReader *readers;
+  RunReader **heap;
+  unsigned num_readers = 0;
+  /* The key currently being gathered and its ordinals. */
+  unsigned char key[MAX_POSTINGS_KEY];
+  unsigned key_length = 0;
+  bool have_key = false;
+  OrdinalSet ordinals = {NULL, 0, 0};
+  /* The previous key written to the current block. */
+  unsigned char previous_key[MAX_POSTINGS_KEY];
+  unsigned previous_length = 0;
+  unsigned keys_in_block = 0;
+  long block_start = 0;
+  /* The directory of blocks. */
+  long *block_offsets = NULL;
+  unsigned char (*first_keys)[MAX_POSTINGS_KEY] = NULL;
+  unsigned char *first_key_lengths = NULL;
+  unsigned long num_blocks = 0, max_blocks = 0;
+  long directory_offset;
+
+  flush_run(builder);
+  readers = (RunReader *)malloc_or_die(
+      (builder->num_runs + 1) * sizeof(RunReader));
+  heap = (RunReader **)malloc_or_die(
+      (builder->num_runs + 1) * sizeof(RunReader *));
+  for (unsigned r = 0; r < builder->num_runs; r++) {
+    readers[num_readers].fp = builder->runs[r];
+    if (read_run_record(&readers[num_readers])) {
+      heap[num_readers] = &readers[num_readers];
+      num_readers++;
+    }
+  }
+  for (unsigned i = num_readers / 2; i-- > 0;) {
+    sift_down(heap, num_readers, i);
+  }
+
+  /* Each iteration either extends the current key's ordinals
+   * or completes it.
+   */
+  for (;;) {
+    RunReader *next = num_readers > 0 ? heap[0] : NULL;
+    bool same_key = next != NULL && have_key &&
+                    compare_keys(next->key, next->key_length, key,
+                                 key_length) == 0;
+
+    if (have_key && !same_key) {
+      /* Write out the completed key. */
+      unsigned shared = 0;
+
+      if (keys_in_block == POSTINGS_BLOCK_KEYS) {
+        keys_in_block = 0;
+      }
+      if (keys_in_block == 0) {
+        /* Start a new block, leaving space for its key count. */
+        if (num_blocks > 0) {
+          long end = ftell(fp);
+          fseek(fp, block_start, SEEK_SET);
+          putc(POSTINGS_BLOCK_KEYS, fp);
+          fseek(fp, end, SEEK_SET);
+        }
+        if (num_blocks == max_blocks) {
+          max_blocks = max_blocks == 0 ? 1024 : 2 * max_blocks;
+          block_offsets = (long *)realloc_or_die(
+              (void *)block_offsets, max_blocks * sizeof(*block_offsets));
+          first_keys = (unsigned char(*)[MAX_POSTINGS_KEY])realloc_or_die(
+              (void *)first_keys, max_blocks * sizeof(*first_keys));
+          first_key_lengths = (unsigned char *)realloc_or_die(
+              (void *)first_key_lengths, max_blocks);
+        }
+        block_start = ftell(fp);
+        block_offsets[num_blocks] = block_start;
+        memcpy(first_keys[num_blocks], key, key_length);
+        first_key_lengths[num_blocks] = (unsigned char)key_length;
+        num_blocks++;
+        putc(0, fp);
+        previous_length = 0;
+      }
+      while (shared < key_length && shared < previous_length &&
+             key[shared] == previous_key[shared]) {
+        shared++;
+      }
+      write_varint(fp, shared);
+      write_varint(fp, key_length - shared);
+      fwrite(key + shared, 1, key_length - shared, fp);
+      write_varint(fp, ordinals.num_ordinals);
+      for (unsigned long i = 0; i < ordinals.num_ordinals; i++) {
+        write_varint(fp, i == 0 ? ordinals.ordinals[0]
+                                : ordinals.ordinals[i] -
+                                      ordinals.ordinals[i - 1]);
+      }
+      memcpy(previous_key, key, key_length);
+      previous_length = key_length;
+      keys_in_block++;
+      have_key = false;
+      ordinals.num_ordinals = 0;
+    }
+    if (next == NULL) {
+      break;
+    }
+    if (!have_key) {
+      memcpy(key, next->key, next->key_length);
+      key_length = next->key_length;
+      have_key = true;
+    }
+    /* Equal records may occur; the ordinals arrive in ascending order. */
+    if (ordinals.num_ordinals == 0 ||
+        ordinals.ordinals[ordinals.num_ordinals - 1] != next->ordinal) {
+      add_ordinal(&ordinals, next->ordinal);
+    }
+    if (read_run_record(next)) {
+      sift_down(heap, num_readers, 0);
+    } else {
+      heap[0] = heap[--num_readers];
+      sift_down(heap, num_readers, 0);
+    }
+  }
+  if (num_blocks > 0) {
+    /* Complete the count of the final block. */
+    long end = ftell(fp);
+    fseek(fp, block_start, SEEK_SET);
+    putc((int)keys_in_block, fp);
+    fseek(fp, end, SEEK_SET);
+  }
+
+  directory_offset = ftell(fp);
+  for (unsigned long b = 0; b < num_blocks; b++) {
+    write_fixed(fp, 8, (unsigned long)block_offsets[b]);
+    putc(first_key_lengths[b], fp);
+    fwrite(first_keys[b], 1, first_key_lengths[b], fp);
+  }
+  write_fixed(fp, 8, (unsigned long)directory_offset);
+  write_fixed(fp, 8, num_blocks);
+  write_fixed(fp, 8, (unsigned long)previous_end);
+
+  clear_ordinal_set(&ordinals);
+  (void)free((void *)block_offsets);
+  (void)free((void *)first_keys);
+  (void)free((void *)first_key_lengths);
+  (void)free((void *)heap);
+  (void)free((void *)readers);
+  return !ferror(fp);
+}
+
+/* Read the directory of the segment of a postings table that ends
+ * at offset end of fp, and the offset of the end of its predecessor.
+ * Return false if it is not well formed.
+ */
+static bool read_segment(FILE *fp, long end, PostingsSegment *segment,
+                         long *previous_end) {
+  unsigned long directory_offset, num_blocks, previous;
+
+  segment->num_blocks = 0;
+  segment->block_offsets = NULL;
+  segment->first_keys = NULL;
+  segment->first_key_lengths = NULL;
+  if (end < POSTINGS_TRAILER_LENGTH ||
+      fseek(fp, end - POSTINGS_TRAILER_LENGTH, SEEK_SET) != 0 ||
+      !read_fixed(fp, 8, &directory_offset) ||
+      !read_fixed(fp, 8, &num_blocks) || !read_fixed(fp, 8, &previous) ||
+      directory_offset > (unsigned long)end || previous >= directory_offset ||
+      fseek(fp, (long)directory_offset, SEEK_SET) != 0) {
+    return false;
+  }
+  segment->block_offsets = (long *)malloc_or_die(
+      (num_blocks + 1) * sizeof(*segment->block_offsets));
+  segment->first_keys = (unsigned char(*)[MAX_POSTINGS_KEY])malloc_or_die(
+      (num_blocks + 1) * sizeof(*segment->first_keys));
+  segment->first_key_lengths = (unsigned char *)malloc_or_die(num_blocks + 1);
+  for (unsigned long b = 0; b < num_blocks; b++) {
+    unsigned long offset;
+    int length;
+
+    if (!read_fixed(fp, 8, &offset) || (length = getc(fp)) == EOF ||
+        fread(segment->first_keys[b], 1, (size_t)length, fp) !=
+            (size_t)length) {
+      return false;
+    }
+    segment->block_offsets[b] = (long)offset;
+    segment->first_key_lengths[b] = (unsigned char)length;
+    segment->num_blocks++;
+  }
+  *previous_end = (long)previous;
+  return true;
+}
+
+/* Read the directories of the postings table in fp.
+ * Return NULL if it is not well formed.
+ * fp must remain open for as long as the table is in use.
+ */
+PostingsTable *read_postings_table(FILE *fp) {
+  PostingsTable *table;
+  unsigned max_segments = 0;
+  long end;
+
+  if (fseek(fp, 0, SEEK_END) != 0 || (end = ftell(fp)) < 0) {
+    return NULL;
+  }
+  table = (PostingsTable *)malloc_or_die(sizeof(*table));
+  table->fp = fp;
+  table->segments = NULL;
+  table->num_segments = 0;
+  /* The segments are found from the last back to the first. */
+  while (end != 0) {
+    if (table->num_segments == max_segments) {
+      max_segments = max_segments == 0 ? 4 : 2 * max_segments;
+      table->segments = (PostingsSegment *)realloc_or_die(
+          (void *)table->segments, max_segments * sizeof(*table->segments));
+    }
+    table->num_segments++;
+    if (!read_segment(fp, end, &table->segments[table->num_segments - 1],
+                      &end)) {
+      close_postings_table(table);
+      return NULL;
+    }
+  }
+  for (unsigned i = 0, j = table->num_segments; i + 1 < j; i++, j--) {
+    PostingsSegment temp = table->segments[i];
+    table->segments[i] = table->segments[j - 1];
+    table->segments[j - 1] = temp;
+  }
+  return table;
+}
+
+/* Free the space of table.
+ * Its file remains open, for the caller to close.
+ */
+void close_postings_table(PostingsTable *table) {
+  for (unsigned i = 0; i < table->num_segments; i++) {
+    (void)free((void *)table->segments[i].block_offsets);
+    (void)free((void *)table->segments[i].first_keys);
+    (void)free((void *)table->segments[i].first_key_lengths);
+  }
+  (void)free((void *)table->segments);
+  (void)free((void *)table);
+}
+
+/* Return the number of segments in table. */
+unsigned postings_segments(const PostingsTable *table) {
+  return table->num_segments;
+}
+
+/* Read the next key of a block into key, which holds the previous key
+ * of the block, and the number of ordinals that follow it.
+ */
+static bool read_block_key(FILE *fp, unsigned char *key,
+                           unsigned long *key_length, unsigned long *count) {
+  unsigned long shared, rest;
+
+  if (!read_varint(fp, &shared) || !read_varint(fp, &rest) ||
+      shared > *key_length || shared + rest > MAX_POSTINGS_KEY ||
+      fread(key + shared, 1, rest, fp) != rest || !read_varint(fp, count)) {
+    return false;
+  }
+  *key_length = shared + rest;
+  return true;
+}
+
+/* Add to result the ordinals of all keys that are at least low and
+ * at most high. If high_is_prefix then keys beginning with high
+ * are also included.
+ * Return without adding anything more if the table is damaged.
+ */
+void lookup_postings(PostingsTable *table, const unsigned char *low,
+                     unsigned low_length, const unsigned char *high,
+                     unsigned high_length, bool high_is_prefix,
+                     OrdinalSet *result) {
+  for (unsigned s = 0; s < table->num_segments; s++) {
+    const PostingsSegment *segment = &table->segments[s];
+    unsigned long first = 0, last = segment->num_blocks;
+    unsigned char key[MAX_POSTINGS_KEY];
+    bool finished = false;
+
+    if (segment->num_blocks == 0) {
+      continue;
+    }
+    /* Find the last block whose first key is not greater than low. */
+    while (last - first > 1) {
+      unsigned long mid = (first + last) / 2;
+      if (compare_keys(segment->first_keys[mid],
+                       segment->first_key_lengths[mid], low,
+                       low_length) <= 0) {
+        first = mid;
+      } else {
+        last = mid;
+      }
+    }
+    for (unsigned long b = first; b < segment->num_blocks && !finished;
+         b++) {
+      FILE *fp = table->fp;
+      unsigned long key_length = 0;
+      int keys_in_block;
+
+      if (fseek(fp, segment->block_offsets[b], SEEK_SET) != 0 ||
+          (keys_in_block = getc(fp)) == EOF) {
+        return;
+      }
+      for (int k = 0; k < keys_in_block && !finished; k++) {
+        unsigned long count, ordinal = 0;
+        bool wanted;
+
+        if (!read_block_key(fp, key, &key_length, &count)) {
+          return;
+        }
+        if (compare_keys(key, (unsigned)key_length, low, low_length) < 0) {
+          wanted = false;
+        } else if (compare_keys(key, (unsigned)key_length, high,
+                                high_length) <= 0) {
+          wanted = true;
+        } else if (high_is_prefix && key_length >= high_length &&
+                   memcmp(key, high, high_length) == 0) {
+          wanted = true;
+        } else {
+          wanted = false;
+          finished = true;
+        }
+        for (unsigned long i = 0; i < count; i++) {
+          unsigned long difference;
+          if (!read_varint(fp, &difference)) {
+            return;
+          }
+          ordinal += difference;
+          if (wanted) {
+            add_ordinal(result, ordinal);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* Add every key of every segment of table, with its ordinals,
+ * to builder, so that the segments can be merged into one.
+ * Return false if the table is damaged.
+ */
+bool copy_postings(PostingsTable *table, PostingsBuilder *builder) {
+  FILE *fp = table->fp;
+  unsigned char key[MAX_POSTINGS_KEY];
+
+  for (unsigned s = 0; s < table->num_segments; s++) {
+    const PostingsSegment *segment = &table->segments[s];
+
+    for (unsigned long b = 0; b < segment->num_blocks; b++) {
+      unsigned long key_length = 0;
+      int keys_in_block;
+
+      if (fseek(fp, segment->block_offsets[b], SEEK_SET) != 0 ||
+          (keys_in_block = getc(fp)) == EOF) {
+        return false;
+      }
+      for (int k = 0; k < keys_in_block; k++) {
+        unsigned long count, ordinal = 0;
+
+        if (!read_block_key(fp, key, &key_length, &count)) {
+          return false;
+        }
+        for (unsigned long i = 0; i < count; i++) {
+          unsigned long difference;
+          if (!read_varint(fp, &difference)) {
+            return false;
+          }
+          ordinal += difference;
+          add_posting(builder, key, (unsigned)key_length, ordinal);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/* Add ordinal to set. normalise_ordinal_set must be called before
+ * set is searched.
+ */
+void add_ordinal(OrdinalSet *set, unsigned long ordinal) {
+  if (set->num_ordinals == set->max_ordinals) {
+    set->max_ordinals = set->max_ordinals == 0 ? 64 : 2 * set->max_ordinals;
+    set->ordinals = (unsigned long *)realloc_or_die(
+        (void *)set->ordinals, set->max_ordinals * sizeof(*set->ordinals));
+  }
+  set->ordinals[set->num_ordinals++] = ordinal;
+}
+
+void clear_ordinal_set(OrdinalSet *set) {
+  (void)free((void *)set->ordinals);
+  set->ordinals = NULL;
+  set->num_ordinals = set->max_ordinals = 0;
+}
+
+static int compare_ordinals(const void *o1, const void *o2) {
+  unsigned long ordinal1 = *(const unsigned long *)o1;
+  unsigned long ordinal2 = *(const unsigned long *)o2;
+  return ordinal1 < ordinal2 ? -1 : ordinal1 > ordinal2 ? 1 : 0;
+}
+
+/* Sort set and remove any duplicates. */
+void normalise_ordinal_set(OrdinalSet *set) {
+  unsigned long kept = 0;
+
+  if (set->num_ordinals == 0) {
+    /* There may be no array to sort. */
+    return;
+  }
+  qsort(set->ordinals, set->num_ordinals, sizeof(*set->ordinals),
+        compare_ordinals);
+  for (unsigned long i = 0; i < set->num_ordinals; i++) {
+    if (kept == 0 || set->ordinals[kept - 1] != set->ordinals[i]) {
+      set->ordinals[kept++] = set->ordinals[i];
+    }
+  }
+  set->num_ordinals = kept;
+}
+
+/* Retain in set only those ordinals also in other.
+ * Both must have been normalised.
+ */
+void intersect_ordinal_sets(OrdinalSet *set, const OrdinalSet *other) {
+  unsigned long kept = 0, j = 0;
+
+  for (unsigned long i = 0; i < set->num_ordinals; i++) {
+    while (j < other->num_ordinals && other->ordinals[j] < set->ordinals[i]) {
+      j++;
+    }
+    if (j < other->num_ordinals && other->ordinals[j] == set->ordinals[i]) {
+      set->ordinals[kept++] = set->ordinals[i];
+    }
+  }
+  set->num_ordinals = kept;
+}
+
+/* Whether the normalised set contains ordinal. */
+bool ordinal_set_contains(const OrdinalSet *set, unsigned long ordinal) {
+  return set->num_ordinals > 0 &&
+         bsearch(&ordinal, set->ordinals, set->num_ordinals,
+                 sizeof(*set->ordinals), compare_ordinals) != NULL;
+}
@@ -0,0 +1,71 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Sorted tables of keys, each with a list of the numbers (ordinals)
+ * of the games in an input file in which the key occurs.
+ * These are used by the sidecar indexes of gameindex.c.
+ * Keys are arbitrary byte strings, compared as by memcmp.
+ */
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* The longest key that may be stored. */
+#define MAX_POSTINGS_KEY 255
+
+/* A set of game ordinals.
+ * Once normalised, these are held in ascending order without duplicates.
+ */
+typedef struct {
+  unsigned long *ordinals;
+  unsigned long num_ordinals;
+  unsigned long max_ordinals;
+} OrdinalSet;
+
+typedef struct PostingsBuilder PostingsBuilder;
+typedef struct PostingsTable PostingsTable;
+
+void add_ordinal(OrdinalSet *set, unsigned long ordinal);
+void add_posting(PostingsBuilder *builder, const unsigned char *key,
+                 unsigned key_length, unsigned long ordinal);
+void clear_ordinal_set(OrdinalSet *set);
+void close_postings_table(PostingsTable *table);
+bool copy_postings(PostingsTable *table, PostingsBuilder *builder);
+void free_postings_builder(PostingsBuilder *builder);
+void intersect_ordinal_sets(OrdinalSet *set, const OrdinalSet *other);
+void lookup_postings(PostingsTable *table, const unsigned char *low,
+                     unsigned low_length, const unsigned char *high,
+                     unsigned high_length, bool high_is_prefix,
+                     OrdinalSet *result);
+PostingsBuilder *new_postings_builder(void);
+void normalise_ordinal_set(OrdinalSet *set);
+bool ordinal_set_contains(const OrdinalSet *set, unsigned long ordinal);
+unsigned postings_segments(const PostingsTable *table);
+PostingsTable *read_postings_table(FILE *fp);
+bool read_fixed(FILE *fp, unsigned num_bytes, unsigned long *value);
+bool read_varint(FILE *fp, unsigned long *value);
+bool write_postings(PostingsBuilder *builder, FILE *fp, long previous_end);
+void write_fixed(FILE *fp, unsigned num_bytes, unsigned long value);
+void write_varint(FILE *fp, unsigned long value);
+
+#endif // POSTINGS_H
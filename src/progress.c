@@ -0,0 +1,184 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+#include "progress.h"
+
+#include "grammar.h"
+#include "lex.h"
+#include "typedef.h"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+/* Set by the timer when a report is due. */
+static volatile sig_atomic_t progress_due = 0;
+static bool progress_started = false;
+static struct timespec start_time;
+/* The games processed and bytes of input consumed before the start,
+ * by the run that a resumed run continues, which the rates exclude.
+ */
+static unsigned long start_games = 0;
+static unsigned long start_bytes = 0;
+static FILE *heartbeat = NULL;
+/* The length of the last line written to stderr, to be erased. */
+static int progress_line_length = 0;
+
+static void set_progress_due(int signal_number) { progress_due = 1; }
+
+/* Start the timer of the reports, if any are wanted. */
+void start_progress(const StateInfo *globals) {
+  struct sigaction action;
+  struct itimerval interval;
+  unsigned long total;
+
+  if ((globals->verbosity == 0 && globals->heartbeat_file == NULL) ||
+      globals->progress_interval == 0) {
+    return;
+  }
+  if (globals->heartbeat_file != NULL) {
+    heartbeat = must_open_file(globals, globals->heartbeat_file, "w");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  start_games = globals->num_games_processed;
+  input_progress(&start_bytes, &total);
+  action.sa_handler = set_progress_due;
+  sigemptyset(&action.sa_mask);
+  /* Interrupted reads and writes carry on. */
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGALRM, &action, NULL);
+  interval.it_interval.tv_sec = globals->progress_interval;
+  interval.it_interval.tv_usec = 0;
+  interval.it_value = interval.it_interval;
+  setitimer(ITIMER_REAL, &interval, NULL);
+  progress_started = true;
+}
+
+/* Write str as a JSON string to fp. */
+static void print_json_string(FILE *fp, const char *str) {
+  putc('"', fp);
+  for (; *str != '\0'; str++) {
+    if (*str == '"' || *str == '\\') {
+      putc('\\', fp);
+    }
+    putc(*str, fp);
+  }
+  putc('"', fp);
+}
+
+/* Write the current progress to stderr and the heartbeat file. */
+static void report_progress(const StateInfo *globals, bool finished) {
+  struct timespec now;
+  unsigned long consumed, total;
+  double seconds, games_per_second, bytes_per_second;
+  /* The estimated seconds to go, or -1 if unknown. */
+  double eta = -1;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  seconds = (double)(now.tv_sec - start_time.tv_sec) +
+            (double)(now.tv_nsec - start_time.tv_nsec) / 1e9;
+  if (seconds <= 0) {
+    seconds = 1e-9;
+  }
+  input_progress(&consumed, &total);
+  games_per_second = (globals->num_games_processed - start_games) / seconds;
+  bytes_per_second = (consumed - start_bytes) / seconds;
+  if (finished) {
+    eta = 0;
+  } else if (total > 0 && consumed > start_bytes && consumed <= total) {
+    eta = (total - consumed) / bytes_per_second;
+  }
+
+  if (globals->verbosity != 0 && !finished) {
+    int length = fprintf(stderr, "Games: %lu (%lu matched), %.1f",
+                         globals->num_games_processed,
+                         globals->num_games_matched, consumed / 1e6);
+    if (total > 0) {
+      length += fprintf(stderr, " of %.1f MB (%.0f%%)", total / 1e6,
+                        100.0 * consumed / total);
+    } else {
+      length += fprintf(stderr, " MB");
+    }
+    length += fprintf(stderr, ", %.0f games/s, %.2f MB/s", games_per_second,
+                      bytes_per_second / 1e6);
+    if (eta >= 0) {
+      unsigned long eta_seconds = (unsigned long)(eta + 0.5);
+
+      length += fprintf(stderr, ", ETA %lu:%02lu:%02lu", eta_seconds / 3600,
+                        eta_seconds / 60 % 60, eta_seconds % 60);
+    }
+    /* Cover the rest of a longer previous line. */
+    fprintf(stderr, "%*s\r",
+            progress_line_length > length ? progress_line_length - length : 0,
+            "");
+    progress_line_length = length;
+  }
+  if (heartbeat != NULL) {
+    fprintf(heartbeat, "{\"elapsed_seconds\": %.3f, \"games\": %lu, "
+                       "\"matched\": %lu, \"bytes\": %lu, \"total_bytes\": %lu",
+            seconds, globals->num_games_processed, globals->num_games_matched,
+            consumed, total);
+    fprintf(heartbeat, ", \"games_per_second\": %.0f, \"mb_per_second\": %.2f",
+            games_per_second, bytes_per_second / 1e6);
+    if (eta >= 0) {
+      fprintf(heartbeat, ", \"eta_seconds\": %.0f", eta);
+    } else {
+      fprintf(heartbeat, ", \"eta_seconds\": null");
+    }
+    fprintf(heartbeat, ", \"file\": ");
+    print_json_string(heartbeat, globals->current_input_file != NULL
+                                     ? globals->current_input_file
+                                     : "");
+    fprintf(heartbeat, ", \"finished\": %s}\n", finished ? "true" : "false");
+    fflush(heartbeat);
+  }
+}
+
+/* Report the progress at the end of a game if a report is due. */
+void note_progress(const StateInfo *globals) {
+  if (progress_due) {
+    progress_due = 0;
+    report_progress(globals, false);
+  }
+}
+
+/* Stop the timer, erase the progress line and write a final heartbeat. */
+void finish_progress(const StateInfo *globals) {
+  struct itimerval stop = {{0, 0}, {0, 0}};
+
+  if (!progress_started) {
+    return;
+  }
+  setitimer(ITIMER_REAL, &stop, NULL);
+  progress_started = false;
+  if (progress_line_length > 0) {
+    fprintf(stderr, "%*s\r", progress_line_length, "");
+    progress_line_length = 0;
+  }
+  if (heartbeat != NULL) {
+    report_progress(globals, true);
+    (void)fclose(heartbeat);
+    heartbeat = NULL;
+  }
+}
@@ -0,0 +1,41 @@
+/*
+ *  This file is part of pgn-extract: a Portable Game Notation (PGN) extractor.
+ *  Copyright (C) 1994-2024 David J. Barnes
+ *
+ *  pgn-extract is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  pgn-extract is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with pgn-extract. If not, see <http://www.gnu.org/licenses/>.
+ *
+ *  David J. Barnes may be contacted as d.j.barnes@kent.ac.uk
+ *  https://www.cs.kent.ac.uk/people/staff/djb/
+ */
+
+/* Progress reports of long runs.
+ * Unless --quiet is used, a line of progress is written to stderr
+ * every --progressinterval seconds (default 1): the games processed
+ * and matched, the bytes of input consumed out of the total size of
+ * the input files, games/s, MB/s and an estimate of the time to go.
+ * With --heartbeat the same is appended as a line of JSON to a file,
+ * such as /dev/fd/N, for programs that track long runs.
+ * A timer marks each report as due, so that processing a game costs
+ * no more than a test of a flag.
+ */
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include "typedef.h"
+
+void finish_progress(const StateInfo *globals);
+void note_progress(const StateInfo *globals);
+void start_progress(const StateInfo *globals);
+
+#endif // PROGRESS_H
@@ -21,8 +21,10 @@
 
 #include "taglist.h"
 
+#include "intern.h"
 #include "moves.h"
 #include "mymalloc.h"
+#include "postings.h"
 #include "typedef.h"
 
 #include <ctype.h>
@@ -432,6 +434,24 @@ static bool relative_numeric_match(const StateInfo *globals,
 #define MINDATE 100
 #define MAXDATE 3000
 
+/* Extract the year from date_string and encode the whole date
+ * as a number for relational comparisons.
+ * Return false if there is no year.
+ */
+static bool encode_date(const char *date_string, unsigned *year,
+                        unsigned *encoded_date) {
+  unsigned month = 1, day = 1;
+
+  if (sscanf(date_string, "%u", year) == 1) {
+    /* Try to extract month and day from the date string. */
+    sscanf(date_string, "%*u.%u.%u", &month, &day);
+    *encoded_date = 10000 * *year + 100 * month + day;
+    return true;
+  } else {
+    return false;
+  }
+}
+
 static bool check_date(const StateInfo *globals, const char *date_string,
                        const StringArray *list) {
   unsigned list_index;
@@ -441,11 +461,8 @@ static bool check_date(const StateInfo *globals, const char *date_string,
    * The first match is used to set wanted properly for the first time.
    */
   bool wanted = false;
-  unsigned game_year, game_month = 1, game_day = 1;
-  if (sscanf(date_string, "%u", &game_year) == 1) {
-    /* Try to extract month and day from the game's date string. */
-    sscanf(date_string, "%*u.%u.%u", &game_month, &game_day);
-    double encoded_game_date = 10000 * game_year + 100 * game_month + game_day;
+  unsigned game_year, encoded_game_date;
+  if (encode_date(date_string, &game_year, &encoded_game_date)) {
     for (list_index = 0; list_index < list->num_used_elements; list_index++) {
       const char *list_string = list->tag_strings[list_index].tag_string;
       TagOperator operator= list->tag_strings[list_index].operator;
@@ -461,12 +478,9 @@ static bool check_date(const StateInfo *globals, const char *date_string,
       }
       if (operator!= NONE) {
         /* We have a relational comparison. */
-        unsigned list_year, list_month = 1, list_day = 1;
-        if (sscanf(list_string, "%u", &list_year) == 1) {
+        unsigned list_year, encoded_list_date;
+        if (encode_date(list_string, &list_year, &encoded_list_date)) {
           if ((game_year > MINDATE) && (game_year < MAXDATE)) {
-            sscanf(list_string, "%*u.%u.%u", &list_month, &list_day);
-            double encoded_list_date =
-                10000 * list_year + 100 * list_month + list_day;
             bool matches = relative_numeric_match(
                 globals, operator, encoded_game_date, encoded_list_date);
             if (list_index == 0) {
@@ -852,6 +866,49 @@ static bool all_negative_matches(const StringArray *list) {
   return all_negative;
 }
 
+/* Check value, the value of tag in a game, against list. */
+static bool check_tag_value(const StateInfo *globals, int tag,
+                            const char *value, StringArray *list) {
+  bool wanted;
+
+  if (tag == DATE_TAG) {
+    wanted = check_date(globals, value, list);
+  } else if ((tag == WHITE_ELO_TAG) || (tag == BLACK_ELO_TAG)) {
+    wanted = check_elo(globals, value, list);
+  } else if (tag == TIME_CONTROL_TAG) {
+    wanted = check_time_control(globals, value, list);
+  } else {
+    wanted = check_list(globals, tag, value, list);
+  }
+  return wanted;
+}
+
+/* Return the value of tag in game, or NULL if it does not have one.
+ * Tags beyond those known in advance are found by a binary search
+ * of its extra_tags.
+ */
+const char *game_tag_value(const Game *game, unsigned tag) {
+  unsigned low = 0, high = game->num_extra_tags;
+
+  if (tag < ORIGINAL_NUMBER_OF_TAGS) {
+    return game->tags[tag];
+  }
+  while (low < high) {
+    unsigned mid = low + (high - low) / 2;
+
+    if (game->extra_tags[mid].tag < tag) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low < game->num_extra_tags && game->extra_tags[low].tag == tag) {
+    return game->extra_tags[low].value;
+  } else {
+    return NULL;
+  }
+}
+
 /* Check the Tag Details of this current game against those in
  * the wanted lists. Check all details apart from any ECO
  * tag as this is checked separately by CheckECOTag.
@@ -861,9 +918,10 @@ static bool all_negative_matches(const StringArray *list) {
  * games reaching this far are wanted.
  * Return true if wanted, false otherwise.
  */
-bool check_tag_details_not_ECO(const StateInfo *globals, char *Details[],
-                               int num_details, bool positive_match) {
+bool check_tag_details_not_ECO(const StateInfo *globals, const Game *game,
+                               bool positive_match) {
   bool wanted = true;
+  char **Details = game->tags;
   int tag;
 
   if (globals->check_tags) {
@@ -873,14 +931,6 @@ bool check_tag_details_not_ECO(const StateInfo *globals, char *Details[],
     } else {
       list = &negative_tags;
     }
-    /* Sanity check. */
-    if (num_details < list->list_length) {
-      fprintf(globals->logfile,
-              "Internal error: mismatch in tag set lengths in ");
-      fprintf(globals->logfile, "CheckTagDetailsNotECO: %d vs %d\n",
-              num_details, list->list_length);
-      exit(1);
-    }
 
     /* PSEUDO_PLAYER_TAG and PSEUDO_ELO_TAG are treated differently,
      * since they have the effect of or-ing together the WHITE_ and BLACK_
@@ -946,20 +996,9 @@ bool check_tag_details_not_ECO(const StateInfo *globals, char *Details[],
       } else if (tag == ECO_TAG) {
         /* This is handled separately. */
       } else if (list->list_of_tags[tag].num_used_elements != 0) {
-        if (Details[tag] != NULL) {
-          if (tag == DATE_TAG) {
-            wanted = check_date(globals, Details[tag],
-                                &list->list_of_tags[DATE_TAG]);
-          } else if ((tag == WHITE_ELO_TAG) || (tag == BLACK_ELO_TAG)) {
-            wanted = check_elo(globals, Details[tag], &list->list_of_tags[tag]);
-          } else if (tag == TIME_CONTROL_TAG) {
-            wanted = check_time_control(globals, Details[tag],
-                                        &list->list_of_tags[TIME_CONTROL_TAG]);
-          } else {
-            wanted = check_list(globals, tag, Details[tag],
-                                &list->list_of_tags[tag]);
-          }
-        } else {
+        const char *detail = game_tag_value(game, tag);
+
+        if (detail == NULL) {
           /* Matching tag not present.
            * If the matches are all negative, then that is ok.
            */
@@ -968,6 +1007,14 @@ bool check_tag_details_not_ECO(const StateInfo *globals, char *Details[],
           } else {
             wanted = false;
           }
+        } else if (!interned_tag(globals, tag)) {
+          wanted = check_tag_value(globals, tag, detail,
+                                   &list->list_of_tags[tag]);
+        } else if (!known_tag_match(detail, positive_match, &wanted)) {
+          /* The first game with this value since it was interned. */
+          wanted = check_tag_value(globals, tag, detail,
+                                   &list->list_of_tags[tag]);
+          note_tag_match(detail, positive_match, wanted);
         }
       } else {
         /* Not used. */
@@ -1016,3 +1063,227 @@ bool check_setup_tag(const StateInfo *globals, char *Details[]) {
     exit(1);
   }
 }
+
+/* The tags whose values are held in a tag index.
+ * Each value is keyed by its tag number followed by the value itself.
+ */
+static const TagName indexed_tags[] = {WHITE_TAG, BLACK_TAG, EVENT_TAG,
+                                       SITE_TAG,  DATE_TAG,  ECO_TAG};
+#define NUM_INDEXED_TAGS (sizeof(indexed_tags) / sizeof(indexed_tags[0]))
+/* Dates with a year in range are also keyed by this number followed
+ * by their encoded value, most significant byte first, so that
+ * relational date criteria can be resolved as a range of keys.
+ */
+#define ENCODED_DATE_KEY ORIGINAL_NUMBER_OF_TAGS
+#define ENCODED_DATE_KEY_LENGTH 5
+
+static void encoded_date_key(unsigned encoded_date, unsigned char *key) {
+  key[0] = ENCODED_DATE_KEY;
+  for (int i = ENCODED_DATE_KEY_LENGTH - 1; i > 0; i--) {
+    key[i] = (unsigned char)(encoded_date & 0xff);
+    encoded_date >>= 8;
+  }
+}
+
+/* Add to builder the keys of the indexed tags of the game
+ * with the given ordinal.
+ */
+void add_tag_index_keys(char *Details[], PostingsBuilder *builder,
+                        unsigned long ordinal) {
+  unsigned char key[MAX_POSTINGS_KEY];
+
+  for (unsigned i = 0; i < NUM_INDEXED_TAGS; i++) {
+    TagName tag = indexed_tags[i];
+    const char *value = Details[tag];
+
+    if (value != NULL) {
+      /* Long values are truncated, which still allows prefix matches
+       * of any criterion short enough to be looked up.
+       */
+      size_t length = strlen(value);
+      if (length > MAX_POSTINGS_KEY - 1) {
+        length = MAX_POSTINGS_KEY - 1;
+      }
+      key[0] = (unsigned char)tag;
+      memcpy(key + 1, value, length);
+      add_posting(builder, key, (unsigned)length + 1, ordinal);
+
+      if (tag == DATE_TAG) {
+        unsigned year, encoded_date;
+        if (encode_date(value, &year, &encoded_date) && year > MINDATE &&
+            year < MAXDATE) {
+          encoded_date_key(encoded_date, key);
+          add_posting(builder, key, ENCODED_DATE_KEY_LENGTH, ordinal);
+        }
+      }
+    }
+  }
+}
+
+/* Add to result the games in table having a value of tag
+ * with prefix as a prefix.
+ * Return false if prefix is too long to have been indexed.
+ */
+static bool lookup_tag_prefix(PostingsTable *table, TagName tag,
+                              const char *prefix, OrdinalSet *result) {
+  unsigned char key[MAX_POSTINGS_KEY];
+  size_t length = strlen(prefix);
+
+  if (length > MAX_POSTINGS_KEY - 1) {
+    return false;
+  }
+  key[0] = (unsigned char)tag;
+  memcpy(key + 1, prefix, length);
+  lookup_postings(table, key, (unsigned)length + 1, key, (unsigned)length + 1,
+                  true, result);
+  return true;
+}
+
+/* Resolve the Date criteria in list against table, in the same way
+ * as check_date. Either all of the criteria must be prefixes, or all
+ * must be relational.
+ */
+static bool lookup_date_criteria(PostingsTable *table, const StringArray *list,
+                                 OrdinalSet *result) {
+  unsigned num_relational = 0;
+  /* The range of encoded dates satisfying all the relational criteria. */
+  unsigned long low = 0, high = ~0U;
+
+  for (unsigned ix = 0; ix < list->num_used_elements; ix++) {
+    const char *list_string = list->tag_strings[ix].tag_string;
+    TagOperator operator= list->tag_strings[ix].operator;
+    unsigned year, encoded_date;
+
+    if (*list_string == 'b') {
+      operator= LESS_THAN;
+      list_string++;
+    } else if (*list_string == 'a') {
+      operator= GREATER_THAN;
+      list_string++;
+    }
+    if (operator== NONE) {
+      continue;
+    } else if (!encode_date(list_string, &year, &encoded_date)) {
+      return false;
+    }
+    num_relational++;
+    switch (operator) {
+    case LESS_THAN:
+      if (encoded_date == 0) {
+        return false;
+      }
+      high = encoded_date - 1 < high ? encoded_date - 1 : high;
+      break;
+    case LESS_THAN_OR_EQUAL_TO:
+      high = encoded_date < high ? encoded_date : high;
+      break;
+    case GREATER_THAN:
+      if (encoded_date == ~0U) {
+        return false;
+      }
+      low = encoded_date + 1UL > low ? encoded_date + 1UL : low;
+      break;
+    case GREATER_THAN_OR_EQUAL_TO:
+      low = encoded_date > low ? encoded_date : low;
+      break;
+    case EQUAL_TO:
+      low = encoded_date > low ? encoded_date : low;
+      high = encoded_date < high ? encoded_date : high;
+      break;
+    default:
+      return false;
+    }
+  }
+
+  if (num_relational == 0) {
+    for (unsigned ix = 0; ix < list->num_used_elements; ix++) {
+      if (!lookup_tag_prefix(table, DATE_TAG, list->tag_strings[ix].tag_string,
+                             result)) {
+        return false;
+      }
+    }
+    return true;
+  } else if (num_relational == list->num_used_elements) {
+    if (low <= high) {
+      unsigned char low_key[ENCODED_DATE_KEY_LENGTH];
+      unsigned char high_key[ENCODED_DATE_KEY_LENGTH];
+
+      encoded_date_key((unsigned)low, low_key);
+      encoded_date_key((unsigned)high, high_key);
+      lookup_postings(table, low_key, ENCODED_DATE_KEY_LENGTH, high_key,
+                      ENCODED_DATE_KEY_LENGTH, false, result);
+    }
+    return true;
+  } else {
+    return false;
+  }
+}
+
+/* Resolve the criteria for tag against table, adding to result the
+ * games that could match them.
+ * Return false if they cannot be resolved through the index.
+ */
+static bool lookup_tag_criteria(const StateInfo *globals,
+                                PostingsTable *table, TagName tag,
+                                OrdinalSet *result) {
+  const StringArray *list = &positive_tags.list_of_tags[tag];
+
+  if (tag == DATE_TAG) {
+    return lookup_date_criteria(table, list, result);
+  } else if (globals->tag_match_anywhere ||
+             (globals->use_soundex && soundex_tag(tag)) ||
+             (tag == ECO_TAG && globals->add_ECO)) {
+    return false;
+  }
+  for (unsigned ix = 0; ix < list->num_used_elements; ix++) {
+    const char *prefix = list->tag_strings[ix].tag_string;
+
+    if (list->tag_strings[ix].operator!= NONE) {
+      return false;
+    } else if (tag == PSEUDO_PLAYER_TAG) {
+      if (!lookup_tag_prefix(table, WHITE_TAG, prefix, result) ||
+          !lookup_tag_prefix(table, BLACK_TAG, prefix, result)) {
+        return false;
+      }
+    } else if (!lookup_tag_prefix(table, tag, prefix, result)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Use the tag index in table to find the games that could match
+ * the tag criteria.
+ * Return false if none of the criteria can be resolved through it;
+ * otherwise set candidates to the games that could match.
+ */
+bool tag_index_candidates(const StateInfo *globals, PostingsTable *table,
+                          OrdinalSet *candidates) {
+  bool resolved = false;
+
+  if (!globals->check_tags) {
+    return false;
+  }
+  for (unsigned i = 0; i <= NUM_INDEXED_TAGS; i++) {
+    TagName tag = i < NUM_INDEXED_TAGS ? indexed_tags[i] : PSEUDO_PLAYER_TAG;
+    OrdinalSet matches = {NULL, 0, 0};
+
+    if (positive_tags.list_of_tags[tag].num_used_elements == 0) {
+      /* No criteria. */
+    } else if (!lookup_tag_criteria(globals, table, tag, &matches)) {
+      clear_ordinal_set(&matches);
+    } else {
+      normalise_ordinal_set(&matches);
+      if (!resolved) {
+        clear_ordinal_set(candidates);
+        *candidates = matches;
+        resolved = true;
+      } else {
+        /* Different tags must all match. */
+        intersect_ordinal_sets(candidates, &matches);
+        clear_ordinal_set(&matches);
+      }
+    }
+  }
+  return resolved;
+}
@@ -32,6 +32,7 @@
 #ifndef TAGLIST_H
 #define TAGLIST_H
 
+#include "postings.h"
 #include "typedef.h"
 
 #include <stdbool.h>
@@ -135,6 +136,8 @@ typedef enum {
   REGEX
 } TagOperator;
 
+void add_tag_index_keys(char *Details[], PostingsBuilder *builder,
+                        unsigned long ordinal);
 void add_tag_to_negative_list(StateInfo *globals, int tag, const char *tagstr,
                               TagOperator operator);
 void add_tag_to_positive_list(StateInfo *globals, int tag, const char *tagstr,
@@ -142,10 +145,13 @@ void add_tag_to_positive_list(StateInfo *globals, int tag, const char *tagstr,
 bool check_setup_tag(const StateInfo *globals, char *Details[]);
 bool check_ECO_tag(const StateInfo *globals, char *Details[],
                    bool positive_match);
-bool check_tag_details_not_ECO(const StateInfo *globals, char *Details[],
-                               int num_details, bool positive_match);
+bool check_tag_details_not_ECO(const StateInfo *globals, const Game *game,
+                               bool positive_match);
 void extract_tag_argument(StateInfo *globals, const char *argstr,
                           bool positive_match);
+const char *game_tag_value(const Game *game, unsigned tag);
 void init_tag_lists(void);
+bool tag_index_candidates(const StateInfo *globals, PostingsTable *table,
+                          OrdinalSet *candidates);
 
 #endif // TAGLIST_H
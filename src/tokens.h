@@ -42,6 +42,10 @@ typedef enum {
   RAV_END,
   MOVE,
   TERMINATING_RESULT,
+  /* A whole game in a binary game file, to be read with
+   * next_binary_game.
+   */
+  BINARY_GAME,
   /* The remaining tokens are those that are used to
    * perform the identification.  They are not handled by
    * the parser.
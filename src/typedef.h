@@ -36,6 +36,8 @@
  *            non-capture and capture moves respectively.
  *     XOLALG: As XLALG but with O-O and O-O-O for castling moves.
  *     UCI: UCI-compatible format - actually LALG.
+ *     BIN: The compact binary format of binary.c.
+ *     POS: The fixed-size position records of positions.c.
  */
 #ifndef TYPEDEF_H
 #define TYPEDEF_H
@@ -68,7 +70,9 @@ typedef enum {
   ELALG,
   XLALG,
   XOLALG,
-  UCI
+  UCI,
+  BIN,
+  POS
 } OutputFormat;
 
 /* Define a type to specify whether a move gives check, checkmate,
@@ -118,30 +122,15 @@ typedef struct nag {
  */
 #define MAX_MOVE_LEN 15
 
-/* Retain the text of a move and any associated
- * NAGs and comments.
+/* Details of a move that are only needed for some forms of output,
+ * which are held apart from the move so that most moves do not
+ * carry them.
  */
-typedef struct move {
-  /* This array is of type unsigned char,
-   * in order to accommodate full 8-bit letters without
-   * sign extension.
-   */
-  unsigned char move[MAX_MOVE_LEN + 1];
-  /* Class of move, e.g. PAWN_MOVE, PIECE_MOVE. */
-  MoveClass class;
-  Col from_col;
-  Rank from_rank;
-  Col to_col;
-  Rank to_rank;
-  Piece piece_to_move;
-  /* captured_piece is EMPTY if there is no capture. */
-  Piece captured_piece;
-  /* promoted_piece is EMPTY if class is not PAWN_MOVE_WITH_PROMOTION. */
-  Piece promoted_piece;
-  /* Whether this move gives check. */
-  CheckStatus check_status;
+typedef struct {
   /* An EPD representation of the board immediately before this move
    * has been played.
+   * Set by annotate_move_FEN, which holds it and fen_suffix
+   * after the annotations.
    */
   char *epd;
   /* The move count additions to the EPD representation to complete
@@ -158,6 +147,36 @@ typedef struct move {
    * engine, say.
    */
   double evaluation;
+} MoveAnnotations;
+
+/* Retain the text of a move and any associated
+ * NAGs and comments.
+ * The enumerated details of the move are held in a byte each.
+ */
+typedef struct move {
+  /* This array is of type unsigned char,
+   * in order to accommodate full 8-bit letters without
+   * sign extension.
+   */
+  unsigned char move[MAX_MOVE_LEN + 1];
+  Col from_col;
+  Rank from_rank;
+  Col to_col;
+  Rank to_rank;
+  /* The MoveClass of the move, e.g. PAWN_MOVE, PIECE_MOVE. */
+  unsigned char class;
+  /* The Piece moved. */
+  unsigned char piece_to_move;
+  /* captured_piece is EMPTY if there is no capture. */
+  unsigned char captured_piece;
+  /* promoted_piece is EMPTY if class is not PAWN_MOVE_WITH_PROMOTION. */
+  unsigned char promoted_piece;
+  /* The CheckStatus of the move: whether it gives check. */
+  unsigned char check_status;
+  /* See annotate_move and move_annotations.
+   * NULL if the move has none.
+   */
+  MoveAnnotations *annotations;
   Nag *NAGs;
   CommentList *comment_list;
   /* terminating_result holds the result of the current list of moves. */
@@ -172,22 +191,39 @@ typedef struct move {
   struct move *prev, *next;
 } Move;
 
+/* The value of a tag that is not one of the ORIGINAL_NUMBER_OF_TAGS
+ * tags known in advance, identified by its index in the tag list.
+ */
+typedef struct {
+  unsigned tag;
+  char *value;
+} ExtraTag;
+
 /* Retain details of the header of a game.
  * This comprises the Tags and any comment prefixing the
  * moves of the game.
  */
 typedef struct {
-  /* The tag values. */
+  /* The values of the tags known in advance, indexed by their _TAG. */
   char **Tags;
-  unsigned header_tags_length;
+  /* The values of the other tags of the game, in order of tag index,
+   * so that a game pays only for the tags it has, however many
+   * different tags have been seen.
+   */
+  ExtraTag *extra_tags;
+  unsigned num_extra_tags;
+  unsigned extra_tags_allocated;
   CommentList *prefix_comment;
 } GameHeader;
 
 typedef struct {
-  /* Tags for this game. */
+  /* Tags for this game, indexed by their _TAG. */
   char **tags;
-  /* The maximum number of strings in tags. */
-  int tags_length;
+  /* The values of any tags beyond ORIGINAL_NUMBER_OF_TAGS,
+   * in order of tag index.
+   */
+  const ExtraTag *extra_tags;
+  unsigned num_extra_tags;
   /* Any comment prefixing the game, between
    * the tags and the moves.
    */
@@ -438,6 +474,44 @@ typedef struct {
   bool lichess_comment_fix;
   /* Only match games with at least one comment. */
   bool keep_only_commented_games;
+  /* Whether to write an index of the games in each input file. */
+  bool build_index;
+  /* The number of plies of each game whose positions are indexed.
+   * 0 => no limit.
+   */
+  unsigned index_ply_limit;
+  /* Whether to add to existing indexes only the games appended to
+   * each input file since they were built.
+   */
+  bool update_index;
+  /* Whether to cache the games parsed from each input file, and
+   * read them from the cache on later runs.
+   */
+  bool use_game_cache;
+  /* With -Wpos, write only every Nth position of each game. */
+  unsigned position_sample_interval;
+  /* With -Wpos, omit positions in which the side to move is in check. */
+  bool skip_positions_in_check;
+  /* The level of compression of compressed output files.
+   * 0 => the default level of the format.
+   */
+  int compression_level;
+  /* The depth of --perft. */
+  unsigned perft_depth;
+  /* Whether to report the memory allocated (--memstats). */
+  bool memory_statistics;
+  /* The number of most expensive games to report (--slowgames). */
+  unsigned slow_games_to_report;
+  /* The seconds between progress reports (--progressinterval).
+   * 0 => no reports.
+   */
+  unsigned progress_interval;
+  /* The seconds between checkpoints (--checkpointinterval). */
+  unsigned checkpoint_interval;
+  /* The number of values of each tag kept by --interntags.
+   * 0 => tag values are not interned.
+   */
+  unsigned interned_tag_values;
 
   /* The depth limit for splitting variations.
    * 0 => no limit.
@@ -458,6 +532,20 @@ typedef struct {
   const char *drop_comment_pattern;
   /* The comment marker to use for input line numbers, if required. */
   const char *line_number_marker;
+  /* The suffix added to the names of the output files of -# and -E
+   * to compress them (--compress).
+   */
+  const char *compressed_output_suffix;
+  /* The position of --perft. */
+  const char *perft_fen;
+  /* The EPD file of positions of --perftsuite. */
+  const char *perft_suite;
+  /* The file of JSON progress reports (--heartbeat). */
+  const char *heartbeat_file;
+  /* The file to which the state of the run is saved (--checkpoint). */
+  const char *checkpoint_file;
+  /* The file from which the state of the run is restored (--resume). */
+  const char *resume_file;
   /* Current input file name. */
   const char *current_input_file;
   /* File of ECO lines. */
@@ -689,7 +689,7 @@ uint64_t generate_zobrist_hash_from_board(const Board *board) {
     int board_col_index = ColConvert(FIRSTCOL);
     for (int c = 0; c < BOARDSIZE; c++, board_col_index++) {
       int piece_id = -1;
-      switch ((int)board->board[board_rank_index][board_col_index]) {
+      switch ((int)BOARD_SQUARE(board, board_rank_index, board_col_index)) {
       case B(PAWN):
         piece_id = 0;
         break;
@@ -776,12 +776,12 @@ uint64_t generate_zobrist_hash_from_board(const Board *board) {
       pawn = B(PAWN);
     }
     if ((ep_col > FIRSTCOL) &&
-        (board->board[RankConvert(from_rank)][ColConvert(ep_col - 1)] ==
+        (BOARD_SQUARE(board, RankConvert(from_rank), ColConvert(ep_col - 1)) ==
          pawn)) {
       redundant = false;
     }
     if (redundant && (ep_col < LASTCOL) &&
-        (board->board[RankConvert(from_rank)][ColConvert(ep_col + 1)] ==
+        (BOARD_SQUARE(board, RankConvert(from_rank), ColConvert(ep_col + 1)) ==
          pawn)) {
       redundant = false;
     }